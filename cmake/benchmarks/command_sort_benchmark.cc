@@ -0,0 +1,163 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+// Compares the command buffer radix sort against std::stable_sort on the
+// same keys, and measures recording and replaying into the memory backend.
+
+#include "rendering/command_buffer.h"
+#include "rendering/memory_render_backend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+using namespace tamarindo;
+
+constexpr size_t COMMANDS_PER_RUN = 10'000'000;
+
+constexpr uint32_t SHADER_COUNT = 16;
+constexpr uint32_t MATERIAL_COUNT = 256;
+constexpr uint32_t MESH_COUNT = 1024;
+constexpr uint32_t MAX_DEPTH = 1000;
+
+struct Command {
+    uint64_t key;
+    DrawPacket packet;
+};
+
+// Draws in scene order, with state spread like a typical scene: few
+// shaders, more materials and many meshes
+std::vector<Command> GenerateCommands(size_t count)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<uint32_t> shader_dist(0, SHADER_COUNT - 1);
+    std::uniform_int_distribution<uint32_t> material_dist(0,
+                                                          MATERIAL_COUNT - 1);
+    std::uniform_int_distribution<uint32_t> mesh_dist(0, MESH_COUNT - 1);
+    std::uniform_real_distribution<float> depth_dist(0.0f, MAX_DEPTH);
+
+    std::vector<Command> commands(count);
+    for (size_t i = 0; i < count; ++i) {
+        DrawPacket& packet = commands[i].packet;
+        packet.shader = shader_dist(rng);
+        packet.material = material_dist(rng);
+        packet.mesh = mesh_dist(rng);
+        packet.object_constants = static_cast<uint32_t>(i);
+        packet.index_count = 36;
+        packet.index_offset = 0;
+        packet.vertex_offset = 0;
+        commands[i].key = sort_key::Make(
+            0, 0, packet.shader, packet.material, packet.mesh,
+            sort_key::QuantizeDepth(depth_dist(rng), MAX_DEPTH));
+    }
+    return commands;
+}
+
+void Record(const std::vector<Command>& commands, CommandBuffer* buffer)
+{
+    buffer->Reset();
+    for (const Command& command : commands) {
+        buffer->AddDraw(command.key, command.packet);
+    }
+}
+
+// Runs `func` enough times to process COMMANDS_PER_RUN commands and returns
+// the average nanoseconds per command. `setup` runs before every call and is
+// not measured.
+template <typename Setup, typename Func>
+double Measure(size_t count, Setup setup, Func func)
+{
+    const size_t iterations = std::max<size_t>(1, COMMANDS_PER_RUN / count);
+
+    // Warm up caches
+    setup();
+    func();
+
+    double total_ns = 0.0;
+    for (size_t i = 0; i < iterations; ++i) {
+        setup();
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        const auto end = std::chrono::steady_clock::now();
+        total_ns +=
+            std::chrono::duration<double, std::nano>(end - start).count();
+    }
+    return total_ns / static_cast<double>(iterations * count);
+}
+
+}  // namespace
+
+int main()
+{
+    std::printf("%10s %16s %12s %10s\n", "count", "step", "ns/command",
+                "binds");
+
+    size_t checksum = 0;
+    for (const size_t count : {1'000, 10'000, 100'000, 1'000'000}) {
+        const std::vector<Command> commands = GenerateCommands(count);
+
+        CommandBuffer buffer;
+        buffer.Reserve(count);
+        const double record_ns =
+            Measure(count, [] {}, [&] { Record(commands, &buffer); });
+        std::printf("%10zu %16s %12.2f %10s\n", count, "record", record_ns,
+                    "");
+
+        std::vector<SortEntry> entries;
+        std::vector<SortEntry> scratch;
+        const auto copy_entries = [&] { entries = buffer.entries(); };
+        const double std_sort_ns = Measure(count, copy_entries, [&] {
+            std::stable_sort(entries.begin(), entries.end(),
+                             [](const SortEntry& a, const SortEntry& b) {
+                                 return a.key < b.key;
+                             });
+        });
+        checksum += entries[count / 2].packet_index;
+        std::printf("%10zu %16s %12.2f %10s\n", count, "std::stable",
+                    std_sort_ns, "");
+
+        const double radix_ns = Measure(count, copy_entries,
+                                        [&] { RadixSort(&entries, &scratch); });
+        checksum += entries[count / 2].packet_index;
+        std::printf("%10zu %16s %12.2f %9.2fx\n", count, "radix", radix_ns,
+                    std_sort_ns / radix_ns);
+
+        // Replays in recording order first, then sorted, to show the binds
+        // the sort saves
+        MemoryRenderBackend backend;
+        const auto clear_backend = [&] { backend.Clear(); };
+        const double unsorted_ns = Measure(
+            count, clear_backend, [&] { buffer.Submit(&backend); });
+        std::printf("%10zu %16s %12.2f %10zu\n", count, "submit unsorted",
+                    unsorted_ns, backend.bind_count());
+
+        buffer.Sort();
+        const double sorted_ns = Measure(count, clear_backend,
+                                         [&] { buffer.Submit(&backend); });
+        checksum += backend.draw_count();
+        std::printf("%10zu %16s %12.2f %10zu\n", count, "submit sorted",
+                    sorted_ns, backend.bind_count());
+    }
+
+    // Keeps the results alive so the compiler can not drop the work
+    std::printf("\nchecksum: %zu\n", checksum);
+    return 0;
+}
@@ -0,0 +1,285 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+// Compares the two ways the GL backend uploads the per-frame constants: the
+// persistently mapped ring buffer, and re-specifying the buffers with
+// glNamedBufferData. Runs headless, so it can use Mesa llvmpipe:
+//
+//   LIBGL_ALWAYS_SOFTWARE=1 ./gl_upload_benchmark
+//
+// "upload" is the time spent copying the constants, "wait" the time
+// BeginFrame() blocks on the fence of a ring region. Both paths have to
+// render the same image.
+
+#include "logging/logger.h"
+#include "rendering/command_buffer.h"
+#include "rendering/gl_render_backend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+using namespace tamarindo;
+
+constexpr unsigned int FRAME_COUNT = 50;
+constexpr unsigned int WIDTH = 1280;
+constexpr unsigned int HEIGHT = 720;
+
+// BACKGROUND_COLOR packed as RGBA8, red in the lowest byte
+constexpr uint32_t CLEAR_COLOR_RGBA8 = 0xFFCBBFAD;
+
+// Constants per object in the frame constant buffer, 256 bytes
+constexpr uint32_t OBJECT_CONSTANT_STRIDE = 16;
+constexpr size_t OBJECT_FLOAT_STRIDE = OBJECT_CONSTANT_STRIDE * 4;
+
+// SHADER_CODE from editor/game_data.h in GLSL. Matrices are read with the
+// same memory layout as the HLSL constant buffers, so vectors multiply on
+// the left as in mul(v, M).
+constexpr const char* SHADER_CODE = R"(
+    layout(std140, binding = 0) uniform PerSceneBuffer
+    {
+        mat4 viewProjectionMat;
+    };
+
+    layout(std140, binding = 1) uniform PerObjectBuffer
+    {
+        mat4 modelMat;
+    };
+
+    #ifdef TM_VERTEX_SHADER
+    layout(location = 0) in vec3 position;
+    layout(location = 1) in vec2 tex;
+
+    layout(location = 0) out vec2 outTex;
+
+    void main()
+    {
+        vec4 modelPosition = vec4(position, 1.0) * modelMat;
+        gl_Position = modelPosition * viewProjectionMat;
+        outTex = tex;
+    }
+    #endif
+
+    #ifdef TM_FRAGMENT_SHADER
+    layout(location = 0) in vec2 inTex;
+
+    layout(location = 0) out vec4 outColor;
+
+    void main()
+    {
+        outColor = vec4(inTex, 0.0, 1.0);
+    }
+    #endif
+)";
+
+// Cube with one UV square per face, wound clockwise seen from outside
+void CreateCube(std::vector<float>* vertices,
+                std::vector<unsigned int>* indices)
+{
+    const int faces[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4},
+                             {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+    const float uvs[4][2] = {{0, 0}, {0, 1}, {1, 1}, {1, 0}};
+    for (const auto& face : faces) {
+        const unsigned int base =
+            static_cast<unsigned int>(vertices->size() / 5);
+        for (int i = 0; i < 4; ++i) {
+            const int corner = face[i];
+            vertices->insert(vertices->end(),
+                             {(corner & 1) ? 0.5f : -0.5f,
+                              (corner & 2) ? 0.5f : -0.5f,
+                              (corner & 4) ? 0.5f : -0.5f, uvs[i][0],
+                              uvs[i][1]});
+        }
+        indices->insert(indices->end(), {base, base + 1, base + 2, base,
+                                         base + 2, base + 3});
+    }
+}
+
+// Left-handed perspective looking down +z, stored transposed like the scene
+// constant buffer
+void MakeViewProjection(float* out)
+{
+    const float z_near = 0.1f;
+    const float z_far = 200.0f;
+    const float y_scale = 1.0f / std::tan(0.5f);
+    const float x_scale = y_scale * HEIGHT / WIDTH;
+    const float range = z_far / (z_far - z_near);
+    const float matrix[16] = {x_scale, 0.0f,    0.0f,             0.0f,
+                              0.0f,    y_scale, 0.0f,             0.0f,
+                              0.0f,    0.0f,    range,            1.0f,
+                              0.0f,    0.0f,    -z_near * range, 0.0f};
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            out[column * 4 + row] = matrix[row * 4 + column];
+        }
+    }
+}
+
+// Transposed model matrices, one per 256 bytes
+std::vector<float> GenerateObjectConstants(size_t count)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> xy_dist(-30.0f, 30.0f);
+    std::uniform_real_distribution<float> z_dist(2.0f, 120.0f);
+
+    std::vector<float> constants(count * OBJECT_FLOAT_STRIDE, 0.0f);
+    for (size_t i = 0; i < count; ++i) {
+        float* out = &constants[i * OBJECT_FLOAT_STRIDE];
+        out[0] = 1.0f;
+        out[5] = 1.0f;
+        out[10] = 1.0f;
+        out[15] = 1.0f;
+        // Translation, transposed into the last column
+        out[3] = xy_dist(rng);
+        out[7] = xy_dist(rng);
+        out[11] = z_dist(rng);
+    }
+    return constants;
+}
+
+uint64_t HashImage(const std::vector<uint32_t>& pixels)
+{
+    uint64_t hash = 1469598103934665603ull;
+    for (const uint32_t pixel : pixels) {
+        hash = (hash ^ pixel) * 1099511628211ull;
+    }
+    return hash;
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point start,
+                 std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+}  // namespace
+
+int main()
+{
+    Logger logger;
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    CreateCube(&vertices, &indices);
+    float view_projection[16];
+    MakeViewProjection(view_projection);
+    const float clear_color[4] = {0.678f, 0.749f, 0.796f, 1.0f};
+
+    std::printf("%12s %8s %10s %10s %10s %10s %10s\n", "upload", "draws",
+                "upload ms", "submit ms", "wait ms", "frame ms", "covered");
+
+    bool is_consistent = true;
+    for (const size_t draw_count : {1'000, 10'000}) {
+        const std::vector<float> object_constants =
+            GenerateObjectConstants(draw_count);
+
+        uint64_t reference_hash = 0;
+        for (const bool use_persistent_mapping : {true, false}) {
+            GLRenderBackendParams params;
+            params.width = WIDTH;
+            params.height = HEIGHT;
+            params.use_persistent_mapping = use_persistent_mapping;
+            GLRenderBackend backend;
+            if (!backend.Initialize(params)) {
+                return 1;
+            }
+
+            const uint32_t shader = backend.CreateShader(SHADER_CODE);
+            const uint32_t mesh = backend.CreateMesh(vertices, indices);
+            if (shader == RenderBackend::INVALID_HANDLE ||
+                mesh == RenderBackend::INVALID_HANDLE) {
+                return 1;
+            }
+
+            CommandBuffer command_buffer;
+            for (size_t i = 0; i < draw_count; ++i) {
+                // Translation z, transposed into the third row
+                const float z = object_constants[i * OBJECT_FLOAT_STRIDE + 11];
+                DrawPacket packet;
+                packet.shader = shader;
+                packet.material = 0;
+                packet.mesh = mesh;
+                packet.object_constants =
+                    static_cast<uint32_t>(i) * OBJECT_CONSTANT_STRIDE;
+                packet.index_count = static_cast<uint32_t>(indices.size());
+                packet.index_offset = 0;
+                packet.vertex_offset = 0;
+                command_buffer.AddDraw(
+                    sort_key::Make(0, 0, 0, 0, 0,
+                                   sort_key::QuantizeDepth(z, 200.0f)),
+                    packet);
+            }
+            command_buffer.Sort();
+
+            double upload_ms = 0.0;
+            double submit_ms = 0.0;
+            double wait_ms = 0.0;
+            for (unsigned int frame = 0; frame < FRAME_COUNT; ++frame) {
+                const auto start = std::chrono::steady_clock::now();
+                if (!backend.BeginFrame(clear_color)) {
+                    return 1;
+                }
+                const auto waited = std::chrono::steady_clock::now();
+                backend.SetSceneConstants(view_projection);
+                backend.SetObjectConstantData(
+                    object_constants.data(),
+                    object_constants.size() * sizeof(float));
+                const auto uploaded = std::chrono::steady_clock::now();
+                command_buffer.Submit(&backend);
+                if (!backend.EndFrame()) {
+                    return 1;
+                }
+                const auto submitted = std::chrono::steady_clock::now();
+
+                wait_ms += ElapsedMs(start, waited);
+                upload_ms += ElapsedMs(waited, uploaded);
+                submit_ms += ElapsedMs(uploaded, submitted);
+            }
+
+            // Pixels that are not the clear color, as a sanity check of the
+            // last frame
+            std::vector<uint32_t> pixels;
+            if (!backend.ReadColorBuffer(&pixels)) {
+                return 1;
+            }
+            const size_t covered = static_cast<size_t>(
+                std::count_if(pixels.begin(), pixels.end(),
+                              [](uint32_t pixel) {
+                                  return pixel != CLEAR_COLOR_RGBA8;
+                              }));
+
+            const uint64_t hash = HashImage(pixels);
+            if (use_persistent_mapping) {
+                reference_hash = hash;
+            }
+            is_consistent = is_consistent && hash == reference_hash;
+
+            std::printf("%12s %8zu %10.3f %10.3f %10.3f %10.3f %10zu\n",
+                        use_persistent_mapping ? "ring" : "buffer data",
+                        draw_count, upload_ms / FRAME_COUNT,
+                        submit_ms / FRAME_COUNT, wait_ms / FRAME_COUNT,
+                        (upload_ms + submit_ms + wait_ms) / FRAME_COUNT,
+                        covered);
+        }
+    }
+    return is_consistent ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+// Compares building and tearing down the GameObject tree of a glTF model
+// with GameObjectArena against the previous path, which did a `new` per node
+// and a recursive delete.
+//
+// Usage: gltf_load_benchmark [model.glb]
+// Without a model, a synthetic scene with SYNTHETIC_NODE_COUNT nodes is used.
+
+#include "engine_lib/world/game_object.h"
+#include "engine_lib/world/game_object_arena.h"
+#include "engine_lib/world/gltf_game_object_loader.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+namespace
+{
+
+std::atomic<size_t> g_AllocationCount{0};
+std::atomic<size_t> g_FreeCount{0};
+
+}  // namespace
+
+void* operator new(size_t size)
+{
+    g_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr != nullptr) {
+        g_FreeCount.fetch_add(1, std::memory_order_relaxed);
+        std::free(ptr);
+    }
+}
+
+void operator delete(void* ptr, size_t /*size*/) noexcept
+{
+    operator delete(ptr);
+}
+
+// std::pmr::new_delete_resource() goes through the aligned overloads. The
+// original pointer is stored right before the aligned block.
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    g_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+    const size_t align = static_cast<size_t>(alignment);
+    void* raw = std::malloc(size + align + sizeof(void*));
+    if (raw == nullptr) {
+        throw std::bad_alloc();
+    }
+    const uintptr_t aligned =
+        (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + align - 1) &
+        ~(uintptr_t{align} - 1);
+    reinterpret_cast<void**>(aligned)[-1] = raw;
+    return reinterpret_cast<void*>(aligned);
+}
+
+void operator delete(void* ptr, std::align_val_t /*alignment*/) noexcept
+{
+    if (ptr != nullptr) {
+        g_FreeCount.fetch_add(1, std::memory_order_relaxed);
+        std::free(static_cast<void**>(ptr)[-1]);
+    }
+}
+
+void operator delete(void* ptr, size_t /*size*/,
+                     std::align_val_t alignment) noexcept
+{
+    operator delete(ptr, alignment);
+}
+
+namespace
+{
+
+using namespace tamarindo;
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t SYNTHETIC_NODE_COUNT = 100'000;
+constexpr size_t SYNTHETIC_CHILDREN_PER_NODE = 8;
+constexpr int RUN_COUNT = 10;
+
+struct Measurement {
+    size_t build_allocations = 0;
+    size_t teardown_frees = 0;
+    double build_ms = 0.0;
+    double teardown_ms = 0.0;
+};
+
+// Wide tree with realistic, heap-sized node names
+tinygltf::Model generateModel()
+{
+    tinygltf::Model model;
+    model.meshes.resize(1);
+    model.nodes.resize(SYNTHETIC_NODE_COUNT);
+    for (size_t i = 0; i < SYNTHETIC_NODE_COUNT; ++i) {
+        tinygltf::Node& node = model.nodes[i];
+        node.name = "SM_Building_Window_Frame_" + std::to_string(i);
+        node.mesh = (i % 2 == 0) ? 0 : -1;
+        node.translation = {1.0, 2.0, 3.0};
+        for (size_t c = 1; c <= SYNTHETIC_CHILDREN_PER_NODE; ++c) {
+            const size_t child = i * SYNTHETIC_CHILDREN_PER_NODE + c;
+            if (child < SYNTHETIC_NODE_COUNT) {
+                node.children.push_back(static_cast<int>(child));
+            }
+        }
+    }
+    model.scenes.resize(1);
+    model.scenes[0].nodes.push_back(0);
+    model.defaultScene = 0;
+    return model;
+}
+
+// What GLTFGameObjectLoader did before the arena
+GameObject* buildPerNode(const tinygltf::Model& model, int node_index)
+{
+    const tinygltf::Node& node = model.nodes[node_index];
+    GameObject* game_object =
+        node.name.empty() ? new GameObject() : new GameObject(node.name);
+    game_object->m_MeshIndex = node.mesh;
+    for (const int child_index : node.children) {
+        game_object->addChild(buildPerNode(model, child_index));
+    }
+    return game_object;
+}
+
+double elapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+
+Measurement measurePerNode(const tinygltf::Model& model)
+{
+    Measurement result;
+    for (int run = 0; run < RUN_COUNT; ++run) {
+        const size_t allocations = g_AllocationCount.load();
+        auto start = Clock::now();
+        GameObject* root = new GameObject();
+        for (const int node_index : model.scenes[model.defaultScene].nodes) {
+            root->addChild(buildPerNode(model, node_index));
+        }
+        result.build_ms += elapsedMs(start);
+        result.build_allocations = g_AllocationCount.load() - allocations;
+
+        const size_t frees = g_FreeCount.load();
+        start = Clock::now();
+        root->terminate();
+        delete root;
+        result.teardown_ms += elapsedMs(start);
+        result.teardown_frees = g_FreeCount.load() - frees;
+    }
+    result.build_ms /= RUN_COUNT;
+    result.teardown_ms /= RUN_COUNT;
+    return result;
+}
+
+Measurement measureArena(const tinygltf::Model& model)
+{
+    Measurement result;
+    for (int run = 0; run < RUN_COUNT; ++run) {
+        GameObjectArena arena;
+
+        const size_t allocations = g_AllocationCount.load();
+        auto start = Clock::now();
+        GLTFGameObjectLoader::load(model, &arena);
+        result.build_ms += elapsedMs(start);
+        result.build_allocations = g_AllocationCount.load() - allocations;
+
+        const size_t frees = g_FreeCount.load();
+        start = Clock::now();
+        arena.release();
+        result.teardown_ms += elapsedMs(start);
+        result.teardown_frees = g_FreeCount.load() - frees;
+    }
+    result.build_ms /= RUN_COUNT;
+    result.teardown_ms /= RUN_COUNT;
+    return result;
+}
+
+void printMeasurement(const char* path, const Measurement& m)
+{
+    std::printf("%10s %12zu %10.3f %12zu %12.3f\n", path, m.build_allocations,
+                m.build_ms, m.teardown_frees, m.teardown_ms);
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    tinygltf::Model model;
+    if (argc > 1) {
+        tinygltf::TinyGLTF loader;
+        std::string err;
+        std::string warn;
+        const auto start = Clock::now();
+        if (!loader.LoadBinaryFromFile(&model, &err, &warn, argv[1])) {
+            std::printf("Could not load %s: %s\n", argv[1], err.c_str());
+            return 1;
+        }
+        std::printf("Parsed %s in %.3f ms\n", argv[1], elapsedMs(start));
+        if (model.scenes.empty()) {
+            std::printf("%s has no scenes\n", argv[1]);
+            return 1;
+        }
+        // Same fallback as the loader when the file names no scene
+        if (model.defaultScene < 0) {
+            model.defaultScene = 0;
+        }
+    } else {
+        model = generateModel();
+        std::printf("Synthetic model\n");
+    }
+    std::printf("%zu nodes, average of %d runs\n\n", model.nodes.size(),
+                RUN_COUNT);
+
+    std::printf("%10s %12s %10s %12s %12s\n", "path", "allocations",
+                "build ms", "frees", "teardown ms");
+    printMeasurement("per-node", measurePerNode(model));
+    printMeasurement("arena", measureArena(model));
+    return 0;
+}
@@ -0,0 +1,296 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+// Runs the CPU side of the frame loop against the null backend: update the
+// transforms, build the draw list with the DrawListBuilder the editor uses
+// (frustum culling, occlusion culling and level of detail selection), record
+// the visible draws on all threads, sort and submit. Reports the time per
+// frame of each step and what the backend received.
+
+#include "rendering/command_buffer.h"
+#include "rendering/draw_list_builder.h"
+#include "rendering/null_render_backend.h"
+#include "rendering/parallel_command_recorder.h"
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+using namespace tamarindo;
+
+constexpr unsigned int FRAME_COUNT = 200;
+
+constexpr uint32_t SHADER_COUNT = 8;
+constexpr uint32_t MESH_COUNT = 64;
+constexpr float MAX_DEPTH = 1000.0f;
+
+// Position and uv, like the editor meshes
+constexpr unsigned int VERTEX_FLOAT_COUNT = 5;
+
+constexpr float FOV_ANGLE_IN_RADIANS = DirectX::XM_PIDIV4;
+constexpr float VIEWPORT_WIDTH = 1280.0f;
+constexpr float VIEWPORT_HEIGHT = 720.0f;
+
+// One object in this many is a large occluder
+constexpr uint32_t OCCLUDER_INTERVAL = 64;
+constexpr float OBJECT_SIZE = 4.0f;
+constexpr float OCCLUDER_SIZE = 60.0f;
+
+// Constants per object in the frame constant buffer, 256 bytes
+constexpr uint32_t OBJECT_CONSTANT_STRIDE = 16;
+
+struct Object {
+    float position[3];
+    float velocity[3];
+    float size;
+    uint32_t shader;
+    uint32_t mesh;
+};
+
+// The data stays on the CPU too, occluders are rasterized from it
+struct Mesh {
+    uint32_t handle;
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<LodLevel> levels;
+};
+
+// Appends a grid of `cells` x `cells` quads facing the camera, in the unit
+// square of the XY plane, as one more level of `mesh`
+void AddGridLevel(unsigned int cells, float geometric_error, Mesh* mesh)
+{
+    LodLevel level;
+    level.index_offset = static_cast<unsigned int>(mesh->indices.size());
+    level.vertex_offset =
+        static_cast<unsigned int>(mesh->vertices.size() / VERTEX_FLOAT_COUNT);
+    level.geometric_error = geometric_error;
+
+    for (unsigned int y = 0; y <= cells; ++y) {
+        for (unsigned int x = 0; x <= cells; ++x) {
+            const float u = static_cast<float>(x) / cells;
+            const float v = static_cast<float>(y) / cells;
+            mesh->vertices.insert(mesh->vertices.end(), {u, v, 0.0f, u, v});
+        }
+    }
+    for (unsigned int y = 0; y < cells; ++y) {
+        for (unsigned int x = 0; x < cells; ++x) {
+            const unsigned int i = y * (cells + 1) + x;
+            mesh->indices.insert(mesh->indices.end(),
+                                 {i, i + cells + 1, i + 1, i + 1,
+                                  i + cells + 1, i + cells + 2});
+        }
+    }
+    level.index_count =
+        static_cast<unsigned int>(mesh->indices.size()) - level.index_offset;
+    mesh->levels.push_back(level);
+}
+
+// Like the editor grid with a coarse level of a single quad. The grid is
+// flat so the coarse level is exact, the error given to it only makes the
+// distant objects switch like real meshes would.
+Mesh CreateGridMesh(RenderBackend* backend, unsigned int cells)
+{
+    Mesh mesh;
+    AddGridLevel(cells, /*geometric_error=*/0.0f, &mesh);
+    AddGridLevel(1, /*geometric_error=*/0.5f / cells, &mesh);
+    mesh.handle = backend->CreateMesh(mesh.vertices, mesh.indices);
+    return mesh;
+}
+
+std::vector<Object> GenerateObjects(size_t count)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position_dist(-400.0f, 400.0f);
+    std::uniform_real_distribution<float> velocity_dist(-1.0f, 1.0f);
+    std::uniform_int_distribution<uint32_t> shader_dist(0, SHADER_COUNT - 1);
+    std::uniform_int_distribution<uint32_t> mesh_dist(0, MESH_COUNT - 1);
+
+    std::vector<Object> objects(count);
+    for (size_t i = 0; i < count; ++i) {
+        Object& object = objects[i];
+        for (int axis = 0; axis < 3; ++axis) {
+            object.position[axis] = position_dist(rng);
+            object.velocity[axis] = velocity_dist(rng);
+        }
+        object.position[2] += 500.0f;
+        object.size =
+            i % OCCLUDER_INTERVAL == 0 ? OCCLUDER_SIZE : OBJECT_SIZE;
+        object.shader = shader_dist(rng);
+        object.mesh = mesh_dist(rng);
+    }
+    return objects;
+}
+
+// Moves the objects and computes their world matrices and bounds, like the
+// update thread of the editor writes its snapshot
+void Update(float delta_time, const DirectX::BoundingBox& local_bounds,
+            std::vector<Object>* objects,
+            std::vector<DirectX::XMMATRIX>* world_matrices,
+            std::vector<DirectX::BoundingBox>* world_bounds)
+{
+    for (size_t i = 0; i < objects->size(); ++i) {
+        Object& object = (*objects)[i];
+        for (int axis = 0; axis < 3; ++axis) {
+            object.position[axis] += object.velocity[axis] * delta_time;
+        }
+        (*world_matrices)[i] =
+            DirectX::XMMatrixScaling(object.size, object.size, 1.0f) *
+            DirectX::XMMatrixTranslation(object.position[0],
+                                         object.position[1],
+                                         object.position[2]);
+        local_bounds.Transform((*world_bounds)[i], (*world_matrices)[i]);
+    }
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point start,
+                 std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+}  // namespace
+
+int main()
+{
+    NullRenderBackend backend;
+    std::vector<uint32_t> shaders;
+    for (uint32_t i = 0; i < SHADER_COUNT; ++i) {
+        shaders.push_back(backend.CreateShader("pos_uv"));
+    }
+    std::vector<Mesh> meshes;
+    for (uint32_t i = 0; i < MESH_COUNT; ++i) {
+        meshes.push_back(CreateGridMesh(&backend, 1 + i % 16));
+    }
+    const DirectX::BoundingBox local_bounds(
+        DirectX::XMFLOAT3(0.5f, 0.5f, 0.0f),
+        DirectX::XMFLOAT3(0.5f, 0.5f, 0.0f));
+
+    // Camera at the origin looking down +z, at the objects
+    DrawListView view;
+    view.view_proj = DirectX::XMMatrixPerspectiveFovLH(
+        FOV_ANGLE_IN_RADIANS, VIEWPORT_WIDTH / VIEWPORT_HEIGHT, 0.1f,
+        MAX_DEPTH);
+    view.eye_position = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+    view.fov_angle_in_radians = FOV_ANGLE_IN_RADIANS;
+    view.viewport_height = VIEWPORT_HEIGHT;
+
+    ParallelCommandRecorder recorder{ParallelCommandRecorderParams()};
+    const unsigned long long uploaded_bytes = backend.stats().uploaded_bytes;
+    std::printf("Recording threads: %u, uploaded %llu bytes\n\n",
+                recorder.thread_count(), uploaded_bytes);
+    std::printf("%10s %10s %10s %10s %10s %10s %10s %10s %8s\n", "objects",
+                "update", "build", "record", "submit", "frame ms", "visible",
+                "occluded", "invalid");
+
+    for (const size_t count : {1'000, 10'000, 100'000}) {
+        std::vector<Object> objects = GenerateObjects(count);
+        std::vector<DirectX::XMMATRIX> world_matrices(count);
+        std::vector<DirectX::BoundingBox> world_bounds(count);
+
+        DrawListBuilder builder{DrawListBuilderParams()};
+        for (size_t i = 0; i < count; ++i) {
+            const Mesh& mesh = meshes[objects[i].mesh];
+            const LodLevel& coarsest = mesh.levels.back();
+            OccluderGeometry occluder;
+            occluder.vertices =
+                &mesh.vertices[coarsest.vertex_offset * VERTEX_FLOAT_COUNT];
+            occluder.vertex_stride = VERTEX_FLOAT_COUNT;
+            occluder.indices = &mesh.indices[coarsest.index_offset];
+            occluder.index_count = coarsest.index_count;
+            builder.AddDraw(local_bounds, mesh.levels,
+                            i % OCCLUDER_INTERVAL == 0 ? &occluder : nullptr);
+        }
+
+        std::vector<unsigned int> visible_draws;
+        CommandBuffer command_buffer;
+
+        const ParallelCommandRecorder::RecordFunction record =
+            [&objects, &shaders, &meshes, &world_bounds, &visible_draws,
+             &builder, &view](size_t begin, size_t end,
+                              CommandBuffer* buffer) {
+                for (size_t i = begin; i < end; ++i) {
+                    const unsigned int draw_id = visible_draws[i];
+                    const Object& object = objects[draw_id];
+
+                    const DirectX::XMVECTOR center =
+                        DirectX::XMVector3Transform(
+                            DirectX::XMLoadFloat3(
+                                &world_bounds[draw_id].Center),
+                            view.view_proj);
+                    const uint16_t depth = sort_key::QuantizeDepth(
+                        DirectX::XMVectorGetW(center), MAX_DEPTH);
+
+                    const LodLevel& level = builder.GetSelectedLevel(draw_id);
+                    DrawPacket packet;
+                    packet.shader = shaders[object.shader];
+                    packet.material = 0;
+                    packet.mesh = meshes[object.mesh].handle;
+                    packet.object_constants = draw_id * OBJECT_CONSTANT_STRIDE;
+                    packet.index_count = level.index_count;
+                    packet.index_offset = level.index_offset;
+                    packet.vertex_offset = level.vertex_offset;
+                    buffer->AddDraw(sort_key::Make(0, 0, object.shader, 0,
+                                                   object.mesh, depth),
+                                    packet);
+                }
+            };
+
+        double update_ms = 0.0;
+        double build_ms = 0.0;
+        double record_ms = 0.0;
+        double submit_ms = 0.0;
+        size_t visible_count = 0;
+        size_t occluded_count = 0;
+        for (unsigned int frame = 0; frame < FRAME_COUNT; ++frame) {
+            backend.ResetFrameStats();
+
+            const auto start = std::chrono::steady_clock::now();
+            Update(1.0f / 60.0f, local_bounds, &objects, &world_matrices,
+                   &world_bounds);
+            const auto updated = std::chrono::steady_clock::now();
+            builder.Build(view, world_matrices, world_bounds, &visible_draws);
+            const auto built = std::chrono::steady_clock::now();
+            recorder.Record(visible_draws.size(), record, &command_buffer);
+            const auto recorded = std::chrono::steady_clock::now();
+            command_buffer.Submit(&backend);
+            const auto submitted = std::chrono::steady_clock::now();
+
+            update_ms += ElapsedMs(start, updated);
+            build_ms += ElapsedMs(updated, built);
+            record_ms += ElapsedMs(built, recorded);
+            submit_ms += ElapsedMs(recorded, submitted);
+            visible_count += visible_draws.size();
+            occluded_count += builder.occlusion_stats().occluded_count;
+        }
+
+        const NullRenderBackendStats& stats = backend.stats();
+        std::printf(
+            "%10zu %10.3f %10.3f %10.3f %10.3f %10.3f %10zu %10zu %8zu\n",
+            count, update_ms / FRAME_COUNT, build_ms / FRAME_COUNT,
+            record_ms / FRAME_COUNT, submit_ms / FRAME_COUNT,
+            (update_ms + build_ms + record_ms + submit_ms) / FRAME_COUNT,
+            visible_count / FRAME_COUNT, occluded_count / FRAME_COUNT,
+            stats.invalid_call_count);
+    }
+    return 0;
+}
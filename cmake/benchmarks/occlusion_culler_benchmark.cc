@@ -0,0 +1,173 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+// Checks the working layer restart of the occlusion culler, then measures
+// the time per frame to rasterize a growing number of occluders and to test
+// a fixed set of boxes against them. Exits with 1 if the check fails.
+
+#include "rendering/occlusion_culler.h"
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace tamarindo
+{
+
+// Reaches the tiles through the friend declaration of OcclusionCuller
+class OcclusionCullerTester
+{
+   public:
+    // A far wall covers half of tile 0, then a near occluder the other half.
+    // Merging them would only move layer 0 to the wall, restarting the
+    // working layer lets the near occluder cover the tile on its own.
+    static bool CheckLayerRestart()
+    {
+        constexpr uint32_t LOW_HALF = 0x0000FFFFu;
+        constexpr uint32_t HIGH_HALF = 0xFFFF0000u;
+
+        OcclusionCuller culler{OcclusionCullerParams()};
+        culler.BeginFrame(DirectX::XMMatrixIdentity());
+        const float far_depth = culler.tile_depth0_[0];
+
+        culler.UpdateTile(0, LOW_HALF, 0.9f);
+        if (!Expect(culler.tile_depth1_[0] == 0.9f &&
+                        culler.tile_coverage_[0] == LOW_HALF,
+                    "the far wall starts the working layer")) {
+            return false;
+        }
+        culler.UpdateTile(0, HIGH_HALF, 0.1f);
+        if (!Expect(culler.tile_depth0_[0] == far_depth &&
+                        culler.tile_depth1_[0] == 0.1f &&
+                        culler.tile_coverage_[0] == HIGH_HALF,
+                    "the near occluder restarts the working layer")) {
+            return false;
+        }
+        culler.UpdateTile(0, LOW_HALF, 0.1f);
+        return Expect(culler.tile_depth0_[0] == 0.1f &&
+                          culler.tile_coverage_[0] == 0,
+                      "the near occluders cover the tile");
+    }
+
+   private:
+    static bool Expect(bool condition, const char* what)
+    {
+        if (!condition) {
+            std::printf("Layer restart check failed: %s\n", what);
+        }
+        return condition;
+    }
+};
+
+}  // namespace tamarindo
+
+namespace
+{
+
+using namespace tamarindo;
+
+constexpr unsigned int FRAME_COUNT = 100;
+constexpr unsigned int BOX_COUNT = 10'000;
+
+// A quad in the unit square of the XY plane, facing the camera
+constexpr float QUAD_VERTICES[] = {0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                                   0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f};
+constexpr unsigned int QUAD_INDICES[] = {0, 2, 1, 1, 2, 3};
+
+// Occluders are nearer than the boxes, so larger counts hide more of them
+std::vector<DirectX::XMMATRIX> GenerateOccluders(unsigned int count)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position_dist(-150.0f, 150.0f);
+    std::uniform_real_distribution<float> depth_dist(100.0f, 300.0f);
+    std::uniform_real_distribution<float> size_dist(20.0f, 80.0f);
+
+    std::vector<DirectX::XMMATRIX> worlds(count);
+    for (DirectX::XMMATRIX& world : worlds) {
+        const float size = size_dist(rng);
+        world = DirectX::XMMatrixScaling(size, size, 1.0f) *
+                DirectX::XMMatrixTranslation(position_dist(rng),
+                                             position_dist(rng),
+                                             depth_dist(rng));
+    }
+    return worlds;
+}
+
+std::vector<DirectX::BoundingBox> GenerateBoxes()
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position_dist(-300.0f, 300.0f);
+    std::uniform_real_distribution<float> depth_dist(400.0f, 900.0f);
+
+    std::vector<DirectX::BoundingBox> boxes(BOX_COUNT);
+    for (DirectX::BoundingBox& box : boxes) {
+        box.Center = DirectX::XMFLOAT3(position_dist(rng), position_dist(rng),
+                                       depth_dist(rng));
+        box.Extents = DirectX::XMFLOAT3(2.0f, 2.0f, 2.0f);
+    }
+    return boxes;
+}
+
+}  // namespace
+
+int main()
+{
+    if (!OcclusionCullerTester::CheckLayerRestart()) {
+        return 1;
+    }
+    std::printf("Layer restart check passed\n\n");
+
+    const DirectX::XMMATRIX view_proj = DirectX::XMMatrixPerspectiveFovLH(
+        DirectX::XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f);
+    const std::vector<DirectX::BoundingBox> boxes = GenerateBoxes();
+
+    OcclusionCuller culler{OcclusionCullerParams()};
+    std::printf("%10s %10s %12s %10s %10s\n", "occluders", "triangles",
+                "rasterize ms", "test ms", "occluded");
+
+    for (const unsigned int occluder_count : {16u, 64u, 256u, 1024u}) {
+        const std::vector<DirectX::XMMATRIX> occluders =
+            GenerateOccluders(occluder_count);
+
+        double rasterize_ms = 0.0;
+        double test_ms = 0.0;
+        std::vector<unsigned int> ids;
+        for (unsigned int frame = 0; frame < FRAME_COUNT; ++frame) {
+            culler.BeginFrame(view_proj);
+            for (const DirectX::XMMATRIX& world : occluders) {
+                culler.RenderOccluder(QUAD_VERTICES, 3, QUAD_INDICES, 6,
+                                      world);
+            }
+            ids.resize(boxes.size());
+            for (unsigned int i = 0; i < ids.size(); ++i) {
+                ids[i] = i;
+            }
+            culler.Cull(boxes, &ids);
+
+            rasterize_ms += culler.stats().rasterize_ms;
+            test_ms += culler.stats().test_ms;
+        }
+
+        const OcclusionCullerStats& stats = culler.stats();
+        std::printf("%10u %10u %12.3f %10.3f %10u\n", occluder_count,
+                    stats.occluder_triangle_count, rasterize_ms / FRAME_COUNT,
+                    test_ms / FRAME_COUNT, stats.occluded_count);
+    }
+    return 0;
+}
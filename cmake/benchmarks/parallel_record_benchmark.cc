@@ -0,0 +1,185 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+// Measures draw recording throughput of the parallel command recorder for a
+// growing number of threads, including the per-thread sort and the merge.
+// The merged buffer is replayed into the memory backend to check it matches
+// the single-threaded one.
+
+#include "rendering/command_buffer.h"
+#include "rendering/memory_render_backend.h"
+#include "rendering/parallel_command_recorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using namespace tamarindo;
+
+constexpr size_t DRAWS_PER_RUN = 20'000'000;
+
+constexpr uint32_t SHADER_COUNT = 16;
+constexpr uint32_t MATERIAL_COUNT = 256;
+constexpr uint32_t MESH_COUNT = 1024;
+constexpr float MAX_DEPTH = 1000.0f;
+
+struct SceneObject {
+    float center[3];
+    uint32_t shader;
+    uint32_t material;
+    uint32_t mesh;
+    uint32_t index_count;
+};
+
+struct Scene {
+    std::vector<SceneObject> objects;
+    // Row-major view projection, row vectors like DirectXMath
+    float view_proj[4][4];
+};
+
+Scene GenerateScene(size_t count)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position_dist(-500.0f, 500.0f);
+    std::uniform_int_distribution<uint32_t> shader_dist(0, SHADER_COUNT - 1);
+    std::uniform_int_distribution<uint32_t> material_dist(0,
+                                                          MATERIAL_COUNT - 1);
+    std::uniform_int_distribution<uint32_t> mesh_dist(0, MESH_COUNT - 1);
+
+    Scene scene;
+    scene.objects.resize(count);
+    for (SceneObject& object : scene.objects) {
+        object.center[0] = position_dist(rng);
+        object.center[1] = position_dist(rng);
+        object.center[2] = position_dist(rng) + 500.0f;
+        object.shader = shader_dist(rng);
+        object.material = material_dist(rng);
+        object.mesh = mesh_dist(rng);
+        object.index_count = 36;
+    }
+
+    // Only the w column matters for the sort depth
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            scene.view_proj[row][column] = row == column ? 1.0f : 0.0f;
+        }
+    }
+    scene.view_proj[2][3] = 1.0f;
+    scene.view_proj[3][3] = 0.0f;
+    return scene;
+}
+
+// Same work per draw as the editor: view depth, key and packet
+void RecordSlice(const Scene& scene, size_t begin, size_t end,
+                 CommandBuffer* buffer)
+{
+    const float(*m)[4] = scene.view_proj;
+    for (size_t i = begin; i < end; ++i) {
+        const SceneObject& object = scene.objects[i];
+        const float* c = object.center;
+        const float w = c[0] * m[0][3] + c[1] * m[1][3] + c[2] * m[2][3] +
+                        m[3][3];
+
+        DrawPacket packet;
+        packet.shader = object.shader;
+        packet.material = object.material;
+        packet.mesh = object.mesh;
+        packet.object_constants = static_cast<uint32_t>(i);
+        packet.index_count = object.index_count;
+        packet.index_offset = 0;
+        packet.vertex_offset = 0;
+        buffer->AddDraw(sort_key::Make(0, 0, packet.shader, packet.material,
+                                       packet.mesh,
+                                       sort_key::QuantizeDepth(w, MAX_DEPTH)),
+                        packet);
+    }
+}
+
+// Returns the average nanoseconds per draw of recording the whole scene
+double Measure(const Scene& scene, ParallelCommandRecorder* recorder,
+               CommandBuffer* output)
+{
+    const size_t count = scene.objects.size();
+    const size_t iterations = std::max<size_t>(1, DRAWS_PER_RUN / count);
+    const ParallelCommandRecorder::RecordFunction record =
+        [&scene](size_t begin, size_t end, CommandBuffer* buffer) {
+            RecordSlice(scene, begin, end, buffer);
+        };
+
+    // Warm up caches and grow the buffers
+    recorder->Record(count, record, output);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        recorder->Record(count, record, output);
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double total_ns =
+        std::chrono::duration<double, std::nano>(end - start).count();
+    return total_ns / static_cast<double>(iterations * count);
+}
+
+}  // namespace
+
+int main()
+{
+    const unsigned int max_threads =
+        std::max(1u, std::thread::hardware_concurrency());
+    std::printf("Hardware threads: %u\n\n", max_threads);
+    std::printf("%10s %8s %10s %10s %8s\n", "count", "threads", "ns/draw",
+                "speedup", "matches");
+
+    for (const size_t count : {10'000, 100'000, 1'000'000}) {
+        const Scene scene = GenerateScene(count);
+
+        MemoryRenderBackend reference;
+        double single_thread_ns = 0.0;
+        for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+            ParallelCommandRecorderParams params;
+            params.thread_count = threads;
+            ParallelCommandRecorder recorder(params);
+            CommandBuffer output;
+            const double ns = Measure(scene, &recorder, &output);
+
+            MemoryRenderBackend backend;
+            output.Submit(&backend);
+            if (threads == 1) {
+                single_thread_ns = ns;
+                output.Submit(&reference);
+            }
+            const bool matches =
+                backend.calls().size() == reference.calls().size() &&
+                std::equal(backend.calls().begin(), backend.calls().end(),
+                           reference.calls().begin(),
+                           [](const MemoryRenderBackend::Call& a,
+                              const MemoryRenderBackend::Call& b) {
+                               return a.type == b.type &&
+                                      std::equal(a.args, a.args + 3, b.args);
+                           });
+
+            std::printf("%10zu %8u %10.2f %9.2fx %8s\n", count, threads, ns,
+                        single_thread_ns / ns, matches ? "yes" : "NO");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+// Copyright 2023 Emmanuel Arias Soto
+//
+// SHADER_CODE from editor/game_data.h, compiled to SPIR-V for the Vulkan
+// backend. Keep both in sync.
+
+cbuffer PerSceneBuffer: register(b0)
+{
+    matrix viewProjectionMat;
+};
+
+cbuffer PerObjectBuffer: register(b1)
+{
+    matrix modelMat;
+};
+
+struct VertexInput
+{
+    float3 position : POSITION;
+    float2 tex : TEX;
+};
+
+struct PixelInput
+{
+    float4 position : SV_POSITION;
+    float2 tex : TEX;
+};
+
+PixelInput vs(VertexInput input)
+{
+    PixelInput output;
+
+    float4 modelPosition = mul(float4(input.position, 1.0f), modelMat);
+    output.position = mul(modelPosition, viewProjectionMat);
+
+    output.tex = input.tex;
+
+    return output;
+}
+
+float4 ps(PixelInput input) : SV_TARGET
+{
+    return float4(input.tex, 0.0f, 1.0f);
+}
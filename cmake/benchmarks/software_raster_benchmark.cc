@@ -0,0 +1,239 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+// Renders a field of cubes with the software backend at several thread
+// counts. Reports the time per frame spent transforming and binning, and
+// rasterizing, and checks every thread count produces the same image. Pass
+// a path to also write the last frame as a PPM file.
+
+#include "rendering/command_buffer.h"
+#include "rendering/software_render_backend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using namespace tamarindo;
+
+constexpr unsigned int FRAME_COUNT = 20;
+constexpr unsigned int WIDTH = 1280;
+constexpr unsigned int HEIGHT = 720;
+constexpr size_t CUBE_COUNT = 4'000;
+
+// Constants per object, as in the frame constant buffer
+constexpr uint32_t OBJECT_CONSTANT_STRIDE = 16;
+constexpr size_t OBJECT_FLOAT_STRIDE = OBJECT_CONSTANT_STRIDE * 4;
+
+// Cube with one UV square per face, wound clockwise seen from outside
+void CreateCube(std::vector<float>* vertices,
+                std::vector<unsigned int>* indices)
+{
+    const int faces[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4},
+                             {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+    const float uvs[4][2] = {{0, 0}, {0, 1}, {1, 1}, {1, 0}};
+    for (const auto& face : faces) {
+        const unsigned int base =
+            static_cast<unsigned int>(vertices->size() / 5);
+        for (int i = 0; i < 4; ++i) {
+            const int corner = face[i];
+            vertices->insert(vertices->end(),
+                             {(corner & 1) ? 0.5f : -0.5f,
+                              (corner & 2) ? 0.5f : -0.5f,
+                              (corner & 4) ? 0.5f : -0.5f, uvs[i][0],
+                              uvs[i][1]});
+        }
+        indices->insert(indices->end(), {base, base + 1, base + 2, base,
+                                         base + 2, base + 3});
+    }
+}
+
+// Left-handed perspective looking down +z, stored transposed like the scene
+// constant buffer
+void MakeViewProjection(float* out)
+{
+    const float z_near = 0.1f;
+    const float z_far = 200.0f;
+    const float y_scale = 1.0f / std::tan(0.5f);
+    const float x_scale = y_scale * HEIGHT / WIDTH;
+    const float range = z_far / (z_far - z_near);
+    const float matrix[16] = {x_scale, 0.0f,    0.0f,             0.0f,
+                              0.0f,    y_scale, 0.0f,             0.0f,
+                              0.0f,    0.0f,    range,            1.0f,
+                              0.0f,    0.0f,    -z_near * range, 0.0f};
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            out[column * 4 + row] = matrix[row * 4 + column];
+        }
+    }
+}
+
+// Transposed model matrices: a rotation around y and a translation
+std::vector<float> GenerateObjectConstants()
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> xy_dist(-30.0f, 30.0f);
+    std::uniform_real_distribution<float> z_dist(2.0f, 120.0f);
+    std::uniform_real_distribution<float> angle_dist(0.0f, 6.28f);
+
+    std::vector<float> constants(CUBE_COUNT * OBJECT_FLOAT_STRIDE, 0.0f);
+    for (size_t i = 0; i < CUBE_COUNT; ++i) {
+        const float angle = angle_dist(rng);
+        const float c = std::cos(angle);
+        const float s = std::sin(angle);
+        const float model[16] = {c, 0, -s, 0, 0, 1, 0, 0, s, 0, c, 0,
+                                 xy_dist(rng), xy_dist(rng), z_dist(rng), 1};
+        float* out = &constants[i * OBJECT_FLOAT_STRIDE];
+        for (int row = 0; row < 4; ++row) {
+            for (int column = 0; column < 4; ++column) {
+                out[column * 4 + row] = model[row * 4 + column];
+            }
+        }
+    }
+    return constants;
+}
+
+uint64_t HashImage(const SoftwareRenderBackend& backend)
+{
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned int y = 0; y < backend.height(); ++y) {
+        const uint32_t* row = backend.color_buffer() + y * backend.row_pitch();
+        for (unsigned int x = 0; x < backend.width(); ++x) {
+            hash = (hash ^ row[x]) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+void WritePpm(const SoftwareRenderBackend& backend, const char* path)
+{
+    FILE* file = std::fopen(path, "wb");
+    if (!file) {
+        std::printf("Could not open %s\n", path);
+        return;
+    }
+    std::fprintf(file, "P6 %u %u 255\n", backend.width(), backend.height());
+    for (unsigned int y = 0; y < backend.height(); ++y) {
+        const uint32_t* row = backend.color_buffer() + y * backend.row_pitch();
+        for (unsigned int x = 0; x < backend.width(); ++x) {
+            const unsigned char rgb[3] = {
+                static_cast<unsigned char>(row[x]),
+                static_cast<unsigned char>(row[x] >> 8),
+                static_cast<unsigned char>(row[x] >> 16)};
+            std::fwrite(rgb, 1, 3, file);
+        }
+    }
+    std::fclose(file);
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point start,
+                 std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    CreateCube(&vertices, &indices);
+    float view_projection[16];
+    MakeViewProjection(view_projection);
+    const std::vector<float> object_constants = GenerateObjectConstants();
+    const float clear_color[4] = {0.678f, 0.749f, 0.796f, 1.0f};
+
+    std::printf("%ux%u, %zu cubes\n\n", WIDTH, HEIGHT, CUBE_COUNT);
+    std::printf("%8s %10s %10s %10s %12s %8s\n", "threads", "bin ms",
+                "raster ms", "frame ms", "pixels", "image");
+
+    const unsigned int max_threads =
+        std::max(1u, std::thread::hardware_concurrency());
+    uint64_t reference_hash = 0;
+    bool is_deterministic = true;
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        SoftwareRenderBackendParams params;
+        params.width = WIDTH;
+        params.height = HEIGHT;
+        params.thread_count = threads;
+        SoftwareRenderBackend backend(params);
+        const uint32_t shader = backend.CreateShader("pos_uv");
+        const uint32_t mesh = backend.CreateMesh(vertices, indices);
+
+        // Front to back, the order the editor sort keys give
+        CommandBuffer command_buffer;
+        for (size_t i = 0; i < CUBE_COUNT; ++i) {
+            // Translation z, transposed into the third row
+            const float z = object_constants[i * OBJECT_FLOAT_STRIDE + 11];
+            DrawPacket packet;
+            packet.shader = shader;
+            packet.material = 0;
+            packet.mesh = mesh;
+            packet.object_constants =
+                static_cast<uint32_t>(i) * OBJECT_CONSTANT_STRIDE;
+            packet.index_count = static_cast<uint32_t>(indices.size());
+            packet.index_offset = 0;
+            packet.vertex_offset = 0;
+            command_buffer.AddDraw(
+                sort_key::Make(0, 0, 0, 0, 0,
+                               sort_key::QuantizeDepth(z, 200.0f)),
+                packet);
+        }
+        command_buffer.Sort();
+
+        double bin_ms = 0.0;
+        double raster_ms = 0.0;
+        for (unsigned int frame = 0; frame < FRAME_COUNT; ++frame) {
+            const auto start = std::chrono::steady_clock::now();
+            backend.BeginFrame(clear_color);
+            backend.SetSceneConstants(view_projection);
+            backend.SetObjectConstantData(
+                object_constants.data(),
+                object_constants.size() * sizeof(float));
+            command_buffer.Submit(&backend);
+            const auto binned = std::chrono::steady_clock::now();
+            backend.Rasterize();
+            const auto rasterized = std::chrono::steady_clock::now();
+
+            bin_ms += ElapsedMs(start, binned);
+            raster_ms += ElapsedMs(binned, rasterized);
+        }
+
+        const uint64_t hash = HashImage(backend);
+        if (threads == 1) {
+            reference_hash = hash;
+        }
+        is_deterministic = is_deterministic && hash == reference_hash;
+        std::printf("%8u %10.3f %10.3f %10.3f %12llu %8s\n", threads,
+                    bin_ms / FRAME_COUNT, raster_ms / FRAME_COUNT,
+                    (bin_ms + raster_ms) / FRAME_COUNT,
+                    static_cast<unsigned long long>(
+                        backend.stats().shaded_pixel_count),
+                    hash == reference_hash ? "same" : "DIFFERS");
+
+        if (argc > 1 && threads * 2 > max_threads) {
+            WritePpm(backend, argv[1]);
+        }
+    }
+    return is_deterministic ? 0 : 1;
+}
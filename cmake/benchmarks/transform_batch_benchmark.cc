@@ -0,0 +1,138 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+// Compares the batch TRS kernels against the per-object path used by
+// Transform before (translate * toMat4 * scale).
+
+#include "engine_lib/world/transform_batch.h"
+
+#include "glm/ext/matrix_transform.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+using namespace tamarindo;
+
+constexpr size_t TRANSFORMS_PER_RUN = 10'000'000;
+
+struct TransformData {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> matrices;
+};
+
+TransformData generateTransforms(size_t count)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+
+    TransformData data;
+    data.positions.resize(count);
+    data.rotations.resize(count);
+    data.scales.resize(count);
+    data.matrices.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        data.positions[i] = glm::vec3(dist(rng), dist(rng), dist(rng));
+        data.rotations[i] = glm::normalize(
+            glm::quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+        data.scales[i] = glm::abs(glm::vec3(dist(rng), dist(rng), dist(rng)));
+    }
+    return data;
+}
+
+void composePerObject(TransformData* data)
+{
+    const size_t count = data->positions.size();
+    for (size_t i = 0; i < count; ++i) {
+        data->matrices[i] =
+            glm::translate(glm::mat4(1.0), data->positions[i]) *
+            glm::toMat4(data->rotations[i]) *
+            glm::scale(glm::mat4(1.0), data->scales[i]);
+    }
+}
+
+void composeBatch(TransformKernel kernel, TransformData* data)
+{
+    composeTransformMatrices(kernel, data->positions.data(),
+                             data->rotations.data(), data->scales.data(),
+                             data->matrices.data(), data->positions.size());
+}
+
+// Runs `func` enough times to process TRANSFORMS_PER_RUN transforms and
+// returns the average nanoseconds per transform.
+template <typename Func>
+double measure(TransformData* data, Func func)
+{
+    const size_t count = data->positions.size();
+    const size_t iterations = TRANSFORMS_PER_RUN / count;
+
+    // Warm up caches
+    func(data);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        func(data);
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const double total_ns =
+        std::chrono::duration<double, std::nano>(end - start).count();
+    return total_ns / static_cast<double>(iterations * count);
+}
+
+}  // namespace
+
+int main()
+{
+    std::printf("Best kernel: %s\n\n",
+                getTransformKernelName(getBestTransformKernel()));
+    std::printf("%10s %12s %12s %10s\n", "count", "path", "ns/transform",
+                "speedup");
+
+    float checksum = 0.0f;
+    for (const size_t count : {1'000, 10'000, 100'000}) {
+        TransformData data = generateTransforms(count);
+
+        const double baseline_ns = measure(&data, composePerObject);
+        checksum += data.matrices[count - 1][3][0];
+        std::printf("%10zu %12s %12.2f %10s\n", count, "per-object",
+                    baseline_ns, "1.00x");
+
+        for (const TransformKernel kernel :
+             {TransformKernel::Scalar, TransformKernel::SSE,
+              TransformKernel::AVX2}) {
+            if (!isTransformKernelSupported(kernel)) {
+                continue;
+            }
+            const double kernel_ns = measure(
+                &data, [kernel](TransformData* d) { composeBatch(kernel, d); });
+            checksum += data.matrices[count - 1][3][0];
+            std::printf("%10zu %12s %12.2f %9.2fx\n", count,
+                        getTransformKernelName(kernel), kernel_ns,
+                        baseline_ns / kernel_ns);
+        }
+    }
+
+    // Keeps the results alive so the compiler can not drop the work
+    std::printf("\nchecksum: %f\n", checksum);
+    return 0;
+}
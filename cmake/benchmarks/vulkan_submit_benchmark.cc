@@ -0,0 +1,253 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+// Measures the CPU cost of submitting frames with the Vulkan backend, at
+// several draw and recording thread counts. Runs headless, so it can use
+// Mesa lavapipe:
+//
+//   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json \
+//       ./vulkan_submit_benchmark
+//
+// "wait" is the time BeginFrame() blocks on the timeline semaphore, which
+// is the GPU, or lavapipe, falling behind.
+
+#include "logging/logger.h"
+#include "rendering/command_buffer.h"
+#include "rendering/vulkan_render_backend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using namespace tamarindo;
+
+constexpr unsigned int FRAME_COUNT = 100;
+constexpr unsigned int WIDTH = 1280;
+constexpr unsigned int HEIGHT = 720;
+
+// BACKGROUND_COLOR packed as RGBA8, red in the lowest byte
+constexpr uint32_t CLEAR_COLOR_RGBA8 = 0xFFCBBFAD;
+
+// Constants per object in the frame constant buffer, 256 bytes
+constexpr uint32_t OBJECT_CONSTANT_STRIDE = 16;
+constexpr size_t OBJECT_FLOAT_STRIDE = OBJECT_CONSTANT_STRIDE * 4;
+
+bool LoadSpirv(const char* path, std::vector<uint32_t>* code)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        std::printf("Could not open %s\n", path);
+        return false;
+    }
+    const std::streamsize size = file.tellg();
+    file.seekg(0);
+    code->resize(static_cast<size_t>(size) / sizeof(uint32_t));
+    return static_cast<bool>(
+        file.read(reinterpret_cast<char*>(code->data()), size));
+}
+
+// Cube with one UV square per face, wound clockwise seen from outside
+void CreateCube(std::vector<float>* vertices,
+                std::vector<unsigned int>* indices)
+{
+    const int faces[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4},
+                             {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+    const float uvs[4][2] = {{0, 0}, {0, 1}, {1, 1}, {1, 0}};
+    for (const auto& face : faces) {
+        const unsigned int base =
+            static_cast<unsigned int>(vertices->size() / 5);
+        for (int i = 0; i < 4; ++i) {
+            const int corner = face[i];
+            vertices->insert(vertices->end(),
+                             {(corner & 1) ? 0.5f : -0.5f,
+                              (corner & 2) ? 0.5f : -0.5f,
+                              (corner & 4) ? 0.5f : -0.5f, uvs[i][0],
+                              uvs[i][1]});
+        }
+        indices->insert(indices->end(), {base, base + 1, base + 2, base,
+                                         base + 2, base + 3});
+    }
+}
+
+// Left-handed perspective looking down +z, stored transposed like the scene
+// constant buffer
+void MakeViewProjection(float* out)
+{
+    const float z_near = 0.1f;
+    const float z_far = 200.0f;
+    const float y_scale = 1.0f / std::tan(0.5f);
+    const float x_scale = y_scale * HEIGHT / WIDTH;
+    const float range = z_far / (z_far - z_near);
+    const float matrix[16] = {x_scale, 0.0f,    0.0f,             0.0f,
+                              0.0f,    y_scale, 0.0f,             0.0f,
+                              0.0f,    0.0f,    range,            1.0f,
+                              0.0f,    0.0f,    -z_near * range, 0.0f};
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            out[column * 4 + row] = matrix[row * 4 + column];
+        }
+    }
+}
+
+// Transposed model matrices, one per 256 bytes
+std::vector<float> GenerateObjectConstants(size_t count)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> xy_dist(-30.0f, 30.0f);
+    std::uniform_real_distribution<float> z_dist(2.0f, 120.0f);
+
+    std::vector<float> constants(count * OBJECT_FLOAT_STRIDE, 0.0f);
+    for (size_t i = 0; i < count; ++i) {
+        float* out = &constants[i * OBJECT_FLOAT_STRIDE];
+        out[0] = 1.0f;
+        out[5] = 1.0f;
+        out[10] = 1.0f;
+        out[15] = 1.0f;
+        // Translation, transposed into the last column
+        out[3] = xy_dist(rng);
+        out[7] = xy_dist(rng);
+        out[11] = z_dist(rng);
+    }
+    return constants;
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point start,
+                 std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+}  // namespace
+
+int main()
+{
+    Logger logger;
+
+    std::vector<uint32_t> vertex_code;
+    std::vector<uint32_t> pixel_code;
+    if (!LoadSpirv(TM_SHADER_DIR "/pos_uv.vs.spv", &vertex_code) ||
+        !LoadSpirv(TM_SHADER_DIR "/pos_uv.ps.spv", &pixel_code)) {
+        return 1;
+    }
+
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    CreateCube(&vertices, &indices);
+    float view_projection[16];
+    MakeViewProjection(view_projection);
+    const float clear_color[4] = {0.678f, 0.749f, 0.796f, 1.0f};
+
+    std::printf("%8s %8s %10s %10s %10s %10s %10s\n", "threads", "draws",
+                "record", "submit", "wait", "frame ms", "covered");
+
+    const unsigned int max_threads =
+        std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int threads = 1; threads <= max_threads; threads *= 2) {
+        VulkanRenderBackendParams params;
+        params.width = WIDTH;
+        params.height = HEIGHT;
+        params.thread_count = threads;
+        VulkanRenderBackend backend;
+        if (!backend.Initialize(params)) {
+            return 1;
+        }
+
+        const uint32_t shader =
+            backend.CreateShaderFromSpirv(vertex_code, pixel_code);
+        const uint32_t mesh = backend.CreateMesh(vertices, indices);
+        if (shader == RenderBackend::INVALID_HANDLE ||
+            mesh == RenderBackend::INVALID_HANDLE) {
+            return 1;
+        }
+
+        for (const size_t draw_count : {1'000, 10'000, 50'000}) {
+            const std::vector<float> object_constants =
+                GenerateObjectConstants(draw_count);
+
+            CommandBuffer command_buffer;
+            for (size_t i = 0; i < draw_count; ++i) {
+                // Translation z, transposed into the third row
+                const float z = object_constants[i * OBJECT_FLOAT_STRIDE + 11];
+                DrawPacket packet;
+                packet.shader = shader;
+                packet.material = 0;
+                packet.mesh = mesh;
+                packet.object_constants =
+                    static_cast<uint32_t>(i) * OBJECT_CONSTANT_STRIDE;
+                packet.index_count = static_cast<uint32_t>(indices.size());
+                packet.index_offset = 0;
+                packet.vertex_offset = 0;
+                command_buffer.AddDraw(
+                    sort_key::Make(0, 0, 0, 0, 0,
+                                   sort_key::QuantizeDepth(z, 200.0f)),
+                    packet);
+            }
+            command_buffer.Sort();
+
+            double record_ms = 0.0;
+            double submit_ms = 0.0;
+            double wait_ms = 0.0;
+            for (unsigned int frame = 0; frame < FRAME_COUNT; ++frame) {
+                const auto start = std::chrono::steady_clock::now();
+                if (!backend.BeginFrame(clear_color)) {
+                    return 1;
+                }
+                const auto waited = std::chrono::steady_clock::now();
+                backend.SetSceneConstants(view_projection);
+                backend.SetObjectConstantData(
+                    object_constants.data(),
+                    object_constants.size() * sizeof(float));
+                backend.SubmitParallel(command_buffer);
+                const auto recorded = std::chrono::steady_clock::now();
+                if (!backend.EndFrame()) {
+                    return 1;
+                }
+                const auto submitted = std::chrono::steady_clock::now();
+
+                wait_ms += ElapsedMs(start, waited);
+                record_ms += ElapsedMs(waited, recorded);
+                submit_ms += ElapsedMs(recorded, submitted);
+            }
+
+            // Pixels that are not the clear color, as a sanity check of the
+            // last frame
+            std::vector<uint32_t> pixels;
+            size_t covered = 0;
+            if (backend.ReadColorBuffer(&pixels)) {
+                covered = static_cast<size_t>(std::count_if(
+                    pixels.begin(), pixels.end(), [](uint32_t pixel) {
+                        return pixel != CLEAR_COLOR_RGBA8;
+                    }));
+            }
+
+            std::printf("%8u %8zu %10.3f %10.3f %10.3f %10.3f %10zu\n",
+                        backend.thread_count(), draw_count,
+                        record_ms / FRAME_COUNT, submit_ms / FRAME_COUNT,
+                        wait_ms / FRAME_COUNT,
+                        (record_ms + submit_ms + wait_ms) / FRAME_COUNT,
+                        covered);
+        }
+    }
+    return 0;
+}
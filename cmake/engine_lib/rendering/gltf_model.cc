@@ -26,13 +26,13 @@
 #include "engine_lib/rendering/shader_program.h"
 
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 
 namespace tamarindo
 {
 GLTFModel::GLTFModel(const tinygltf::Model& model) : m_Model(model) {}
 
-#define BUFFER_OFFSET(i) ((char*)NULL + (i))
-
 void GLTFModel::bindMesh(int mesh_index)
 {
     if (m_Meshes.find(mesh_index) != m_Meshes.end()) {
@@ -43,60 +43,108 @@ void GLTFModel::bindMesh(int mesh_index)
     TM_LOG_INFO("Processing mesh {}: {}", mesh_index, mesh.name);
     GLTFMesh gltf_mesh;
 
-    for (size_t i = 0; i < mesh.primitives.size(); ++i) {
-        tinygltf::Primitive primitive = mesh.primitives[i];
-
-        VertexArrayDesc desc;
-
-        for (auto& [name, buffer_view_index] : primitive.attributes) {
-            tinygltf::Accessor accessor = m_Model.accessors[buffer_view_index];
-
-            const tinygltf::BufferView& buffer_view =
-                m_Model.bufferViews[accessor.bufferView];
-            int byte_stride = accessor.ByteStride(buffer_view);
-            int size = accessor.type == TINYGLTF_TYPE_SCALAR
-                           ? 1
-                           : size = accessor.type;
-
-            int attr_location = -1;
-            const int vb_binding_index = 0;
-            if (name.compare("POSITION") == 0) {
-                attr_location = 0;
-            } else if (name.compare("TEXCOORD_0") == 0) {
-                attr_location = -1;
+    for (const tinygltf::Primitive& primitive : mesh.primitives) {
+        const auto position_it = primitive.attributes.find("POSITION");
+        if (position_it != primitive.attributes.end()) {
+            const tinygltf::Accessor& accessor =
+                m_Model.accessors[position_it->second];
+            // glTF requires min and max on position accessors
+            if (accessor.minValues.size() == 3 &&
+                accessor.maxValues.size() == 3) {
+                gltf_mesh.Bounds.expand(glm::vec3(
+                    (float)accessor.minValues[0], (float)accessor.minValues[1],
+                    (float)accessor.minValues[2]));
+                gltf_mesh.Bounds.expand(glm::vec3(
+                    (float)accessor.maxValues[0], (float)accessor.maxValues[1],
+                    (float)accessor.maxValues[2]));
             }
+        }
 
-            if (attr_location != -1) {
-                TM_LOG_INFO("For attribute {}, location = {}", name,
-                            attr_location);
-
-                VertexArrayAtrributeDesc attr_desc;
-
-                attr_desc.location = attr_location;
-                attr_desc.bindingIndex = vb_binding_index;
-                attr_desc.size = size;
-                attr_desc.componentType = accessor.componentType;
-                attr_desc.isNormalized = accessor.normalized;
-                attr_desc.byteOffset = (unsigned int)accessor.byteOffset;
-                attr_desc.stride = byte_stride;
-                attr_desc.buffer = m_Buffers[buffer_view_index];
+        GLTFPrimitive packed;
+        if (!packPrimitive(primitive, &packed)) {
+            TM_LOG_WARN("Skipping unsupported primitive of mesh {}", mesh.name);
+            continue;
+        }
+        gltf_mesh.Primitives.push_back(packed);
+    }
+    m_Meshes[mesh_index] = gltf_mesh;
+}
 
-                desc.atributeData.push_back(attr_desc);
+bool GLTFModel::packPrimitive(const tinygltf::Primitive& primitive,
+                              GLTFPrimitive* packed)
+{
+    const auto position_it = primitive.attributes.find("POSITION");
+    if (position_it == primitive.attributes.end() || primitive.indices < 0) {
+        return false;
+    }
+
+    const tinygltf::Accessor& position_accessor =
+        m_Model.accessors[position_it->second];
+    const tinygltf::Accessor& index_accessor =
+        m_Model.accessors[primitive.indices];
+    if (position_accessor.bufferView < 0 || index_accessor.bufferView < 0 ||
+        position_accessor.type != TINYGLTF_TYPE_VEC3 ||
+        position_accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT ||
+        index_accessor.type != TINYGLTF_TYPE_SCALAR) {
+        return false;
+    }
+
+    const tinygltf::BufferView& position_view =
+        m_Model.bufferViews[position_accessor.bufferView];
+    const tinygltf::BufferView& index_view =
+        m_Model.bufferViews[index_accessor.bufferView];
+    const int position_stride = position_accessor.ByteStride(position_view);
+    const int index_stride = index_accessor.ByteStride(index_view);
+    if (position_stride <= 0 || index_stride <= 0) {
+        return false;
+    }
+
+    const unsigned char* position_data =
+        m_Model.buffers[position_view.buffer].data.data() +
+        position_view.byteOffset + position_accessor.byteOffset;
+    const unsigned char* index_data =
+        m_Model.buffers[index_view.buffer].data.data() +
+        index_view.byteOffset + index_accessor.byteOffset;
+
+    packed->IndexCount = index_accessor.count;
+    packed->FirstIndex = (unsigned int)m_Indices.size();
+    packed->BaseVertex = (int)m_Positions.size();
+    packed->MaterialIndex = primitive.material;
+
+    for (size_t i = 0; i < position_accessor.count; ++i) {
+        glm::vec3 position;
+        std::memcpy(&position, position_data + i * position_stride,
+                    sizeof(position));
+        m_Positions.push_back(position);
+    }
+
+    // Every index is widened to 32 bits, so one index type covers the
+    // whole buffer
+    for (size_t i = 0; i < index_accessor.count; ++i) {
+        const unsigned char* index = index_data + i * index_stride;
+        switch (index_accessor.componentType) {
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                m_Indices.push_back(*index);
+                break;
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+                uint16_t value;
+                std::memcpy(&value, index, sizeof(value));
+                m_Indices.push_back(value);
+                break;
             }
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+                uint32_t value;
+                std::memcpy(&value, index, sizeof(value));
+                m_Indices.push_back(value);
+                break;
+            }
+            default:
+                m_Positions.resize(packed->BaseVertex);
+                m_Indices.resize(packed->FirstIndex);
+                return false;
         }
-
-        tinygltf::Accessor index_accessor =
-            m_Model.accessors[primitive.indices];
-
-        desc.elementArrayBuffer = m_Buffers[index_accessor.bufferView];
-
-        unsigned int vao;
-        ResourcesManager::createVertexArray(desc, &vao);
-
-        gltf_mesh.Primitives.push_back(
-            GLTFPrimitive{vao, index_accessor.count, primitive.material});
     }
-    m_Meshes[mesh_index] = gltf_mesh;
+    return true;
 }
 
 void GLTFModel::bindModelNodes(int node_index)
@@ -132,29 +180,11 @@ void GLTFModel::bindModelNodes(int node_index)
 
 bool GLTFModel::initialize()
 {
-    for (size_t i = 0; i < m_Model.bufferViews.size(); ++i) {
-        const tinygltf::BufferView& buffer_view = m_Model.bufferViews[i];
-
-        if (buffer_view.target != TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER &&
-            buffer_view.target != TINYGLTF_TARGET_ARRAY_BUFFER) {
-            continue;
-        }
-
-        const tinygltf::Buffer& buffer = m_Model.buffers[buffer_view.buffer];
-
-        BufferDesc desc;
-        desc.data = &buffer.data.at(0) + buffer_view.byteOffset;
-        desc.size = (long)buffer_view.byteLength;
-
-        unsigned int vbo = 0;
-        ResourcesManager::createBuffer(desc, &vbo);
-        m_Buffers[i] = vbo;
-
-        TM_LOG_INFO(
-            "Buffer view: {}, buffer.data.size = {}, "
-            "bufferview.byteOffset = {}",
-            i, buffer.data.size(), buffer_view.byteOffset);
-    }
+    // Filled every frame with the matrices of the visible instances
+    BufferDesc instance_desc;
+    instance_desc.data = nullptr;
+    instance_desc.size = 0;
+    ResourcesManager::createBuffer(instance_desc, &m_InstanceBuffer);
 
     for (const tinygltf::Material& mat : m_Model.materials) {
         auto& base_color = mat.pbrMetallicRoughness.baseColorFactor;
@@ -167,100 +197,48 @@ bool GLTFModel::initialize()
         bindModelNodes(node_index);
     }
 
-    return true;
-}
-
-void GLTFModel::terminate()
-{
-    for (auto [key, value] : m_Buffers) {
-        ResourcesManager::releaseBuffer(value);
-    }
-    for (auto [key, value] : m_Meshes) {
-        for (const auto& p : value.Primitives) {
-            ResourcesManager::releaseVertexArray(p.VAO);
-        }
-    }
-}
-
-/*static*/ std::unique_ptr<GameObject> GLTFGameObjectLoader::load(
-    const GLTFGameObjectDesc& desc)
-{
-    GLTFGameObjectLoader l;
-    return l.loadInternal(desc);
-}
-
-void setTransformFromNode(Transform* t, const tinygltf::Node& node)
-{
-    if (node.translation.size() == 3) {
-        t->setPosition(glm::vec3((float)node.translation.at(0),
-                                 (float)node.translation.at(1),
-                                 (float)node.translation.at(2)));
-    }
-    if (node.scale.size() == 3) {
-        t->setScale(glm::vec3((float)node.scale.at(0), (float)node.scale.at(1),
-                              (float)node.scale.at(2)));
-    }
-    if (node.rotation.size() == 4) {
-        t->setRotation(
-            glm::quat((float)node.rotation.at(3), (float)node.rotation.at(0),
-                      (float)node.rotation.at(1), (float)node.rotation.at(2)));
-    }
-}
-
-void GLTFGameObjectLoader::setMeshFromNode() {}
+    BufferDesc vertex_desc;
+    vertex_desc.data = m_Positions.data();
+    vertex_desc.size = (long)(m_Positions.size() * sizeof(glm::vec3));
+    ResourcesManager::createBuffer(vertex_desc, &m_VertexBuffer);
 
-void GLTFGameObjectLoader::processModelNode(GameObject* parent_game_object,
-                                            const tinygltf::Model& model,
-                                            int node_index)
-{
-    assert((node_index >= 0) && (node_index < model.nodes.size()));
-    const tinygltf::Node& node = model.nodes[node_index];
-    TM_LOG_INFO("Processing node {}: {}", node_index, node.name);
+    BufferDesc index_desc;
+    index_desc.data = m_Indices.data();
+    index_desc.size = (long)(m_Indices.size() * sizeof(unsigned int));
+    ResourcesManager::createBuffer(index_desc, &m_IndexBuffer);
 
-    GameObject* game_object =
-        (node.name.empty()) ? new GameObject() : new GameObject(node.name);
+    TM_LOG_INFO("Packed {} vertices and {} indices", m_Positions.size(),
+                m_Indices.size());
 
-    if ((node.mesh >= 0) && (node.mesh < model.meshes.size())) {
-        TM_LOG_INFO("Node has mesh");
-        setTransformFromNode(&game_object->m_Transform, node);
-        setMeshFromNode();
-    }
-    /*if ((node.mesh >= 0) && (node.mesh < m_Model.meshes.size())) {
-        Transform t;
+    VertexArrayAtrributeDesc position_desc;
+    position_desc.location = 0;
+    position_desc.bindingIndex = 0;
+    position_desc.size = 3;
+    position_desc.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    position_desc.isNormalized = false;
+    position_desc.byteOffset = 0;
+    position_desc.stride = sizeof(glm::vec3);
+    position_desc.buffer = m_VertexBuffer;
 
-        bindMesh(node.mesh);
-        m_MeshInstances[node.mesh].push_back(t);
-    }*/
+    VertexArrayDesc desc;
+    desc.elementArrayBuffer = m_IndexBuffer;
+    desc.atributeData.push_back(position_desc);
+    desc.instanceBuffer = m_InstanceBuffer;
+    ResourcesManager::createVertexArray(desc, &m_VertexArray);
 
-    parent_game_object->addChild(game_object);
+    // The GPU buffers own the geometry from now on
+    m_Positions = std::vector<glm::vec3>();
+    m_Indices = std::vector<unsigned int>();
 
-    for (const int child_node_index : node.children) {
-        processModelNode(game_object, model, child_node_index);
-    }
+    return true;
 }
 
-std::unique_ptr<GameObject> GLTFGameObjectLoader::loadInternal(
-    const GLTFGameObjectDesc& desc)
+void GLTFModel::terminate()
 {
-    tinygltf::Model model;
-    tinygltf::TinyGLTF loader;
-    std::string err;
-    std::string warn;
-
-    bool loaded =
-        loader.LoadBinaryFromFile(&model, &err, &warn, desc.ModelPath);
-    if (!loaded) {
-        return nullptr;
-    }
-
-    std::unique_ptr<GameObject> root_go = std::make_unique<GameObject>();
-
-    const tinygltf::Scene& scene = model.scenes[model.defaultScene];
-    for (const int node_index : scene.nodes) {
-        processModelNode(root_go.get(), model, node_index);
-    }
-
-    return root_go;
+    ResourcesManager::releaseVertexArray(m_VertexArray);
+    ResourcesManager::releaseBuffer(m_VertexBuffer);
+    ResourcesManager::releaseBuffer(m_IndexBuffer);
+    ResourcesManager::releaseBuffer(m_InstanceBuffer);
 }
 
 }  // namespace tamarindo
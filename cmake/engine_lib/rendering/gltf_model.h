@@ -19,7 +19,8 @@
 
 #include "engine_lib/rendering/material.h"
 #include "engine_lib/rendering/model.h"
-#include "engine_lib/rendering/game_object.h"
+#include "engine_lib/world/bounds.h"
+#include "engine_lib/world/game_object.h"
 
 #include "tiny_gltf.h"
 
@@ -31,14 +32,19 @@
 namespace tamarindo
 {
 
+// Range of the primitive in the shared vertex and index buffers of the
+// model. Indices are relative to BaseVertex.
 struct GLTFPrimitive {
-    unsigned int VAO;
     size_t IndexCount;
+    unsigned int FirstIndex;
+    int BaseVertex;
     int MaterialIndex;
 };
 
 struct GLTFMesh {
     std::vector<GLTFPrimitive> Primitives;
+    // Union of the position bounds of the primitives, in mesh space
+    AABB Bounds;
 };
 
 class GLTFModel : public Model
@@ -53,12 +59,32 @@ class GLTFModel : public Model
     void bindModelNodes(int node_index, tinygltf::Model model,
                         GameObject* parent_game_object);
 
+    // The primitives of every mesh are packed into one vertex and one index
+    // buffer, so the whole model is drawn with this vertex array
+    inline unsigned int getVertexArray() const { return m_VertexArray; }
+
+    // The vertex array reads its per-instance matrices from this buffer
+    inline unsigned int getInstanceBuffer() const { return m_InstanceBuffer; }
+
    private:
     void bindModelNodes(int node_index);
     void bindMesh(int mesh_index);
 
+    // Appends the positions and indices of the primitive to the shared
+    // arrays. Returns false if its accessors are not supported.
+    bool packPrimitive(const tinygltf::Primitive& primitive,
+                       GLTFPrimitive* packed);
+
     tinygltf::Model m_Model;
-    std::unordered_map<size_t, unsigned int> m_Buffers;
+
+    // Filled while binding the meshes, released once uploaded
+    std::vector<glm::vec3> m_Positions;
+    std::vector<unsigned int> m_Indices;
+
+    unsigned int m_VertexBuffer = 0;
+    unsigned int m_IndexBuffer = 0;
+    unsigned int m_InstanceBuffer = 0;
+    unsigned int m_VertexArray = 0;
 
     // TODO: Change back to private
    public:
@@ -69,24 +95,6 @@ class GLTFModel : public Model
     std::unordered_map<int, std::vector<Transform>> m_MeshInstances;
 };
 
-struct GLTFGameObjectDesc {
-    std::string ModelPath;
-};
-
-class GLTFGameObjectLoader
-{
-   public:
-    static std::unique_ptr<GameObject> load(const GLTFGameObjectDesc& desc);
-
-   private:
-    std::unique_ptr<GameObject> loadInternal(const GLTFGameObjectDesc& desc);
-
-    void setMeshFromNode();
-
-    void processModelNode(GameObject* parent_game_object,
-                          const tinygltf::Model& model, int node_index);
-};
-
 }  // namespace tamarindo
 
 #endif  // ENGINE_LIB_RENDERING_GLTF_MODEL_H_
@@ -16,8 +16,8 @@
 #include "engine_lib/rendering/imgui_renderer.h"
 
 #include "engine_lib/logging/logger.h"
-#include "engine_lib/rendering/game_object.h"
-#include "engine_lib/rendering/scene.h"
+#include "engine_lib/world/game_object.h"
+#include "engine_lib/world/scene.h"
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -0,0 +1,230 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "engine_lib/rendering/indirect_draw_list.h"
+
+#include "engine_lib/logging/logger.h"
+
+#include "glad/glad.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace tamarindo
+{
+
+namespace
+{
+// Primitives without a material
+const glm::vec4 DEFAULT_COLOR = glm::vec4(1.0f);
+
+// Grows to fit the largest build
+constexpr size_t INITIAL_REGION_SIZE = 64 * 1024;
+
+// Waits are retried, a timeout only means the GPU is slow
+constexpr GLuint64 WAIT_TIMEOUT_NS = 1'000'000'000;
+
+constexpr GLbitfield MAP_FLAGS =
+    GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
+bool IndirectDrawList::initialize()
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_Alignment = std::max((size_t)alignment, sizeof(glm::vec4));
+    return createBuffer(INITIAL_REGION_SIZE);
+}
+
+void IndirectDrawList::terminate()
+{
+    releaseBuffer();
+    m_Commands.clear();
+    m_DrawColors.clear();
+}
+
+bool IndirectDrawList::createBuffer(size_t region_size)
+{
+    m_RegionSize = alignUp(region_size, m_Alignment);
+    const GLsizeiptr size = (GLsizeiptr)(m_RegionSize * REGION_COUNT);
+    glCreateBuffers(1, &m_Buffer);
+    glNamedBufferStorage(m_Buffer, size, nullptr, MAP_FLAGS);
+    m_MappedData = static_cast<uint8_t*>(
+        glMapNamedBufferRange(m_Buffer, 0, size, MAP_FLAGS));
+    if (m_MappedData == nullptr) {
+        TM_LOG_ERROR("Could not map the indirect draw buffer");
+        releaseBuffer();
+        return false;
+    }
+    return true;
+}
+
+void IndirectDrawList::releaseBuffer()
+{
+    for (GLsync& fence : m_Fences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    // Draws still reading the buffer keep its storage alive
+    if (m_Buffer != 0) {
+        glUnmapNamedBuffer(m_Buffer);
+        glDeleteBuffers(1, &m_Buffer);
+    }
+    m_Buffer = 0;
+    m_MappedData = nullptr;
+    m_RegionSize = 0;
+    m_RegionIndex = 0;
+    m_IsRegionWritten = false;
+}
+
+bool IndirectDrawList::waitForRegion(unsigned int region)
+{
+    GLsync& fence = m_Fences[region];
+    if (fence == nullptr) {
+        return true;
+    }
+
+    GLenum result;
+    do {
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                  WAIT_TIMEOUT_NS);
+    } while (result == GL_TIMEOUT_EXPIRED);
+    glDeleteSync(fence);
+    fence = nullptr;
+    if (result == GL_WAIT_FAILED) {
+        TM_LOG_ERROR("Waiting on an indirect draw fence failed");
+        return false;
+    }
+    return true;
+}
+
+bool IndirectDrawList::writeRegion()
+{
+    // The draws submitted since the last build are the last ones reading
+    // its region
+    if (m_IsRegionWritten) {
+        m_Fences[m_RegionIndex] =
+            glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_RegionIndex = (m_RegionIndex + 1) % REGION_COUNT;
+        m_IsRegionWritten = false;
+    }
+
+    const size_t commands_size =
+        m_Commands.size() * sizeof(DrawElementsIndirectCommand);
+    const size_t colors_offset = alignUp(commands_size, m_Alignment);
+    const size_t size = colors_offset + m_DrawColors.size() * sizeof(glm::vec4);
+    if (size > m_RegionSize) {
+        const size_t region_size = std::max(size, m_RegionSize * 2);
+        TM_LOG_INFO("Growing indirect draw regions from {} to {} bytes",
+                    m_RegionSize, region_size);
+        releaseBuffer();
+        if (!createBuffer(region_size)) {
+            return false;
+        }
+    } else if (!waitForRegion(m_RegionIndex)) {
+        return false;
+    }
+
+    m_CommandsOffset = m_RegionIndex * m_RegionSize;
+    m_ColorsOffset = m_CommandsOffset + colors_offset;
+    std::memcpy(m_MappedData + m_CommandsOffset, m_Commands.data(),
+                commands_size);
+    std::memcpy(m_MappedData + m_ColorsOffset, m_DrawColors.data(),
+                m_DrawColors.size() * sizeof(glm::vec4));
+    m_IsRegionWritten = true;
+    return true;
+}
+
+void IndirectDrawList::build(const std::vector<InstancedDraw>& draws,
+                             const std::vector<Material>& materials,
+                             const Material* wireframe_material)
+{
+    m_Commands.clear();
+    m_DrawColors.clear();
+    for (const InstancedDraw& draw : draws) {
+        m_Commands.push_back(DrawElementsIndirectCommand{
+            (unsigned int)draw.IndexCount, draw.InstanceCount,
+            draw.FirstIndex, draw.BaseVertex, draw.BaseInstance});
+
+        const bool has_material = draw.MaterialIndex >= 0 &&
+                                  draw.MaterialIndex < (int)materials.size();
+        m_DrawColors.push_back(
+            has_material ? glm::vec4(glm::vec3(materials[draw.MaterialIndex]
+                                                   .getColor()),
+                                     1.0f)
+                         : DEFAULT_COLOR);
+    }
+
+    if (wireframe_material != nullptr) {
+        m_DrawColors.resize(
+            m_Commands.size() * 2,
+            glm::vec4(glm::vec3(wireframe_material->getColor()), 1.0f));
+    }
+
+    if (m_Commands.empty()) {
+        return;
+    }
+
+    // Nothing to draw from without a region
+    if (!writeRegion()) {
+        m_Commands.clear();
+        m_DrawColors.clear();
+    }
+}
+
+void IndirectDrawList::submit(unsigned int pass) const
+{
+    if (m_Commands.empty()) {
+        return;
+    }
+
+    const GLuint draw_id_base = pass * (GLuint)m_Commands.size();
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_COLORS_BINDING, m_Buffer,
+                      (GLintptr)m_ColorsOffset,
+                      (GLsizeiptr)(m_DrawColors.size() * sizeof(glm::vec4)));
+
+    if (m_UseMultiDraw) {
+        glUniform1ui(DRAW_ID_BASE_LOCATION, draw_id_base);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_Buffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                    (const void*)(uintptr_t)m_CommandsOffset,
+                                    (GLsizei)m_Commands.size(), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        return;
+    }
+
+    // gl_DrawID is zero outside of multi-draws, so the uniform carries the
+    // whole draw index
+    for (size_t i = 0; i < m_Commands.size(); ++i) {
+        const DrawElementsIndirectCommand& command = m_Commands[i];
+        glUniform1ui(DRAW_ID_BASE_LOCATION, draw_id_base + (GLuint)i);
+        glDrawElementsInstancedBaseVertexBaseInstance(
+            GL_TRIANGLES, (GLsizei)command.count, GL_UNSIGNED_INT,
+            (const void*)((uintptr_t)command.firstIndex *
+                          sizeof(unsigned int)),
+            (GLsizei)command.instanceCount, command.baseVertex,
+            command.baseInstance);
+    }
+}
+
+}  // namespace tamarindo
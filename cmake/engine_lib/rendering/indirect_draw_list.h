@@ -0,0 +1,138 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_INDIRECT_DRAW_LIST_H_
+#define ENGINE_LIB_RENDERING_INDIRECT_DRAW_LIST_H_
+
+#include "engine_lib/rendering/instance_batcher.h"
+#include "engine_lib/rendering/material.h"
+
+#include "glm/glm.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Same typedef as glad, so this header does not need it
+typedef struct __GLsync* GLsync;
+
+namespace tamarindo
+{
+
+// Layout glMultiDrawElementsIndirect reads from the draw indirect buffer
+struct DrawElementsIndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+};
+
+// Turns the instanced draws of a model into indirect draw commands, built on
+// the CPU every frame, and submits all of them with a single
+// glMultiDrawElementsIndirect call. The geometry of the model has to live in
+// one vertex array, see GLTFModel::getVertexArray.
+//
+// Materials cannot change between the draws of one call, so the color of
+// every draw goes into a shader storage buffer. Shaders read it at
+// drawIdBase + gl_DrawID, with drawIdBase the uint uniform at
+// DRAW_ID_BASE_LOCATION.
+//
+// Commands and colors are written into one buffer mapped once, persistent
+// and coherent, split into REGION_COUNT regions like GLRingBuffer. Each
+// build() fences the region of the previous one and waits for the fence of
+// the region it writes, so the buffer is never re-specified. A build that
+// does not fit replaces the buffer with a larger one, which GL keeps alive
+// until the draws still reading it are done.
+class IndirectDrawList
+{
+   public:
+    // Shader storage binding of the per-draw colors, one vec4 each
+    static constexpr unsigned int DRAW_COLORS_BINDING = 0;
+    static constexpr int DRAW_ID_BASE_LOCATION = 0;
+
+    // Passes submit() takes: the materials of the draws, and the wireframe
+    // material over all of them
+    static constexpr unsigned int MATERIAL_PASS = 0;
+    static constexpr unsigned int WIREFRAME_PASS = 1;
+
+    // Builds whose data the GPU can still be reading
+    static constexpr unsigned int REGION_COUNT = 3;
+
+    bool initialize();
+    void terminate();
+
+    // Replaces the commands with one per draw, in the same order.
+    // `wireframe_material` may be null if the wireframe pass is not used.
+    void build(const std::vector<InstancedDraw>& draws,
+               const std::vector<Material>& materials,
+               const Material* wireframe_material);
+
+    // Draws every command. The vertex array of the model and the shader
+    // program have to be bound.
+    void submit(unsigned int pass) const;
+
+    // When turned off, the same commands are issued one by one from the CPU
+    // with drawIdBase carrying the whole draw index, to compare against the
+    // multi-draw. The shaders need GL 4.6 either way, which has multi-draw
+    // indirect.
+    inline bool usesMultiDraw() const { return m_UseMultiDraw; }
+    inline void setUseMultiDraw(bool use_multi_draw)
+    {
+        m_UseMultiDraw = use_multi_draw;
+    }
+
+    inline const std::vector<DrawElementsIndirectCommand>& getCommands() const
+    {
+        return m_Commands;
+    }
+
+   private:
+    bool createBuffer(size_t region_size);
+    void releaseBuffer();
+
+    // Waits until the GPU is done with the region
+    bool waitForRegion(unsigned int region);
+
+    // Copies the commands and colors into the next region. Returns false if
+    // the buffer could not grow or a fence failed.
+    bool writeRegion();
+
+    std::vector<DrawElementsIndirectCommand> m_Commands;
+    // MATERIAL_PASS colors first, then WIREFRAME_PASS ones
+    std::vector<glm::vec4> m_DrawColors;
+
+    unsigned int m_Buffer = 0;
+    uint8_t* m_MappedData = nullptr;
+    size_t m_RegionSize = 0;
+    // Of regions and of the colors in them, a multiple of the shader storage
+    // offset alignment
+    size_t m_Alignment = sizeof(glm::vec4);
+    std::array<GLsync, REGION_COUNT> m_Fences = {};
+    unsigned int m_RegionIndex = 0;
+    bool m_IsRegionWritten = false;
+
+    // Where the last build wrote, from the start of m_Buffer
+    size_t m_CommandsOffset = 0;
+    size_t m_ColorsOffset = 0;
+
+    bool m_UseMultiDraw = true;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_INDIRECT_DRAW_LIST_H_
@@ -0,0 +1,73 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "engine_lib/rendering/instance_batcher.h"
+
+#include "engine_lib/rendering/gltf_model.h"
+#include "engine_lib/world/bounds.h"
+
+#include <algorithm>
+
+namespace tamarindo
+{
+
+void InstanceBatcher::build(const GLTFModel& model,
+                            const glm::mat4& model_matrix,
+                            const Frustum* frustum)
+{
+    m_InstanceMatrices.clear();
+    m_Draws.clear();
+
+    for (const auto& [mesh_index, transforms] : model.m_MeshInstances) {
+        const GLTFMesh& mesh = model.m_Meshes.at(mesh_index);
+
+        const unsigned int base_instance =
+            static_cast<unsigned int>(m_InstanceMatrices.size());
+        for (const Transform& t : transforms) {
+            const glm::mat4 instance_matrix = model_matrix * t.getMatrix();
+            if (frustum != nullptr &&
+                frustum->test(transformAABB(mesh.Bounds, instance_matrix)) ==
+                    FrustumTest::Outside) {
+                continue;
+            }
+            m_InstanceMatrices.push_back(instance_matrix);
+        }
+
+        const unsigned int instance_count =
+            static_cast<unsigned int>(m_InstanceMatrices.size()) -
+            base_instance;
+        if (instance_count == 0) {
+            continue;
+        }
+
+        for (const GLTFPrimitive& primitive : mesh.Primitives) {
+            m_Draws.push_back(InstancedDraw{
+                primitive.IndexCount, primitive.FirstIndex,
+                primitive.BaseVertex, primitive.MaterialIndex, base_instance,
+                instance_count});
+        }
+    }
+
+    std::sort(m_Draws.begin(), m_Draws.end(),
+              [](const InstancedDraw& a, const InstancedDraw& b) {
+                  if (a.MaterialIndex != b.MaterialIndex) {
+                      return a.MaterialIndex < b.MaterialIndex;
+                  }
+                  return a.FirstIndex < b.FirstIndex;
+              });
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,70 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_INSTANCE_BATCHER_H_
+#define ENGINE_LIB_RENDERING_INSTANCE_BATCHER_H_
+
+#include "glm/glm.hpp"
+
+#include <vector>
+
+namespace tamarindo
+{
+class Frustum;
+class GLTFModel;
+
+// One instanced draw of a primitive, from the shared buffers of the model.
+// Its instance matrices are [baseInstance, baseInstance + instanceCount) in
+// the packed matrix array.
+struct InstancedDraw {
+    size_t IndexCount;
+    unsigned int FirstIndex;
+    int BaseVertex;
+    int MaterialIndex;
+    unsigned int BaseInstance;
+    unsigned int InstanceCount;
+};
+
+// Turns the per-mesh instance lists of a GLTFModel into one instanced draw
+// per primitive. The matrices of the visible instances of a mesh are packed
+// next to each other, so every primitive of the mesh shares the same range.
+class InstanceBatcher
+{
+   public:
+    // Instances whose bounds are outside `frustum` are dropped. A null
+    // frustum keeps every instance.
+    void build(const GLTFModel& model, const glm::mat4& model_matrix,
+               const Frustum* frustum);
+
+    inline const std::vector<glm::mat4>& getInstanceMatrices() const
+    {
+        return m_InstanceMatrices;
+    }
+
+    // Sorted by material, then by position in the index buffer
+    inline const std::vector<InstancedDraw>& getDraws() const
+    {
+        return m_Draws;
+    }
+
+   private:
+    std::vector<glm::mat4> m_InstanceMatrices;
+    std::vector<InstancedDraw> m_Draws;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_INSTANCE_BATCHER_H_
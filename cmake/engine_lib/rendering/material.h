@@ -43,6 +43,8 @@ class Material
 
     void setColor(const Color& color);
 
+    inline const Color& getColor() const { return m_Color; }
+
    private:
     Color m_Color;
 };
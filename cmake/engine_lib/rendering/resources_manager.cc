@@ -39,6 +39,13 @@ bool ResourcesManager::createBuffer(const BufferDesc& desc,
     return true;
 }
 
+void ResourcesManager::updateBuffer(unsigned int buffer,
+                                    const BufferDesc& desc)
+{
+    glNamedBufferData(buffer, desc.size, desc.data, GL_STREAM_DRAW);
+    CheckOpenGLErr();
+}
+
 void ResourcesManager::releaseBuffer(unsigned int buffer)
 {
     glDeleteBuffers(1, &buffer);
@@ -63,6 +70,22 @@ bool ResourcesManager::createVertexArray(const VertexArrayDesc& desc,
                                   attr_desc.byteOffset, attr_desc.stride);
     }
 
+    if (desc.instanceBuffer != 0) {
+        // Per-vertex attributes use their location as binding index, so the
+        // first matrix location is free to use as well
+        const GLuint binding = desc.instanceMatrixLocation;
+        glVertexArrayVertexBuffer(vao, binding, desc.instanceBuffer, 0,
+                                  sizeof(float) * 16);
+        glVertexArrayBindingDivisor(vao, binding, 1);
+        for (GLuint column = 0; column < 4; ++column) {
+            const GLuint location = desc.instanceMatrixLocation + column;
+            glEnableVertexArrayAttrib(vao, location);
+            glVertexArrayAttribBinding(vao, location, binding);
+            glVertexArrayAttribFormat(vao, location, 4, GL_FLOAT, GL_FALSE,
+                                      sizeof(float) * 4 * column);
+        }
+    }
+
     glVertexArrayElementBuffer(vao, desc.elementArrayBuffer);
 
     *vertex_array = vao;
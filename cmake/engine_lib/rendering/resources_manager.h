@@ -43,6 +43,11 @@ struct VertexArrayDesc {
     unsigned int elementArrayBuffer;
 
     std::vector<VertexArrayAtrributeDesc> atributeData;
+
+    // Optional buffer with one mat4 per instance, read as four vec4
+    // attributes starting at instanceMatrixLocation
+    unsigned int instanceBuffer = 0;
+    unsigned int instanceMatrixLocation = 2;
 };
 
 class ResourcesManager
@@ -50,6 +55,10 @@ class ResourcesManager
    public:
     static bool createBuffer(const BufferDesc& desc, unsigned int* buffer);
 
+    // Replaces the whole content of the buffer, letting the driver orphan
+    // the old storage instead of waiting for the draws that still read it
+    static void updateBuffer(unsigned int buffer, const BufferDesc& desc);
+
     static bool createVertexArray(const VertexArrayDesc& desc,
                                   unsigned int* vertex_array);
 
@@ -18,7 +18,8 @@
 #include "engine_lib/input/input_manager.h"
 #include "engine_lib/logging/logger.h"
 #include "engine_lib/rendering/gltf_model.h"
-#include "engine_lib/rendering/scene.h"
+#include "engine_lib/rendering/resources_manager.h"
+#include "engine_lib/world/scene.h"
 
 // TODO: Do not expose this
 #include "glad/glad.h"
@@ -35,27 +36,34 @@ std::string VERTEX_SHADER = R"(
 
         layout(location = 0) in vec3 aPos;
         layout(location = 1) in vec2 aUVs;
+        // Per-instance, takes locations 2 to 5
+        layout(location = 2) in mat4 aModel;
+
+        // One color per draw, see IndirectDrawList
+        layout(std430, binding = 0) readonly buffer DrawColors {
+            vec4 drawColors[];
+        };
+        layout(location = 0) uniform uint drawIdBase;
 
-        uniform mat4 model;
         uniform mat4 viewProj;
 
+        flat out vec3 color;
+
         void main() {
-            gl_Position = viewProj * model * vec4(aPos, 1.0);
+            gl_Position = viewProj * aModel * vec4(aPos, 1.0);
+            color = drawColors[drawIdBase + gl_DrawID].rgb;
         }
     )";
 
 std::string FRAGMENT_SHADER = R"(
         #version 460 core
 
-        struct MyMaterial {
-            vec3 color;
-        };
-        uniform MyMaterial material;
+        flat in vec3 color;
 
         out vec4 out_color;
 
         void main() {
-            out_color = vec4(material.color, 1.0f);
+            out_color = vec4(color, 1.0f);
         }
     )";
 }  // namespace
@@ -67,11 +75,16 @@ SceneRenderer::SceneRenderer(GLFWwindow* window) : m_Window(window)
     if (!m_ShaderProgram) {
         TM_LOG_ERROR("Could not create shader");
     }
+    m_IndirectDraws.initialize();
 }
 
 SceneRenderer::~SceneRenderer() = default;
 
-void SceneRenderer::terminate() { m_ShaderProgram->terminate(); }
+void SceneRenderer::terminate()
+{
+    m_IndirectDraws.terminate();
+    m_ShaderProgram->terminate();
+}
 
 void SceneRenderer::render()
 {
@@ -90,35 +103,40 @@ void SceneRenderer::render()
     // m_ShaderProgram->bind();
     // m_ScenePtr->bindToShader(*m_ShaderProgram.get());
 
-    // for (const auto& [mesh_index, transforms] : model->m_MeshInstances) {
-    //     const GLTFMesh& mesh = model->m_Meshes.at(mesh_index);
-
-    //    for (const auto& primitive : mesh.Primitives) {
-    //        glBindVertexArray(primitive.VAO);
-    //        for (const auto& t : transforms) {
-    //            glm::mat4 model_matrix = transform.getMatrix() *
-    //            t.getMatrix(); m_ShaderProgram->setMat4f("model",
-    //            model_matrix);
-
-    //            model->m_Materials[primitive.MaterialIndex].submitForRender(
-    //                *m_ShaderProgram);
-    //            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    //            glDrawElements(GL_TRIANGLES, (GLsizei)primitive.IndexCount,
-    //                           GL_UNSIGNED_INT, 0);
-
-    //            // TODO: Fix this hack
-    //            if (m_RenderWireframe) {
-    //                m_DebugMaterial.submitForRender(*m_ShaderProgram);
-    //                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    //                glDrawElements(GL_TRIANGLES,
-    //                (GLsizei)primitive.IndexCount,
-    //                               GL_UNSIGNED_INT, 0);
-    //            }
-    //        }
-
-    //        glBindVertexArray(0);
-    //    }
-    //}
+    // renderModel(model, transform.getMatrix(), nullptr);
+}
+
+void SceneRenderer::renderModel(GLTFModel* model, const glm::mat4& model_matrix,
+                                const Frustum* frustum)
+{
+    m_InstanceBatcher.build(*model, model_matrix, frustum);
+    const std::vector<glm::mat4>& matrices =
+        m_InstanceBatcher.getInstanceMatrices();
+    if (matrices.empty()) {
+        return;
+    }
+
+    BufferDesc instance_desc;
+    instance_desc.data = matrices.data();
+    instance_desc.size = (long)(matrices.size() * sizeof(glm::mat4));
+    ResourcesManager::updateBuffer(model->getInstanceBuffer(), instance_desc);
+
+    m_IndirectDraws.build(m_InstanceBatcher.getDraws(), model->m_Materials,
+                          m_RenderWireframe ? &m_DebugMaterial : nullptr);
+
+    // Every primitive of the model is in the same buffers, so all the draws
+    // go out in one call per pass
+    glBindVertexArray(model->getVertexArray());
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    m_IndirectDraws.submit(IndirectDrawList::MATERIAL_PASS);
+
+    // TODO: Fix this hack
+    if (m_RenderWireframe) {
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        m_IndirectDraws.submit(IndirectDrawList::WIREFRAME_PASS);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    }
+    glBindVertexArray(0);
 }
 
 void SceneRenderer::update(const tamarindo::Timer& timer)
@@ -17,6 +17,8 @@
 #ifndef ENGINE_LIB_SCENE_RENDERER_H_
 #define ENGINE_LIB_SCENE_RENDERER_H_
 
+#include "engine_lib/rendering/indirect_draw_list.h"
+#include "engine_lib/rendering/instance_batcher.h"
 #include "engine_lib/rendering/material.h"
 #include "engine_lib/rendering/shader_program.h"
 
@@ -26,6 +28,8 @@ struct GLFWwindow;
 
 namespace tamarindo
 {
+class Frustum;
+class GLTFModel;
 class ShaderProgram;
 class Timer;
 
@@ -43,8 +47,17 @@ class SceneRenderer
     void update(const Timer& timer);
 
    private:
+    // Draws every visible instance of the model with one multi-draw
+    // indirect call, one command per primitive. `frustum` may be null to
+    // skip culling.
+    void renderModel(GLTFModel* model, const glm::mat4& model_matrix,
+                     const Frustum* frustum);
+
     bool m_RenderWireframe = true;
 
+    InstanceBatcher m_InstanceBatcher;
+    IndirectDrawList m_IndirectDraws;
+
     std::unique_ptr<ShaderProgram> m_ShaderProgram = nullptr;
 
    private:
@@ -0,0 +1,142 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "engine_lib/utils/thread_pool.h"
+
+namespace tamarindo
+{
+
+namespace
+{
+
+size_t getDefaultWorkerCount()
+{
+    const unsigned int hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads > 1 ? hardware_threads - 1 : 0;
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool() : ThreadPool(getDefaultWorkerCount()) {}
+
+ThreadPool::ThreadPool(size_t worker_count)
+{
+    m_Workers.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; ++i) {
+        m_Workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_IsStopping = true;
+    }
+    m_WorkAvailable.notify_all();
+
+    for (std::thread& worker : m_Workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t job_count,
+                             const std::function<void(size_t)>& job)
+{
+    if (job_count == 0) {
+        return;
+    }
+
+    if (m_Workers.empty() || job_count == 1) {
+        for (size_t i = 0; i < job_count; ++i) {
+            job(i);
+        }
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        // A worker that woke up late for the previous batch may still be
+        // looking at the job counter, so wait for it before resetting it.
+        m_WorkFinished.wait(lock, [this] { return m_ActiveWorkers == 0; });
+
+        m_Job = &job;
+        m_JobCount = job_count;
+        m_PendingJobs = job_count;
+        m_NextJob.store(0, std::memory_order_relaxed);
+        ++m_Generation;
+    }
+    m_WorkAvailable.notify_all();
+
+    runJobs(job, job_count);
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_WorkFinished.wait(lock, [this] { return m_PendingJobs == 0; });
+    m_Job = nullptr;
+}
+
+void ThreadPool::workerLoop()
+{
+    uint64_t last_generation = 0;
+    while (true) {
+        const std::function<void(size_t)>* job = nullptr;
+        size_t job_count = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WorkAvailable.wait(lock, [this, last_generation] {
+                return m_IsStopping || m_Generation != last_generation;
+            });
+            if (m_IsStopping) {
+                return;
+            }
+            last_generation = m_Generation;
+            job = m_Job;
+            job_count = m_JobCount;
+            ++m_ActiveWorkers;
+        }
+
+        if (job != nullptr) {
+            runJobs(*job, job_count);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            --m_ActiveWorkers;
+        }
+        m_WorkFinished.notify_all();
+    }
+}
+
+void ThreadPool::runJobs(const std::function<void(size_t)>& job,
+                         size_t job_count)
+{
+    size_t completed_jobs = 0;
+    for (size_t i = m_NextJob.fetch_add(1, std::memory_order_relaxed);
+         i < job_count; i = m_NextJob.fetch_add(1, std::memory_order_relaxed)) {
+        job(i);
+        ++completed_jobs;
+    }
+
+    if (completed_jobs > 0) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_PendingJobs -= completed_jobs;
+        if (m_PendingJobs == 0) {
+            m_WorkFinished.notify_all();
+        }
+    }
+}
+
+}  // namespace tamarindo
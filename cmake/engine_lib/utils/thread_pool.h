@@ -0,0 +1,77 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_UTILS_THREAD_POOL_H_
+#define ENGINE_LIB_UTILS_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tamarindo
+{
+
+// Fixed set of worker threads that run batches of independent jobs. The
+// thread calling parallelFor() also runs jobs, so a pool with N workers uses
+// N + 1 threads.
+class ThreadPool
+{
+   public:
+    // Uses one worker per hardware thread, minus the calling thread.
+    ThreadPool();
+    explicit ThreadPool(size_t worker_count);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    inline size_t getWorkerCount() const { return m_Workers.size(); }
+
+    // Runs job(i) for every i in [0, job_count) and returns once all of them
+    // finished. Jobs may run in any order and on any thread.
+    void parallelFor(size_t job_count,
+                     const std::function<void(size_t)>& job);
+
+   private:
+    void workerLoop();
+
+    void runJobs(const std::function<void(size_t)>& job, size_t job_count);
+
+    std::vector<std::thread> m_Workers;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkAvailable;
+    std::condition_variable m_WorkFinished;
+
+    // Current batch, guarded by m_Mutex except for the job counter
+    const std::function<void(size_t)>* m_Job = nullptr;
+    size_t m_JobCount = 0;
+    size_t m_PendingJobs = 0;
+    size_t m_ActiveWorkers = 0;
+    uint64_t m_Generation = 0;
+    bool m_IsStopping = false;
+
+    std::atomic<size_t> m_NextJob{0};
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_UTILS_THREAD_POOL_H_
@@ -0,0 +1,111 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "engine_lib/world/bounds.h"
+
+#include <algorithm>
+
+namespace tamarindo
+{
+
+AABB transformAABB(const AABB& box, const glm::mat4& transform)
+{
+    if (box.isEmpty()) {
+        return box;
+    }
+
+    // Arvo's method: each matrix column contributes its min and max
+    // separately, which avoids transforming all eight corners.
+    AABB result;
+    result.min = glm::vec3(transform[3]);
+    result.max = result.min;
+    for (int col = 0; col < 3; ++col) {
+        const glm::vec3 axis = glm::vec3(transform[col]);
+        const glm::vec3 a = axis * box.min[col];
+        const glm::vec3 b = axis * box.max[col];
+        result.min += glm::min(a, b);
+        result.max += glm::max(a, b);
+    }
+    return result;
+}
+
+bool intersectRayAABB(const glm::vec3& origin, const glm::vec3& inv_direction,
+                      const AABB& box, float max_t, float* t_entry)
+{
+    float t_min = 0.0f;
+    float t_max = max_t;
+    for (int axis = 0; axis < 3; ++axis) {
+        float t0 = (box.min[axis] - origin[axis]) * inv_direction[axis];
+        float t1 = (box.max[axis] - origin[axis]) * inv_direction[axis];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        // Written so NaNs from 0 * inf keep the previous bound
+        t_min = t0 > t_min ? t0 : t_min;
+        t_max = t1 < t_max ? t1 : t_max;
+        if (t_min > t_max) {
+            return false;
+        }
+    }
+    *t_entry = t_min;
+    return true;
+}
+
+/*static*/ Frustum Frustum::fromMatrix(const glm::mat4& view_projection)
+{
+    // Gribb-Hartmann: each plane is the last row of the matrix plus or minus
+    // one of the other rows. GLM matrices are column-major.
+    const glm::mat4& m = view_projection;
+    const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.m_Planes[Left] = row3 + row0;
+    frustum.m_Planes[Right] = row3 - row0;
+    frustum.m_Planes[Bottom] = row3 + row1;
+    frustum.m_Planes[Top] = row3 - row1;
+    frustum.m_Planes[Near] = row3 + row2;
+    frustum.m_Planes[Far] = row3 - row2;
+
+    for (glm::vec4& plane : frustum.m_Planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+FrustumTest Frustum::test(const AABB& box) const
+{
+    const glm::vec3 center = box.getCenter();
+    const glm::vec3 half_extent = box.getExtent() * 0.5f;
+
+    FrustumTest result = FrustumTest::Inside;
+    for (const glm::vec4& plane : m_Planes) {
+        const glm::vec3 normal(plane);
+        const float distance = glm::dot(normal, center) + plane.w;
+        const float radius = glm::dot(glm::abs(normal), half_extent);
+        if (distance < -radius) {
+            return FrustumTest::Outside;
+        }
+        if (distance < radius) {
+            result = FrustumTest::Intersects;
+        }
+    }
+    return result;
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,114 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_WORLD_BOUNDS_H_
+#define ENGINE_LIB_WORLD_BOUNDS_H_
+
+#include "glm/glm.hpp"
+
+#include <array>
+#include <limits>
+
+namespace tamarindo
+{
+
+struct AABB {
+    // Default constructed boxes are empty, so growing them with expand()
+    // starts from the first point.
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    inline bool isEmpty() const
+    {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+
+    inline glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+    inline glm::vec3 getExtent() const { return max - min; }
+
+    inline void expand(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    inline void expand(const AABB& other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    // Half of the surface area, which is all the SAH needs
+    inline float getHalfArea() const
+    {
+        const glm::vec3 e = getExtent();
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    inline bool contains(const AABB& other) const
+    {
+        return other.min.x >= min.x && other.min.y >= min.y &&
+               other.min.z >= min.z && other.max.x <= max.x &&
+               other.max.y <= max.y && other.max.z <= max.z;
+    }
+
+    inline bool overlaps(const AABB& other) const
+    {
+        return other.min.x <= max.x && other.max.x >= min.x &&
+               other.min.y <= max.y && other.max.y >= min.y &&
+               other.min.z <= max.z && other.max.z >= min.z;
+    }
+};
+
+// Bounds of `box` after applying `transform`, which may rotate it
+AABB transformAABB(const AABB& box, const glm::mat4& transform);
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+// Distance along the ray where it enters the box, clamped to [0, max_t]. The
+// ray is given by its origin and 1 / direction. Returns false if it misses.
+bool intersectRayAABB(const glm::vec3& origin, const glm::vec3& inv_direction,
+                      const AABB& box, float max_t, float* t_entry);
+
+enum class FrustumTest { Outside, Intersects, Inside };
+
+// Six planes stored as (normal, distance). A point p is inside a plane when
+// dot(normal, p) + distance >= 0.
+class Frustum
+{
+   public:
+    enum Plane { Left = 0, Right, Bottom, Top, Near, Far, Count };
+
+    // Extracts the planes from a view-projection matrix with OpenGL clip
+    // space (-w <= z <= w). Works for perspective and orthographic cameras.
+    static Frustum fromMatrix(const glm::mat4& view_projection);
+
+    FrustumTest test(const AABB& box) const;
+
+    inline const glm::vec4& getPlane(int plane) const
+    {
+        return m_Planes[plane];
+    }
+
+   private:
+    std::array<glm::vec4, Plane::Count> m_Planes;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_WORLD_BOUNDS_H_
@@ -0,0 +1,441 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "engine_lib/world/bvh.h"
+
+#include "engine_lib/utils/thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+struct Bin {
+    AABB bounds;
+    uint32_t count = 0;
+};
+
+uint32_t getBinIndex(float centroid, float min, float scale)
+{
+    const uint32_t bin = static_cast<uint32_t>((centroid - min) * scale);
+    return std::min(bin, BoundingVolumeHierarchy::BIN_COUNT - 1);
+}
+
+}  // namespace
+
+void BoundingVolumeHierarchy::build(const AABB* bounds, size_t count,
+                                    ThreadPool* thread_pool)
+{
+    clear();
+    if (count == 0) {
+        return;
+    }
+
+    m_BuildPrimitives.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        m_BuildPrimitives[i] = {bounds[i], bounds[i].getCenter(), i};
+    }
+
+    m_Nodes.reserve(2 * count);
+    m_Nodes.emplace_back();
+
+    const uint32_t primitive_count = static_cast<uint32_t>(count);
+    if (thread_pool == nullptr || thread_pool->getWorkerCount() == 0 ||
+        count < MIN_PARALLEL_PRIMITIVES) {
+        buildNode(&m_Nodes, 0, 0, primitive_count, nullptr, 0);
+        finishBuild();
+        return;
+    }
+
+    // Enough subtrees to keep every thread busy even if they are unbalanced
+    const size_t thread_count = thread_pool->getWorkerCount() + 1;
+    const uint32_t defer_size = std::max(
+        MIN_SUBTREE_SIZE, static_cast<uint32_t>(count / (thread_count * 4)));
+
+    std::vector<BuildTask> tasks;
+    buildNode(&m_Nodes, 0, 0, primitive_count, &tasks, defer_size);
+
+    // Subtrees only touch their own primitive range, so they can be built
+    // independently into local arrays
+    std::vector<std::vector<Node>> subtrees(tasks.size());
+    thread_pool->parallelFor(tasks.size(), [&](size_t t) {
+        const BuildTask& task = tasks[t];
+        std::vector<Node>& nodes = subtrees[t];
+        nodes.reserve(2 * (task.end - task.begin));
+        nodes.emplace_back();
+        buildNode(&nodes, 0, task.begin, task.end, nullptr, 0);
+    });
+
+    // The root of each subtree replaces its placeholder, and the rest of the
+    // nodes are appended with their child indices rebased.
+    for (size_t t = 0; t < tasks.size(); ++t) {
+        const std::vector<Node>& nodes = subtrees[t];
+        const uint32_t base = static_cast<uint32_t>(m_Nodes.size()) - 1;
+        auto rebase = [base](Node node) {
+            if (!node.isLeaf()) {
+                node.first += base;
+            }
+            return node;
+        };
+
+        m_Nodes[tasks[t].node] = rebase(nodes[0]);
+        for (size_t i = 1; i < nodes.size(); ++i) {
+            m_Nodes.push_back(rebase(nodes[i]));
+        }
+    }
+    finishBuild();
+}
+
+void BoundingVolumeHierarchy::finishBuild()
+{
+    m_PrimitiveBounds.resize(m_BuildPrimitives.size());
+    m_PrimitiveIndices.resize(m_BuildPrimitives.size());
+    for (size_t i = 0; i < m_BuildPrimitives.size(); ++i) {
+        m_PrimitiveBounds[i] = m_BuildPrimitives[i].bounds;
+        m_PrimitiveIndices[i] = m_BuildPrimitives[i].index;
+    }
+    m_BuildPrimitives.clear();
+    m_BuildPrimitives.shrink_to_fit();
+}
+
+void BoundingVolumeHierarchy::clear()
+{
+    m_Nodes.clear();
+    m_BuildPrimitives.clear();
+    m_PrimitiveBounds.clear();
+    m_PrimitiveIndices.clear();
+}
+
+void BoundingVolumeHierarchy::buildNode(std::vector<Node>* nodes,
+                                        uint32_t node_index, uint32_t begin,
+                                        uint32_t end,
+                                        std::vector<BuildTask>* deferred,
+                                        uint32_t defer_size)
+{
+    AABB bounds;
+    for (uint32_t i = begin; i < end; ++i) {
+        bounds.expand(m_BuildPrimitives[i].bounds);
+    }
+    (*nodes)[node_index].bounds = bounds;
+
+    const uint32_t count = end - begin;
+    if (deferred != nullptr && count <= defer_size) {
+        deferred->push_back({node_index, begin, end});
+        return;
+    }
+
+    const uint32_t mid = splitRange(begin, end, bounds);
+    if (mid == end) {
+        (*nodes)[node_index].first = begin;
+        (*nodes)[node_index].count = count;
+        return;
+    }
+
+    const uint32_t left = static_cast<uint32_t>(nodes->size());
+    nodes->resize(nodes->size() + 2);
+    (*nodes)[node_index].first = left;
+    (*nodes)[node_index].count = 0;
+
+    buildNode(nodes, left, begin, mid, deferred, defer_size);
+    buildNode(nodes, left + 1, mid, end, deferred, defer_size);
+}
+
+uint32_t BoundingVolumeHierarchy::splitRange(uint32_t begin, uint32_t end,
+                                             const AABB& bounds)
+{
+    // Binning costs the same for 2 primitives as for 2000, and a few boxes
+    // per leaf are cheap to test, so small ranges always become leaves
+    const uint32_t count = end - begin;
+    if (count <= MAX_LEAF_SIZE) {
+        return end;
+    }
+
+    AABB centroid_bounds;
+    for (uint32_t i = begin; i < end; ++i) {
+        centroid_bounds.expand(m_BuildPrimitives[i].centroid);
+    }
+    const glm::vec3 extent = centroid_bounds.getExtent();
+
+    // SAH cost relative to intersecting every primitive in a leaf, with one
+    // unit for the traversal step
+    float best_cost = static_cast<float>(count);
+    int best_axis = -1;
+    uint32_t best_bin = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (extent[axis] <= 0.0f) {
+            continue;
+        }
+        const float min = centroid_bounds.min[axis];
+        const float scale = BIN_COUNT / extent[axis];
+
+        std::array<Bin, BIN_COUNT> bins;
+        for (uint32_t i = begin; i < end; ++i) {
+            const BuildPrimitive& primitive = m_BuildPrimitives[i];
+            Bin& bin =
+                bins[getBinIndex(primitive.centroid[axis], min, scale)];
+            bin.bounds.expand(primitive.bounds);
+            ++bin.count;
+        }
+
+        // Sweep from the right to get the cost of every split plane in one
+        // pass from the left
+        std::array<float, BIN_COUNT - 1> right_costs;
+        AABB right_bounds;
+        uint32_t right_count = 0;
+        for (uint32_t b = BIN_COUNT - 1; b > 0; --b) {
+            right_bounds.expand(bins[b].bounds);
+            right_count += bins[b].count;
+            right_costs[b - 1] = right_count == 0
+                                     ? 0.0f
+                                     : right_bounds.getHalfArea() * right_count;
+        }
+
+        AABB left_bounds;
+        uint32_t left_count = 0;
+        const float inv_area = 1.0f / std::max(bounds.getHalfArea(), 1e-12f);
+        for (uint32_t b = 0; b < BIN_COUNT - 1; ++b) {
+            left_bounds.expand(bins[b].bounds);
+            left_count += bins[b].count;
+            if (left_count == 0 || left_count == count) {
+                continue;
+            }
+            const float cost =
+                1.0f + (left_bounds.getHalfArea() * left_count +
+                        right_costs[b]) *
+                           inv_area;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b;
+            }
+        }
+    }
+
+    if (best_axis < 0) {
+        // Every centroid is in the same spot, or no split beats a leaf but
+        // the leaf would be too big: split in the middle of the range
+        return begin + count / 2;
+    }
+
+    const float min = centroid_bounds.min[best_axis];
+    const float scale = BIN_COUNT / extent[best_axis];
+    BuildPrimitive* const mid = std::partition(
+        m_BuildPrimitives.data() + begin, m_BuildPrimitives.data() + end,
+        [&](const BuildPrimitive& primitive) {
+            return getBinIndex(primitive.centroid[best_axis], min, scale) <=
+                   best_bin;
+        });
+    return static_cast<uint32_t>(mid - m_BuildPrimitives.data());
+}
+
+void BoundingVolumeHierarchy::queryFrustum(
+    const Frustum& frustum, std::vector<uint32_t>* results) const
+{
+    if (m_Nodes.empty()) {
+        return;
+    }
+
+    // Nodes fully inside the frustum skip the plane tests for their subtree
+    struct StackEntry {
+        uint32_t node;
+        bool is_inside;
+    };
+    std::vector<StackEntry> stack;
+    stack.reserve(64);
+    stack.push_back({0, false});
+
+    while (!stack.empty()) {
+        const StackEntry entry = stack.back();
+        stack.pop_back();
+        const Node& node = m_Nodes[entry.node];
+
+        bool is_inside = entry.is_inside;
+        if (!is_inside) {
+            const FrustumTest result = frustum.test(node.bounds);
+            if (result == FrustumTest::Outside) {
+                continue;
+            }
+            is_inside = result == FrustumTest::Inside;
+        }
+
+        if (node.isLeaf()) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                if (is_inside || node.count == 1 ||
+                    frustum.test(m_PrimitiveBounds[i]) !=
+                        FrustumTest::Outside) {
+                    results->push_back(m_PrimitiveIndices[i]);
+                }
+            }
+        } else {
+            stack.push_back({node.first + 1, is_inside});
+            stack.push_back({node.first, is_inside});
+        }
+    }
+}
+
+void BoundingVolumeHierarchy::queryBox(const AABB& box,
+                                       std::vector<uint32_t>* results) const
+{
+    if (m_Nodes.empty()) {
+        return;
+    }
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+
+    while (!stack.empty()) {
+        const Node& node = m_Nodes[stack.back()];
+        stack.pop_back();
+        if (!box.overlaps(node.bounds)) {
+            continue;
+        }
+
+        if (node.isLeaf()) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                if (node.count == 1 || box.overlaps(m_PrimitiveBounds[i])) {
+                    results->push_back(m_PrimitiveIndices[i]);
+                }
+            }
+        } else {
+            stack.push_back(node.first + 1);
+            stack.push_back(node.first);
+        }
+    }
+}
+
+void BoundingVolumeHierarchy::queryRay(const Ray& ray, float max_distance,
+                                       std::vector<uint32_t>* results) const
+{
+    if (m_Nodes.empty()) {
+        return;
+    }
+
+    const glm::vec3 inv_direction = 1.0f / ray.direction;
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+
+    float t_entry;
+    while (!stack.empty()) {
+        const Node& node = m_Nodes[stack.back()];
+        stack.pop_back();
+        if (!intersectRayAABB(ray.origin, inv_direction, node.bounds,
+                              max_distance, &t_entry)) {
+            continue;
+        }
+
+        if (node.isLeaf()) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                if (node.count == 1 ||
+                    intersectRayAABB(ray.origin, inv_direction,
+                                     m_PrimitiveBounds[i], max_distance,
+                                     &t_entry)) {
+                    results->push_back(m_PrimitiveIndices[i]);
+                }
+            }
+        } else {
+            stack.push_back(node.first + 1);
+            stack.push_back(node.first);
+        }
+    }
+}
+
+bool BoundingVolumeHierarchy::castRay(const Ray& ray, float max_distance,
+                                      uint32_t* primitive,
+                                      float* distance) const
+{
+    if (m_Nodes.empty()) {
+        return false;
+    }
+
+    const glm::vec3 inv_direction = 1.0f / ray.direction;
+    float closest = max_distance;
+    bool has_hit = false;
+
+    float t_entry;
+    if (!intersectRayAABB(ray.origin, inv_direction, m_Nodes[0].bounds,
+                          closest, &t_entry)) {
+        return false;
+    }
+
+    struct StackEntry {
+        uint32_t node;
+        float t_entry;
+    };
+    std::vector<StackEntry> stack;
+    stack.reserve(64);
+    stack.push_back({0, t_entry});
+
+    while (!stack.empty()) {
+        const StackEntry entry = stack.back();
+        stack.pop_back();
+        // A closer hit was found after this node was pushed
+        if (entry.t_entry > closest) {
+            continue;
+        }
+
+        const Node& node = m_Nodes[entry.node];
+        if (node.isLeaf()) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                if (intersectRayAABB(ray.origin, inv_direction,
+                                     m_PrimitiveBounds[i], closest,
+                                     &t_entry) &&
+                    (!has_hit || t_entry < closest)) {
+                    closest = t_entry;
+                    *primitive = m_PrimitiveIndices[i];
+                    has_hit = true;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first so it can shrink `closest` early
+        float t_left;
+        float t_right;
+        const bool hit_left =
+            intersectRayAABB(ray.origin, inv_direction,
+                             m_Nodes[node.first].bounds, closest, &t_left);
+        const bool hit_right =
+            intersectRayAABB(ray.origin, inv_direction,
+                             m_Nodes[node.first + 1].bounds, closest, &t_right);
+        if (hit_left && hit_right) {
+            if (t_left <= t_right) {
+                stack.push_back({node.first + 1, t_right});
+                stack.push_back({node.first, t_left});
+            } else {
+                stack.push_back({node.first, t_left});
+                stack.push_back({node.first + 1, t_right});
+            }
+        } else if (hit_left) {
+            stack.push_back({node.first, t_left});
+        } else if (hit_right) {
+            stack.push_back({node.first + 1, t_right});
+        }
+    }
+
+    if (has_hit) {
+        *distance = closest;
+    }
+    return has_hit;
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,120 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_WORLD_BVH_H_
+#define ENGINE_LIB_WORLD_BVH_H_
+
+#include "engine_lib/world/bounds.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tamarindo
+{
+class ThreadPool;
+
+// Static bounding volume hierarchy over a set of boxes, built with a binned
+// surface area heuristic. Nodes live in a single array and the two children
+// of an interior node are always next to each other, so a node only needs
+// the index of its first child.
+//
+// Queries return the indices of the boxes passed to build().
+class BoundingVolumeHierarchy
+{
+   public:
+    static constexpr uint32_t BIN_COUNT = 16;
+    static constexpr uint32_t MAX_LEAF_SIZE = 4;
+
+    struct Node {
+        AABB bounds;
+        // First child for interior nodes, first primitive for leaves
+        uint32_t first = 0;
+        // Number of primitives, zero for interior nodes
+        uint32_t count = 0;
+
+        inline bool isLeaf() const { return count > 0; }
+    };
+
+    // With a thread pool, the top of the tree is split on the calling thread
+    // and the resulting subtrees are built in parallel.
+    void build(const AABB* bounds, size_t count,
+               ThreadPool* thread_pool = nullptr);
+
+    void clear();
+
+    inline bool isEmpty() const { return m_Nodes.empty(); }
+    inline size_t getPrimitiveCount() const
+    {
+        return m_PrimitiveIndices.size();
+    }
+    inline const std::vector<Node>& getNodes() const { return m_Nodes; }
+
+    // Each query appends the primitives it finds to `results`.
+    void queryFrustum(const Frustum& frustum,
+                      std::vector<uint32_t>* results) const;
+    void queryBox(const AABB& box, std::vector<uint32_t>* results) const;
+    void queryRay(const Ray& ray, float max_distance,
+                  std::vector<uint32_t>* results) const;
+
+    // Finds the primitive whose bounds the ray enters first. Returns false if
+    // the ray misses every primitive within `max_distance`.
+    bool castRay(const Ray& ray, float max_distance, uint32_t* primitive,
+                 float* distance) const;
+
+   private:
+    static constexpr size_t MIN_PARALLEL_PRIMITIVES = 16 * 1024;
+    static constexpr uint32_t MIN_SUBTREE_SIZE = 1024;
+
+    struct BuildTask {
+        uint32_t node;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    // Partitioned in place during the build, so every pass over a range
+    // reads memory sequentially
+    struct BuildPrimitive {
+        AABB bounds;
+        glm::vec3 centroid;
+        uint32_t index;
+    };
+
+    // Builds the subtree of nodes[node_index] over the primitives in
+    // [begin, end). Ranges of at most `defer_size` primitives are added to
+    // `deferred` instead, if it is not null.
+    void buildNode(std::vector<Node>* nodes, uint32_t node_index,
+                   uint32_t begin, uint32_t end,
+                   std::vector<BuildTask>* deferred, uint32_t defer_size);
+
+    // Splits [begin, end) with the binned SAH and returns the first index of
+    // the right half, or `end` if the range becomes a leaf.
+    uint32_t splitRange(uint32_t begin, uint32_t end, const AABB& bounds);
+
+    // Moves the primitives from the build records to their leaf order arrays
+    void finishBuild();
+
+    std::vector<Node> m_Nodes;
+    std::vector<BuildPrimitive> m_BuildPrimitives;
+
+    // Primitives in leaf order, so each leaf references a contiguous range
+    std::vector<AABB> m_PrimitiveBounds;
+    std::vector<uint32_t> m_PrimitiveIndices;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_WORLD_BVH_H_
@@ -0,0 +1,95 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_WORLD_COMPONENTS_H_
+#define ENGINE_LIB_WORLD_COMPONENTS_H_
+
+#include "engine_lib/world/bounds.h"
+#include "engine_lib/world/entity_registry.h"
+
+#include "glm/glm.hpp"
+#include "glm/gtx/quaternion.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace tamarindo
+{
+
+// Position, rotation and scale are separate components so their columns can
+// be handed straight to composeTransformMatrices().
+struct LocalPosition {
+    glm::vec3 value = glm::vec3(0.0f);
+};
+
+struct LocalRotation {
+    glm::quat value = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+};
+
+struct LocalScale {
+    glm::vec3 value = glm::vec3(1.0f);
+};
+
+struct LocalMatrix {
+    glm::mat4 value = glm::mat4(1.0f);
+};
+
+struct WorldMatrix {
+    glm::mat4 value = glm::mat4(1.0f);
+};
+
+// Entities without a Parent are hierarchy roots. `depth` is the number of
+// ancestors, which lets the transform system update parents before children.
+struct Parent {
+    Entity entity;
+    uint32_t depth = 1;
+};
+
+struct Name {
+    std::string value;
+};
+
+// Bounds in model space. TransformSystem keeps WorldBounds in sync with it.
+struct LocalBounds {
+    AABB value;
+};
+
+struct WorldBounds {
+    AABB value;
+};
+
+// Marks an entity as moving. The scene keeps it in its dynamic AABB tree
+// instead of the static BVH.
+struct DynamicProxy {
+    uint32_t proxy = UINT32_MAX;
+    // Center of the bounds at the last update, used to predict motion
+    glm::vec3 last_center = glm::vec3(0.0f);
+};
+
+// Index of the glTF mesh drawn by this entity
+struct MeshInstance {
+    int mesh_index = -1;
+};
+
+static_assert(sizeof(LocalPosition) == sizeof(glm::vec3));
+static_assert(sizeof(LocalRotation) == sizeof(glm::quat));
+static_assert(sizeof(LocalScale) == sizeof(glm::vec3));
+static_assert(sizeof(LocalMatrix) == sizeof(glm::mat4));
+static_assert(sizeof(WorldMatrix) == sizeof(glm::mat4));
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_WORLD_COMPONENTS_H_
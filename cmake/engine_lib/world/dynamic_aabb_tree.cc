@@ -0,0 +1,490 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "engine_lib/world/dynamic_aabb_tree.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+AABB combine(const AABB& a, const AABB& b)
+{
+    AABB result = a;
+    result.expand(b);
+    return result;
+}
+
+AABB makeFat(const AABB& bounds)
+{
+    AABB fat = bounds;
+    fat.min -= glm::vec3(DynamicAABBTree::FAT_MARGIN);
+    fat.max += glm::vec3(DynamicAABBTree::FAT_MARGIN);
+    return fat;
+}
+
+}  // namespace
+
+uint32_t DynamicAABBTree::createProxy(const AABB& bounds)
+{
+    const uint32_t proxy = allocateNode();
+    m_Nodes[proxy].bounds = makeFat(bounds);
+    m_Nodes[proxy].height = 0;
+    insertLeaf(proxy);
+    ++m_ProxyCount;
+    return proxy;
+}
+
+void DynamicAABBTree::destroyProxy(uint32_t proxy)
+{
+    assert(proxy < m_Nodes.size() && m_Nodes[proxy].isLeaf());
+    removeLeaf(proxy);
+    freeNode(proxy);
+    --m_ProxyCount;
+}
+
+bool DynamicAABBTree::moveProxy(uint32_t proxy, const AABB& bounds,
+                                const glm::vec3& displacement)
+{
+    assert(proxy < m_Nodes.size() && m_Nodes[proxy].isLeaf());
+    if (m_Nodes[proxy].bounds.contains(bounds)) {
+        return false;
+    }
+
+    removeLeaf(proxy);
+
+    // Stretch the fat bounds in the direction of motion, so an object moving
+    // at a steady speed is reinserted every few frames instead of every one
+    AABB fat = makeFat(bounds);
+    const glm::vec3 prediction = displacement * DISPLACEMENT_MULTIPLIER;
+    fat.min += glm::min(prediction, glm::vec3(0.0f));
+    fat.max += glm::max(prediction, glm::vec3(0.0f));
+    m_Nodes[proxy].bounds = fat;
+
+    insertLeaf(proxy);
+    return true;
+}
+
+void DynamicAABBTree::setProxyBounds(uint32_t proxy, const AABB& bounds)
+{
+    assert(proxy < m_Nodes.size() && m_Nodes[proxy].isLeaf());
+    m_Nodes[proxy].bounds = makeFat(bounds);
+}
+
+void DynamicAABBTree::refit()
+{
+    if (m_Root == NULL_NODE) {
+        return;
+    }
+
+    // Parents come before their children in pre-order, so walking it
+    // backwards updates children first
+    std::vector<uint32_t> order;
+    order.reserve(m_Nodes.size());
+    order.push_back(m_Root);
+    for (size_t i = 0; i < order.size(); ++i) {
+        const Node& node = m_Nodes[order[i]];
+        if (!node.isLeaf()) {
+            order.push_back(node.child1);
+            order.push_back(node.child2);
+        }
+    }
+
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        Node& node = m_Nodes[*it];
+        if (!node.isLeaf()) {
+            node.bounds = combine(m_Nodes[node.child1].bounds,
+                                  m_Nodes[node.child2].bounds);
+        }
+    }
+}
+
+void DynamicAABBTree::clear()
+{
+    m_Nodes.clear();
+    m_Root = NULL_NODE;
+    m_FreeList = NULL_NODE;
+    m_ProxyCount = 0;
+}
+
+uint32_t DynamicAABBTree::getHeight() const
+{
+    return m_Root == NULL_NODE ? 0 : m_Nodes[m_Root].height;
+}
+
+uint32_t DynamicAABBTree::allocateNode()
+{
+    if (m_FreeList == NULL_NODE) {
+        m_Nodes.emplace_back();
+        return static_cast<uint32_t>(m_Nodes.size() - 1);
+    }
+
+    const uint32_t node = m_FreeList;
+    m_FreeList = m_Nodes[node].parent;
+    m_Nodes[node] = Node{};
+    return node;
+}
+
+void DynamicAABBTree::freeNode(uint32_t node)
+{
+    m_Nodes[node].parent = m_FreeList;
+    m_Nodes[node].height = -1;
+    m_FreeList = node;
+}
+
+void DynamicAABBTree::insertLeaf(uint32_t leaf)
+{
+    if (m_Root == NULL_NODE) {
+        m_Root = leaf;
+        m_Nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // Walk down to the sibling that increases the total surface area the
+    // least, stopping early when making a new parent here is cheaper than
+    // descending further
+    const AABB leaf_bounds = m_Nodes[leaf].bounds;
+    uint32_t index = m_Root;
+    while (!m_Nodes[index].isLeaf()) {
+        const Node& node = m_Nodes[index];
+        const float area = node.bounds.getHalfArea();
+        const float combined_area =
+            combine(node.bounds, leaf_bounds).getHalfArea();
+
+        // Cost of creating a new parent for this node and the leaf
+        const float cost = 2.0f * combined_area;
+        // Minimum cost of pushing the leaf further down
+        const float inheritance_cost = 2.0f * (combined_area - area);
+
+        auto descend_cost = [&](uint32_t child) {
+            const AABB& child_bounds = m_Nodes[child].bounds;
+            const float new_area =
+                combine(child_bounds, leaf_bounds).getHalfArea();
+            return m_Nodes[child].isLeaf()
+                       ? new_area + inheritance_cost
+                       : new_area - child_bounds.getHalfArea() +
+                             inheritance_cost;
+        };
+        const float cost1 = descend_cost(node.child1);
+        const float cost2 = descend_cost(node.child2);
+
+        if (cost < cost1 && cost < cost2) {
+            break;
+        }
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+    const uint32_t sibling = index;
+
+    const uint32_t old_parent = m_Nodes[sibling].parent;
+    const uint32_t new_parent = allocateNode();
+    m_Nodes[new_parent].parent = old_parent;
+    m_Nodes[new_parent].bounds =
+        combine(leaf_bounds, m_Nodes[sibling].bounds);
+    m_Nodes[new_parent].height = m_Nodes[sibling].height + 1;
+    m_Nodes[new_parent].child1 = sibling;
+    m_Nodes[new_parent].child2 = leaf;
+    m_Nodes[sibling].parent = new_parent;
+    m_Nodes[leaf].parent = new_parent;
+
+    if (old_parent == NULL_NODE) {
+        m_Root = new_parent;
+    } else if (m_Nodes[old_parent].child1 == sibling) {
+        m_Nodes[old_parent].child1 = new_parent;
+    } else {
+        m_Nodes[old_parent].child2 = new_parent;
+    }
+
+    fixUpwards(m_Nodes[leaf].parent);
+}
+
+void DynamicAABBTree::removeLeaf(uint32_t leaf)
+{
+    if (leaf == m_Root) {
+        m_Root = NULL_NODE;
+        return;
+    }
+
+    const uint32_t parent = m_Nodes[leaf].parent;
+    const uint32_t grand_parent = m_Nodes[parent].parent;
+    const uint32_t sibling = m_Nodes[parent].child1 == leaf
+                                 ? m_Nodes[parent].child2
+                                 : m_Nodes[parent].child1;
+
+    // The sibling takes the place of the parent
+    m_Nodes[sibling].parent = grand_parent;
+    freeNode(parent);
+    if (grand_parent == NULL_NODE) {
+        m_Root = sibling;
+        return;
+    }
+
+    if (m_Nodes[grand_parent].child1 == parent) {
+        m_Nodes[grand_parent].child1 = sibling;
+    } else {
+        m_Nodes[grand_parent].child2 = sibling;
+    }
+    fixUpwards(grand_parent);
+}
+
+void DynamicAABBTree::fixUpwards(uint32_t node)
+{
+    uint32_t index = node;
+    while (index != NULL_NODE) {
+        index = balance(index);
+
+        Node& current = m_Nodes[index];
+        const Node& child1 = m_Nodes[current.child1];
+        const Node& child2 = m_Nodes[current.child2];
+        current.height = 1 + std::max(child1.height, child2.height);
+        current.bounds = combine(child1.bounds, child2.bounds);
+
+        index = current.parent;
+    }
+}
+
+uint32_t DynamicAABBTree::balance(uint32_t a_index)
+{
+    Node& a = m_Nodes[a_index];
+    if (a.isLeaf() || a.height < 2) {
+        return a_index;
+    }
+
+    const uint32_t b_index = a.child1;
+    const uint32_t c_index = a.child2;
+    Node& b = m_Nodes[b_index];
+    Node& c = m_Nodes[c_index];
+
+    // Replaces `a` with `new_root` in the parent of `a`
+    auto replace_in_parent = [this, a_index](uint32_t new_root) {
+        const uint32_t parent = m_Nodes[new_root].parent;
+        if (parent == NULL_NODE) {
+            m_Root = new_root;
+        } else if (m_Nodes[parent].child1 == a_index) {
+            m_Nodes[parent].child1 = new_root;
+        } else {
+            m_Nodes[parent].child2 = new_root;
+        }
+    };
+
+    const int32_t balance_factor = c.height - b.height;
+
+    // Rotate C up
+    if (balance_factor > 1) {
+        const uint32_t f_index = c.child1;
+        const uint32_t g_index = c.child2;
+        Node& f = m_Nodes[f_index];
+        Node& g = m_Nodes[g_index];
+
+        c.child1 = a_index;
+        c.parent = a.parent;
+        a.parent = c_index;
+        replace_in_parent(c_index);
+
+        // The taller grandchild stays under C, the other moves under A
+        if (f.height > g.height) {
+            c.child2 = f_index;
+            a.child2 = g_index;
+            g.parent = a_index;
+            a.bounds = combine(b.bounds, g.bounds);
+            c.bounds = combine(a.bounds, f.bounds);
+            a.height = 1 + std::max(b.height, g.height);
+            c.height = 1 + std::max(a.height, f.height);
+        } else {
+            c.child2 = g_index;
+            a.child2 = f_index;
+            f.parent = a_index;
+            a.bounds = combine(b.bounds, f.bounds);
+            c.bounds = combine(a.bounds, g.bounds);
+            a.height = 1 + std::max(b.height, f.height);
+            c.height = 1 + std::max(a.height, g.height);
+        }
+        return c_index;
+    }
+
+    // Rotate B up
+    if (balance_factor < -1) {
+        const uint32_t d_index = b.child1;
+        const uint32_t e_index = b.child2;
+        Node& d = m_Nodes[d_index];
+        Node& e = m_Nodes[e_index];
+
+        b.child1 = a_index;
+        b.parent = a.parent;
+        a.parent = b_index;
+        replace_in_parent(b_index);
+
+        if (d.height > e.height) {
+            b.child2 = d_index;
+            a.child1 = e_index;
+            e.parent = a_index;
+            a.bounds = combine(c.bounds, e.bounds);
+            b.bounds = combine(a.bounds, d.bounds);
+            a.height = 1 + std::max(c.height, e.height);
+            b.height = 1 + std::max(a.height, d.height);
+        } else {
+            b.child2 = e_index;
+            a.child1 = d_index;
+            d.parent = a_index;
+            a.bounds = combine(c.bounds, d.bounds);
+            b.bounds = combine(a.bounds, e.bounds);
+            a.height = 1 + std::max(c.height, d.height);
+            b.height = 1 + std::max(a.height, e.height);
+        }
+        return b_index;
+    }
+
+    return a_index;
+}
+
+void DynamicAABBTree::queryFrustum(const Frustum& frustum,
+                                   std::vector<uint32_t>* results) const
+{
+    if (m_Root == NULL_NODE) {
+        return;
+    }
+
+    // Nodes fully inside the frustum skip the plane tests for their subtree
+    struct StackEntry {
+        uint32_t node;
+        bool is_inside;
+    };
+    std::vector<StackEntry> stack;
+    stack.reserve(64);
+    stack.push_back({m_Root, false});
+
+    while (!stack.empty()) {
+        const StackEntry entry = stack.back();
+        stack.pop_back();
+        const Node& node = m_Nodes[entry.node];
+
+        bool is_inside = entry.is_inside;
+        if (!is_inside) {
+            const FrustumTest result = frustum.test(node.bounds);
+            if (result == FrustumTest::Outside) {
+                continue;
+            }
+            is_inside = result == FrustumTest::Inside;
+        }
+
+        if (node.isLeaf()) {
+            results->push_back(entry.node);
+        } else {
+            stack.push_back({node.child2, is_inside});
+            stack.push_back({node.child1, is_inside});
+        }
+    }
+}
+
+void DynamicAABBTree::queryBox(const AABB& box,
+                               std::vector<uint32_t>* results) const
+{
+    if (m_Root == NULL_NODE) {
+        return;
+    }
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(m_Root);
+
+    while (!stack.empty()) {
+        const uint32_t index = stack.back();
+        stack.pop_back();
+        const Node& node = m_Nodes[index];
+        if (!box.overlaps(node.bounds)) {
+            continue;
+        }
+
+        if (node.isLeaf()) {
+            results->push_back(index);
+        } else {
+            stack.push_back(node.child2);
+            stack.push_back(node.child1);
+        }
+    }
+}
+
+void DynamicAABBTree::queryRay(const Ray& ray, float max_distance,
+                               std::vector<uint32_t>* results) const
+{
+    if (m_Root == NULL_NODE) {
+        return;
+    }
+
+    const glm::vec3 inv_direction = 1.0f / ray.direction;
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(m_Root);
+
+    float t_entry;
+    while (!stack.empty()) {
+        const uint32_t index = stack.back();
+        stack.pop_back();
+        const Node& node = m_Nodes[index];
+        if (!intersectRayAABB(ray.origin, inv_direction, node.bounds,
+                              max_distance, &t_entry)) {
+            continue;
+        }
+
+        if (node.isLeaf()) {
+            results->push_back(index);
+        } else {
+            stack.push_back(node.child2);
+            stack.push_back(node.child1);
+        }
+    }
+}
+
+void DynamicAABBTree::validate() const
+{
+    if (m_Root == NULL_NODE) {
+        assert(m_ProxyCount == 0);
+        return;
+    }
+    assert(m_Nodes[m_Root].parent == NULL_NODE);
+
+    size_t leaf_count = 0;
+    std::vector<uint32_t> stack = {m_Root};
+    while (!stack.empty()) {
+        const uint32_t index = stack.back();
+        stack.pop_back();
+        const Node& node = m_Nodes[index];
+        if (node.isLeaf()) {
+            assert(node.height == 0);
+            ++leaf_count;
+            continue;
+        }
+
+        const Node& child1 = m_Nodes[node.child1];
+        const Node& child2 = m_Nodes[node.child2];
+        assert(child1.parent == index && child2.parent == index);
+        assert(node.height == 1 + std::max(child1.height, child2.height));
+        assert(node.bounds.contains(child1.bounds) &&
+               node.bounds.contains(child2.bounds));
+        (void)child1;
+        (void)child2;
+
+        stack.push_back(node.child1);
+        stack.push_back(node.child2);
+    }
+    assert(leaf_count == m_ProxyCount);
+    (void)leaf_count;
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,115 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_WORLD_DYNAMIC_AABB_TREE_H_
+#define ENGINE_LIB_WORLD_DYNAMIC_AABB_TREE_H_
+
+#include "engine_lib/world/bounds.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tamarindo
+{
+
+// Bounding volume tree for objects that move. Each proxy is stored with
+// "fat" bounds, enlarged by a margin and by the predicted motion, so small
+// moves do not touch the tree at all. When a proxy leaves its fat bounds it
+// is removed and reinserted in O(log n), and rotations keep the tree
+// balanced.
+//
+// Proxies are node indices and stay valid until destroyProxy().
+class DynamicAABBTree
+{
+   public:
+    static constexpr uint32_t NULL_NODE = UINT32_MAX;
+
+    // Added to every side of the fat bounds
+    static constexpr float FAT_MARGIN = 0.1f;
+    // How far ahead of the displacement the fat bounds reach
+    static constexpr float DISPLACEMENT_MULTIPLIER = 4.0f;
+
+    uint32_t createProxy(const AABB& bounds);
+    void destroyProxy(uint32_t proxy);
+
+    // Moves the proxy to `bounds`. Returns true if it had to be reinserted,
+    // false if the new bounds still fit in the fat bounds.
+    bool moveProxy(uint32_t proxy, const AABB& bounds,
+                   const glm::vec3& displacement);
+
+    // Refit path for when most proxies change every frame: set the new
+    // bounds of each proxy without touching the tree, then call refit() once
+    // to recompute every interior node bottom-up in O(n). The topology is
+    // kept, so a full rebuild is still better after large rearrangements.
+    void setProxyBounds(uint32_t proxy, const AABB& bounds);
+    void refit();
+
+    void clear();
+
+    inline const AABB& getFatBounds(uint32_t proxy) const
+    {
+        return m_Nodes[proxy].bounds;
+    }
+    inline size_t getProxyCount() const { return m_ProxyCount; }
+    uint32_t getHeight() const;
+
+    // Each query appends the proxies it finds to `results`.
+    void queryFrustum(const Frustum& frustum,
+                      std::vector<uint32_t>* results) const;
+    void queryBox(const AABB& box, std::vector<uint32_t>* results) const;
+    void queryRay(const Ray& ray, float max_distance,
+                  std::vector<uint32_t>* results) const;
+
+    // Checks parent links, heights and bounds. For debugging only.
+    void validate() const;
+
+   private:
+    struct Node {
+        AABB bounds;
+        // Next free node while the node is in the free list
+        uint32_t parent = NULL_NODE;
+        uint32_t child1 = NULL_NODE;
+        uint32_t child2 = NULL_NODE;
+        // Leaves have height 0, free nodes -1
+        int32_t height = -1;
+
+        inline bool isLeaf() const { return child1 == NULL_NODE; }
+    };
+
+    uint32_t allocateNode();
+    void freeNode(uint32_t node);
+
+    void insertLeaf(uint32_t leaf);
+    void removeLeaf(uint32_t leaf);
+
+    // Rebalances the subtree rooted at `node` with one rotation if its
+    // children heights differ by more than one. Returns the new subtree root.
+    uint32_t balance(uint32_t node);
+
+    // Recomputes bounds and heights from `node` up to the root, rebalancing
+    // on the way
+    void fixUpwards(uint32_t node);
+
+    std::vector<Node> m_Nodes;
+    uint32_t m_Root = NULL_NODE;
+    uint32_t m_FreeList = NULL_NODE;
+    size_t m_ProxyCount = 0;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_WORLD_DYNAMIC_AABB_TREE_H_
@@ -0,0 +1,72 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "engine_lib/world/entity_conversion.h"
+
+#include "engine_lib/world/components.h"
+#include "engine_lib/world/game_object.h"
+
+namespace tamarindo
+{
+
+namespace
+{
+
+Entity createEntity(EntityRegistry* registry, const GameObject& game_object,
+                    Entity parent, uint32_t depth)
+{
+    const Transform& transform = game_object.m_Transform;
+
+    // Entities are created with their final component set, so loading does
+    // not move them between archetypes.
+    auto create = [&](auto&&... extra_components) {
+        return registry->createEntity(
+            Name{std::string(game_object.m_Name)},
+            LocalPosition{transform.getPosition()},
+            LocalRotation{transform.getRotation()},
+            LocalScale{transform.getScale()}, LocalMatrix{}, WorldMatrix{},
+            std::forward<decltype(extra_components)>(extra_components)...);
+    };
+
+    const bool has_mesh = game_object.m_MeshIndex >= 0;
+    const MeshInstance mesh_instance{game_object.m_MeshIndex};
+    if (!parent.isValid()) {
+        return has_mesh ? create(mesh_instance) : create();
+    }
+    const Parent parent_component{parent, depth};
+    return has_mesh ? create(parent_component, mesh_instance)
+                    : create(parent_component);
+}
+
+Entity createEntities(EntityRegistry* registry, const GameObject& game_object,
+                      Entity parent, uint32_t depth)
+{
+    const Entity entity = createEntity(registry, game_object, parent, depth);
+    for (const GameObject* child : game_object.m_Children) {
+        createEntities(registry, *child, entity, depth + 1);
+    }
+    return entity;
+}
+
+}  // namespace
+
+Entity createEntitiesFromGameObject(EntityRegistry* registry,
+                                    const GameObject& root)
+{
+    return createEntities(registry, root, Entity{}, 0);
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,34 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_WORLD_ENTITY_CONVERSION_H_
+#define ENGINE_LIB_WORLD_ENTITY_CONVERSION_H_
+
+#include "engine_lib/world/entity_registry.h"
+
+namespace tamarindo
+{
+class GameObject;
+
+// Creates one entity per node of the GameObject tree, with the transform
+// components, a Name, a Parent for every non-root node and a MeshInstance
+// for nodes that reference a mesh. Returns the entity of `root`.
+Entity createEntitiesFromGameObject(EntityRegistry* registry,
+                                    const GameObject& root);
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_WORLD_ENTITY_CONVERSION_H_
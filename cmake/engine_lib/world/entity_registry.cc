@@ -0,0 +1,320 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "engine_lib/world/entity_registry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+std::array<ComponentInfo, MAX_COMPONENT_TYPES> g_ComponentInfos;
+std::atomic<ComponentId> g_ComponentTypeCount{0};
+std::mutex g_ComponentRegistrationMutex;
+
+size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+}  // namespace
+
+namespace internal
+{
+
+ComponentId registerComponentType(const ComponentInfo& info)
+{
+    std::lock_guard<std::mutex> lock(g_ComponentRegistrationMutex);
+    const ComponentId id = g_ComponentTypeCount.load();
+    assert(id < MAX_COMPONENT_TYPES);
+    assert(info.alignment <= Archetype::CHUNK_ALIGNMENT);
+    g_ComponentInfos[id] = info;
+    g_ComponentTypeCount.store(id + 1);
+    return id;
+}
+
+const ComponentInfo& getComponentInfo(ComponentId id)
+{
+    assert(id < g_ComponentTypeCount.load());
+    return g_ComponentInfos[id];
+}
+
+}  // namespace internal
+
+Archetype::Archetype(ComponentMask mask) : m_Mask(mask)
+{
+    size_t row_size = sizeof(Entity);
+    for (ComponentId id = 0; id < MAX_COMPONENT_TYPES; ++id) {
+        if (hasComponent(id)) {
+            m_ComponentIds.push_back(id);
+            row_size += internal::getComponentInfo(id).size;
+        }
+    }
+
+    // Start from the ideal capacity and shrink it until the columns, with
+    // their alignment padding, fit in a chunk.
+    size_t capacity = CHUNK_SIZE / row_size;
+    while (capacity > 1 && layoutColumns(capacity, nullptr) > CHUNK_SIZE) {
+        --capacity;
+    }
+
+    // A row larger than a chunk gets a chunk of its own, as large as needed
+    m_ChunkBytes = CHUNK_SIZE;
+    if (capacity <= 1) {
+        capacity = 1;
+        m_ChunkBytes = std::max(
+            CHUNK_SIZE, alignUp(layoutColumns(1, nullptr), CHUNK_ALIGNMENT));
+    }
+    m_ChunkCapacity = static_cast<uint32_t>(capacity);
+    layoutColumns(capacity, &m_ColumnOffsets);
+}
+
+size_t Archetype::layoutColumns(
+    size_t capacity,
+    std::array<size_t, MAX_COMPONENT_TYPES>* column_offsets) const
+{
+    size_t offset = sizeof(Entity) * capacity;
+    for (const ComponentId id : m_ComponentIds) {
+        const ComponentInfo& info = internal::getComponentInfo(id);
+        offset = alignUp(offset, info.alignment);
+        if (column_offsets != nullptr) {
+            (*column_offsets)[id] = offset;
+        }
+        offset += info.size * capacity;
+    }
+    return offset;
+}
+
+Archetype::~Archetype()
+{
+    while (m_EntityCount > 0) {
+        removeRow(static_cast<uint32_t>(m_EntityCount - 1), 0);
+    }
+}
+
+size_t Archetype::getChunkEntityCount(size_t chunk_index) const
+{
+    const size_t chunk_start = chunk_index * m_ChunkCapacity;
+    const size_t remaining = m_EntityCount - chunk_start;
+    return remaining < m_ChunkCapacity ? remaining : m_ChunkCapacity;
+}
+
+void* Archetype::getComponent(uint32_t row, ComponentId id) const
+{
+    assert(hasComponent(id));
+    const uint32_t chunk_index = row / m_ChunkCapacity;
+    const uint32_t slot = row % m_ChunkCapacity;
+    return static_cast<std::byte*>(getColumn(chunk_index, id)) +
+           slot * internal::getComponentInfo(id).size;
+}
+
+bool Archetype::hasChangedSince(size_t chunk_index, ComponentMask components,
+                                uint32_t version) const
+{
+    for (const ComponentId id : m_ComponentIds) {
+        if ((components & (ComponentMask{1} << id)) != 0 &&
+            m_ChangeVersions[chunk_index][id] > version) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t Archetype::allocateRow(Entity entity, uint32_t version)
+{
+    const uint32_t row = static_cast<uint32_t>(m_EntityCount);
+    const uint32_t chunk_index = row / m_ChunkCapacity;
+    if (chunk_index == m_Chunks.size()) {
+        m_Chunks.push_back(static_cast<std::byte*>(::operator new(
+            m_ChunkBytes, std::align_val_t(CHUNK_ALIGNMENT))));
+        m_ChangeVersions.emplace_back();
+    }
+
+    getEntities(chunk_index)[row % m_ChunkCapacity] = entity;
+    m_ChangeVersions[chunk_index].fill(version);
+    ++m_EntityCount;
+    return row;
+}
+
+Entity Archetype::removeRow(uint32_t row, uint32_t version)
+{
+    assert(row < m_EntityCount);
+    const uint32_t last_row = static_cast<uint32_t>(m_EntityCount - 1);
+
+    Entity moved_entity;
+    for (const ComponentId id : m_ComponentIds) {
+        const ComponentInfo& info = internal::getComponentInfo(id);
+        void* removed = getComponent(row, id);
+        info.destroy(removed);
+        if (row != last_row) {
+            void* last = getComponent(last_row, id);
+            info.moveConstruct(removed, last);
+            info.destroy(last);
+        }
+    }
+    if (row != last_row) {
+        moved_entity = getEntity(last_row);
+        getEntities(row / m_ChunkCapacity)[row % m_ChunkCapacity] =
+            moved_entity;
+        m_ChangeVersions[row / m_ChunkCapacity].fill(version);
+    }
+
+    --m_EntityCount;
+    if (m_Chunks.size() * m_ChunkCapacity - m_EntityCount >=
+        m_ChunkCapacity) {
+        ::operator delete(m_Chunks.back(), std::align_val_t(CHUNK_ALIGNMENT));
+        m_Chunks.pop_back();
+        m_ChangeVersions.pop_back();
+    }
+    return moved_entity;
+}
+
+EntityRegistry::EntityRegistry() = default;
+
+EntityRegistry::~EntityRegistry() = default;
+
+Entity EntityRegistry::allocateEntity()
+{
+    Entity entity;
+    if (!m_FreeIndices.empty()) {
+        entity.index = m_FreeIndices.back();
+        m_FreeIndices.pop_back();
+    } else {
+        entity.index = static_cast<uint32_t>(m_Records.size());
+        m_Records.emplace_back();
+    }
+    entity.generation = m_Records[entity.index].generation;
+    ++m_EntityCount;
+    return entity;
+}
+
+void EntityRegistry::destroyEntity(Entity entity)
+{
+    if (!isAlive(entity)) {
+        return;
+    }
+
+    notifyRemove(entity, ~ComponentMask{0});
+
+    EntityRecord& record = m_Records[entity.index];
+    const Entity moved_entity =
+        record.archetype->removeRow(record.row, m_ChangeVersion);
+    if (moved_entity.isValid()) {
+        m_Records[moved_entity.index].row = record.row;
+    }
+
+    // Bumping the generation invalidates every copy of this handle
+    ++record.generation;
+    record.archetype = nullptr;
+    m_FreeIndices.push_back(entity.index);
+    --m_EntityCount;
+    ++m_StructureVersion;
+}
+
+void EntityRegistry::clear()
+{
+    for (uint32_t index = 0; index < m_Records.size(); ++index) {
+        EntityRecord& record = m_Records[index];
+        if (record.archetype != nullptr) {
+            notifyRemove(Entity{index, record.generation}, ~ComponentMask{0});
+            ++record.generation;
+            record.archetype = nullptr;
+            m_FreeIndices.push_back(index);
+        }
+    }
+    m_ArchetypeList.clear();
+    m_Archetypes.clear();
+    m_EntityCount = 0;
+    ++m_StructureVersion;
+}
+
+bool EntityRegistry::isAlive(Entity entity) const
+{
+    return entity.index < m_Records.size() &&
+           m_Records[entity.index].archetype != nullptr &&
+           m_Records[entity.index].generation == entity.generation;
+}
+
+void EntityRegistry::notifyRemove(Entity entity, ComponentMask mask)
+{
+    const EntityRecord& record = m_Records[entity.index];
+    mask &= record.archetype->getMask() & m_RemoveCallbackMask;
+    for (ComponentId id = 0; mask != 0; ++id, mask >>= 1) {
+        if ((mask & 1) != 0) {
+            void* component = record.archetype->getComponent(record.row, id);
+            m_RemoveCallbacks[id](entity, component);
+        }
+    }
+}
+
+Archetype* EntityRegistry::getArchetype(Entity entity, uint32_t* row) const
+{
+    if (!isAlive(entity)) {
+        return nullptr;
+    }
+    const EntityRecord& record = m_Records[entity.index];
+    *row = record.row;
+    return record.archetype;
+}
+
+Archetype* EntityRegistry::getOrCreateArchetype(ComponentMask mask)
+{
+    auto it = m_Archetypes.find(mask);
+    if (it != m_Archetypes.end()) {
+        return it->second.get();
+    }
+
+    auto archetype = std::make_unique<Archetype>(mask);
+    Archetype* archetype_ptr = archetype.get();
+    m_Archetypes.emplace(mask, std::move(archetype));
+    m_ArchetypeList.push_back(archetype_ptr);
+    return archetype_ptr;
+}
+
+uint32_t EntityRegistry::moveEntity(Entity entity, Archetype* target)
+{
+    EntityRecord& record = m_Records[entity.index];
+    Archetype* source = record.archetype;
+    const uint32_t source_row = record.row;
+
+    const uint32_t target_row = target->allocateRow(entity, m_ChangeVersion);
+    const ComponentMask shared = source->getMask() & target->getMask();
+    for (ComponentId id = 0; id < MAX_COMPONENT_TYPES; ++id) {
+        if ((shared & (ComponentMask{1} << id)) != 0) {
+            internal::getComponentInfo(id).moveConstruct(
+                target->getComponent(target_row, id),
+                source->getComponent(source_row, id));
+        }
+    }
+
+    // The moved-from components are destroyed by removeRow()
+    const Entity moved_entity = source->removeRow(source_row, m_ChangeVersion);
+    if (moved_entity.isValid()) {
+        m_Records[moved_entity.index].row = source_row;
+    }
+
+    record.archetype = target;
+    record.row = target_row;
+    ++m_StructureVersion;
+    return target_row;
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,461 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_WORLD_ENTITY_REGISTRY_H_
+#define ENGINE_LIB_WORLD_ENTITY_REGISTRY_H_
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace tamarindo
+{
+
+struct Entity {
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+    uint32_t index = INVALID_INDEX;
+    uint32_t generation = 0;
+
+    inline bool isValid() const { return index != INVALID_INDEX; }
+
+    inline bool operator==(const Entity& other) const
+    {
+        return index == other.index && generation == other.generation;
+    }
+    inline bool operator!=(const Entity& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+using ComponentId = uint32_t;
+using ComponentMask = uint64_t;
+
+constexpr ComponentId MAX_COMPONENT_TYPES = 64;
+
+// Type-erased operations used to move components between archetypes.
+struct ComponentInfo {
+    size_t size;
+    size_t alignment;
+    void (*moveConstruct)(void* dst, void* src);
+    void (*destroy)(void* ptr);
+};
+
+namespace internal
+{
+
+ComponentId registerComponentType(const ComponentInfo& info);
+const ComponentInfo& getComponentInfo(ComponentId id);
+
+template <typename T>
+void moveConstructComponent(void* dst, void* src)
+{
+    new (dst) T(std::move(*static_cast<T*>(src)));
+}
+
+template <typename T>
+void destroyComponent(void* ptr)
+{
+    static_cast<T*>(ptr)->~T();
+}
+
+}  // namespace internal
+
+// Ids are handed out the first time a component type is used.
+template <typename T>
+ComponentId getComponentId()
+{
+    static_assert(std::is_same_v<T, std::decay_t<T>>,
+                  "Components must be plain value types");
+    static const ComponentId s_Id = internal::registerComponentType(
+        ComponentInfo{sizeof(T), alignof(T),
+                      &internal::moveConstructComponent<T>,
+                      &internal::destroyComponent<T>});
+    return s_Id;
+}
+
+template <typename... Components>
+ComponentMask makeComponentMask()
+{
+    return (ComponentMask{0} | ... |
+            (ComponentMask{1}
+             << getComponentId<std::remove_const_t<Components>>()));
+}
+
+// Storage for every entity that has exactly the same set of components. The
+// entities are split into fixed-size chunks, and each chunk stores one tightly
+// packed column per component, so systems only read the columns they need.
+// Rows are kept dense: every chunk but the last one is full. An archetype
+// whose rows do not fit in CHUNK_SIZE stores one row per larger chunk.
+//
+// Every column of every chunk also keeps the registry change version of its
+// last write, so systems can skip the chunks they already processed.
+class Archetype
+{
+   public:
+    static constexpr size_t CHUNK_SIZE = 16 * 1024;
+    static constexpr size_t CHUNK_ALIGNMENT = 64;
+
+    explicit Archetype(ComponentMask mask);
+    ~Archetype();
+
+    Archetype(const Archetype& other) = delete;
+    Archetype& operator=(const Archetype& other) = delete;
+
+    inline ComponentMask getMask() const { return m_Mask; }
+    inline size_t getEntityCount() const { return m_EntityCount; }
+    inline size_t getChunkCount() const { return m_Chunks.size(); }
+    inline uint32_t getChunkCapacity() const { return m_ChunkCapacity; }
+
+    inline bool hasComponent(ComponentId id) const
+    {
+        return (m_Mask & (ComponentMask{1} << id)) != 0;
+    }
+
+    size_t getChunkEntityCount(size_t chunk_index) const;
+
+    inline Entity* getEntities(size_t chunk_index) const
+    {
+        return reinterpret_cast<Entity*>(m_Chunks[chunk_index]);
+    }
+
+    inline void* getColumn(size_t chunk_index, ComponentId id) const
+    {
+        return m_Chunks[chunk_index] + m_ColumnOffsets[id];
+    }
+
+    template <typename T>
+    inline T* getColumn(size_t chunk_index) const
+    {
+        return static_cast<T*>(getColumn(
+            chunk_index, getComponentId<std::remove_const_t<T>>()));
+    }
+
+    inline uint32_t getChangeVersion(size_t chunk_index, ComponentId id) const
+    {
+        return m_ChangeVersions[chunk_index][id];
+    }
+    inline void setChangeVersion(size_t chunk_index, ComponentId id,
+                                 uint32_t version)
+    {
+        m_ChangeVersions[chunk_index][id] = version;
+    }
+
+    // True if any column of `components` in the chunk was written after
+    // `version`
+    bool hasChangedSince(size_t chunk_index, ComponentMask components,
+                         uint32_t version) const;
+
+    void* getComponent(uint32_t row, ComponentId id) const;
+
+    inline Entity getEntity(uint32_t row) const
+    {
+        return getEntities(row / m_ChunkCapacity)[row % m_ChunkCapacity];
+    }
+
+    // Appends a row for `entity`. Component storage is left uninitialized and
+    // must be constructed by the caller. Every column of the chunk of the row
+    // is marked as changed at `version`.
+    uint32_t allocateRow(Entity entity, uint32_t version);
+
+    // Destroys the components of `row` and fills the gap with the last row,
+    // marking the chunk of `row` as changed at `version`. Returns the entity
+    // that was moved into `row`, or an invalid entity if the last row was
+    // removed.
+    Entity removeRow(uint32_t row, uint32_t version);
+
+   private:
+    // Bytes used by the columns of a chunk of `capacity` rows. Writes the
+    // column offsets if `column_offsets` is not null.
+    size_t layoutColumns(
+        size_t capacity,
+        std::array<size_t, MAX_COMPONENT_TYPES>* column_offsets) const;
+
+    ComponentMask m_Mask;
+    uint32_t m_ChunkCapacity = 0;
+    size_t m_ChunkBytes = CHUNK_SIZE;
+    size_t m_EntityCount = 0;
+
+    std::vector<ComponentId> m_ComponentIds;
+    std::array<size_t, MAX_COMPONENT_TYPES> m_ColumnOffsets = {};
+
+    std::vector<std::byte*> m_Chunks;
+    // Indexed by chunk, then by component id
+    std::vector<std::array<uint32_t, MAX_COMPONENT_TYPES>> m_ChangeVersions;
+};
+
+// Owns the entities and the archetypes that store their components.
+// Structural changes (creating or destroying entities, adding or removing
+// components) must not happen while iterating over the registry.
+//
+// Writes are tracked per chunk and column with a change version: columns
+// reached through a non-const getComponent() or a non-const forEachChunk()
+// column are stamped with getChangeVersion(). A system remembers the version
+// it last ran at, calls advanceChangeVersion() once it is done, and on its
+// next run only visits the chunks written after it with
+// forEachChangedChunk().
+class EntityRegistry
+{
+   public:
+    EntityRegistry();
+    ~EntityRegistry();
+
+    EntityRegistry(const EntityRegistry& other) = delete;
+    EntityRegistry& operator=(const EntityRegistry& other) = delete;
+
+    template <typename... Components>
+    Entity createEntity(Components&&... components)
+    {
+        const ComponentMask mask =
+            makeComponentMask<std::decay_t<Components>...>();
+        Archetype* archetype = getOrCreateArchetype(mask);
+
+        const Entity entity = allocateEntity();
+        const uint32_t row = archetype->allocateRow(entity, m_ChangeVersion);
+        (new (archetype->getComponent(
+             row, getComponentId<std::decay_t<Components>>()))
+             std::decay_t<Components>(std::forward<Components>(components)),
+         ...);
+
+        EntityRecord& record = m_Records[entity.index];
+        record.archetype = archetype;
+        record.row = row;
+        ++m_StructureVersion;
+        return entity;
+    }
+
+    void destroyEntity(Entity entity);
+
+    // Destroys every entity. Handles created before stay invalid.
+    void clear();
+
+    bool isAlive(Entity entity) const;
+
+    inline size_t getEntityCount() const { return m_EntityCount; }
+
+    // Version stamped on the columns written from now on
+    inline uint32_t getChangeVersion() const { return m_ChangeVersion; }
+    inline void advanceChangeVersion() { ++m_ChangeVersion; }
+
+    // Changes on every structural change, so pointers into the chunks can
+    // be cached while it stays the same
+    inline uint32_t getStructureVersion() const { return m_StructureVersion; }
+
+    // Archetype and row of a live entity, null if it is not alive. Valid
+    // until the next structural change.
+    Archetype* getArchetype(Entity entity, uint32_t* row) const;
+
+    // Adds a component, or replaces it if the entity already has one.
+    template <typename T>
+    void addComponent(Entity entity, T component)
+    {
+        assert(isAlive(entity));
+        const ComponentId id = getComponentId<T>();
+        if (T* existing = getComponent<T>(entity)) {
+            *existing = std::move(component);
+            return;
+        }
+
+        const EntityRecord& record = m_Records[entity.index];
+        const ComponentMask mask =
+            record.archetype->getMask() | (ComponentMask{1} << id);
+        const uint32_t row = moveEntity(entity, getOrCreateArchetype(mask));
+        new (m_Records[entity.index].archetype->getComponent(row, id))
+            T(std::move(component));
+    }
+
+    template <typename T>
+    void removeComponent(Entity entity)
+    {
+        assert(isAlive(entity));
+        const ComponentId id = getComponentId<T>();
+        const EntityRecord& record = m_Records[entity.index];
+        if (!record.archetype->hasComponent(id)) {
+            return;
+        }
+        notifyRemove(entity, ComponentMask{1} << id);
+        const ComponentMask mask =
+            record.archetype->getMask() & ~(ComponentMask{1} << id);
+        moveEntity(entity, getOrCreateArchetype(mask));
+    }
+
+    // Calls `callback` with every T about to be destroyed by
+    // destroyEntity(), removeComponent() or clear(), to release what the
+    // component refers to outside of the registry. One callback per type, an
+    // empty one removes it. The callback must not make structural changes.
+    template <typename T>
+    void setRemoveCallback(std::function<void(Entity, T*)> callback)
+    {
+        const ComponentId id = getComponentId<T>();
+        if (!callback) {
+            m_RemoveCallbacks[id] = nullptr;
+            m_RemoveCallbackMask &= ~(ComponentMask{1} << id);
+            return;
+        }
+        m_RemoveCallbacks[id] = [callback = std::move(callback)](
+                                    Entity entity, void* component) {
+            callback(entity, static_cast<T*>(component));
+        };
+        m_RemoveCallbackMask |= ComponentMask{1} << id;
+    }
+
+    // Marks the component as changed, use the const overload to only read it
+    template <typename T>
+    T* getComponent(Entity entity)
+    {
+        if (!isAlive(entity)) {
+            return nullptr;
+        }
+        const ComponentId id = getComponentId<T>();
+        const EntityRecord& record = m_Records[entity.index];
+        if (!record.archetype->hasComponent(id)) {
+            return nullptr;
+        }
+        record.archetype->setChangeVersion(
+            record.row / record.archetype->getChunkCapacity(), id,
+            m_ChangeVersion);
+        return static_cast<T*>(record.archetype->getComponent(record.row, id));
+    }
+
+    template <typename T>
+    const T* getComponent(Entity entity) const
+    {
+        if (!isAlive(entity)) {
+            return nullptr;
+        }
+        const ComponentId id = getComponentId<T>();
+        const EntityRecord& record = m_Records[entity.index];
+        if (!record.archetype->hasComponent(id)) {
+            return nullptr;
+        }
+        return static_cast<const T*>(
+            record.archetype->getComponent(record.row, id));
+    }
+
+    template <typename T>
+    bool hasComponent(Entity entity) const
+    {
+        return isAlive(entity) &&
+               m_Records[entity.index].archetype->hasComponent(
+                   getComponentId<T>());
+    }
+
+    // Calls func(count, entities, columns...) once per chunk whose archetype
+    // has all the requested components and none of the excluded ones. Each
+    // column is a pointer to `count` tightly packed components. Columns of
+    // non-const components are marked as changed.
+    template <typename... Components, typename Func>
+    void forEachChunk(Func&& func, ComponentMask excluded = 0)
+    {
+        forEachChangedChunk<Components...>(0, 0, std::forward<Func>(func),
+                                           excluded);
+    }
+
+    // Like forEachChunk(), but skips the chunks where none of the `watched`
+    // components were written after `version`. Skips none if `watched` is
+    // empty.
+    template <typename... Components, typename Func>
+    void forEachChangedChunk(uint32_t version, ComponentMask watched,
+                             Func&& func, ComponentMask excluded = 0)
+    {
+        const ComponentMask required = makeComponentMask<Components...>();
+        for (Archetype* archetype : m_ArchetypeList) {
+            const ComponentMask mask = archetype->getMask();
+            if ((mask & required) != required || (mask & excluded) != 0) {
+                continue;
+            }
+            for (size_t c = 0; c < archetype->getChunkCount(); ++c) {
+                if (watched != 0 &&
+                    !archetype->hasChangedSince(c, watched, version)) {
+                    continue;
+                }
+                (markColumnChanged<Components>(archetype, c), ...);
+                func(archetype->getChunkEntityCount(c),
+                     archetype->getEntities(c),
+                     archetype->template getColumn<Components>(c)...);
+            }
+        }
+    }
+
+    // Per-entity version of forEachChunk(): calls func(entity, components...).
+    template <typename... Components, typename Func>
+    void forEach(Func&& func, ComponentMask excluded = 0)
+    {
+        forEachChunk<Components...>(
+            [&func](size_t count, const Entity* entities,
+                    Components*... columns) {
+                for (size_t i = 0; i < count; ++i) {
+                    func(entities[i], columns[i]...);
+                }
+            },
+            excluded);
+    }
+
+   private:
+    template <typename T>
+    inline void markColumnChanged(Archetype* archetype, size_t chunk_index)
+    {
+        if constexpr (!std::is_const_v<T>) {
+            archetype->setChangeVersion(chunk_index, getComponentId<T>(),
+                                        m_ChangeVersion);
+        }
+    }
+
+    struct EntityRecord {
+        uint32_t generation = 0;
+        Archetype* archetype = nullptr;
+        uint32_t row = 0;
+    };
+
+    Entity allocateEntity();
+
+    // Calls the remove callbacks of the components in `mask` the entity has
+    void notifyRemove(Entity entity, ComponentMask mask);
+
+    Archetype* getOrCreateArchetype(ComponentMask mask);
+
+    // Moves the entity to `target`, carrying over the components both
+    // archetypes share. Components only present in the target are left
+    // uninitialized. Returns the new row.
+    uint32_t moveEntity(Entity entity, Archetype* target);
+
+    std::vector<EntityRecord> m_Records;
+    std::vector<uint32_t> m_FreeIndices;
+    size_t m_EntityCount = 0;
+
+    std::unordered_map<ComponentMask, std::unique_ptr<Archetype>> m_Archetypes;
+    std::vector<Archetype*> m_ArchetypeList;
+
+    std::array<std::function<void(Entity, void*)>, MAX_COMPONENT_TYPES>
+        m_RemoveCallbacks;
+    ComponentMask m_RemoveCallbackMask = 0;
+
+    uint32_t m_ChangeVersion = 1;
+    uint32_t m_StructureVersion = 1;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_WORLD_ENTITY_REGISTRY_H_
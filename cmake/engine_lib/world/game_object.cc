@@ -10,13 +10,12 @@
  See the License for the specific language governing permissions and
  limitations under the License.
  */
-#include "engine_lib/rendering/game_object.h"
+#include "engine_lib/world/game_object.h"
 
 #include "engine_lib/logging/logger.h"
 #include "engine_lib/rendering/shader_program.h"
 #include "engine_lib/utils/macros.h"
-
-#include "glm/ext/matrix_transform.hpp"
+#include "engine_lib/world/transform_batch.h"
 
 namespace tamarindo
 {
@@ -25,7 +24,6 @@ Transform::Transform()
       m_Scale(glm::vec3(1.0f, 1.0f, 1.0f)),
       m_Rotation(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f))
 {
-    calculateTransformMatrix();
 }
 
 Transform::Transform(const glm::vec3& position, const glm::vec3& scale)
@@ -33,50 +31,55 @@ Transform::Transform(const glm::vec3& position, const glm::vec3& scale)
       m_Scale(scale),
       m_Rotation(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f))
 {
-    calculateTransformMatrix();
 }
 
 const glm::vec3& Transform::getPosition() const { return m_Position; }
 const glm::vec3& Transform::getScale() const { return m_Scale; }
-const glm::mat4& Transform::getMatrix() const { return m_TransformMatrix; }
+const glm::quat& Transform::getRotation() const { return m_Rotation; }
+const glm::mat4& Transform::getMatrix() const
+{
+    if (m_IsMatrixDirty) {
+        calculateTransformMatrix();
+    }
+    return m_TransformMatrix;
+}
 
 void Transform::setPosition(const glm::vec3& position)
 {
     m_Position = position;
-    calculateTransformMatrix();
+    m_IsMatrixDirty = true;
 }
 
 void Transform::setScale(const glm::vec3& scale)
 {
     m_Scale = scale;
-    calculateTransformMatrix();
+    m_IsMatrixDirty = true;
 }
 
 void Transform::setRotation(const glm::quat& rotation)
 {
     m_Rotation = rotation;
-    calculateTransformMatrix();
+    m_IsMatrixDirty = true;
 }
 
-void Transform::calculateTransformMatrix()
+void Transform::calculateTransformMatrix() const
 {
-    glm::mat4 scaling_matrix = glm::scale(glm::mat4(1.0), m_Scale);
-
-    glm::mat4 rotation_matrix = glm::toMat4(m_Rotation);
-
-    glm::mat4 translation_matrix = glm::translate(glm::mat4(1.0), m_Position);
-
     // Because GLM has column vector operation, the world matrix is defined as
     // T * R * S
-    m_TransformMatrix = translation_matrix * rotation_matrix * scaling_matrix;
+    m_TransformMatrix = composeTransformMatrix(m_Position, m_Rotation, m_Scale);
+    m_IsMatrixDirty = false;
 }
 
 GameObject::GameObject(
     /*const Transform& transform, std::unique_ptr<Model> mesh*/)
-    : m_Name("Game Object")
+    : GameObject("Game Object")
 /*: m_Transform(transform), m_Model(std::move(mesh))*/ {}
 
-GameObject::GameObject(const std::string& name) : m_Name{name} {}
+GameObject::GameObject(std::string_view name,
+                       std::pmr::memory_resource* resource)
+    : m_Name{name, resource}, m_Children{resource}
+{
+}
 
 // Transform& GameObject::getTransform() { return m_Transform; }
 //
@@ -20,7 +20,9 @@
 #include "glm/gtx/quaternion.hpp"
 
 #include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace tamarindo
@@ -41,7 +43,10 @@ class Transform
 
     const glm::vec3& getPosition() const;
     const glm::vec3& getScale() const;
+    const glm::quat& getRotation() const;
 
+    // The matrix is rebuilt lazily, so setting position, rotation and scale
+    // in a row only composes it once.
     const glm::mat4& getMatrix() const;
 
    private:
@@ -51,25 +56,34 @@ class Transform
 
     glm::vec3 m_Scale;
 
-    glm::mat4 m_TransformMatrix;
+    mutable glm::mat4 m_TransformMatrix;
+    mutable bool m_IsMatrixDirty = true;
 
-    void calculateTransformMatrix();
+    void calculateTransformMatrix() const;
 };
 
 class GameObject
 {
    public:
     GameObject(/*const Transform& transform, std::unique_ptr<Model> model*/);
-    GameObject(const std::string& name);
-
+    // The name and the child list allocate from `resource`, which lets a
+    // GameObjectArena own the whole object.
+    explicit GameObject(
+        std::string_view name,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // Deletes the children of a tree built with `new`. Trees created by a
+    // GameObjectArena are freed by the arena instead.
     void terminate();
 
     void addChild(GameObject* child);
 
     // private:
-    std::string m_Name;
-    std::vector<GameObject*> m_Children;
+    std::pmr::string m_Name;
+    std::pmr::vector<GameObject*> m_Children;
     Transform m_Transform;
+    // Index of the glTF mesh drawn by this node, or -1 if it has none
+    int m_MeshIndex = -1;
     /*
 
     Transform& getTransform();
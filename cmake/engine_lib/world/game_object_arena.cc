@@ -0,0 +1,72 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "engine_lib/world/game_object_arena.h"
+
+#include "engine_lib/world/game_object.h"
+
+#include <new>
+
+namespace tamarindo
+{
+
+void* GameObjectArena::BlockResource::do_allocate(size_t bytes,
+                                                  size_t alignment)
+{
+    ++m_BlockCount;
+    m_ReservedBytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void GameObjectArena::BlockResource::do_deallocate(void* ptr, size_t bytes,
+                                                   size_t alignment)
+{
+    --m_BlockCount;
+    m_ReservedBytes -= bytes;
+    std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+}
+
+bool GameObjectArena::BlockResource::do_is_equal(
+    const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+GameObjectArena::GameObjectArena() : m_Resource(INITIAL_BLOCK_SIZE, &m_Blocks)
+{
+}
+
+GameObjectArena::~GameObjectArena() { release(); }
+
+GameObject* GameObjectArena::create()
+{
+    return create("Game Object");
+}
+
+GameObject* GameObjectArena::create(std::string_view name)
+{
+    void* memory = m_Resource.allocate(sizeof(GameObject), alignof(GameObject));
+    ++m_ObjectCount;
+    return new (memory) GameObject(name, &m_Resource);
+}
+
+void GameObjectArena::release()
+{
+    m_Resource.release();
+    m_ObjectCount = 0;
+}
+
+}  // namespace tamarindo
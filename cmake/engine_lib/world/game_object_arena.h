@@ -0,0 +1,84 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_WORLD_GAME_OBJECT_ARENA_H_
+#define ENGINE_LIB_WORLD_GAME_OBJECT_ARENA_H_
+
+#include <cstddef>
+#include <memory_resource>
+#include <string_view>
+
+namespace tamarindo
+{
+class GameObject;
+
+// Bump allocator for GameObject trees. Objects, names and child lists are
+// carved out of a few large blocks, and release() frees all of them at once
+// without walking the tree.
+class GameObjectArena
+{
+   public:
+    static constexpr size_t INITIAL_BLOCK_SIZE = 64 * 1024;
+
+    GameObjectArena();
+    ~GameObjectArena();
+
+    GameObjectArena(const GameObjectArena& other) = delete;
+    GameObjectArena& operator=(const GameObjectArena& other) = delete;
+
+    GameObject* create();
+    GameObject* create(std::string_view name);
+
+    // Invalidates every object created so far. Destructors are not run,
+    // which is fine because everything a GameObject owns lives in the arena.
+    void release();
+
+    inline std::pmr::memory_resource* getResource() { return &m_Resource; }
+
+    inline size_t getObjectCount() const { return m_ObjectCount; }
+    inline size_t getBlockCount() const { return m_Blocks.getBlockCount(); }
+    inline size_t getReservedBytes() const
+    {
+        return m_Blocks.getReservedBytes();
+    }
+
+   private:
+    // Forwards to the heap and keeps track of the blocks handed to the arena
+    class BlockResource : public std::pmr::memory_resource
+    {
+       public:
+        inline size_t getBlockCount() const { return m_BlockCount; }
+        inline size_t getReservedBytes() const { return m_ReservedBytes; }
+
+       private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+        bool do_is_equal(
+            const std::pmr::memory_resource& other) const noexcept override;
+
+        size_t m_BlockCount = 0;
+        size_t m_ReservedBytes = 0;
+    };
+
+    BlockResource m_Blocks;
+    std::pmr::monotonic_buffer_resource m_Resource;
+
+    size_t m_ObjectCount = 0;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_WORLD_GAME_OBJECT_ARENA_H_
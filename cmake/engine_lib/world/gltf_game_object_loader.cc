@@ -0,0 +1,148 @@
+/*
+ Copyright 2022-2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "engine_lib/world/gltf_game_object_loader.h"
+
+#include "engine_lib/logging/logger.h"
+#include "engine_lib/world/entity_conversion.h"
+#include "engine_lib/world/game_object.h"
+#include "engine_lib/world/game_object_arena.h"
+
+#include <cassert>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+void setTransformFromNode(Transform* t, const tinygltf::Node& node)
+{
+    if (node.translation.size() == 3) {
+        t->setPosition(glm::vec3((float)node.translation.at(0),
+                                 (float)node.translation.at(1),
+                                 (float)node.translation.at(2)));
+    }
+    if (node.scale.size() == 3) {
+        t->setScale(glm::vec3((float)node.scale.at(0), (float)node.scale.at(1),
+                              (float)node.scale.at(2)));
+    }
+    if (node.rotation.size() == 4) {
+        t->setRotation(
+            glm::quat((float)node.rotation.at(3), (float)node.rotation.at(0),
+                      (float)node.rotation.at(1), (float)node.rotation.at(2)));
+    }
+}
+
+}  // namespace
+
+/*static*/ GameObject* GLTFGameObjectLoader::load(
+    const GLTFGameObjectDesc& desc, GameObjectArena* arena)
+{
+    tinygltf::Model model;
+    tinygltf::TinyGLTF loader;
+    std::string err;
+    std::string warn;
+
+    bool loaded =
+        loader.LoadBinaryFromFile(&model, &err, &warn, desc.ModelPath);
+    if (!loaded) {
+        TM_LOG_ERROR("Could not load {}: {}", desc.ModelPath, err);
+        return nullptr;
+    }
+
+    return load(model, arena);
+}
+
+/*static*/ GameObject* GLTFGameObjectLoader::load(const tinygltf::Model& model,
+                                                  GameObjectArena* arena)
+{
+    GLTFGameObjectLoader l(arena);
+    return l.loadInternal(model);
+}
+
+/*static*/ Entity GLTFGameObjectLoader::loadEntities(
+    const GLTFGameObjectDesc& desc, EntityRegistry* registry)
+{
+    // The GameObject tree is only needed during the conversion
+    GameObjectArena arena;
+    GameObject* root_go = load(desc, &arena);
+    if (root_go == nullptr) {
+        return Entity{};
+    }
+
+    return createEntitiesFromGameObject(registry, *root_go);
+}
+
+GLTFGameObjectLoader::GLTFGameObjectLoader(GameObjectArena* arena)
+    : m_Arena(arena)
+{
+}
+
+void GLTFGameObjectLoader::setMeshFromNode(GameObject* game_object,
+                                           const tinygltf::Node& node)
+{
+    game_object->m_MeshIndex = node.mesh;
+}
+
+void GLTFGameObjectLoader::processModelNode(GameObject* parent_game_object,
+                                            const tinygltf::Model& model,
+                                            int node_index)
+{
+    assert((node_index >= 0) && (node_index < model.nodes.size()));
+    const tinygltf::Node& node = model.nodes[node_index];
+
+    GameObject* game_object =
+        (node.name.empty()) ? m_Arena->create() : m_Arena->create(node.name);
+    // Sized once so the child list is a single arena allocation
+    game_object->m_Children.reserve(node.children.size());
+
+    if ((node.mesh >= 0) && (node.mesh < model.meshes.size())) {
+        setTransformFromNode(&game_object->m_Transform, node);
+        setMeshFromNode(game_object, node);
+    }
+
+    parent_game_object->addChild(game_object);
+
+    for (const int child_node_index : node.children) {
+        processModelNode(game_object, model, child_node_index);
+    }
+}
+
+GameObject* GLTFGameObjectLoader::loadInternal(const tinygltf::Model& model)
+{
+    // "scene" is optional, tinygltf leaves -1 when the file has none
+    const int scene_index = (model.defaultScene < 0) ? 0 : model.defaultScene;
+    if (scene_index >= static_cast<int>(model.scenes.size())) {
+        TM_LOG_ERROR("Model has no scene {} to load, it has {} scenes",
+                     scene_index, model.scenes.size());
+        return nullptr;
+    }
+
+    GameObject* root_go = m_Arena->create();
+
+    const tinygltf::Scene& scene = model.scenes[scene_index];
+    root_go->m_Children.reserve(scene.nodes.size());
+    for (const int node_index : scene.nodes) {
+        processModelNode(root_go, model, node_index);
+    }
+
+    TM_LOG_INFO("Loaded {} nodes in {} arena blocks", model.nodes.size(),
+                m_Arena->getBlockCount());
+    return root_go;
+}
+
+}  // namespace tamarindo
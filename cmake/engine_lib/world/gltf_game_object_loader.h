@@ -0,0 +1,69 @@
+/*
+ Copyright 2022-2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_WORLD_GLTF_GAME_OBJECT_LOADER_H_
+#define ENGINE_LIB_WORLD_GLTF_GAME_OBJECT_LOADER_H_
+
+#include "engine_lib/world/entity_registry.h"
+
+#include "tiny_gltf.h"
+
+#include <string>
+
+namespace tamarindo
+{
+class GameObject;
+class GameObjectArena;
+
+struct GLTFGameObjectDesc {
+    std::string ModelPath;
+};
+
+class GLTFGameObjectLoader
+{
+   public:
+    // Loads the .glb file and builds one GameObject per node. Every object
+    // is allocated from `arena`. Returns nullptr if the file failed to load.
+    static GameObject* load(const GLTFGameObjectDesc& desc,
+                            GameObjectArena* arena);
+
+    // Same as above, for a model that is already parsed. Loads the default
+    // scene, or the first one if there is none. Returns nullptr if the model
+    // has no scenes.
+    static GameObject* load(const tinygltf::Model& model,
+                            GameObjectArena* arena);
+
+    // Loads the model and stores its nodes as entities in `registry`.
+    // Returns the root entity, or an invalid entity if loading failed.
+    static Entity loadEntities(const GLTFGameObjectDesc& desc,
+                               EntityRegistry* registry);
+
+   private:
+    explicit GLTFGameObjectLoader(GameObjectArena* arena);
+
+    GameObject* loadInternal(const tinygltf::Model& model);
+
+    void setMeshFromNode(GameObject* game_object, const tinygltf::Node& node);
+
+    void processModelNode(GameObject* parent_game_object,
+                          const tinygltf::Model& model, int node_index);
+
+    GameObjectArena* m_Arena;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_WORLD_GLTF_GAME_OBJECT_LOADER_H_
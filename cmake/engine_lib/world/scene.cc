@@ -14,26 +14,46 @@
  limitations under the License.
  */
 
-#include "engine_lib/rendering/scene.h"
+#include "engine_lib/world/scene.h"
 
 #include "engine_lib/rendering/shader_program.h"
+#include "engine_lib/world/components.h"
 
 namespace tamarindo
 {
 
+Scene::Scene()
+{
+    m_Registry.setRemoveCallback<DynamicProxy>(
+        [this](Entity /*entity*/, DynamicProxy* dynamic_proxy) {
+            if (dynamic_proxy->proxy == DynamicAABBTree::NULL_NODE) {
+                return;
+            }
+            m_DynamicTree.destroyProxy(dynamic_proxy->proxy);
+            m_DynamicTreeEntities[dynamic_proxy->proxy] = Entity{};
+        });
+}
+
 void Scene::update(const Timer& timer)
 {
     if (ICamera* camera_ptr = m_Camera.get()) {
         camera_ptr->onUpdate(timer);
     }
+    m_TransformHierarchy.updateWorldMatrices(m_ThreadPool);
+    m_TransformSystem.update(&m_Registry);
+    updateDynamicTree();
 }
 
 void Scene::terminate()
 {
-    if (m_GameObject != nullptr) {
-        m_GameObject->terminate();
-        m_GameObject.reset();
-    }
+    m_GameObject = nullptr;
+    m_GameObjectArena.release();
+    m_TransformHierarchy.clear();
+    m_Registry.clear();
+    m_StaticBVH.clear();
+    m_StaticBVHEntities.clear();
+    m_DynamicTree.clear();
+    m_DynamicTreeEntities.clear();
 }
 
 bool Scene::canRender() const
@@ -59,9 +79,93 @@ void Scene::setCamera(std::unique_ptr<ICamera> camera)
     m_Camera = std::move(camera);
 }
 
-void Scene::setGameObject(std::unique_ptr<GameObject> game_object)
+void Scene::setGameObject(GameObject* game_object)
 {
-    m_GameObject = std::move(game_object);
+    m_GameObject = game_object;
+    if (m_GameObject != nullptr) {
+        m_TransformHierarchy.buildFromGameObject(*m_GameObject);
+    } else {
+        m_TransformHierarchy.clear();
+    }
+}
+
+void Scene::rebuildStaticBVH()
+{
+    std::vector<AABB> bounds;
+    m_StaticBVHEntities.clear();
+    m_Registry.forEach<const WorldBounds>(
+        [&](Entity entity, const WorldBounds& world_bounds) {
+            m_StaticBVHEntities.push_back(entity);
+            bounds.push_back(world_bounds.value);
+        },
+        makeComponentMask<DynamicProxy>());
+    m_StaticBVH.build(bounds.data(), bounds.size(), m_ThreadPool);
+}
+
+void Scene::queryFrustum(const Frustum& frustum,
+                         std::vector<Entity>* results) const
+{
+    m_QueryResults.clear();
+    m_StaticBVH.queryFrustum(frustum, &m_QueryResults);
+    for (const uint32_t primitive : m_QueryResults) {
+        results->push_back(m_StaticBVHEntities[primitive]);
+    }
+
+    m_QueryResults.clear();
+    m_DynamicTree.queryFrustum(frustum, &m_QueryResults);
+    for (const uint32_t proxy : m_QueryResults) {
+        results->push_back(m_DynamicTreeEntities[proxy]);
+    }
+}
+
+void Scene::updateDynamicTree()
+{
+    // Inserts the new proxies and counts the ones that left their fat bounds
+    size_t escaped_count = 0;
+    m_Registry.forEach<DynamicProxy, const WorldBounds>(
+        [this, &escaped_count](Entity entity, DynamicProxy& dynamic_proxy,
+                               const WorldBounds& world_bounds) {
+            if (dynamic_proxy.proxy != DynamicAABBTree::NULL_NODE) {
+                if (!m_DynamicTree.getFatBounds(dynamic_proxy.proxy)
+                         .contains(world_bounds.value)) {
+                    ++escaped_count;
+                }
+                return;
+            }
+            dynamic_proxy.proxy = m_DynamicTree.createProxy(world_bounds.value);
+            if (dynamic_proxy.proxy >= m_DynamicTreeEntities.size()) {
+                m_DynamicTreeEntities.resize(dynamic_proxy.proxy + 1);
+            }
+            m_DynamicTreeEntities[dynamic_proxy.proxy] = entity;
+            dynamic_proxy.last_center = world_bounds.value.getCenter();
+        });
+
+    // When most proxies move, one O(n) refit is cheaper than reinserting
+    // each of them. Otherwise only proxies that left their fat bounds touch
+    // the tree.
+    const bool use_refit =
+        escaped_count > 0 &&
+        static_cast<float>(escaped_count) >=
+            DYNAMIC_TREE_REFIT_RATIO *
+                static_cast<float>(m_DynamicTree.getProxyCount());
+    m_Registry.forEach<DynamicProxy, const WorldBounds>(
+        [this, use_refit](Entity /*entity*/, DynamicProxy& dynamic_proxy,
+                          const WorldBounds& world_bounds) {
+            const glm::vec3 center = world_bounds.value.getCenter();
+            if (!use_refit) {
+                m_DynamicTree.moveProxy(dynamic_proxy.proxy,
+                                        world_bounds.value,
+                                        center - dynamic_proxy.last_center);
+            } else if (!m_DynamicTree.getFatBounds(dynamic_proxy.proxy)
+                            .contains(world_bounds.value)) {
+                m_DynamicTree.setProxyBounds(dynamic_proxy.proxy,
+                                             world_bounds.value);
+            }
+            dynamic_proxy.last_center = center;
+        });
+    if (use_refit) {
+        m_DynamicTree.refit();
+    }
 }
 
 }  // namespace tamarindo
@@ -19,17 +19,32 @@
 
 #include "engine_lib/utils/timer.h"
 #include "engine_lib/rendering/camera_interface.h"
-#include "engine_lib/rendering/game_object.h"
+#include "engine_lib/world/bvh.h"
+#include "engine_lib/world/dynamic_aabb_tree.h"
+#include "engine_lib/world/entity_registry.h"
+#include "engine_lib/world/game_object.h"
+#include "engine_lib/world/game_object_arena.h"
+#include "engine_lib/world/transform_hierarchy.h"
+#include "engine_lib/world/transform_system.h"
 
 #include <memory>
+#include <vector>
 
 namespace tamarindo
 {
 class ShaderProgram;
+class ThreadPool;
 
 class Scene
 {
    public:
+    Scene();
+    ~Scene() = default;
+
+    // The registry calls back into the scene when entities are destroyed
+    Scene(const Scene& other) = delete;
+    Scene& operator=(const Scene& other) = delete;
+
     void update(const Timer& timer);
     void terminate();
 
@@ -38,12 +53,95 @@ class Scene
 
     void setCamera(std::unique_ptr<ICamera> camera);
 
-    inline GameObject* getGameObject() const { return m_GameObject.get(); };
-    void setGameObject(std::unique_ptr<GameObject> game_object);
+    // GameObjects of the scene are allocated here, and terminate() frees all
+    // of them at once.
+    inline GameObjectArena* getGameObjectArena()
+    {
+        return &m_GameObjectArena;
+    }
+
+    inline GameObject* getGameObject() const { return m_GameObject; };
+    // The tree must be allocated from getGameObjectArena().
+    void setGameObject(GameObject* game_object);
+
+    // Optional pool used to update the transform hierarchy in parallel. It
+    // must outlive the scene.
+    inline void setThreadPool(ThreadPool* thread_pool)
+    {
+        m_ThreadPool = thread_pool;
+    }
+
+    inline const TransformHierarchy& getTransformHierarchy() const
+    {
+        return m_TransformHierarchy;
+    }
+    inline TransformHierarchy& getTransformHierarchy()
+    {
+        return m_TransformHierarchy;
+    }
+
+    // Entities are updated by the scene's systems every frame
+    inline const EntityRegistry& getRegistry() const { return m_Registry; }
+    inline EntityRegistry& getRegistry() { return m_Registry; }
+
+    // Rebuilds the BVH over the WorldBounds of every entity without a
+    // DynamicProxy. Meant for geometry that does not move, after loading or
+    // large edits.
+    void rebuildStaticBVH();
+
+    inline const BoundingVolumeHierarchy& getStaticBVH() const
+    {
+        return m_StaticBVH;
+    }
+    // Entity of a primitive returned by a getStaticBVH() query
+    inline Entity getStaticBVHEntity(uint32_t primitive) const
+    {
+        return m_StaticBVHEntities[primitive];
+    }
+
+    // Entities with a DynamicProxy, updated every frame by update(). Their
+    // proxies are destroyed with the entity or the component.
+    inline const DynamicAABBTree& getDynamicTree() const
+    {
+        return m_DynamicTree;
+    }
+    inline Entity getDynamicTreeEntity(uint32_t proxy) const
+    {
+        return m_DynamicTreeEntities[proxy];
+    }
+
+    // Appends the static and dynamic entities whose bounds touch the
+    // frustum
+    void queryFrustum(const Frustum& frustum,
+                      std::vector<Entity>* results) const;
 
    private:
+    // Share of the dynamic proxies that must leave their fat bounds in one
+    // frame for the tree to be refit instead of reinserting each of them
+    static constexpr float DYNAMIC_TREE_REFIT_RATIO = 0.25f;
+
+    void updateDynamicTree();
+
     std::unique_ptr<ICamera> m_Camera = nullptr;
-    std::unique_ptr<GameObject> m_GameObject = nullptr;
+    GameObjectArena m_GameObjectArena;
+    GameObject* m_GameObject = nullptr;
+
+    TransformHierarchy m_TransformHierarchy;
+
+    EntityRegistry m_Registry;
+    TransformSystem m_TransformSystem;
+
+    BoundingVolumeHierarchy m_StaticBVH;
+    std::vector<Entity> m_StaticBVHEntities;
+
+    DynamicAABBTree m_DynamicTree;
+    // Indexed by proxy
+    std::vector<Entity> m_DynamicTreeEntities;
+
+    // Scratch for the queries
+    mutable std::vector<uint32_t> m_QueryResults;
+
+    ThreadPool* m_ThreadPool = nullptr;
 };
 
 }  // namespace tamarindo
@@ -0,0 +1,431 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "engine_lib/world/transform_batch.h"
+
+#include <cassert>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || \
+    defined(__i386__)
+#define TM_TRANSFORM_BATCH_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang need the AVX2 functions to be flagged, so the rest of the
+// file can still be built for the baseline instruction set.
+#if defined(TM_TRANSFORM_BATCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TM_TARGET_AVX2
+#endif
+
+namespace tamarindo
+{
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float),
+              "glm::vec3 must be tightly packed");
+static_assert(sizeof(glm::quat) == 4 * sizeof(float),
+              "glm::quat must be tightly packed");
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float),
+              "glm::mat4 must be tightly packed");
+
+namespace
+{
+
+// Writes a column-major T * R * S matrix. The rotation part is the standard
+// unit quaternion to matrix conversion with every column scaled by the
+// matching scale component.
+inline void composeScalar(const glm::vec3& p, const glm::quat& q,
+                          const glm::vec3& s, float* m)
+{
+    const float xx = q.x * q.x;
+    const float yy = q.y * q.y;
+    const float zz = q.z * q.z;
+    const float xy = q.x * q.y;
+    const float xz = q.x * q.z;
+    const float yz = q.y * q.z;
+    const float wx = q.w * q.x;
+    const float wy = q.w * q.y;
+    const float wz = q.w * q.z;
+
+    m[0] = (1.0f - 2.0f * (yy + zz)) * s.x;
+    m[1] = 2.0f * (xy + wz) * s.x;
+    m[2] = 2.0f * (xz - wy) * s.x;
+    m[3] = 0.0f;
+
+    m[4] = 2.0f * (xy - wz) * s.y;
+    m[5] = (1.0f - 2.0f * (xx + zz)) * s.y;
+    m[6] = 2.0f * (yz + wx) * s.y;
+    m[7] = 0.0f;
+
+    m[8] = 2.0f * (xz + wy) * s.z;
+    m[9] = 2.0f * (yz - wx) * s.z;
+    m[10] = (1.0f - 2.0f * (xx + yy)) * s.z;
+    m[11] = 0.0f;
+
+    m[12] = p.x;
+    m[13] = p.y;
+    m[14] = p.z;
+    m[15] = 1.0f;
+}
+
+void composeBatchScalar(const glm::vec3* positions, const glm::quat* rotations,
+                        const glm::vec3* scales, glm::mat4* out_matrices,
+                        size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        composeScalar(positions[i], rotations[i], scales[i],
+                      &out_matrices[i][0][0]);
+    }
+}
+
+#ifdef TM_TRANSFORM_BATCH_X86
+
+// Splits four packed vec3 (12 floats loaded as a, b, c) into x, y and z
+// vectors.
+inline void deinterleaveVec3SSE(__m128 a, __m128 b, __m128 c, __m128* x,
+                                __m128* y, __m128* z)
+{
+    // a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+    const __m128 x01 = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0));
+    const __m128 x23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+    *x = _mm_shuffle_ps(x01, x23, _MM_SHUFFLE(2, 0, 2, 0));
+
+    const __m128 y01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+    const __m128 y23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+    *y = _mm_shuffle_ps(y01, y23, _MM_SHUFFLE(2, 0, 2, 0));
+
+    const __m128 z01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+    const __m128 z23 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+    *z = _mm_shuffle_ps(z01, z23, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+inline void storeColumnSSE(__m128 x, __m128 y, __m128 z, __m128 w,
+                           int column, float* out)
+{
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_storeu_ps(out + 0 * 16 + column * 4, x);
+    _mm_storeu_ps(out + 1 * 16 + column * 4, y);
+    _mm_storeu_ps(out + 2 * 16 + column * 4, z);
+    _mm_storeu_ps(out + 3 * 16 + column * 4, w);
+}
+
+void composeBatchSSE(const glm::vec3* positions, const glm::quat* rotations,
+                     const glm::vec3* scales, glm::mat4* out_matrices,
+                     size_t count)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float* q_ptr = &rotations[i].x;
+        __m128 qx = _mm_loadu_ps(q_ptr + 0);
+        __m128 qy = _mm_loadu_ps(q_ptr + 4);
+        __m128 qz = _mm_loadu_ps(q_ptr + 8);
+        __m128 qw = _mm_loadu_ps(q_ptr + 12);
+        _MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+        const float* p_ptr = &positions[i].x;
+        __m128 px, py, pz;
+        deinterleaveVec3SSE(_mm_loadu_ps(p_ptr + 0), _mm_loadu_ps(p_ptr + 4),
+                            _mm_loadu_ps(p_ptr + 8), &px, &py, &pz);
+
+        const float* s_ptr = &scales[i].x;
+        __m128 sx, sy, sz;
+        deinterleaveVec3SSE(_mm_loadu_ps(s_ptr + 0), _mm_loadu_ps(s_ptr + 4),
+                            _mm_loadu_ps(s_ptr + 8), &sx, &sy, &sz);
+
+        const __m128 xx = _mm_mul_ps(qx, qx);
+        const __m128 yy = _mm_mul_ps(qy, qy);
+        const __m128 zz = _mm_mul_ps(qz, qz);
+        const __m128 xy = _mm_mul_ps(qx, qy);
+        const __m128 xz = _mm_mul_ps(qx, qz);
+        const __m128 yz = _mm_mul_ps(qy, qz);
+        const __m128 wx = _mm_mul_ps(qw, qx);
+        const __m128 wy = _mm_mul_ps(qw, qy);
+        const __m128 wz = _mm_mul_ps(qw, qz);
+
+        float* out = &out_matrices[i][0][0];
+
+        const __m128 m00 = _mm_mul_ps(
+            _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+        const __m128 m01 =
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+        const __m128 m02 =
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+        storeColumnSSE(m00, m01, m02, zero, 0, out);
+
+        const __m128 m10 =
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+        const __m128 m11 = _mm_mul_ps(
+            _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+        const __m128 m12 =
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+        storeColumnSSE(m10, m11, m12, zero, 1, out);
+
+        const __m128 m20 =
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+        const __m128 m21 =
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+        const __m128 m22 = _mm_mul_ps(
+            _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+        storeColumnSSE(m20, m21, m22, zero, 2, out);
+
+        storeColumnSSE(px, py, pz, one, 3, out);
+    }
+
+    composeBatchScalar(positions + i, rotations + i, scales + i,
+                       out_matrices + i, count - i);
+}
+
+// 4x4 transpose applied independently to both 128-bit lanes.
+TM_TARGET_AVX2 inline void transposeLanesAVX(__m256* r0, __m256* r1,
+                                             __m256* r2, __m256* r3)
+{
+    const __m256 t0 = _mm256_unpacklo_ps(*r0, *r1);
+    const __m256 t1 = _mm256_unpackhi_ps(*r0, *r1);
+    const __m256 t2 = _mm256_unpacklo_ps(*r2, *r3);
+    const __m256 t3 = _mm256_unpackhi_ps(*r2, *r3);
+    *r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    *r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    *r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    *r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+// Loads the 4 floats at `ptr` in the low lane and the 4 floats at
+// `ptr + offset` in the high lane.
+TM_TARGET_AVX2 inline __m256 loadLanesAVX(const float* ptr, size_t offset)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(ptr)),
+                                _mm_loadu_ps(ptr + offset), 1);
+}
+
+TM_TARGET_AVX2 inline void deinterleaveVec3AVX(const float* ptr, __m256* x,
+                                               __m256* y, __m256* z)
+{
+    // Same shuffles as the SSE version, with elements 0-3 in the low lane and
+    // elements 4-7 in the high lane.
+    const __m256 a = loadLanesAVX(ptr + 0, 12);
+    const __m256 b = loadLanesAVX(ptr + 4, 12);
+    const __m256 c = loadLanesAVX(ptr + 8, 12);
+
+    const __m256 x01 = _mm256_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0));
+    const __m256 x23 = _mm256_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+    *x = _mm256_shuffle_ps(x01, x23, _MM_SHUFFLE(2, 0, 2, 0));
+
+    const __m256 y01 = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+    const __m256 y23 = _mm256_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+    *y = _mm256_shuffle_ps(y01, y23, _MM_SHUFFLE(2, 0, 2, 0));
+
+    const __m256 z01 = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+    const __m256 z23 = _mm256_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+    *z = _mm256_shuffle_ps(z01, z23, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+TM_TARGET_AVX2 inline void storeColumnAVX(__m256 x, __m256 y, __m256 z,
+                                          __m256 w, int column, float* out)
+{
+    transposeLanesAVX(&x, &y, &z, &w);
+    const __m256 rows[4] = {x, y, z, w};
+    for (int k = 0; k < 4; ++k) {
+        _mm_storeu_ps(out + k * 16 + column * 4,
+                      _mm256_castps256_ps128(rows[k]));
+        _mm_storeu_ps(out + (k + 4) * 16 + column * 4,
+                      _mm256_extractf128_ps(rows[k], 1));
+    }
+}
+
+TM_TARGET_AVX2 void composeBatchAVX2(const glm::vec3* positions,
+                                     const glm::quat* rotations,
+                                     const glm::vec3* scales,
+                                     glm::mat4* out_matrices, size_t count)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const float* q_ptr = &rotations[i].x;
+        __m256 qx = loadLanesAVX(q_ptr + 0, 16);
+        __m256 qy = loadLanesAVX(q_ptr + 4, 16);
+        __m256 qz = loadLanesAVX(q_ptr + 8, 16);
+        __m256 qw = loadLanesAVX(q_ptr + 12, 16);
+        transposeLanesAVX(&qx, &qy, &qz, &qw);
+
+        __m256 px, py, pz;
+        deinterleaveVec3AVX(&positions[i].x, &px, &py, &pz);
+
+        __m256 sx, sy, sz;
+        deinterleaveVec3AVX(&scales[i].x, &sx, &sy, &sz);
+
+        const __m256 xx = _mm256_mul_ps(qx, qx);
+        const __m256 yy = _mm256_mul_ps(qy, qy);
+        const __m256 zz = _mm256_mul_ps(qz, qz);
+        const __m256 xy = _mm256_mul_ps(qx, qy);
+        const __m256 xz = _mm256_mul_ps(qx, qz);
+        const __m256 yz = _mm256_mul_ps(qy, qz);
+        const __m256 wx = _mm256_mul_ps(qw, qx);
+        const __m256 wy = _mm256_mul_ps(qw, qy);
+        const __m256 wz = _mm256_mul_ps(qw, qz);
+
+        float* out = &out_matrices[i][0][0];
+
+        const __m256 m00 = _mm256_mul_ps(
+            _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), sx);
+        const __m256 m01 =
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx);
+        const __m256 m02 =
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx);
+        storeColumnAVX(m00, m01, m02, zero, 0, out);
+
+        const __m256 m10 =
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy);
+        const __m256 m11 = _mm256_mul_ps(
+            _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), sy);
+        const __m256 m12 =
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy);
+        storeColumnAVX(m10, m11, m12, zero, 1, out);
+
+        const __m256 m20 =
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz);
+        const __m256 m21 =
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz);
+        const __m256 m22 = _mm256_mul_ps(
+            _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), sz);
+        storeColumnAVX(m20, m21, m22, zero, 2, out);
+
+        storeColumnAVX(px, py, pz, one, 3, out);
+    }
+
+    composeBatchSSE(positions + i, rotations + i, scales + i, out_matrices + i,
+                    count - i);
+}
+
+bool cpuSupportsAVX2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+
+    // The OS must also save the YMM registers on context switches
+    __cpuid(info, 1);
+    const bool has_osxsave = (info[2] & (1 << 27)) != 0;
+    const bool has_avx = (info[2] & (1 << 28)) != 0;
+    if (!has_osxsave || !has_avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif  // TM_TRANSFORM_BATCH_X86
+
+TransformKernel detectBestTransformKernel()
+{
+#ifdef TM_TRANSFORM_BATCH_X86
+    if (cpuSupportsAVX2()) {
+        return TransformKernel::AVX2;
+    }
+    // SSE2 is part of the x86-64 baseline
+    return TransformKernel::SSE;
+#else
+    return TransformKernel::Scalar;
+#endif
+}
+
+}  // namespace
+
+TransformKernel getBestTransformKernel()
+{
+    static const TransformKernel s_BestKernel = detectBestTransformKernel();
+    return s_BestKernel;
+}
+
+bool isTransformKernelSupported(TransformKernel kernel)
+{
+    return static_cast<int>(kernel) <=
+           static_cast<int>(getBestTransformKernel());
+}
+
+const char* getTransformKernelName(TransformKernel kernel)
+{
+    switch (kernel) {
+        case TransformKernel::Scalar:
+            return "Scalar";
+        case TransformKernel::SSE:
+            return "SSE";
+        case TransformKernel::AVX2:
+            return "AVX2";
+    }
+    return "Unknown";
+}
+
+glm::mat4 composeTransformMatrix(const glm::vec3& position,
+                                 const glm::quat& rotation,
+                                 const glm::vec3& scale)
+{
+    glm::mat4 result;
+    composeScalar(position, rotation, scale, &result[0][0]);
+    return result;
+}
+
+void composeTransformMatrices(const glm::vec3* positions,
+                              const glm::quat* rotations,
+                              const glm::vec3* scales, glm::mat4* out_matrices,
+                              size_t count)
+{
+    composeTransformMatrices(getBestTransformKernel(), positions, rotations,
+                             scales, out_matrices, count);
+}
+
+void composeTransformMatrices(TransformKernel kernel,
+                              const glm::vec3* positions,
+                              const glm::quat* rotations,
+                              const glm::vec3* scales, glm::mat4* out_matrices,
+                              size_t count)
+{
+    assert(isTransformKernelSupported(kernel));
+    switch (kernel) {
+#ifdef TM_TRANSFORM_BATCH_X86
+        case TransformKernel::AVX2:
+            composeBatchAVX2(positions, rotations, scales, out_matrices,
+                             count);
+            return;
+        case TransformKernel::SSE:
+            composeBatchSSE(positions, rotations, scales, out_matrices, count);
+            return;
+#endif
+        default:
+            composeBatchScalar(positions, rotations, scales, out_matrices,
+                               count);
+            return;
+    }
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,59 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_WORLD_TRANSFORM_BATCH_H_
+#define ENGINE_LIB_WORLD_TRANSFORM_BATCH_H_
+
+#include "glm/glm.hpp"
+#include "glm/gtx/quaternion.hpp"
+
+#include <cstddef>
+
+namespace tamarindo
+{
+
+enum class TransformKernel { Scalar, SSE, AVX2 };
+
+// Best kernel supported by the running CPU. Detected once at startup.
+TransformKernel getBestTransformKernel();
+
+bool isTransformKernelSupported(TransformKernel kernel);
+
+const char* getTransformKernelName(TransformKernel kernel);
+
+// Builds the T * R * S matrix of a single transform. The matrix is written
+// directly from the quaternion terms, without any matrix multiplication.
+glm::mat4 composeTransformMatrix(const glm::vec3& position,
+                                 const glm::quat& rotation,
+                                 const glm::vec3& scale);
+
+// Batch version of composeTransformMatrix(). Processes `count` transforms
+// stored in parallel arrays using the best kernel for the running CPU.
+void composeTransformMatrices(const glm::vec3* positions,
+                              const glm::quat* rotations,
+                              const glm::vec3* scales, glm::mat4* out_matrices,
+                              size_t count);
+
+// Same as above, forcing a specific kernel. The kernel must be supported.
+void composeTransformMatrices(TransformKernel kernel,
+                              const glm::vec3* positions,
+                              const glm::quat* rotations,
+                              const glm::vec3* scales, glm::mat4* out_matrices,
+                              size_t count);
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_WORLD_TRANSFORM_BATCH_H_
@@ -0,0 +1,269 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "engine_lib/world/transform_hierarchy.h"
+
+#include "engine_lib/utils/thread_pool.h"
+#include "engine_lib/world/game_object.h"
+#include "engine_lib/world/transform_batch.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+// Transforms composed per job when rebuilding every local matrix. Kept a
+// multiple of the widest kernel, so the split does not change which
+// transforms go through the scalar tail.
+constexpr size_t LOCAL_MATRIX_CHUNK_SIZE = 4096;
+
+// Smallest subtree worth handing to a worker thread.
+constexpr size_t MIN_SUBTREE_JOB_SIZE = 256;
+
+}  // namespace
+
+uint32_t TransformHierarchy::addNode(uint32_t parent_index,
+                                     const glm::vec3& position,
+                                     const glm::quat& rotation,
+                                     const glm::vec3& scale)
+{
+    const uint32_t index = static_cast<uint32_t>(m_ParentIndices.size());
+    assert(parent_index == INVALID_INDEX ||
+           (parent_index < index && m_SubtreeEnds[parent_index] == index));
+
+    m_Positions.push_back(position);
+    m_Rotations.push_back(rotation);
+    m_Scales.push_back(scale);
+    m_ParentIndices.push_back(parent_index);
+    m_SubtreeEnds.push_back(index + 1);
+    m_LocalMatrices.push_back(glm::mat4(1.0f));
+    m_WorldMatrices.push_back(glm::mat4(1.0f));
+    m_IsLocalDirty.push_back(true);
+    m_DirtyNodes.push_back(index);
+
+    // The new node extends the subtree of all its ancestors
+    for (uint32_t p = parent_index; p != INVALID_INDEX;
+         p = m_ParentIndices[p]) {
+        m_SubtreeEnds[p] = index + 1;
+    }
+
+    return index;
+}
+
+uint32_t TransformHierarchy::addGameObject(const GameObject& game_object,
+                                           uint32_t parent_index)
+{
+    const Transform& t = game_object.m_Transform;
+    const uint32_t index = addNode(parent_index, t.getPosition(),
+                                   t.getRotation(), t.getScale());
+
+    for (const GameObject* child : game_object.m_Children) {
+        addGameObject(*child, index);
+    }
+    return index;
+}
+
+void TransformHierarchy::buildFromGameObject(const GameObject& root)
+{
+    clear();
+    addGameObject(root, INVALID_INDEX);
+    updateWorldMatrices();
+}
+
+void TransformHierarchy::clear()
+{
+    m_Positions.clear();
+    m_Rotations.clear();
+    m_Scales.clear();
+    m_ParentIndices.clear();
+    m_SubtreeEnds.clear();
+    m_LocalMatrices.clear();
+    m_WorldMatrices.clear();
+    m_IsLocalDirty.clear();
+    m_DirtyNodes.clear();
+}
+
+void TransformHierarchy::reserve(size_t node_count)
+{
+    m_Positions.reserve(node_count);
+    m_Rotations.reserve(node_count);
+    m_Scales.reserve(node_count);
+    m_ParentIndices.reserve(node_count);
+    m_SubtreeEnds.reserve(node_count);
+    m_LocalMatrices.reserve(node_count);
+    m_WorldMatrices.reserve(node_count);
+    m_IsLocalDirty.reserve(node_count);
+}
+
+void TransformHierarchy::updateWorldMatrices(ThreadPool* thread_pool)
+{
+    m_LastUpdateCount = 0;
+    if (m_DirtyNodes.empty()) {
+        return;
+    }
+
+    m_UpdateRoots.clear();
+    const uint32_t node_count = static_cast<uint32_t>(m_ParentIndices.size());
+
+    // When most of the hierarchy changed, it is cheaper to rebuild every local
+    // matrix with the batch kernel than to visit the dirty nodes one by one.
+    if (m_DirtyNodes.size() * 2 >= node_count) {
+        composeAllLocalMatrices(thread_pool);
+        for (uint32_t i = 0; i < node_count; i = m_SubtreeEnds[i]) {
+            m_UpdateRoots.push_back(i);
+        }
+    } else {
+        std::sort(m_DirtyNodes.begin(), m_DirtyNodes.end());
+
+        // A dirty node inside an already selected subtree is handled as part
+        // of that subtree.
+        uint32_t selected_end = 0;
+        for (const uint32_t index : m_DirtyNodes) {
+            if (index < selected_end) {
+                continue;
+            }
+            m_UpdateRoots.push_back(index);
+            selected_end = m_SubtreeEnds[index];
+        }
+    }
+    m_DirtyNodes.clear();
+
+    for (const uint32_t root_index : m_UpdateRoots) {
+        m_LastUpdateCount += m_SubtreeEnds[root_index] - root_index;
+    }
+
+    if (thread_pool == nullptr || thread_pool->getWorkerCount() == 0) {
+        for (const uint32_t root_index : m_UpdateRoots) {
+            updateSubtree(root_index);
+        }
+        return;
+    }
+    updateSubtreesInParallel(*thread_pool);
+}
+
+void TransformHierarchy::composeAllLocalMatrices(ThreadPool* thread_pool)
+{
+    const size_t node_count = m_LocalMatrices.size();
+    if (thread_pool == nullptr) {
+        composeTransformMatrices(m_Positions.data(), m_Rotations.data(),
+                                 m_Scales.data(), m_LocalMatrices.data(),
+                                 node_count);
+    } else {
+        const size_t chunk_count = (node_count + LOCAL_MATRIX_CHUNK_SIZE - 1) /
+                                   LOCAL_MATRIX_CHUNK_SIZE;
+        thread_pool->parallelFor(chunk_count, [this, node_count](size_t chunk) {
+            const size_t begin = chunk * LOCAL_MATRIX_CHUNK_SIZE;
+            const size_t count =
+                std::min(LOCAL_MATRIX_CHUNK_SIZE, node_count - begin);
+            composeTransformMatrices(
+                m_Positions.data() + begin, m_Rotations.data() + begin,
+                m_Scales.data() + begin, m_LocalMatrices.data() + begin, count);
+        });
+    }
+    std::fill(m_IsLocalDirty.begin(), m_IsLocalDirty.end(), false);
+}
+
+void TransformHierarchy::updateSubtreesInParallel(ThreadPool& thread_pool)
+{
+    // Aim for a few jobs per thread, so uneven subtrees still balance out
+    const size_t thread_count = thread_pool.getWorkerCount() + 1;
+    const size_t job_size = std::max<size_t>(
+        MIN_SUBTREE_JOB_SIZE, m_LastUpdateCount / (thread_count * 4));
+
+    // Subtrees that are too big for a single job get their root updated here,
+    // and their children become independent candidates. Children only read
+    // their parent world matrix, which is final before any job starts, so the
+    // result does not depend on how the jobs are scheduled.
+    m_SubtreeJobs.clear();
+    m_SplitStack.assign(m_UpdateRoots.begin(), m_UpdateRoots.end());
+    while (!m_SplitStack.empty()) {
+        const uint32_t index = m_SplitStack.back();
+        m_SplitStack.pop_back();
+
+        const uint32_t end = m_SubtreeEnds[index];
+        if (end - index <= job_size) {
+            m_SubtreeJobs.push_back(index);
+            continue;
+        }
+
+        updateNode(index);
+        for (uint32_t child = index + 1; child < end;
+             child = m_SubtreeEnds[child]) {
+            m_SplitStack.push_back(child);
+        }
+    }
+
+    thread_pool.parallelFor(m_SubtreeJobs.size(), [this](size_t job) {
+        updateSubtree(m_SubtreeJobs[job]);
+    });
+}
+
+void TransformHierarchy::updateSubtree(uint32_t root_index)
+{
+    const uint32_t end = m_SubtreeEnds[root_index];
+    for (uint32_t i = root_index; i < end; ++i) {
+        updateNode(i);
+    }
+}
+
+void TransformHierarchy::updateNode(uint32_t index)
+{
+    if (m_IsLocalDirty[index]) {
+        m_LocalMatrices[index] = composeTransformMatrix(
+            m_Positions[index], m_Rotations[index], m_Scales[index]);
+        m_IsLocalDirty[index] = false;
+    }
+
+    // Parents are always stored before their children, so the parent world
+    // matrix is already up to date at this point.
+    const uint32_t parent_index = m_ParentIndices[index];
+    m_WorldMatrices[index] =
+        (parent_index == INVALID_INDEX)
+            ? m_LocalMatrices[index]
+            : m_WorldMatrices[parent_index] * m_LocalMatrices[index];
+}
+
+void TransformHierarchy::markDirty(uint32_t index)
+{
+    if (!m_IsLocalDirty[index]) {
+        m_IsLocalDirty[index] = true;
+        m_DirtyNodes.push_back(index);
+    }
+}
+
+void TransformHierarchy::setPosition(uint32_t index, const glm::vec3& position)
+{
+    m_Positions[index] = position;
+    markDirty(index);
+}
+
+void TransformHierarchy::setRotation(uint32_t index, const glm::quat& rotation)
+{
+    m_Rotations[index] = rotation;
+    markDirty(index);
+}
+
+void TransformHierarchy::setScale(uint32_t index, const glm::vec3& scale)
+{
+    m_Scales[index] = scale;
+    markDirty(index);
+}
+
+}  // namespace tamarindo
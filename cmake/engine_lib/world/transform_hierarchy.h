@@ -0,0 +1,135 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_WORLD_TRANSFORM_HIERARCHY_H_
+#define ENGINE_LIB_WORLD_TRANSFORM_HIERARCHY_H_
+
+#include "glm/glm.hpp"
+#include "glm/gtx/quaternion.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tamarindo
+{
+class GameObject;
+class ThreadPool;
+
+// Flat storage for a transform hierarchy. Every node lives in a set of
+// parallel arrays, and nodes are always stored after their parent. Because of
+// that ordering, the world matrices can be propagated with a single linear
+// pass over the arrays.
+//
+// Nodes are kept in depth-first order, so the subtree of a node is the
+// contiguous range [index, getSubtreeEnd(index)). Setters only mark a node as
+// dirty, and updateWorldMatrices() recomputes the subtrees of the dirty nodes,
+// leaving static parts of the hierarchy untouched.
+class TransformHierarchy
+{
+   public:
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+    // Appends a node and returns its index. The parent must be INVALID_INDEX
+    // for a new root, or be the last added node or one of its ancestors, so
+    // the depth-first order is preserved.
+    uint32_t addNode(uint32_t parent_index, const glm::vec3& position,
+                     const glm::quat& rotation, const glm::vec3& scale);
+
+    // Rebuilds the hierarchy from a GameObject tree. The nodes are stored in
+    // depth-first order, so every subtree occupies a contiguous range.
+    void buildFromGameObject(const GameObject& root);
+
+    void clear();
+    void reserve(size_t node_count);
+
+    // Recomputes the local and world matrices of the dirty nodes and their
+    // descendants. With a thread pool, independent subtrees are updated in
+    // parallel; the results are the same as the single-threaded update.
+    void updateWorldMatrices(ThreadPool* thread_pool = nullptr);
+
+    void setPosition(uint32_t index, const glm::vec3& position);
+    void setRotation(uint32_t index, const glm::quat& rotation);
+    void setScale(uint32_t index, const glm::vec3& scale);
+
+    inline size_t size() const { return m_ParentIndices.size(); }
+
+    inline uint32_t getParent(uint32_t index) const
+    {
+        return m_ParentIndices[index];
+    }
+    inline uint32_t getSubtreeEnd(uint32_t index) const
+    {
+        return m_SubtreeEnds[index];
+    }
+    inline const glm::vec3& getPosition(uint32_t index) const
+    {
+        return m_Positions[index];
+    }
+    inline const glm::quat& getRotation(uint32_t index) const
+    {
+        return m_Rotations[index];
+    }
+    inline const glm::vec3& getScale(uint32_t index) const
+    {
+        return m_Scales[index];
+    }
+    inline const glm::mat4& getWorldMatrix(uint32_t index) const
+    {
+        return m_WorldMatrices[index];
+    }
+
+    inline const std::vector<glm::mat4>& getWorldMatrices() const
+    {
+        return m_WorldMatrices;
+    }
+
+    // Number of world matrices recomputed by the last update.
+    inline size_t getLastUpdateCount() const { return m_LastUpdateCount; }
+
+   private:
+    uint32_t addGameObject(const GameObject& game_object,
+                           uint32_t parent_index);
+
+    void markDirty(uint32_t index);
+
+    void composeAllLocalMatrices(ThreadPool* thread_pool);
+    void updateSubtreesInParallel(ThreadPool& thread_pool);
+    void updateSubtree(uint32_t root_index);
+    void updateNode(uint32_t index);
+
+    std::vector<glm::vec3> m_Positions;
+    std::vector<glm::quat> m_Rotations;
+    std::vector<glm::vec3> m_Scales;
+    std::vector<uint32_t> m_ParentIndices;
+    std::vector<uint32_t> m_SubtreeEnds;
+    std::vector<glm::mat4> m_LocalMatrices;
+    std::vector<glm::mat4> m_WorldMatrices;
+
+    std::vector<uint8_t> m_IsLocalDirty;
+    std::vector<uint32_t> m_DirtyNodes;
+
+    size_t m_LastUpdateCount = 0;
+
+    // Scratch storage reused between updates
+    std::vector<uint32_t> m_UpdateRoots;
+    std::vector<uint32_t> m_SubtreeJobs;
+    std::vector<uint32_t> m_SplitStack;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_WORLD_TRANSFORM_HIERARCHY_H_
@@ -0,0 +1,180 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "engine_lib/world/transform_system.h"
+
+#include "engine_lib/world/components.h"
+#include "engine_lib/world/transform_batch.h"
+
+namespace tamarindo
+{
+
+void TransformSystem::update(EntityRegistry* registry)
+{
+    const uint32_t last_version = m_LastChangeVersion;
+
+    // Each chunk stores these columns as parallel arrays, so they go to the
+    // batch kernel as they are.
+    registry->forEachChangedChunk<const LocalPosition, const LocalRotation,
+                                  const LocalScale, LocalMatrix>(
+        last_version,
+        makeComponentMask<LocalPosition, LocalRotation, LocalScale>(),
+        [](size_t count, const Entity* /*entities*/,
+           const LocalPosition* positions, const LocalRotation* rotations,
+           const LocalScale* scales, LocalMatrix* matrices) {
+            composeTransformMatrices(&positions->value, &rotations->value,
+                                     &scales->value, &matrices->value, count);
+        });
+
+    // Reparenting replaces the Parent component in place, without a
+    // structural change
+    bool is_reparented = false;
+    registry->forEachChangedChunk<const Parent>(
+        last_version, makeComponentMask<Parent>(),
+        [&is_reparented](size_t /*count*/, const Entity* /*entities*/,
+                         const Parent* /*parents*/) { is_reparented = true; });
+
+    // Destroyed parents turn their children into roots without touching
+    // the children's chunks, so a rebuild updates every node
+    const bool is_rebuilt =
+        is_reparented || registry->getStructureVersion() != m_StructureVersion;
+    if (is_rebuilt) {
+        rebuildNodes(registry);
+        m_StructureVersion = registry->getStructureVersion();
+    }
+    updateWorldMatrices(registry, last_version, is_rebuilt);
+
+    registry->forEachChangedChunk<const LocalBounds, const WorldMatrix,
+                                  WorldBounds>(
+        last_version, makeComponentMask<LocalBounds, WorldMatrix>(),
+        [](size_t count, const Entity* /*entities*/,
+           const LocalBounds* local_bounds, const WorldMatrix* world_matrices,
+           WorldBounds* world_bounds) {
+            for (size_t i = 0; i < count; ++i) {
+                world_bounds[i].value = transformAABB(local_bounds[i].value,
+                                                      world_matrices[i].value);
+            }
+        });
+
+    // The writes above carry the current version, the ones made after this
+    // update a newer one
+    m_LastChangeVersion = registry->getChangeVersion();
+    registry->advanceChangeVersion();
+}
+
+void TransformSystem::rebuildNodes(EntityRegistry* registry)
+{
+    for (std::vector<HierarchyEntry>& entries : m_EntriesByDepth) {
+        entries.clear();
+    }
+    if (m_EntriesByDepth.empty()) {
+        m_EntriesByDepth.resize(1);
+    }
+
+    registry->forEachChunk<const LocalMatrix, const WorldMatrix>(
+        [this](size_t count, const Entity* entities,
+               const LocalMatrix* /*local_matrices*/,
+               const WorldMatrix* /*world_matrices*/) {
+            for (size_t i = 0; i < count; ++i) {
+                m_EntriesByDepth[0].push_back({entities[i], Entity{}});
+            }
+        },
+        makeComponentMask<Parent>());
+    registry->forEachChunk<const Parent, const LocalMatrix, const WorldMatrix>(
+        [this](size_t count, const Entity* entities, const Parent* parents,
+               const LocalMatrix* /*local_matrices*/,
+               const WorldMatrix* /*world_matrices*/) {
+            for (size_t i = 0; i < count; ++i) {
+                const uint32_t depth = parents[i].depth;
+                if (depth >= m_EntriesByDepth.size()) {
+                    m_EntriesByDepth.resize(depth + 1);
+                }
+                m_EntriesByDepth[depth].push_back(
+                    {entities[i], parents[i].entity});
+            }
+        });
+
+    const ComponentId local_id = getComponentId<LocalMatrix>();
+    const ComponentId world_id = getComponentId<WorldMatrix>();
+    m_Nodes.clear();
+    m_NodeIndices.assign(m_NodeIndices.size(), INVALID_INDEX);
+    for (const std::vector<HierarchyEntry>& entries : m_EntriesByDepth) {
+        for (const HierarchyEntry& entry : entries) {
+            // Parents without a transform, or not laid out yet because their
+            // depth is wrong, leave the node as a root
+            uint32_t parent = INVALID_INDEX;
+            if (registry->isAlive(entry.parent) &&
+                entry.parent.index < m_NodeIndices.size()) {
+                parent = m_NodeIndices[entry.parent.index];
+            }
+
+            uint32_t row = 0;
+            Archetype* archetype = registry->getArchetype(entry.entity, &row);
+            const auto* local_matrix = static_cast<const LocalMatrix*>(
+                archetype->getComponent(row, local_id));
+            auto* world_matrix = static_cast<WorldMatrix*>(
+                archetype->getComponent(row, world_id));
+
+            Node node;
+            node.parent = parent;
+            node.archetype = archetype;
+            node.chunk_index = row / archetype->getChunkCapacity();
+            node.local = &local_matrix->value;
+            node.world = &world_matrix->value;
+
+            if (entry.entity.index >= m_NodeIndices.size()) {
+                m_NodeIndices.resize(entry.entity.index + 1, INVALID_INDEX);
+            }
+            m_NodeIndices[entry.entity.index] =
+                static_cast<uint32_t>(m_Nodes.size());
+            m_Nodes.push_back(node);
+        }
+    }
+}
+
+void TransformSystem::updateWorldMatrices(EntityRegistry* registry,
+                                          uint32_t last_version,
+                                          bool update_all)
+{
+    const ComponentId local_id = getComponentId<LocalMatrix>();
+    const ComponentId world_id = getComponentId<WorldMatrix>();
+    const uint32_t version = registry->getChangeVersion();
+
+    // Parents come first, so their dirty flag is final when a child reads it
+    m_IsNodeDirty.resize(m_Nodes.size());
+    for (size_t i = 0; i < m_Nodes.size(); ++i) {
+        const Node& node = m_Nodes[i];
+        bool is_dirty =
+            update_all || node.archetype->getChangeVersion(
+                              node.chunk_index, local_id) > last_version;
+        if (node.parent != INVALID_INDEX && m_IsNodeDirty[node.parent]) {
+            is_dirty = true;
+        }
+        m_IsNodeDirty[i] = is_dirty;
+        if (!is_dirty) {
+            continue;
+        }
+
+        *node.world = node.parent != INVALID_INDEX
+                          ? *m_Nodes[node.parent].world * *node.local
+                          : *node.local;
+        // Written through the cached pointer, so the chunk is marked here
+        // for the bounds pass and later systems
+        node.archetype->setChangeVersion(node.chunk_index, world_id, version);
+    }
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,87 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_WORLD_TRANSFORM_SYSTEM_H_
+#define ENGINE_LIB_WORLD_TRANSFORM_SYSTEM_H_
+
+#include "engine_lib/world/entity_registry.h"
+
+#include "glm/glm.hpp"
+
+#include <vector>
+
+namespace tamarindo
+{
+
+// Computes LocalMatrix and WorldMatrix for every entity that has them, and
+// WorldBounds for entities with LocalBounds. Only the transform columns are
+// read, one chunk at a time.
+//
+// Work follows the change versions of the registry: a chunk is only
+// composed again if its position, rotation or scale was written since the
+// last update, and a world matrix only if its local matrix or an ancestor
+// changed. A scene where nothing moves costs one version check per chunk
+// and per node.
+class TransformSystem
+{
+   public:
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+    void update(EntityRegistry* registry);
+
+   private:
+    // An entity with LocalMatrix and WorldMatrix. Points into its chunk, so
+    // the nodes are rebuilt on every structural change of the registry.
+    struct Node {
+        // Index of the parent node, INVALID_INDEX for roots
+        uint32_t parent;
+        Archetype* archetype;
+        size_t chunk_index;
+        const glm::mat4* local;
+        glm::mat4* world;
+    };
+
+    struct HierarchyEntry {
+        Entity entity;
+        Entity parent;
+    };
+
+    // Lays out the nodes level by level, roots first, so every parent comes
+    // before its children and is resolved once here instead of every update
+    void rebuildNodes(EntityRegistry* registry);
+
+    // Recomputes the world matrices of the nodes whose local matrix or an
+    // ancestor changed after `last_version`, or of every node with
+    // `update_all`
+    void updateWorldMatrices(EntityRegistry* registry, uint32_t last_version,
+                             bool update_all);
+
+    std::vector<Node> m_Nodes;
+    // Indexed by Entity::index
+    std::vector<uint32_t> m_NodeIndices;
+    // Per node, scratch of updateWorldMatrices()
+    std::vector<uint8_t> m_IsNodeDirty;
+    // Entities grouped by Parent::depth, scratch of rebuildNodes()
+    std::vector<std::vector<HierarchyEntry>> m_EntriesByDepth;
+
+    // The registry versions seen by the last update
+    uint32_t m_LastChangeVersion = 0;
+    uint32_t m_StructureVersion = 0;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_WORLD_TRANSFORM_SYSTEM_H_
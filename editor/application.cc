@@ -18,9 +18,47 @@
 #include "logging/logger.h"
 #include "utils/macros.h"
 #include "window/window.h"
-#include "rendering/shader_builder.h"
 #include "utils/timer.h"
 
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+
+constexpr unsigned int VERTEX_FLOAT_COUNT =
+    tmrd::RenderBackend::MESH_VERTEX_FLOAT_COUNT;
+
+// Geometry copied per frame to close the holes left by released meshes
+constexpr uint64_t GEOMETRY_COMPACTION_BYTES_PER_FRAME = 256 * 1024;
+
+DirectX::BoundingBox ComputeMeshBounds(const GameData::SceneData& scene,
+                                       const GameData::SceneData::Mesh& mesh)
+{
+    DirectX::XMFLOAT3 min_point(FLT_MAX, FLT_MAX, FLT_MAX);
+    DirectX::XMFLOAT3 max_point(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (unsigned int i = 0; i < mesh.index_count; ++i) {
+        const unsigned int vertex =
+            mesh.vertex_offset + scene.index_buffer_data[mesh.index_offset + i];
+        const float* position =
+            &scene.vertex_buffer_data[vertex * VERTEX_FLOAT_COUNT];
+        min_point.x = std::min(min_point.x, position[0]);
+        min_point.y = std::min(min_point.y, position[1]);
+        min_point.z = std::min(min_point.z, position[2]);
+        max_point.x = std::max(max_point.x, position[0]);
+        max_point.y = std::max(max_point.y, position[1]);
+        max_point.z = std::max(max_point.z, position[2]);
+    }
+
+    DirectX::BoundingBox bounds;
+    DirectX::BoundingBox::CreateFromPoints(
+        bounds, DirectX::XMLoadFloat3(&min_point),
+        DirectX::XMLoadFloat3(&max_point));
+    return bounds;
+}
+
+}  // namespace
+
 Application::Application()
 {
     // TODO: Check error
@@ -31,8 +69,16 @@ Application::Application()
     const auto window_data = GameData::GetWindowData();
     render_state_.Initialize(window_data.width, window_data.height);
 
-    shader_ = tmrd::ShaderBuilder::CompilePosUvShader(SHADER_CODE);
-    TM_ASSERT(shader_);
+    // Every draw binds its object constants by offset, there is no path for
+    // devices without it
+    if (!tmrd::FrameConstantAllocator::IsSupported(
+            render_state_.device.Get())) {
+        TM_LOG_ERROR(
+            "Constant buffer offsetting is not supported. A Direct3D 11.1 "
+            "device and driver are required.");
+        is_running_ = false;
+        return;
+    }
 
     tmrd::PerspectiveCameraParams perspective_params;
     perspective_params.aspect_ratio = window_data.aspect_ratio;
@@ -45,27 +91,53 @@ Application::Application()
     camera_->SetController(camera_controller_.get());
 
     scene_constant_buffer_ = std::make_unique<tmrd::MatrixConstantBuffer>();
-    cube_transform_cb_ = std::make_unique<tmrd::MatrixConstantBuffer>();
-    grid_transform_cb_ = std::make_unique<tmrd::MatrixConstantBuffer>();
-
-    UpdateConstantBuffer(camera_->GetViewProjMat(),
-                         scene_constant_buffer_.get());
+    constant_allocator_ = std::make_unique<tmrd::FrameConstantAllocator>(
+        tmrd::FrameConstantAllocatorParams());
 
     cube_transform_.SetPosY(1.0f);
-    UpdateConstantBuffer(cube_transform_.GetMatrix(), cube_transform_cb_.get());
-
-    UpdateConstantBuffer(grid_transform_.GetMatrix(), grid_transform_cb_.get());
 
     scene_data_ = GameData::GetSceneModel();
-    scene_data_buffers_ = std::make_unique<tmrd::ModelData>(
-        scene_data_.vertex_buffer_data, scene_data_.index_buffer_data);
-    TM_ASSERT(scene_data_buffers_);
+
+    state_cache_ = std::make_unique<tmrd::D3D11StateCache>(
+        render_state_.device_context.Get());
+    render_backend_ = std::make_unique<tmrd::D3D11RenderBackend>(
+        state_cache_.get(), tmrd::GeometryHeapParams(),
+        tmrd::UploadManagerParams());
+    transient_textures_ = std::make_unique<tmrd::TransientTexturePool>(
+        tmrd::TransientTexturePoolParams());
+    shader_handle_ = render_backend_->CreateShader(SHADER_CODE);
+    TM_ASSERT(shader_handle_ != tmrd::RenderBackend::INVALID_HANDLE);
+    // Drawn from the first frame, whatever the upload budget
+    mesh_handle_ = render_backend_->CreateMesh(scene_data_.vertex_buffer_data,
+                                               scene_data_.index_buffer_data,
+                                               /*is_synchronous=*/true);
+
+    draw_list_builder_ =
+        std::make_unique<tmrd::DrawListBuilder>(tmrd::DrawListBuilderParams());
+    command_recorder_ = std::make_unique<tmrd::ParallelCommandRecorder>(
+        tmrd::ParallelCommandRecorderParams());
+
+    AddDrawItem(0, &cube_transform_, /*is_occluder=*/true);
+    AddDrawItem(1, &grid_transform_, /*is_occluder=*/true);
+
+    // The first frame renders the initial state
+    WriteSnapshot(&snapshots_.GetWriteBuffer());
+    snapshots_.Swap();
+
+    TM_LOG_INFO("Frustum culling kernel: {}",
+                tmrd::FrustumCuller::GetKernelName(
+                    tmrd::FrustumCuller::GetBestKernel()));
 }
 
 Application ::~Application() { render_state_.Shutdown(); }
 
 void Application::Run()
 {
+    // The constructor already reported why it stopped
+    if (!is_running_) {
+        return;
+    }
+
     TM_LOG_INFO("Starting application...");
     tmrd::Window::Show();
 
@@ -80,9 +152,10 @@ void Application::Run()
         }
         t.StartFrame();
 
-        Update(t);
-
+        update_worker_.Start([this, &t] { Update(t); });
         Render();
+        update_worker_.Wait();
+        snapshots_.Swap();
 
         keyboard_.ResetFrameKeyEvents();
     }
@@ -90,37 +163,156 @@ void Application::Run()
 
 void Application::BindScene()
 {
-    ID3D11DeviceContext* device_context = render_state_.device_context.Get();
-    // Bind scene constant buffer
-    device_context->VSSetConstantBuffers(
-        0, 1, scene_constant_buffer_->buffer.GetAddressOf());
-
-    // Bind shader
-    device_context->IASetInputLayout(&shader_->input_layout());
-    device_context->VSSetShader(&shader_->vertex_shader(), 0, 0);
-    device_context->PSSetShader(&shader_->pixel_shader(), 0, 0);
-
-    // Bind mesh
-    auto stride = scene_data_buffers_->vertex_buffer_stride();
-    auto vb_offset = scene_data_buffers_->vertex_buffer_offset();
-    device_context->IASetVertexBuffers(
-        0, 1, scene_data_buffers_->vertex_buffer.GetAddressOf(), &stride,
-        &vb_offset);
-    device_context->IASetIndexBuffer(
-        scene_data_buffers_->index_buffer.Get(), DXGI_FORMAT_R32_UINT,
-        scene_data_buffers_->index_buffer_offset());
+    // Bind scene constant buffer. Shaders, meshes and object constants are
+    // bound by the render backend when the command buffer is submitted.
+    state_cache_->SetVSConstantBuffer(0, scene_constant_buffer_->buffer.Get());
 }
 
 void Application::Update(const tmrd::Timer& t)
 {
-    if (camera_->OnUpdate(t)) {
-        UpdateConstantBuffer(camera_->GetViewProjMat(),
-                             scene_constant_buffer_.get());
-    }
+    camera_->OnUpdate(t);
 
     // transform_.SetScale(0.5 * sin(t.TotalTime()) + 1);
     cube_transform_.AddRotationY(DirectX::XM_PIDIV4 * t.DeltaTime());
-    UpdateConstantBuffer(cube_transform_.GetMatrix(), cube_transform_cb_.get());
+
+    WriteSnapshot(&snapshots_.GetWriteBuffer());
+}
+
+void Application::WriteSnapshot(FrameSnapshot* snapshot)
+{
+    snapshot->view_proj = camera_->GetViewProjMat();
+    snapshot->eye_position = camera_->GetEyePosition();
+    snapshot->fov_angle_in_radians = camera_->GetFovAngleInRadians();
+    snapshot->z_far = camera_->GetZFar();
+
+    snapshot->world_matrices.resize(draw_items_.size());
+    snapshot->world_bounds.resize(draw_items_.size());
+    for (size_t i = 0; i < draw_items_.size(); ++i) {
+        const DrawItem& item = draw_items_[i];
+        snapshot->world_matrices[i] = item.transform->GetMatrix();
+        item.local_bounds.Transform(snapshot->world_bounds[i],
+                                    snapshot->world_matrices[i]);
+    }
+}
+
+void Application::AddDrawItem(unsigned int mesh_index, Transform* transform,
+                              bool is_occluder)
+{
+    DrawItem item;
+    item.mesh_index = mesh_index;
+    item.transform = transform;
+    item.local_bounds =
+        ComputeMeshBounds(scene_data_, scene_data_.meshes[mesh_index]);
+    draw_items_.push_back(item);
+
+    const GameData::SceneData::Mesh& mesh = scene_data_.meshes[mesh_index];
+    const std::vector<tmrd::LodLevel> single_level = {
+        tmrd::LodLevel{mesh.index_offset, mesh.index_count, mesh.vertex_offset,
+                       /*geometric_error=*/0.0f}};
+    const std::vector<tmrd::LodLevel>& levels =
+        mesh.lods.empty() ? single_level : mesh.lods;
+
+    // The coarsest level is enough to hide things behind the mesh
+    const tmrd::LodLevel& coarsest = levels.back();
+    tmrd::OccluderGeometry occluder;
+    occluder.vertices = &scene_data_.vertex_buffer_data[coarsest.vertex_offset *
+                                                        VERTEX_FLOAT_COUNT];
+    occluder.vertex_stride = VERTEX_FLOAT_COUNT;
+    occluder.indices = &scene_data_.index_buffer_data[coarsest.index_offset];
+    occluder.index_count = coarsest.index_count;
+
+    const unsigned int draw_id = draw_list_builder_->AddDraw(
+        item.local_bounds, levels, is_occluder ? &occluder : nullptr);
+    TM_ASSERT(draw_id == draw_items_.size() - 1);
+}
+
+void Application::BuildDrawList(const FrameSnapshot& snapshot)
+{
+    tmrd::DrawListView view;
+    view.view_proj = snapshot.view_proj;
+    view.eye_position = snapshot.eye_position;
+    view.fov_angle_in_radians = snapshot.fov_angle_in_radians;
+    view.viewport_height =
+        static_cast<float>(GameData::GetWindowData().height);
+    draw_list_builder_->Build(view, snapshot.world_matrices,
+                              snapshot.world_bounds, &visible_draws_);
+
+    const tmrd::OcclusionCullerStats& stats =
+        draw_list_builder_->occlusion_stats();
+    if (stats.occluded_count != last_occluded_count_) {
+        TM_LOG_INFO(
+            "Occlusion culling: {}/{} draws hidden, {} occluder triangles, "
+            "rasterize {:.3f}ms, test {:.3f}ms",
+            stats.occluded_count, stats.tested_count,
+            stats.occluder_triangle_count, stats.rasterize_ms, stats.test_ms);
+        last_occluded_count_ = stats.occluded_count;
+    }
+}
+
+void Application::RecordDraws(const FrameSnapshot& snapshot)
+{
+    // One block of object constants for all the visible draws. The workers
+    // write their slices straight into the mapped buffer.
+    ID3D11DeviceContext* device_context = render_state_.device_context.Get();
+    constant_allocator_->BeginFrame(device_context);
+    if (!constant_allocator_->Allocate(
+            device_context, sizeof(DirectX::XMMATRIX),
+            static_cast<UINT>(visible_draws_.size()), &object_constants_)) {
+        // Only when the device fails, running out of space grows the buffer
+        TM_LOG_ERROR("Could not allocate frame constants, skipping {} draws",
+                     visible_draws_.size());
+        visible_draws_.clear();
+    }
+
+    command_recorder_->Record(
+        visible_draws_.size(),
+        [this, &snapshot](size_t begin, size_t end,
+                          tmrd::CommandBuffer* buffer) {
+            for (size_t i = begin; i < end; ++i) {
+                RecordDraw(snapshot, static_cast<unsigned int>(i), buffer);
+            }
+        },
+        &command_buffer_);
+
+    constant_allocator_->EndFrame(device_context);
+    render_backend_->SetObjectConstantBuffer(
+        constant_allocator_->buffer(), object_constants_.constant_stride);
+}
+
+void Application::RecordDraw(const FrameSnapshot& snapshot,
+                             unsigned int visible_index,
+                             tmrd::CommandBuffer* buffer) const
+{
+    const unsigned int draw_id = visible_draws_[visible_index];
+    const DrawItem& item = draw_items_[draw_id];
+
+    DirectX::XMMATRIX* object_matrix = static_cast<DirectX::XMMATRIX*>(
+        object_constants_.GetElement(visible_index));
+    *object_matrix = XMMatrixTranspose(snapshot.world_matrices[draw_id]);
+
+    // Clip space w is the view depth of the bounds center
+    const DirectX::XMVECTOR center = DirectX::XMVector3Transform(
+        DirectX::XMLoadFloat3(&snapshot.world_bounds[draw_id].Center),
+        snapshot.view_proj);
+    const uint16_t depth = tmrd::sort_key::QuantizeDepth(
+        DirectX::XMVectorGetW(center), snapshot.z_far);
+
+    const tmrd::LodLevel& level =
+        draw_list_builder_->GetSelectedLevel(draw_id);
+    tmrd::DrawPacket packet;
+    packet.shader = shader_handle_;
+    packet.material = 0;
+    packet.mesh = mesh_handle_;
+    packet.object_constants = object_constants_.GetFirstConstant(visible_index);
+    packet.index_count = level.index_count;
+    packet.index_offset = level.index_offset;
+    packet.vertex_offset = static_cast<int32_t>(level.vertex_offset);
+
+    // Opaque draws go front to back to get the most out of early depth
+    buffer->AddDraw(
+        tmrd::sort_key::Make(/*view=*/0, /*pass=*/0, packet.shader,
+                             packet.material, item.mesh_index, depth),
+        packet);
 }
 
 void Application::UpdateConstantBuffer(const DirectX::XMMATRIX& matrix,
@@ -137,33 +329,61 @@ void Application::UpdateConstantBuffer(const DirectX::XMMATRIX& matrix,
 
 void Application::Render()
 {
-    ID3D11DeviceContext* device_context = render_state_.device_context.Get();
-    device_context->ClearRenderTargetView(
-        render_state_.render_target_view.Get(), BACKGROUND_COLOR);
-    device_context->ClearDepthStencilView(
-        render_state_.depth_stencil_view.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-
-    {
-        // Draw cube
-        device_context->VSSetConstantBuffers(
-            1, 1, cube_transform_cb_->buffer.GetAddressOf());
-        const auto& cube_mesh = scene_data_.meshes[0];
-        device_context->DrawIndexed(cube_mesh.index_count,
-                                    cube_mesh.index_offset,
-                                    cube_mesh.vertex_offset);
+    // Mesh data staged since the last frame lands before any draw
+    render_backend_->FlushUploads();
+
+    const FrameSnapshot& snapshot = snapshots_.GetReadBuffer();
+    UpdateConstantBuffer(snapshot.view_proj, scene_constant_buffer_.get());
+
+    BuildDrawList(snapshot);
+    RecordDraws(snapshot);
+
+    render_graph_.Reset();
+    const tmrd::RenderGraphTexture back_buffer = render_graph_.ImportTexture(
+        "back_buffer", render_state_.render_target_view.Get(), nullptr,
+        nullptr);
+    const tmrd::RenderGraphTexture depth = render_graph_.ImportTexture(
+        "depth", nullptr, render_state_.depth_stencil_view.Get(), nullptr);
+    render_graph_.AddPass(
+        "scene",
+        [back_buffer, depth](tmrd::RenderGraphBuilder* builder) {
+            builder->Write(back_buffer);
+            builder->Write(depth);
+        },
+        [this, back_buffer, depth](const tmrd::RenderGraph& graph) {
+            ID3D11DeviceContext* device_context =
+                render_state_.device_context.Get();
+            ID3D11RenderTargetView* render_target_view =
+                graph.GetRenderTargetView(back_buffer);
+            ID3D11DepthStencilView* depth_stencil_view =
+                graph.GetDepthStencilView(depth);
+            device_context->OMSetRenderTargets(1, &render_target_view,
+                                               depth_stencil_view);
+            device_context->ClearRenderTargetView(render_target_view,
+                                                  BACKGROUND_COLOR);
+            device_context->ClearDepthStencilView(
+                depth_stencil_view, D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+            command_buffer_.Submit(render_backend_.get());
+        });
+    render_graph_.Compile();
+    if (!render_graph_.Execute(transient_textures_.get())) {
+        // The passes did not run, presenting would show a stale back buffer
+        TM_LOG_ERROR("Could not create the transient textures, skipping frame");
+        return;
     }
 
-    {
-        // Draw grid
-        device_context->VSSetConstantBuffers(
-            1, 1, grid_transform_cb_->buffer.GetAddressOf());
-        const auto& grid_mesh = scene_data_.meshes[1];
-        device_context->DrawIndexed(grid_mesh.index_count,
-                                    grid_mesh.index_offset,
-                                    grid_mesh.vertex_offset);
+    const tmrd::StateCacheStats& bind_stats = state_cache_->stats();
+    if (bind_stats.filtered_count != last_filtered_bind_count_) {
+        TM_LOG_INFO("State cache: {} binds, {} redundant binds filtered",
+                    bind_stats.bind_count, bind_stats.filtered_count);
+        last_filtered_bind_count_ = bind_stats.filtered_count;
     }
+    state_cache_->ResetStats();
 
     render_state_.swap_chain->Present(0, 0);
+
+    render_backend_->CompactGeometry(GEOMETRY_COMPACTION_BYTES_PER_FRAME);
 }
 
 LRESULT Application::HandleWindowMessage(HWND hWnd, UINT message, WPARAM wParam,
@@ -17,15 +17,25 @@
 #ifndef TAMARINDO_EDITOR_APPLICATION_H_
 #define TAMARINDO_EDITOR_APPLICATION_H_
 
+#include <DirectXCollision.h>
+
 #include <memory>
+#include <vector>
 
 #include "camera/perspective_camera.h"
 #include "camera/spherical_camera_controller.h"
 #include "input/keyboard.h"
+#include "rendering/command_buffer.h"
+#include "rendering/d3d11_render_backend.h"
+#include "rendering/d3d11_state_cache.h"
+#include "rendering/draw_list_builder.h"
+#include "rendering/frame_constant_allocator.h"
 #include "rendering/matrix_constant_buffer.h"
-#include "rendering/model_data.h"
+#include "rendering/parallel_command_recorder.h"
+#include "rendering/render_graph.h"
 #include "rendering/render_state.h"
-#include "rendering/shader.h"
+#include "utils/double_buffer.h"
+#include "utils/frame_worker.h"
 #include "window/window.h"
 #include "window/window_event_handler.h"
 #include "logging/logger.h"
@@ -49,14 +59,53 @@ class Application : public tmrd::WindowEventHandler
    private:
     void BindScene();
 
+    // Simulation step. Runs on the update worker and only writes the next
+    // frame snapshot, never the D3D context.
     void Update(const tmrd::Timer& t);
 
+    // Draws the current frame snapshot
     void Render();
 
     void UpdateConstantBuffer(const DirectX::XMMATRIX& matrix,
                               tmrd::MatrixConstantBuffer* buffer);
 
+    void AddDrawItem(unsigned int mesh_index, Transform* transform,
+                     bool is_occluder);
+
    private:
+    // Everything the renderer needs from a simulated frame
+    struct FrameSnapshot {
+        DirectX::XMMATRIX view_proj;
+        DirectX::XMFLOAT3 eye_position;
+        float fov_angle_in_radians;
+        float z_far;
+        // Indexed by draw id
+        std::vector<DirectX::XMMATRIX> world_matrices;
+        std::vector<DirectX::BoundingBox> world_bounds;
+    };
+
+    void WriteSnapshot(FrameSnapshot* snapshot);
+
+    // Fills visible_draws_ with the draws of the snapshot that pass frustum
+    // and occlusion culling, and selects their levels of detail
+    void BuildDrawList(const FrameSnapshot& snapshot);
+
+    // Records the visible draws into command_buffer_ and sorts them. The
+    // recording is split across the threads of command_recorder_.
+    void RecordDraws(const FrameSnapshot& snapshot);
+
+    // Writes the object constants of the draw and records it. Only reads
+    // the application state, safe to call from the recorder threads.
+    void RecordDraw(const FrameSnapshot& snapshot, unsigned int visible_index,
+                    tmrd::CommandBuffer* buffer) const;
+
+    struct DrawItem {
+        unsigned int mesh_index;
+        Transform* transform;
+        // Bounds of the mesh before applying the transform
+        DirectX::BoundingBox local_bounds;
+    };
+
     bool is_running_ = true;
 
     tmrd::Logger logger;
@@ -69,23 +118,44 @@ class Application : public tmrd::WindowEventHandler
 
     // End data section
 
-    std::unique_ptr<tmrd::Shader> shader_;
-
     GameData::SceneData scene_data_;
 
-    std::unique_ptr<tmrd::ModelData> scene_data_buffers_;
-
     std::unique_ptr<tmrd::PerspectiveCamera> camera_;
     std::unique_ptr<tmrd::SphericalCameraController> camera_controller_;
 
     Transform cube_transform_;
-    std::unique_ptr<tmrd::MatrixConstantBuffer> cube_transform_cb_;
-
     Transform grid_transform_;
-    std::unique_ptr<tmrd::MatrixConstantBuffer> grid_transform_cb_;
 
     std::unique_ptr<tmrd::MatrixConstantBuffer> scene_constant_buffer_;
 
+    // Object constants of the visible draws, one element per entry of
+    // visible_draws_
+    std::unique_ptr<tmrd::FrameConstantAllocator> constant_allocator_;
+    tmrd::ConstantAllocation object_constants_ = {};
+
+    // Frame N is rendered from the read buffer while the update worker
+    // writes frame N + 1
+    tmrd::DoubleBuffer<FrameSnapshot> snapshots_;
+    tmrd::FrameWorker update_worker_;
+
+    // Indexed by the ids returned by the draw list builder
+    std::vector<DrawItem> draw_items_;
+    std::unique_ptr<tmrd::DrawListBuilder> draw_list_builder_;
+    std::vector<unsigned int> visible_draws_;
+    unsigned int last_occluded_count_ = 0;
+
+    // Every bind on the immediate context goes through the state cache
+    std::unique_ptr<tmrd::D3D11StateCache> state_cache_;
+    unsigned int last_filtered_bind_count_ = 0;
+    std::unique_ptr<tmrd::D3D11RenderBackend> render_backend_;
+    // Rebuilt every frame, its transient textures come from the pool
+    tmrd::RenderGraph render_graph_;
+    std::unique_ptr<tmrd::TransientTexturePool> transient_textures_;
+    std::unique_ptr<tmrd::ParallelCommandRecorder> command_recorder_;
+    tmrd::CommandBuffer command_buffer_;
+    uint32_t shader_handle_ = 0;
+    uint32_t mesh_handle_ = 0;
+
     virtual LRESULT HandleWindowMessage(HWND hWnd, UINT message, WPARAM wParam,
                                         LPARAM lParam) override;
 };
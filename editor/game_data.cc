@@ -81,18 +81,24 @@ constexpr std::array<unsigned int, 36> CUBE_IB{{
 //    20, 21, 22, 22, 23, 20   // Bottom face
 //}};
 
+constexpr float GRID_SIZE = 10.f;
+
+// Cells per side of each level of the grid, from the most detailed one
+constexpr std::array<unsigned int, 4> GRID_LOD_CELLS{{32, 16, 8, 4}};
+
 unsigned int AppendGridData(std::vector<float>& vertex_buffer,
-                            std::vector<unsigned int>& index_buffer)
+                            std::vector<unsigned int>& index_buffer,
+                            unsigned int cells_per_side)
 {
-    const unsigned int m = 5;
-    const unsigned int n = 5;
+    const unsigned int m = cells_per_side + 1;
+    const unsigned int n = cells_per_side + 1;
     const unsigned int face_count = (m - 1) * (n - 1) * 2;
 
-    vertex_buffer.reserve(m * n * 5);
-    index_buffer.reserve(face_count * 3);
+    vertex_buffer.reserve(vertex_buffer.size() + m * n * 5);
+    index_buffer.reserve(index_buffer.size() + face_count * 3);
 
-    const float width = 10.f;
-    const float depth = 10.f;
+    const float width = GRID_SIZE;
+    const float depth = GRID_SIZE;
 
     const float dx = width / (n - 1);
     const float dz = depth / (m - 1);
@@ -144,15 +150,28 @@ SceneData GetSceneModel()
                                           /*.index_offset =*/0,
                                           /*.index_count =*/CUBE_IB.size()});
 
-    const unsigned int curr_vertex_offset = m.vertex_buffer_data.size() / 5;
-    const unsigned int curr_index_offset = m.index_buffer_data.size();
-
-    auto grid_index_count =
-        AppendGridData(m.vertex_buffer_data, m.index_buffer_data);
+    // The grid is flat, but its vertices carry the UVs, so a level is as far
+    // from the full grid as half of one of its cells.
+    std::vector<::tamarindo::LodLevel> grid_lods;
+    for (const unsigned int cells : GRID_LOD_CELLS) {
+        const unsigned int curr_vertex_offset =
+            m.vertex_buffer_data.size() / 5;
+        const unsigned int curr_index_offset = m.index_buffer_data.size();
+        const unsigned int grid_index_count =
+            AppendGridData(m.vertex_buffer_data, m.index_buffer_data, cells);
+        const float error =
+            cells == GRID_LOD_CELLS[0] ? 0.0f : 0.5f * GRID_SIZE / cells;
+        grid_lods.push_back(::tamarindo::LodLevel{
+            /*.index_offset =*/curr_index_offset,
+            /*.index_count =*/grid_index_count,
+            /*.vertex_offset =*/curr_vertex_offset,
+            /*.geometric_error =*/error});
+    }
     m.meshes.emplace_back(
-        SceneData::Mesh{/*.vertex_offset =*/curr_vertex_offset,
-                        /*.index_offset =*/curr_index_offset,
-                        /*.index_count =*/grid_index_count});
+        SceneData::Mesh{/*.vertex_offset =*/grid_lods[0].vertex_offset,
+                        /*.index_offset =*/grid_lods[0].index_offset,
+                        /*.index_count =*/grid_lods[0].index_count,
+                        /*.lods =*/std::move(grid_lods)});
     return m;
 }
 
@@ -19,6 +19,8 @@
 
 #include <vector>
 
+#include "rendering/lod_selector.h"
+
 constexpr float BACKGROUND_COLOR[4] = {0.678f, 0.749f, 0.796f, 1.0f};
 
 constexpr const char SHADER_CODE[] = R"(
@@ -75,6 +77,9 @@ struct SceneData {
         unsigned int vertex_offset;
         unsigned int index_offset;
         unsigned int index_count;
+        // Every level of detail, from the most to the least detailed. The
+        // first one matches the range above. Empty for single level meshes.
+        std::vector<::tamarindo::LodLevel> lods;
     };
 
     std::vector<float> vertex_buffer_data;
@@ -17,9 +17,7 @@
 
 Transform::Transform() : matrix_(DirectX::XMMatrixIdentity())
 {
-    matrix_ = DirectX::XMMatrixRotationY(rot_y_) *
-              DirectX::XMMatrixScaling(scale_, scale_, scale_) *
-              DirectX::XMMatrixTranslation(0.0f, pos_y_, 0.0f);
+    UpdateMatrix();
 }
 
 Transform::~Transform() = default;
@@ -30,23 +28,31 @@ void Transform::SetScale(float scale)
         return;
     }
     scale_ = scale;
-    matrix_ = DirectX::XMMatrixRotationY(rot_y_) *
-              DirectX::XMMatrixScaling(scale_, scale_, scale_) *
-              DirectX::XMMatrixTranslation(0.0f, pos_y_, 0.0f);
+    UpdateMatrix();
 }
 
 void Transform::AddRotationY(float rot)
 {
     rot_y_ += rot;
-    matrix_ = DirectX::XMMatrixRotationY(rot_y_) *
-              DirectX::XMMatrixScaling(scale_, scale_, scale_) *
-              DirectX::XMMatrixTranslation(0.0f, pos_y_, 0.0f);
+    UpdateMatrix();
 }
 
 void Transform::SetPosY(float pos)
 {
     pos_y_ = pos;
-    matrix_ = DirectX::XMMatrixRotationY(rot_y_) *
-              DirectX::XMMatrixScaling(scale_, scale_, scale_) *
-              DirectX::XMMatrixTranslation(0.0f, pos_y_, 0.0f);
+    UpdateMatrix();
+}
+
+void Transform::UpdateMatrix()
+{
+    // Same result as RotationY * Scaling * Translation, written directly
+    // instead of multiplying the three matrices.
+    float sin_y;
+    float cos_y;
+    DirectX::XMScalarSinCos(&sin_y, &cos_y, rot_y_);
+    matrix_ = DirectX::XMMatrixSet(
+        cos_y * scale_, 0.0f, -sin_y * scale_, 0.0f,  // row 0
+        0.0f, scale_, 0.0f, 0.0f,                     // row 1
+        sin_y * scale_, 0.0f, cos_y * scale_, 0.0f,   // row 2
+        0.0f, pos_y_, 0.0f, 1.0f);                    // row 3
 }
@@ -33,6 +33,8 @@ class Transform
     void SetPosY(float pos);
 
    private:
+    void UpdateMatrix();
+
     float scale_ = 1.0f;
     float rot_y_ = 0.0f;
     float pos_y_ = 0.0f;
@@ -65,6 +65,7 @@ void PerspectiveCamera::ResetMatrices(bool update_view, bool update_proj)
     if (update_view) {
         const auto& [eye, at] = controller_->GetEyeAtCameraPosition();
         view_matrix_ = DirectX::XMMatrixLookAtLH(eye, at, UP);
+        DirectX::XMStoreFloat3(&eye_position_, eye);
     }
     if (update_proj) {
         projection_matrix_ = DirectX::XMMatrixPerspectiveFovLH(
@@ -61,6 +61,15 @@ class PerspectiveCamera
 
     const DirectX::XMMATRIX& GetViewProjMat() const;
 
+    inline const DirectX::XMFLOAT3& GetEyePosition() const
+    {
+        return eye_position_;
+    }
+
+    inline float GetFovAngleInRadians() const { return fov_angle_in_radians_; }
+
+    inline float GetZFar() const { return z_far_; }
+
    private:
     void ResetMatrices(bool update_view, bool update_proj);
 
@@ -70,6 +79,8 @@ class PerspectiveCamera
     float z_near_;
     float z_far_;
 
+    DirectX::XMFLOAT3 eye_position_ = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+
     DirectX::XMMATRIX view_matrix_ = DirectX::XMMatrixIdentity();
     DirectX::XMMATRIX projection_matrix_ = DirectX::XMMatrixIdentity();
     DirectX::XMMATRIX view_proj_matrix_ = DirectX::XMMatrixIdentity();
@@ -18,7 +18,9 @@
 
 #include <stdio.h>
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
 #include "utils/macros.h"
 
@@ -34,10 +36,12 @@ bool is_console_open = false;
 ScopedWindowsConsole::ScopedWindowsConsole()
 {
     TM_ASSERT(!is_console_open);
+#ifdef _WIN32
     AllocConsole();
     AttachConsole(ATTACH_PARENT_PROCESS);
     freopen_s(&console_stream_, "CONOUT$", "w", stdout);
     freopen_s(&console_stream_, "CONOUT$", "w", stderr);
+#endif
 
     is_console_open = true;
 }
@@ -45,8 +49,10 @@ ScopedWindowsConsole::ScopedWindowsConsole()
 ScopedWindowsConsole::~ScopedWindowsConsole()
 {
     TM_ASSERT(is_console_open);
+#ifdef _WIN32
     fclose(console_stream_);
     FreeConsole();
+#endif
 
     is_console_open = false;
 }
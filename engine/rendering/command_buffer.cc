@@ -0,0 +1,240 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/command_buffer.h"
+
+#include "rendering/render_backend.h"
+#include "utils/macros.h"
+
+#include <algorithm>
+#include <array>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+constexpr uint32_t RADIX_BITS = 8;
+constexpr uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+constexpr uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+
+// Under this the histogram passes cost more than a comparison sort
+constexpr size_t RADIX_SORT_MIN_COUNT = 2048;
+
+// Handle that never matches a real one, forces the first bind
+constexpr uint32_t NO_BINDING = UINT32_MAX;
+
+}  // namespace
+
+namespace sort_key
+{
+
+uint64_t Make(uint32_t view, uint32_t pass, uint32_t shader,
+              uint32_t material, uint32_t mesh, uint16_t depth)
+{
+    TM_ASSERT(view < (1u << VIEW_BITS));
+    TM_ASSERT(pass < (1u << PASS_BITS));
+    TM_ASSERT(shader < (1u << SHADER_BITS));
+    TM_ASSERT(material < (1u << MATERIAL_BITS));
+    TM_ASSERT(mesh < (1u << MESH_BITS));
+    return (static_cast<uint64_t>(view) << VIEW_SHIFT) |
+           (static_cast<uint64_t>(pass) << PASS_SHIFT) |
+           (static_cast<uint64_t>(shader) << SHADER_SHIFT) |
+           (static_cast<uint64_t>(material) << MATERIAL_SHIFT) |
+           (static_cast<uint64_t>(mesh) << MESH_SHIFT) |
+           (static_cast<uint64_t>(depth) << DEPTH_SHIFT);
+}
+
+uint16_t QuantizeDepth(float depth, float max_depth)
+{
+    // The division would give NaN, which clamp passes through
+    if (!(max_depth > 0.0f)) {
+        return 0;
+    }
+    const float normalized = std::clamp(depth / max_depth, 0.0f, 1.0f);
+    return static_cast<uint16_t>(normalized * DEPTH_MASK);
+}
+
+}  // namespace sort_key
+
+void RadixSort(std::vector<SortEntry>* entries,
+               std::vector<SortEntry>* scratch)
+{
+    const size_t count = entries->size();
+    if (count < RADIX_SORT_MIN_COUNT) {
+        std::stable_sort(entries->begin(), entries->end(),
+                         [](const SortEntry& a, const SortEntry& b) {
+                             return a.key < b.key;
+                         });
+        return;
+    }
+    scratch->resize(count);
+
+    // All the histograms are built in a single read of the keys
+    std::array<std::array<uint32_t, RADIX_SIZE>, RADIX_PASSES> histograms = {};
+    for (const SortEntry& entry : *entries) {
+        for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass) {
+            ++histograms[pass][(entry.key >> (pass * RADIX_BITS)) &
+                               (RADIX_SIZE - 1)];
+        }
+    }
+
+    SortEntry* source = entries->data();
+    SortEntry* destination = scratch->data();
+    for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass) {
+        std::array<uint32_t, RADIX_SIZE>& histogram = histograms[pass];
+        const uint32_t shift = pass * RADIX_BITS;
+
+        // Every key shares this byte, the order would not change
+        if (histogram[(source[0].key >> shift) & (RADIX_SIZE - 1)] == count) {
+            continue;
+        }
+
+        // Turn the counts into the first output slot of every bucket
+        uint32_t offset = 0;
+        for (uint32_t& bucket : histogram) {
+            const uint32_t bucket_count = bucket;
+            bucket = offset;
+            offset += bucket_count;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t bucket =
+                (source[i].key >> shift) & (RADIX_SIZE - 1);
+            destination[histogram[bucket]++] = source[i];
+        }
+        std::swap(source, destination);
+    }
+
+    if (source != entries->data()) {
+        entries->swap(*scratch);
+    }
+}
+
+void CommandBuffer::Reset()
+{
+    packets_.clear();
+    entries_.clear();
+}
+
+void CommandBuffer::Reserve(size_t command_count)
+{
+    packets_.reserve(command_count);
+    entries_.reserve(command_count);
+    scratch_.reserve(command_count);
+}
+
+void CommandBuffer::AddDraw(uint64_t sort_key, const DrawPacket& packet)
+{
+    entries_.push_back(
+        SortEntry{sort_key, static_cast<uint32_t>(packets_.size())});
+    packets_.push_back(packet);
+}
+
+void CommandBuffer::Sort() { RadixSort(&entries_, &scratch_); }
+
+void CommandBuffer::MergeSorted(const CommandBuffer* buffers,
+                                size_t buffer_count)
+{
+    struct Cursor {
+        const SortEntry* next;
+        const SortEntry* end;
+        // Where the packets of the buffer start in packets_
+        uint32_t packet_offset;
+    };
+
+    Reset();
+    size_t total_count = 0;
+    for (size_t i = 0; i < buffer_count; ++i) {
+        total_count += buffers[i].command_count();
+    }
+    Reserve(total_count);
+
+    std::vector<Cursor> cursors;
+    cursors.reserve(buffer_count);
+    for (size_t i = 0; i < buffer_count; ++i) {
+        const CommandBuffer& buffer = buffers[i];
+        if (buffer.entries_.empty()) {
+            continue;
+        }
+        cursors.push_back(Cursor{
+            buffer.entries_.data(),
+            buffer.entries_.data() + buffer.entries_.size(),
+            static_cast<uint32_t>(packets_.size())});
+        packets_.insert(packets_.end(), buffer.packets_.begin(),
+                        buffer.packets_.end());
+    }
+
+    // There is one buffer per recording thread, so a linear scan for the
+    // smallest key beats a heap
+    while (!cursors.empty()) {
+        size_t smallest = 0;
+        for (size_t i = 1; i < cursors.size(); ++i) {
+            // Strictly smaller, ties go to the earlier buffer
+            if (cursors[i].next->key < cursors[smallest].next->key) {
+                smallest = i;
+            }
+        }
+
+        Cursor& cursor = cursors[smallest];
+        entries_.push_back(
+            SortEntry{cursor.next->key,
+                      cursor.next->packet_index + cursor.packet_offset});
+        if (++cursor.next == cursor.end) {
+            cursors.erase(cursors.begin() + smallest);
+        }
+    }
+}
+
+void CommandBuffer::Submit(RenderBackend* backend) const
+{
+    Submit(backend, 0, entries_.size());
+}
+
+void CommandBuffer::Submit(RenderBackend* backend, size_t begin,
+                           size_t end) const
+{
+    TM_ASSERT(begin <= end && end <= entries_.size());
+    uint32_t shader = NO_BINDING;
+    uint32_t material = NO_BINDING;
+    uint32_t mesh = NO_BINDING;
+    uint32_t object_constants = NO_BINDING;
+
+    for (size_t i = begin; i < end; ++i) {
+        const DrawPacket& packet = packets_[entries_[i].packet_index];
+        if (packet.shader != shader) {
+            shader = packet.shader;
+            backend->BindShader(shader);
+        }
+        if (packet.material != material) {
+            material = packet.material;
+            backend->BindMaterial(material);
+        }
+        if (packet.mesh != mesh) {
+            mesh = packet.mesh;
+            backend->BindMesh(mesh);
+        }
+        if (packet.object_constants != object_constants) {
+            object_constants = packet.object_constants;
+            backend->BindObjectConstants(object_constants);
+        }
+        backend->DrawIndexed(packet.index_count, packet.index_offset,
+                             packet.vertex_offset);
+    }
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,137 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_COMMAND_BUFFER_H_
+#define ENGINE_LIB_RENDERING_COMMAND_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tamarindo
+{
+
+class RenderBackend;
+
+// 64-bit draw sort key. Fields are packed from the most significant bits,
+// so sorting the keys groups the draws by view, then pass, shader, material
+// and mesh, and orders them by depth last:
+//
+//   | view 4 | pass 4 | shader 10 | material 14 | mesh 16 | depth 16 |
+namespace sort_key
+{
+
+constexpr uint32_t VIEW_BITS = 4;
+constexpr uint32_t PASS_BITS = 4;
+constexpr uint32_t SHADER_BITS = 10;
+constexpr uint32_t MATERIAL_BITS = 14;
+constexpr uint32_t MESH_BITS = 16;
+constexpr uint32_t DEPTH_BITS = 16;
+
+constexpr uint32_t DEPTH_SHIFT = 0;
+constexpr uint32_t MESH_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+constexpr uint32_t MATERIAL_SHIFT = MESH_SHIFT + MESH_BITS;
+constexpr uint32_t SHADER_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+constexpr uint32_t PASS_SHIFT = SHADER_SHIFT + SHADER_BITS;
+constexpr uint32_t VIEW_SHIFT = PASS_SHIFT + PASS_BITS;
+static_assert(VIEW_SHIFT + VIEW_BITS == 64, "The key must use all 64 bits");
+
+uint64_t Make(uint32_t view, uint32_t pass, uint32_t shader,
+              uint32_t material, uint32_t mesh, uint16_t depth);
+
+// Maps a view depth in [0, max_depth] to the depth field, front to back.
+// Use DEPTH_MASK - QuantizeDepth() to sort back to front. Returns 0 if
+// max_depth is not positive.
+uint16_t QuantizeDepth(float depth, float max_depth);
+
+constexpr uint16_t DEPTH_MASK = 0xFFFF;
+
+}  // namespace sort_key
+
+// Everything needed to replay one draw. Plain data, so the buffer can be
+// filled from any thread and replayed on any backend.
+struct DrawPacket {
+    uint32_t shader;
+    uint32_t material;
+    uint32_t mesh;
+    uint32_t object_constants;
+    uint32_t index_count;
+    uint32_t index_offset;
+    int32_t vertex_offset;
+};
+
+struct SortEntry {
+    uint64_t key;
+    uint32_t packet_index;
+};
+
+// Stable LSD radix sort on the keys, one byte per pass. Passes where every
+// key has the same byte are skipped. Small arrays fall back to
+// std::stable_sort. `scratch` is resized as needed.
+void RadixSort(std::vector<SortEntry>* entries,
+               std::vector<SortEntry>* scratch);
+
+// Draws recorded as packets plus sort keys. The keys are sorted separately
+// from the packets, so sorting only moves 16 bytes per draw.
+class CommandBuffer
+{
+   public:
+    CommandBuffer() = default;
+    ~CommandBuffer() = default;
+
+    // Drops the commands but keeps the memory for the next frame
+    void Reset();
+
+    void Reserve(size_t command_count);
+
+    void AddDraw(uint64_t sort_key, const DrawPacket& packet);
+
+    // Orders the commands by key. Draws with the same key keep the order
+    // they were recorded in.
+    void Sort();
+
+    // Replaces the commands with the merge of `buffer_count` sorted buffers.
+    // Draws with the same key keep the order of the buffers, so merging
+    // buffers recorded over consecutive slices of a draw list gives the same
+    // order as recording and sorting the whole list in one buffer.
+    void MergeSorted(const CommandBuffer* buffers, size_t buffer_count);
+
+    // Replays the commands in their current order, skipping binds of the
+    // state set by the previous command.
+    void Submit(RenderBackend* backend) const;
+
+    // Replays the commands [begin, end). The first command binds all its
+    // state, so ranges can be replayed on separate backend command lists.
+    void Submit(RenderBackend* backend, size_t begin, size_t end) const;
+
+    inline size_t command_count() const { return entries_.size(); }
+
+    inline const std::vector<SortEntry>& entries() const { return entries_; }
+
+    inline const DrawPacket& GetPacket(const SortEntry& entry) const
+    {
+        return packets_[entry.packet_index];
+    }
+
+   private:
+    std::vector<DrawPacket> packets_;
+    std::vector<SortEntry> entries_;
+    std::vector<SortEntry> scratch_;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_COMMAND_BUFFER_H_
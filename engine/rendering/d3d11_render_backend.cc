@@ -0,0 +1,142 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/d3d11_render_backend.h"
+
+#include "rendering/d3d11_state_cache.h"
+#include "rendering/shader.h"
+#include "rendering/shader_builder.h"
+#include "utils/macros.h"
+
+namespace tamarindo
+{
+
+D3D11RenderBackend::D3D11RenderBackend(
+    D3D11StateCache* state_cache, const GeometryHeapParams& geometry_params,
+    const UploadManagerParams& upload_params)
+    : state_cache_(state_cache),
+      upload_manager_(upload_params),
+      geometry_heap_(geometry_params, &upload_manager_)
+{
+    TM_ASSERT(state_cache_);
+    // Maps the first staging region
+    upload_manager_.Flush(state_cache_->device_context());
+}
+
+D3D11RenderBackend::~D3D11RenderBackend() = default;
+
+uint32_t D3D11RenderBackend::CreateShader(const std::string& source)
+{
+    std::unique_ptr<Shader> shader = ShaderBuilder::CompilePosUvShader(source);
+    if (!shader) {
+        return INVALID_HANDLE;
+    }
+    shaders_.push_back(std::move(shader));
+    return static_cast<uint32_t>(shaders_.size() - 1);
+}
+
+uint32_t D3D11RenderBackend::CreateMesh(
+    const std::vector<float>& vertex_data,
+    const std::vector<unsigned int>& index_data)
+{
+    return CreateMesh(vertex_data, index_data, /*is_synchronous=*/false);
+}
+
+uint32_t D3D11RenderBackend::CreateMesh(
+    const std::vector<float>& vertex_data,
+    const std::vector<unsigned int>& index_data, bool is_synchronous)
+{
+    TM_ASSERT(geometry_heap_.vertex_stride() ==
+              MESH_VERTEX_FLOAT_COUNT * sizeof(float));
+    const uint32_t mesh = geometry_heap_.Allocate(
+        state_cache_->device_context(), vertex_data.data(),
+        static_cast<UINT>(vertex_data.size() / MESH_VERTEX_FLOAT_COUNT),
+        index_data.data(), static_cast<UINT>(index_data.size()),
+        is_synchronous);
+    return mesh == GeometryHeap::INVALID_MESH ? INVALID_HANDLE : mesh;
+}
+
+void D3D11RenderBackend::ReleaseMesh(uint32_t mesh)
+{
+    geometry_heap_.Free(mesh);
+}
+
+void D3D11RenderBackend::FlushUploads()
+{
+    upload_manager_.Flush(state_cache_->device_context());
+    // The region mapped by the flush is empty, queued data goes first
+    geometry_heap_.RetryQueuedUploads();
+}
+
+void D3D11RenderBackend::CompactGeometry(uint64_t max_bytes)
+{
+    geometry_heap_.Compact(state_cache_->device_context(), max_bytes);
+}
+
+void D3D11RenderBackend::SetObjectConstantBuffer(ID3D11Buffer* buffer,
+                                                 UINT constant_count)
+{
+    object_constant_buffer_ = buffer;
+    object_constant_count_ = constant_count;
+}
+
+void D3D11RenderBackend::BindShader(uint32_t shader)
+{
+    TM_ASSERT(shader < shaders_.size());
+    const Shader* s = shaders_[shader].get();
+    state_cache_->SetInputLayout(&s->input_layout());
+    state_cache_->SetVertexShader(&s->vertex_shader());
+    state_cache_->SetPixelShader(&s->pixel_shader());
+}
+
+void D3D11RenderBackend::BindMaterial(uint32_t /*material*/)
+{
+    // The D3D11 path has no materials yet, the shader outputs the UVs
+}
+
+void D3D11RenderBackend::BindMesh(uint32_t mesh)
+{
+    // Only the first mesh of the frame reaches the context, the rest bind
+    // the same buffers
+    state_cache_->SetVertexBuffer(0, geometry_heap_.vertex_buffer(),
+                                  geometry_heap_.vertex_stride(), 0);
+    state_cache_->SetIndexBuffer(geometry_heap_.index_buffer(),
+                                 DXGI_FORMAT_R32_UINT, 0);
+    bound_range_ = geometry_heap_.range(mesh);
+    is_bound_mesh_drawable_ = geometry_heap_.IsDrawable(mesh);
+}
+
+void D3D11RenderBackend::BindObjectConstants(uint32_t constants)
+{
+    TM_ASSERT(object_constant_buffer_);
+    state_cache_->SetVSConstantBufferRange(OBJECT_CONSTANTS_SLOT,
+                                           object_constant_buffer_, constants,
+                                           object_constant_count_);
+}
+
+void D3D11RenderBackend::DrawIndexed(uint32_t index_count,
+                                     uint32_t index_offset,
+                                     int32_t vertex_offset)
+{
+    if (!is_bound_mesh_drawable_) {
+        return;
+    }
+    state_cache_->device_context()->DrawIndexed(
+        index_count, bound_range_.first_index + index_offset,
+        static_cast<INT>(bound_range_.first_vertex) + vertex_offset);
+}
+
+}  // namespace tamarindo
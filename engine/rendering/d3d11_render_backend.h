@@ -0,0 +1,110 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_D3D11_RENDER_BACKEND_H_
+#define ENGINE_LIB_RENDERING_D3D11_RENDER_BACKEND_H_
+
+#include "rendering/geometry_heap.h"
+#include "rendering/render_backend.h"
+#include "rendering/upload_manager.h"
+
+#include <d3d11.h>
+
+#include <memory>
+#include <vector>
+
+namespace tamarindo
+{
+
+class D3D11StateCache;
+class Shader;
+
+// Replays command buffers on a D3D11 device context, through a state cache
+// that drops the binds the command buffer could not see were redundant,
+// like state left bound by the previous frame. The backend owns the shaders
+// and meshes it creates. Object constant handles are offsets, in 16 byte
+// constants, into the buffer set with SetObjectConstantBuffer().
+//
+// Meshes are ranges of a GeometryHeap, so every mesh binds the same vertex
+// and index buffers and draws add the base offsets of the bound mesh. Their
+// data is staged in an UploadManager and copied at the next FlushUploads(),
+// or at later ones past the upload budget; draws of a mesh whose data has
+// not landed are skipped.
+class D3D11RenderBackend : public RenderBackend
+{
+   public:
+    // Constant buffer slot the object constants are bound to
+    static constexpr UINT OBJECT_CONSTANTS_SLOT = 1;
+
+    D3D11RenderBackend() = delete;
+    D3D11RenderBackend(D3D11StateCache* state_cache,
+                       const GeometryHeapParams& geometry_params,
+                       const UploadManagerParams& upload_params);
+    ~D3D11RenderBackend() override;
+
+    uint32_t CreateShader(const std::string& source) override;
+    uint32_t CreateMesh(const std::vector<float>& vertex_data,
+                        const std::vector<unsigned int>& index_data) override;
+    // With `is_synchronous` the data is copied right away instead of going
+    // through the upload budget, for meshes loaded at startup
+    uint32_t CreateMesh(const std::vector<float>& vertex_data,
+                        const std::vector<unsigned int>& index_data,
+                        bool is_synchronous);
+
+    // The handle can be handed out again by CreateMesh()
+    void ReleaseMesh(uint32_t mesh);
+
+    // Copies the data of the meshes created since the last call, up to the
+    // upload budget, and stages what went over it for the next call. Call
+    // it once per frame, before submitting the draws.
+    void FlushUploads();
+
+    // Moves meshes to close the holes left by released ones, copying about
+    // `max_bytes` at most. Call it between frames to spread the copies.
+    void CompactGeometry(uint64_t max_bytes);
+
+    // Buffer the object constants are bound from, `constant_count`
+    // constants at a time. Usually the frame constant allocator buffer.
+    void SetObjectConstantBuffer(ID3D11Buffer* buffer, UINT constant_count);
+
+    void BindShader(uint32_t shader) override;
+    void BindMaterial(uint32_t material) override;
+    void BindMesh(uint32_t mesh) override;
+    void BindObjectConstants(uint32_t constants) override;
+    void DrawIndexed(uint32_t index_count, uint32_t index_offset,
+                     int32_t vertex_offset) override;
+
+    inline const GeometryHeap& geometry_heap() const { return geometry_heap_; }
+    inline UploadManager* upload_manager() { return &upload_manager_; }
+
+   private:
+    D3D11StateCache* state_cache_;
+
+    std::vector<std::unique_ptr<Shader>> shaders_;
+    // Declared before the heap, which uploads through it
+    UploadManager upload_manager_;
+    GeometryHeap geometry_heap_;
+    // Range of the bound mesh, added to the draw offsets
+    GeometryRange bound_range_;
+    bool is_bound_mesh_drawable_ = false;
+
+    ID3D11Buffer* object_constant_buffer_ = nullptr;
+    UINT object_constant_count_ = 0;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_D3D11_RENDER_BACKEND_H_
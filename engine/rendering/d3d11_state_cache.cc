@@ -0,0 +1,145 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/d3d11_state_cache.h"
+
+#include "logging/logger.h"
+#include "utils/macros.h"
+
+namespace tamarindo
+{
+
+D3D11StateCache::D3D11StateCache(ID3D11DeviceContext* device_context)
+    : device_context_(device_context)
+{
+    TM_ASSERT(device_context_);
+    HRESULT hr = device_context_->QueryInterface(
+        IID_PPV_ARGS(device_context1_.GetAddressOf()));
+    if (FAILED(hr)) {
+        TM_LOG_ERROR("D3D11.1 device context is not available. Error: {}",
+                     hr);
+    }
+}
+
+bool D3D11StateCache::ShouldBind(uint32_t state_bit, bool is_same)
+{
+    if ((valid_mask_ & state_bit) && is_same) {
+        ++stats_.filtered_count;
+        return false;
+    }
+    valid_mask_ |= state_bit;
+    ++stats_.bind_count;
+    return true;
+}
+
+void D3D11StateCache::SetInputLayout(ID3D11InputLayout* input_layout)
+{
+    if (ShouldBind(INPUT_LAYOUT_BIT, input_layout == input_layout_)) {
+        input_layout_ = input_layout;
+        device_context_->IASetInputLayout(input_layout);
+    }
+}
+
+void D3D11StateCache::SetVertexShader(ID3D11VertexShader* vertex_shader)
+{
+    if (ShouldBind(VERTEX_SHADER_BIT, vertex_shader == vertex_shader_)) {
+        vertex_shader_ = vertex_shader;
+        device_context_->VSSetShader(vertex_shader, nullptr, 0);
+    }
+}
+
+void D3D11StateCache::SetPixelShader(ID3D11PixelShader* pixel_shader)
+{
+    if (ShouldBind(PIXEL_SHADER_BIT, pixel_shader == pixel_shader_)) {
+        pixel_shader_ = pixel_shader;
+        device_context_->PSSetShader(pixel_shader, nullptr, 0);
+    }
+}
+
+void D3D11StateCache::SetVertexBuffer(UINT slot, ID3D11Buffer* buffer,
+                                      UINT stride, UINT offset)
+{
+    if (slot < TRACKED_SLOT_COUNT) {
+        VertexBufferBinding& binding = vertex_buffers_[slot];
+        const bool is_same = binding.buffer == buffer &&
+                             binding.stride == stride &&
+                             binding.offset == offset;
+        if (!ShouldBind(VERTEX_BUFFER_BITS << slot, is_same)) {
+            return;
+        }
+        binding = VertexBufferBinding{buffer, stride, offset};
+    } else {
+        ++stats_.bind_count;
+    }
+    device_context_->IASetVertexBuffers(slot, 1, &buffer, &stride, &offset);
+}
+
+void D3D11StateCache::SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format,
+                                     UINT offset)
+{
+    const bool is_same = index_buffer_ == buffer && index_format_ == format &&
+                         index_offset_ == offset;
+    if (ShouldBind(INDEX_BUFFER_BIT, is_same)) {
+        index_buffer_ = buffer;
+        index_format_ = format;
+        index_offset_ = offset;
+        device_context_->IASetIndexBuffer(buffer, format, offset);
+    }
+}
+
+void D3D11StateCache::SetVSConstantBuffer(UINT slot, ID3D11Buffer* buffer)
+{
+    if (slot < TRACKED_SLOT_COUNT) {
+        ConstantBufferBinding& binding = vs_constant_buffers_[slot];
+        const bool is_same = binding.buffer == buffer &&
+                             binding.first_constant == 0 &&
+                             binding.constant_count == 0;
+        if (!ShouldBind(VS_CONSTANT_BUFFER_BITS << slot, is_same)) {
+            return;
+        }
+        binding = ConstantBufferBinding{buffer, 0, 0};
+    } else {
+        ++stats_.bind_count;
+    }
+    device_context_->VSSetConstantBuffers(slot, 1, &buffer);
+}
+
+void D3D11StateCache::SetVSConstantBufferRange(UINT slot, ID3D11Buffer* buffer,
+                                               UINT first_constant,
+                                               UINT constant_count)
+{
+    TM_ASSERT(device_context1_);
+    if (slot < TRACKED_SLOT_COUNT) {
+        ConstantBufferBinding& binding = vs_constant_buffers_[slot];
+        const bool is_same = binding.buffer == buffer &&
+                             binding.first_constant == first_constant &&
+                             binding.constant_count == constant_count;
+        if (!ShouldBind(VS_CONSTANT_BUFFER_BITS << slot, is_same)) {
+            return;
+        }
+        binding = ConstantBufferBinding{buffer, first_constant, constant_count};
+    } else {
+        ++stats_.bind_count;
+    }
+    device_context1_->VSSetConstantBuffers1(slot, 1, &buffer, &first_constant,
+                                            &constant_count);
+}
+
+void D3D11StateCache::Invalidate() { valid_mask_ = 0; }
+
+void D3D11StateCache::ResetStats() { stats_ = StateCacheStats(); }
+
+}  // namespace tamarindo
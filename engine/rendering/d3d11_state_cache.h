@@ -0,0 +1,142 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_D3D11_STATE_CACHE_H_
+#define ENGINE_LIB_RENDERING_D3D11_STATE_CACHE_H_
+
+#include <d3d11_1.h>
+#include <wrl/client.h>
+
+#include <array>
+#include <cstdint>
+
+namespace tamarindo
+{
+
+namespace wrl = Microsoft::WRL;
+
+struct StateCacheStats {
+    // Calls that reached the device context
+    unsigned int bind_count = 0;
+    // Calls dropped because the state was already bound
+    unsigned int filtered_count = 0;
+};
+
+// Shadows the pipeline state bound on a device context and drops the binds
+// that would not change it. Comparing raw pointers is safe because the
+// context keeps a reference to everything bound, so a bound object can not
+// be freed and its address reused.
+class D3D11StateCache
+{
+   public:
+    // Vertex buffer and constant buffer slots that are tracked. Binds to
+    // higher slots always go through.
+    static constexpr UINT TRACKED_SLOT_COUNT = 4;
+
+    D3D11StateCache() = delete;
+    explicit D3D11StateCache(ID3D11DeviceContext* device_context);
+    ~D3D11StateCache() = default;
+
+    D3D11StateCache(const D3D11StateCache& other) = delete;
+    D3D11StateCache& operator=(const D3D11StateCache& other) = delete;
+
+    void SetInputLayout(ID3D11InputLayout* input_layout);
+    void SetVertexShader(ID3D11VertexShader* vertex_shader);
+    void SetPixelShader(ID3D11PixelShader* pixel_shader);
+
+    void SetVertexBuffer(UINT slot, ID3D11Buffer* buffer, UINT stride,
+                         UINT offset);
+    void SetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format,
+                        UINT offset);
+
+    // Binds the whole buffer
+    void SetVSConstantBuffer(UINT slot, ID3D11Buffer* buffer);
+    // Binds `constant_count` 16 byte constants starting at `first_constant`.
+    // Needs a D3D11.1 context.
+    void SetVSConstantBufferRange(UINT slot, ID3D11Buffer* buffer,
+                                  UINT first_constant, UINT constant_count);
+
+    // Forgets the shadowed state. Call it after binding on the context
+    // without going through the cache, or after ClearState().
+    void Invalidate();
+
+    void ResetStats();
+
+    inline const StateCacheStats& stats() const { return stats_; }
+
+    inline ID3D11DeviceContext* device_context() const
+    {
+        return device_context_;
+    }
+
+    inline bool SupportsConstantBufferRanges() const
+    {
+        return device_context1_ != nullptr;
+    }
+
+   private:
+    struct VertexBufferBinding {
+        ID3D11Buffer* buffer;
+        UINT stride;
+        UINT offset;
+    };
+
+    struct ConstantBufferBinding {
+        ID3D11Buffer* buffer;
+        // Both zero when the whole buffer is bound
+        UINT first_constant;
+        UINT constant_count;
+    };
+
+    // Bits of valid_mask_, one per shadowed binding
+    enum StateBit : uint32_t {
+        INPUT_LAYOUT_BIT = 1 << 0,
+        VERTEX_SHADER_BIT = 1 << 1,
+        PIXEL_SHADER_BIT = 1 << 2,
+        INDEX_BUFFER_BIT = 1 << 3,
+        // TRACKED_SLOT_COUNT bits each
+        VERTEX_BUFFER_BITS = 1 << 4,
+        VS_CONSTANT_BUFFER_BITS = VERTEX_BUFFER_BITS << TRACKED_SLOT_COUNT,
+    };
+
+    // Counts the bind and returns true if it has to reach the context. A
+    // binding is only redundant if its shadow is valid.
+    bool ShouldBind(uint32_t state_bit, bool is_same);
+
+    ID3D11DeviceContext* device_context_;
+    wrl::ComPtr<ID3D11DeviceContext1> device_context1_;
+
+    // Bindings whose shadow matches the context
+    uint32_t valid_mask_ = 0;
+
+    ID3D11InputLayout* input_layout_ = nullptr;
+    ID3D11VertexShader* vertex_shader_ = nullptr;
+    ID3D11PixelShader* pixel_shader_ = nullptr;
+
+    std::array<VertexBufferBinding, TRACKED_SLOT_COUNT> vertex_buffers_ = {};
+    ID3D11Buffer* index_buffer_ = nullptr;
+    DXGI_FORMAT index_format_ = DXGI_FORMAT_UNKNOWN;
+    UINT index_offset_ = 0;
+
+    std::array<ConstantBufferBinding, TRACKED_SLOT_COUNT> vs_constant_buffers_ =
+        {};
+
+    StateCacheStats stats_;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_D3D11_STATE_CACHE_H_
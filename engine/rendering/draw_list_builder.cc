@@ -0,0 +1,78 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/draw_list_builder.h"
+
+#include "utils/macros.h"
+
+namespace tamarindo
+{
+
+DrawListBuilder::DrawListBuilder(const DrawListBuilderParams& params)
+    : occlusion_culler_(params.occlusion), lod_selector_(params.lod)
+{
+}
+
+unsigned int DrawListBuilder::AddDraw(const DirectX::BoundingBox& local_bounds,
+                                      const std::vector<LodLevel>& levels,
+                                      const OccluderGeometry* occluder)
+{
+    const unsigned int draw_id = frustum_culler_.AddBox(local_bounds);
+    lod_selector_.AddObject(levels);
+    TM_ASSERT(lod_selector_.object_count() == draw_id + 1 &&
+              occluders_.size() == draw_id);
+    occluders_.push_back(occluder != nullptr ? *occluder : OccluderGeometry());
+    return draw_id;
+}
+
+void DrawListBuilder::Build(
+    const DrawListView& view,
+    const std::vector<DirectX::XMMATRIX>& world_matrices,
+    const std::vector<DirectX::BoundingBox>& world_bounds,
+    std::vector<unsigned int>* visible_draws)
+{
+    TM_ASSERT(world_matrices.size() == occluders_.size() &&
+              world_bounds.size() == occluders_.size());
+    for (unsigned int draw_id = 0; draw_id < occluders_.size(); ++draw_id) {
+        frustum_culler_.SetBox(draw_id, world_bounds[draw_id]);
+
+        DirectX::BoundingSphere world_sphere;
+        DirectX::BoundingSphere::CreateFromBoundingBox(world_sphere,
+                                                       world_bounds[draw_id]);
+        lod_selector_.SetBounds(draw_id, world_sphere);
+    }
+
+    frustum_culler_.Cull(view.view_proj, visible_draws);
+
+    // Occluders outside the frustum can not hide anything inside it
+    occlusion_culler_.BeginFrame(view.view_proj);
+    for (const unsigned int draw_id : *visible_draws) {
+        const OccluderGeometry& occluder = occluders_[draw_id];
+        if (occluder.index_count == 0) {
+            continue;
+        }
+        occlusion_culler_.RenderOccluder(
+            occluder.vertices, occluder.vertex_stride, occluder.indices,
+            occluder.index_count, world_matrices[draw_id]);
+    }
+    occlusion_culler_.Cull(world_bounds, visible_draws);
+
+    lod_selector_.SetCamera(view.eye_position, view.fov_angle_in_radians,
+                            view.viewport_height);
+    lod_selector_.SelectLevels();
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,108 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_DRAW_LIST_BUILDER_H_
+#define ENGINE_LIB_RENDERING_DRAW_LIST_BUILDER_H_
+
+#include "rendering/frustum_culler.h"
+#include "rendering/lod_selector.h"
+#include "rendering/occlusion_culler.h"
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include <vector>
+
+namespace tamarindo
+{
+
+struct DrawListBuilderParams {
+    OcclusionCullerParams occlusion;
+    LodSelectorParams lod;
+};
+
+// Camera the draw list is built for
+struct DrawListView {
+    DirectX::XMMATRIX view_proj;
+    DirectX::XMFLOAT3 eye_position;
+    float fov_angle_in_radians;
+    float viewport_height;
+};
+
+// Triangles an occluder rasterizes into the occlusion culler, usually its
+// coarsest level. Positions are the first three floats of every vertex.
+struct OccluderGeometry {
+    const float* vertices = nullptr;
+    unsigned int vertex_stride = 0;
+    const unsigned int* indices = nullptr;
+    unsigned int index_count = 0;
+};
+
+// CPU side of a frame before the draws are recorded: frustum culling, then
+// occlusion culling against the occluders that passed it, then the level of
+// detail selection. The editor and the headless frame benchmark both run
+// this step, so the benchmark measures the same work as a frame.
+class DrawListBuilder
+{
+   public:
+    DrawListBuilder() = delete;
+    explicit DrawListBuilder(const DrawListBuilderParams& params);
+    ~DrawListBuilder() = default;
+
+    DrawListBuilder(const DrawListBuilder& other) = delete;
+    DrawListBuilder& operator=(const DrawListBuilder& other) = delete;
+
+    // `levels` go from the most to the least detailed, see LodSelector. With
+    // `occluder` the draw also hides what is behind it, its data must
+    // outlive the builder. Returns the draw id, counting up from zero.
+    unsigned int AddDraw(const DirectX::BoundingBox& local_bounds,
+                         const std::vector<LodLevel>& levels,
+                         const OccluderGeometry* occluder);
+
+    // Replaces the contents of `visible_draws` with the ids of the draws
+    // that pass frustum and occlusion culling, and selects the level of
+    // every draw. `world_matrices` and `world_bounds` are indexed by draw id.
+    void Build(const DrawListView& view,
+               const std::vector<DirectX::XMMATRIX>& world_matrices,
+               const std::vector<DirectX::BoundingBox>& world_bounds,
+               std::vector<unsigned int>* visible_draws);
+
+    inline const LodLevel& GetSelectedLevel(unsigned int draw_id) const
+    {
+        return lod_selector_.GetSelectedLevel(draw_id);
+    }
+
+    inline const OcclusionCullerStats& occlusion_stats() const
+    {
+        return occlusion_culler_.stats();
+    }
+
+    inline unsigned int draw_count() const
+    {
+        return frustum_culler_.volume_count();
+    }
+
+   private:
+    FrustumCuller frustum_culler_;
+    OcclusionCuller occlusion_culler_;
+    LodSelector lod_selector_;
+    // Indexed by draw id, no indices for the draws that are not occluders
+    std::vector<OccluderGeometry> occluders_;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_DRAW_LIST_BUILDER_H_
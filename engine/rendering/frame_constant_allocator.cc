@@ -0,0 +1,163 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/frame_constant_allocator.h"
+
+#include "logging/logger.h"
+#include "rendering/render_state.h"
+#include "utils/macros.h"
+
+#include <d3d11_1.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+constexpr UINT CONSTANT_SIZE = 16;
+
+inline UINT AlignUp(UINT value, UINT alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+}  // namespace
+
+bool FrameConstantAllocator::IsSupported(ID3D11Device* device)
+{
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+    if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS,
+                                           &options, sizeof(options)))) {
+        return false;
+    }
+    return options.ConstantBufferOffsetting == TRUE;
+}
+
+FrameConstantAllocator::FrameConstantAllocator(
+    const FrameConstantAllocatorParams& params)
+{
+    const UINT size = AlignUp(params.size_in_bytes, ALIGNMENT);
+    buffer_ = CreateBuffer(size);
+    if (buffer_) {
+        size_ = size;
+    }
+}
+
+/*static*/ wrl::ComPtr<ID3D11Buffer> FrameConstantAllocator::CreateBuffer(
+    UINT size_in_bytes)
+{
+    D3D11_BUFFER_DESC buffer_desc;
+    buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+    buffer_desc.ByteWidth = size_in_bytes;
+    buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    buffer_desc.MiscFlags = 0;
+    buffer_desc.StructureByteStride = 0;
+
+    wrl::ComPtr<ID3D11Buffer> buffer;
+    HRESULT hr =
+        g_Device->CreateBuffer(&buffer_desc, nullptr, buffer.GetAddressOf());
+    if (FAILED(hr)) {
+        TM_LOG_ERROR("Could not create frame constant buffer. Error: {}", hr);
+        return nullptr;
+    }
+    return buffer;
+}
+
+bool FrameConstantAllocator::BeginFrame(ID3D11DeviceContext* device_context)
+{
+    TM_ASSERT(mapped_data_ == nullptr);
+    offset_ = 0;
+    if (!buffer_) {
+        return false;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped_res;
+    HRESULT hr = device_context->Map(buffer_.Get(), 0, D3D11_MAP_WRITE_DISCARD,
+                                     0, &mapped_res);
+    if (FAILED(hr)) {
+        TM_LOG_ERROR("Could not map frame constant buffer. Error: {}", hr);
+        return false;
+    }
+    mapped_data_ = static_cast<uint8_t*>(mapped_res.pData);
+    return true;
+}
+
+bool FrameConstantAllocator::Allocate(ID3D11DeviceContext* device_context,
+                                      UINT element_size, UINT element_count,
+                                      ConstantAllocation* allocation)
+{
+    const UINT stride = AlignUp(element_size, ALIGNMENT);
+    const UINT size = stride * element_count;
+    if (mapped_data_ == nullptr) {
+        return false;
+    }
+    if (offset_ + size > size_ && !Grow(device_context, offset_ + size)) {
+        return false;
+    }
+
+    allocation->data = mapped_data_ + offset_;
+    allocation->first_constant = offset_ / CONSTANT_SIZE;
+    allocation->constant_stride = stride / CONSTANT_SIZE;
+    offset_ += size;
+    return true;
+}
+
+bool FrameConstantAllocator::Grow(ID3D11DeviceContext* device_context,
+                                  UINT min_size)
+{
+    UINT new_size = std::max(size_ * 2, ALIGNMENT);
+    while (new_size < min_size) {
+        new_size *= 2;
+    }
+    wrl::ComPtr<ID3D11Buffer> new_buffer = CreateBuffer(new_size);
+    if (!new_buffer) {
+        return false;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped_res;
+    HRESULT hr = device_context->Map(new_buffer.Get(), 0,
+                                     D3D11_MAP_WRITE_DISCARD, 0, &mapped_res);
+    if (FAILED(hr)) {
+        TM_LOG_ERROR("Could not map frame constant buffer. Error: {}", hr);
+        return false;
+    }
+
+    TM_LOG_INFO("Growing frame constant buffer from {} to {} bytes", size_,
+                new_size);
+    // The old buffer is write-only while mapped, so its contents can not be
+    // carried over
+    device_context->Unmap(buffer_.Get(), 0);
+    buffer_ = std::move(new_buffer);
+    size_ = new_size;
+    mapped_data_ = static_cast<uint8_t*>(mapped_res.pData);
+    return true;
+}
+
+void FrameConstantAllocator::EndFrame(ID3D11DeviceContext* device_context)
+{
+    if (mapped_data_ == nullptr) {
+        return;
+    }
+    device_context->Unmap(buffer_.Get(), 0);
+    mapped_data_ = nullptr;
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,110 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_FRAME_CONSTANT_ALLOCATOR_H_
+#define ENGINE_LIB_RENDERING_FRAME_CONSTANT_ALLOCATOR_H_
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include <cstdint>
+
+namespace tamarindo
+{
+
+namespace wrl = Microsoft::WRL;
+
+struct FrameConstantAllocatorParams {
+    // Initial size of the buffer. It grows when an allocation does not fit.
+    unsigned int size_in_bytes = 1 << 20;
+};
+
+// Array of elements in the frame constant buffer. Every element starts at a
+// 256 byte boundary, so it can be bound on its own with
+// VSSetConstantBuffers1.
+struct ConstantAllocation {
+    uint8_t* data;
+    // Offset of the first element, in 16 byte shader constants
+    UINT first_constant;
+    // Distance between elements, in 16 byte shader constants
+    UINT constant_stride;
+
+    inline void* GetElement(UINT index) const
+    {
+        return data + index * constant_stride * 16;
+    }
+
+    inline UINT GetFirstConstant(UINT index) const
+    {
+        return first_constant + index * constant_stride;
+    }
+};
+
+// Linear allocator for per-draw constants. One dynamic constant buffer is
+// mapped once per frame and suballocated, so draws are bound by offset
+// instead of mapping and renaming a buffer each.
+class FrameConstantAllocator
+{
+   public:
+    // Binding offsets must be multiples of 16 constants
+    static constexpr UINT ALIGNMENT = 256;
+
+    // Constant buffer offsetting needs D3D11.1 and driver support
+    static bool IsSupported(ID3D11Device* device);
+
+    FrameConstantAllocator() = delete;
+    explicit FrameConstantAllocator(const FrameConstantAllocatorParams& params);
+    ~FrameConstantAllocator() = default;
+
+    FrameConstantAllocator(const FrameConstantAllocator& other) = delete;
+    FrameConstantAllocator& operator=(const FrameConstantAllocator& other) =
+        delete;
+
+    // Maps the buffer with WRITE_DISCARD. Allocations of the previous frame
+    // become invalid.
+    bool BeginFrame(ID3D11DeviceContext* device_context);
+
+    // If the buffer is out of space, it is replaced by a larger one mapped
+    // in its place. Earlier allocations of the frame keep their offsets but
+    // not what was written to them, so fill the allocations once the frame
+    // made all of them. Returns false, and leaves the allocation untouched,
+    // if the buffer is not mapped or could not grow.
+    bool Allocate(ID3D11DeviceContext* device_context, UINT element_size,
+                  UINT element_count, ConstantAllocation* allocation);
+
+    // Unmaps the buffer, must happen before any draw reading it
+    void EndFrame(ID3D11DeviceContext* device_context);
+
+    inline ID3D11Buffer* buffer() const { return buffer_.Get(); }
+    inline UINT used_bytes() const { return offset_; }
+
+   private:
+    static wrl::ComPtr<ID3D11Buffer> CreateBuffer(UINT size_in_bytes);
+
+    // Replaces the mapped buffer with a mapped one of at least `min_size`
+    // bytes
+    bool Grow(ID3D11DeviceContext* device_context, UINT min_size);
+
+    wrl::ComPtr<ID3D11Buffer> buffer_;
+    UINT size_ = 0;
+
+    uint8_t* mapped_data_ = nullptr;
+    UINT offset_ = 0;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_FRAME_CONSTANT_ALLOCATOR_H_
@@ -0,0 +1,411 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/frustum_culler.h"
+
+#include "utils/cpu_features.h"
+#include "utils/macros.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+#ifdef TM_CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace tamarindo
+{
+
+namespace
+{
+
+using VolumeBlock = FrustumCuller::VolumeBlock;
+constexpr unsigned int BLOCK_SIZE = FrustumCuller::BLOCK_SIZE;
+
+// Unused lanes get a huge negative radius, so they are outside of every
+// plane and the kernels never need to mask the last block.
+constexpr float UNUSED_LANE_RADIUS = -FLT_MAX;
+
+// Appends `base + lane` for every lane set in `visible_mask`. The store is
+// unconditional and only the cursor moves, which avoids a branch per lane.
+inline unsigned int* WriteVisibleLanes(unsigned int visible_mask,
+                                       unsigned int base, unsigned int* out)
+{
+    for (unsigned int lane = 0; lane < BLOCK_SIZE; ++lane) {
+        *out = base + lane;
+        out += (visible_mask >> lane) & 1;
+    }
+    return out;
+}
+
+unsigned int CullBlockScalar(const VolumeBlock& block,
+                             const FrustumPlanes& frustum)
+{
+    unsigned int visible_mask = 0;
+    for (unsigned int lane = 0; lane < BLOCK_SIZE; ++lane) {
+        bool is_visible = true;
+        for (const DirectX::XMFLOAT4& p : frustum.planes) {
+            const float distance = p.x * block.center_x[lane] +
+                                   p.y * block.center_y[lane] +
+                                   p.z * block.center_z[lane] + p.w;
+            const float radius = std::abs(p.x) * block.extent_x[lane] +
+                                 std::abs(p.y) * block.extent_y[lane] +
+                                 std::abs(p.z) * block.extent_z[lane] +
+                                 block.radius[lane];
+            if (distance + radius < 0.0f) {
+                is_visible = false;
+                break;
+            }
+        }
+        visible_mask |= static_cast<unsigned int>(is_visible) << lane;
+    }
+    return visible_mask;
+}
+
+#ifdef TM_CPU_X86
+
+// Planes splatted once per Cull() call instead of once per block
+struct alignas(32) SplatPlane {
+    float x[BLOCK_SIZE];
+    float y[BLOCK_SIZE];
+    float z[BLOCK_SIZE];
+    float w[BLOCK_SIZE];
+    float abs_x[BLOCK_SIZE];
+    float abs_y[BLOCK_SIZE];
+    float abs_z[BLOCK_SIZE];
+};
+
+using SplatFrustum = std::array<SplatPlane, FrustumPlanes::Count>;
+
+void SplatPlanes(const FrustumPlanes& frustum, SplatFrustum* out)
+{
+    for (int i = 0; i < FrustumPlanes::Count; ++i) {
+        const DirectX::XMFLOAT4& p = frustum.planes[i];
+        SplatPlane& s = (*out)[i];
+        for (unsigned int lane = 0; lane < BLOCK_SIZE; ++lane) {
+            s.x[lane] = p.x;
+            s.y[lane] = p.y;
+            s.z[lane] = p.z;
+            s.w[lane] = p.w;
+            s.abs_x[lane] = std::abs(p.x);
+            s.abs_y[lane] = std::abs(p.y);
+            s.abs_z[lane] = std::abs(p.z);
+        }
+    }
+}
+
+// Returns a 4-bit mask of the lanes in [offset, offset + 4) that are inside
+inline unsigned int CullHalfBlockSSE(const VolumeBlock& block,
+                                     const SplatFrustum& planes,
+                                     unsigned int offset)
+{
+    const __m128 cx = _mm_load_ps(block.center_x + offset);
+    const __m128 cy = _mm_load_ps(block.center_y + offset);
+    const __m128 cz = _mm_load_ps(block.center_z + offset);
+    const __m128 ex = _mm_load_ps(block.extent_x + offset);
+    const __m128 ey = _mm_load_ps(block.extent_y + offset);
+    const __m128 ez = _mm_load_ps(block.extent_z + offset);
+    const __m128 r = _mm_load_ps(block.radius + offset);
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 outside = zero;
+    for (const SplatPlane& p : planes) {
+        const __m128 distance = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_load_ps(p.x), cx),
+                       _mm_mul_ps(_mm_load_ps(p.y), cy)),
+            _mm_add_ps(_mm_mul_ps(_mm_load_ps(p.z), cz), _mm_load_ps(p.w)));
+        const __m128 radius = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_load_ps(p.abs_x), ex),
+                       _mm_mul_ps(_mm_load_ps(p.abs_y), ey)),
+            _mm_add_ps(_mm_mul_ps(_mm_load_ps(p.abs_z), ez), r));
+        outside = _mm_or_ps(
+            outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+    }
+    return ~static_cast<unsigned int>(_mm_movemask_ps(outside)) & 0xF;
+}
+
+unsigned int* CullSSE(const VolumeBlock* blocks, size_t block_count,
+                      const FrustumPlanes& frustum, unsigned int* out)
+{
+    SplatFrustum planes;
+    SplatPlanes(frustum, &planes);
+    for (size_t b = 0; b < block_count; ++b) {
+        const unsigned int visible_mask =
+            CullHalfBlockSSE(blocks[b], planes, 0) |
+            (CullHalfBlockSSE(blocks[b], planes, 4) << 4);
+        out = WriteVisibleLanes(visible_mask,
+                                static_cast<unsigned int>(b * BLOCK_SIZE), out);
+    }
+    return out;
+}
+
+// For every 8-bit lane mask, the visible lanes packed to the front as 3-bit
+// lane numbers, with the number of visible lanes in the top byte.
+struct CompactTable {
+    constexpr CompactTable() : entries()
+    {
+        for (uint32_t mask = 0; mask < 256; ++mask) {
+            uint32_t entry = 0;
+            uint32_t count = 0;
+            for (uint32_t lane = 0; lane < BLOCK_SIZE; ++lane) {
+                if ((mask >> lane) & 1) {
+                    entry |= lane << (3 * count);
+                    ++count;
+                }
+            }
+            entries[mask] = entry | (count << 24);
+        }
+    }
+
+    uint32_t entries[256];
+};
+
+constexpr CompactTable COMPACT_TABLE;
+
+TM_TARGET_AVX2 unsigned int* CullAVX2(const VolumeBlock* blocks,
+                                      size_t block_count,
+                                      const FrustumPlanes& frustum,
+                                      unsigned int* out)
+{
+    SplatFrustum planes;
+    SplatPlanes(frustum, &planes);
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256i lane_ids = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i lane_shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i lane_bits = _mm256_set1_epi32(7);
+
+    for (size_t b = 0; b < block_count; ++b) {
+        const VolumeBlock& block = blocks[b];
+        const __m256 cx = _mm256_load_ps(block.center_x);
+        const __m256 cy = _mm256_load_ps(block.center_y);
+        const __m256 cz = _mm256_load_ps(block.center_z);
+        const __m256 ex = _mm256_load_ps(block.extent_x);
+        const __m256 ey = _mm256_load_ps(block.extent_y);
+        const __m256 ez = _mm256_load_ps(block.extent_z);
+        const __m256 r = _mm256_load_ps(block.radius);
+
+        __m256 outside = zero;
+        for (const SplatPlane& p : planes) {
+            const __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(p.x), cx),
+                              _mm256_mul_ps(_mm256_load_ps(p.y), cy)),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(p.z), cz),
+                              _mm256_load_ps(p.w)));
+            const __m256 radius = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(p.abs_x), ex),
+                              _mm256_mul_ps(_mm256_load_ps(p.abs_y), ey)),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(p.abs_z), ez), r));
+            outside = _mm256_or_ps(
+                outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero,
+                                       _CMP_LT_OQ));
+        }
+
+        // Moves the visible ids to the front of the register and stores all
+        // eight, the cursor only advances past the visible ones.
+        const unsigned int visible_mask =
+            ~static_cast<unsigned int>(_mm256_movemask_ps(outside)) & 0xFF;
+        const uint32_t entry = COMPACT_TABLE.entries[visible_mask];
+        const __m256i permutation = _mm256_and_si256(
+            _mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(entry)),
+                              lane_shifts),
+            lane_bits);
+        const __m256i ids = _mm256_add_epi32(
+            _mm256_set1_epi32(static_cast<int>(b * BLOCK_SIZE)), lane_ids);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out),
+                            _mm256_permutevar8x32_epi32(ids, permutation));
+        out += entry >> 24;
+    }
+    return out;
+}
+
+#endif  // TM_CPU_X86
+
+FrustumCuller::Kernel DetectBestKernel()
+{
+#ifdef TM_CPU_X86
+    if (CpuSupportsAVX2()) {
+        return FrustumCuller::Kernel::AVX2;
+    }
+    // SSE2 is part of the x86-64 baseline
+    return FrustumCuller::Kernel::SSE;
+#else
+    return FrustumCuller::Kernel::Scalar;
+#endif
+}
+
+}  // namespace
+
+FrustumPlanes FrustumPlanes::FromMatrix(const DirectX::XMMATRIX& view_proj)
+{
+    using namespace DirectX;
+
+    // DirectXMath multiplies row vectors, so clip = v * M and every clip
+    // coordinate is the dot product of v with a column of M.
+    const XMMATRIX columns = XMMatrixTranspose(view_proj);
+    const XMVECTOR x = columns.r[0];
+    const XMVECTOR y = columns.r[1];
+    const XMVECTOR z = columns.r[2];
+    const XMVECTOR w = columns.r[3];
+
+    FrustumPlanes frustum;
+    XMStoreFloat4(&frustum.planes[Left], XMPlaneNormalize(XMVectorAdd(w, x)));
+    XMStoreFloat4(&frustum.planes[Right],
+                  XMPlaneNormalize(XMVectorSubtract(w, x)));
+    XMStoreFloat4(&frustum.planes[Bottom], XMPlaneNormalize(XMVectorAdd(w, y)));
+    XMStoreFloat4(&frustum.planes[Top],
+                  XMPlaneNormalize(XMVectorSubtract(w, y)));
+    XMStoreFloat4(&frustum.planes[Near], XMPlaneNormalize(z));
+    XMStoreFloat4(&frustum.planes[Far],
+                  XMPlaneNormalize(XMVectorSubtract(w, z)));
+    return frustum;
+}
+
+FrustumCuller::Kernel FrustumCuller::GetBestKernel()
+{
+    static const Kernel s_best_kernel = DetectBestKernel();
+    return s_best_kernel;
+}
+
+bool FrustumCuller::IsKernelSupported(Kernel kernel)
+{
+    return static_cast<int>(kernel) <= static_cast<int>(GetBestKernel());
+}
+
+const char* FrustumCuller::GetKernelName(Kernel kernel)
+{
+    switch (kernel) {
+        case Kernel::Scalar:
+            return "Scalar";
+        case Kernel::SSE:
+            return "SSE";
+        case Kernel::AVX2:
+            return "AVX2";
+    }
+    return "Unknown";
+}
+
+unsigned int FrustumCuller::AddBox(const DirectX::BoundingBox& box)
+{
+    const unsigned int id = AllocateVolume();
+    SetBox(id, box);
+    return id;
+}
+
+unsigned int FrustumCuller::AddSphere(const DirectX::BoundingSphere& sphere)
+{
+    const unsigned int id = AllocateVolume();
+    SetSphere(id, sphere);
+    return id;
+}
+
+void FrustumCuller::SetBox(unsigned int id, const DirectX::BoundingBox& box)
+{
+    SetVolume(id, box.Center, box.Extents, 0.0f);
+}
+
+void FrustumCuller::SetSphere(unsigned int id,
+                              const DirectX::BoundingSphere& sphere)
+{
+    SetVolume(id, sphere.Center, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f),
+              sphere.Radius);
+}
+
+void FrustumCuller::Clear()
+{
+    blocks_.clear();
+    volume_count_ = 0;
+}
+
+void FrustumCuller::Cull(const DirectX::XMMATRIX& view_proj,
+                         std::vector<unsigned int>* visible) const
+{
+    Cull(GetBestKernel(), FrustumPlanes::FromMatrix(view_proj), visible);
+}
+
+void FrustumCuller::Cull(const FrustumPlanes& frustum,
+                         std::vector<unsigned int>* visible) const
+{
+    Cull(GetBestKernel(), frustum, visible);
+}
+
+void FrustumCuller::Cull(Kernel kernel, const FrustumPlanes& frustum,
+                         std::vector<unsigned int>* visible) const
+{
+    TM_ASSERT(IsKernelSupported(kernel));
+
+    // The kernels write whole blocks and only keep the visible part, so the
+    // output needs room for every lane.
+    visible->resize(blocks_.size() * BLOCK_SIZE);
+    unsigned int* const begin = visible->data();
+    unsigned int* end = begin;
+
+    switch (kernel) {
+#ifdef TM_CPU_X86
+        case Kernel::AVX2:
+            end = CullAVX2(blocks_.data(), blocks_.size(), frustum, begin);
+            break;
+        case Kernel::SSE:
+            end = CullSSE(blocks_.data(), blocks_.size(), frustum, begin);
+            break;
+#endif
+        default:
+            for (size_t b = 0; b < blocks_.size(); ++b) {
+                end = WriteVisibleLanes(
+                    CullBlockScalar(blocks_[b], frustum),
+                    static_cast<unsigned int>(b * BLOCK_SIZE), end);
+            }
+            break;
+    }
+
+    visible->resize(end - begin);
+}
+
+unsigned int FrustumCuller::AllocateVolume()
+{
+    const unsigned int id = volume_count_++;
+    if (id % BLOCK_SIZE == 0) {
+        VolumeBlock& block = blocks_.emplace_back();
+        for (unsigned int lane = 0; lane < BLOCK_SIZE; ++lane) {
+            block.center_x[lane] = 0.0f;
+            block.center_y[lane] = 0.0f;
+            block.center_z[lane] = 0.0f;
+            block.extent_x[lane] = 0.0f;
+            block.extent_y[lane] = 0.0f;
+            block.extent_z[lane] = 0.0f;
+            block.radius[lane] = UNUSED_LANE_RADIUS;
+        }
+    }
+    return id;
+}
+
+void FrustumCuller::SetVolume(unsigned int id, const DirectX::XMFLOAT3& center,
+                              const DirectX::XMFLOAT3& extents, float radius)
+{
+    TM_ASSERT(id < volume_count_);
+    VolumeBlock& block = blocks_[id / BLOCK_SIZE];
+    const unsigned int lane = id % BLOCK_SIZE;
+    block.center_x[lane] = center.x;
+    block.center_y[lane] = center.y;
+    block.center_z[lane] = center.z;
+    block.extent_x[lane] = extents.x;
+    block.extent_y[lane] = extents.y;
+    block.extent_z[lane] = extents.z;
+    block.radius[lane] = radius;
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,108 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_FRUSTUM_CULLER_H_
+#define ENGINE_LIB_RENDERING_FRUSTUM_CULLER_H_
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include <array>
+#include <vector>
+
+namespace tamarindo
+{
+
+// Six planes stored as (normal, distance) with unit normals pointing inside.
+// A point p is inside a plane when dot(normal, p) + distance >= 0.
+struct FrustumPlanes {
+    enum Plane { Left = 0, Right, Bottom, Top, Near, Far, Count };
+
+    // Extracts the planes from any view-projection matrix with D3D clip space
+    // (0 <= z <= w), so it works for perspective and orthographic cameras.
+    static FrustumPlanes FromMatrix(const DirectX::XMMATRIX& view_proj);
+
+    std::array<DirectX::XMFLOAT4, Plane::Count> planes;
+};
+
+// Culls bounding volumes against a camera frustum. Boxes and spheres are
+// stored together in blocks of eight, one array per coordinate, so the SIMD
+// kernels test a whole block per plane. Volumes are conservative: a volume
+// is only rejected when it is fully outside one of the planes.
+class FrustumCuller
+{
+   public:
+    enum class Kernel { Scalar, SSE, AVX2 };
+
+    // Best kernel supported by the running CPU. Detected once at startup.
+    static Kernel GetBestKernel();
+
+    static bool IsKernelSupported(Kernel kernel);
+
+    static const char* GetKernelName(Kernel kernel);
+
+    FrustumCuller() = default;
+    ~FrustumCuller() = default;
+
+    // Returns the id reported by Cull() for this volume
+    unsigned int AddBox(const DirectX::BoundingBox& box);
+    unsigned int AddSphere(const DirectX::BoundingSphere& sphere);
+
+    void SetBox(unsigned int id, const DirectX::BoundingBox& box);
+    void SetSphere(unsigned int id, const DirectX::BoundingSphere& sphere);
+
+    void Clear();
+
+    inline unsigned int volume_count() const { return volume_count_; }
+
+    // Replaces the contents of `visible` with the ids of the volumes that are
+    // at least partially inside the frustum, in increasing order.
+    void Cull(const DirectX::XMMATRIX& view_proj,
+              std::vector<unsigned int>* visible) const;
+    void Cull(const FrustumPlanes& frustum,
+              std::vector<unsigned int>* visible) const;
+
+    // Same as above, forcing a specific kernel. The kernel must be supported.
+    void Cull(Kernel kernel, const FrustumPlanes& frustum,
+              std::vector<unsigned int>* visible) const;
+
+    static constexpr unsigned int BLOCK_SIZE = 8;
+
+    // A box has a zero radius and a sphere has zero extents, so both shapes
+    // share a single test: |n| . extents + radius against the plane distance.
+    struct alignas(32) VolumeBlock {
+        float center_x[BLOCK_SIZE];
+        float center_y[BLOCK_SIZE];
+        float center_z[BLOCK_SIZE];
+        float extent_x[BLOCK_SIZE];
+        float extent_y[BLOCK_SIZE];
+        float extent_z[BLOCK_SIZE];
+        float radius[BLOCK_SIZE];
+    };
+
+   private:
+    unsigned int AllocateVolume();
+
+    void SetVolume(unsigned int id, const DirectX::XMFLOAT3& center,
+                   const DirectX::XMFLOAT3& extents, float radius);
+
+    std::vector<VolumeBlock> blocks_;
+    unsigned int volume_count_ = 0;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_FRUSTUM_CULLER_H_
@@ -0,0 +1,467 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/geometry_heap.h"
+
+#include "logging/logger.h"
+#include "rendering/render_state.h"
+#include "rendering/upload_manager.h"
+#include "utils/macros.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+bool CreateBuffer(UINT size_in_bytes, UINT bind_flags,
+                  wrl::ComPtr<ID3D11Buffer>* buffer)
+{
+    D3D11_BUFFER_DESC buffer_desc;
+    buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+    buffer_desc.ByteWidth = size_in_bytes;
+    buffer_desc.BindFlags = bind_flags;
+    buffer_desc.CPUAccessFlags = 0;
+    buffer_desc.MiscFlags = 0;
+    buffer_desc.StructureByteStride = 0;
+
+    buffer->Reset();
+    HRESULT hr =
+        g_Device->CreateBuffer(&buffer_desc, nullptr, buffer->GetAddressOf());
+    if (FAILED(hr)) {
+        TM_LOG_ERROR("Could not create geometry buffer. Error: {}", hr);
+        return false;
+    }
+    return true;
+}
+
+inline D3D11_BOX BufferBox(UINT first_byte, UINT size_in_bytes)
+{
+    D3D11_BOX box;
+    box.left = first_byte;
+    box.right = first_byte + size_in_bytes;
+    box.top = 0;
+    box.bottom = 1;
+    box.front = 0;
+    box.back = 1;
+    return box;
+}
+
+}  // namespace
+
+GeometryHeap::Pool::Pool(UINT capacity, UINT element_size, UINT bind_flags)
+    : allocator(0), element_size(element_size), bind_flags(bind_flags)
+{
+    TM_ASSERT(capacity > 0);
+    if (CreateBuffer(capacity * element_size, bind_flags, &buffer)) {
+        allocator.Grow(capacity);
+    }
+}
+
+GeometryHeap::GeometryHeap(const GeometryHeapParams& params,
+                           UploadManager* upload_manager)
+    : upload_manager_(upload_manager),
+      vertices_(params.vertex_capacity, params.vertex_stride,
+                D3D11_BIND_VERTEX_BUFFER),
+      indices_(params.index_capacity, sizeof(unsigned int),
+               D3D11_BIND_INDEX_BUFFER)
+{
+}
+
+uint32_t GeometryHeap::Allocate(ID3D11DeviceContext* device_context,
+                                const void* vertex_data, UINT vertex_count,
+                                const unsigned int* index_data,
+                                UINT index_count, bool is_synchronous)
+{
+    TM_ASSERT(vertex_count > 0 && index_count > 0);
+    ReleaseDeferredFrees();
+    Mesh mesh;
+    if (!AllocateRange(device_context, vertex_count, &vertices_,
+                       &mesh.vertices)) {
+        return INVALID_MESH;
+    }
+    if (!AllocateRange(device_context, index_count, &indices_,
+                       &mesh.indices)) {
+        vertices_.allocator.Free(mesh.vertices);
+        return INVALID_MESH;
+    }
+
+    mesh.range.first_vertex = mesh.vertices.offset;
+    mesh.range.vertex_count = vertex_count;
+    mesh.range.first_index = mesh.indices.offset;
+    mesh.range.index_count = index_count;
+    mesh.is_live = true;
+
+    uint32_t handle;
+    if (free_meshes_.empty()) {
+        handle = static_cast<uint32_t>(meshes_.size());
+        meshes_.push_back(mesh);
+    } else {
+        handle = free_meshes_.back();
+        free_meshes_.pop_back();
+        meshes_[handle] = mesh;
+    }
+    ++mesh_count_;
+    SetMesh(mesh.vertices, handle, &vertices_);
+    SetMesh(mesh.indices, handle, &indices_);
+
+    Upload(device_context, vertex_data, mesh.vertices.offset, vertex_count,
+           /*is_vertex_pool=*/true, is_synchronous, handle);
+    Upload(device_context, index_data, mesh.indices.offset, index_count,
+           /*is_vertex_pool=*/false, is_synchronous, handle);
+    return handle;
+}
+
+void GeometryHeap::Free(uint32_t mesh)
+{
+    TM_ASSERT(mesh < meshes_.size() && meshes_[mesh].is_live);
+    Mesh& m = meshes_[mesh];
+    m.is_live = false;
+    --mesh_count_;
+    if (m.queued_upload_count > 0) {
+        // Nothing reads the data any more, the pieces already staged are
+        // waited for below
+        std::erase_if(queued_uploads_, [mesh](const QueuedUpload& upload) {
+            return upload.mesh == mesh;
+        });
+        m.queued_upload_count = 0;
+    }
+    if (IsUploadPending(m)) {
+        // A staged copy landing in a reused range would overwrite it
+        deferred_frees_.push_back(mesh);
+        return;
+    }
+    vertices_.allocator.Free(m.vertices);
+    indices_.allocator.Free(m.indices);
+    m = Mesh();
+    free_meshes_.push_back(mesh);
+}
+
+uint64_t GeometryHeap::Compact(ID3D11DeviceContext* device_context,
+                               uint64_t max_bytes)
+{
+    ReleaseDeferredFrees();
+    CompactWalk vertex_walk = BeginCompactWalk(/*is_vertex_pool=*/true);
+    CompactWalk index_walk = BeginCompactWalk(/*is_vertex_pool=*/false);
+    uint64_t moved_bytes = 0;
+    bool can_move_vertices = true;
+    bool can_move_indices = true;
+    while ((can_move_vertices || can_move_indices) &&
+           (moved_bytes == 0 || moved_bytes < max_bytes)) {
+        // Alternate between the pools so both make progress
+        if (can_move_vertices) {
+            const uint64_t bytes =
+                MoveNextAllocation(device_context, &vertex_walk);
+            can_move_vertices = bytes > 0;
+            moved_bytes += bytes;
+        }
+        if (can_move_indices &&
+            (moved_bytes == 0 || moved_bytes < max_bytes)) {
+            const uint64_t bytes =
+                MoveNextAllocation(device_context, &index_walk);
+            can_move_indices = bytes > 0;
+            moved_bytes += bytes;
+        }
+    }
+    moved_bytes_ += moved_bytes;
+    return moved_bytes;
+}
+
+void GeometryHeap::RetryQueuedUploads()
+{
+    // In order, so later uploads do not keep a large one from ever fitting
+    size_t staged_count = 0;
+    while (staged_count < queued_uploads_.size() &&
+           StageUpload(&queued_uploads_[staged_count])) {
+        --meshes_[queued_uploads_[staged_count].mesh].queued_upload_count;
+        ++staged_count;
+    }
+    queued_uploads_.erase(queued_uploads_.begin(),
+                          queued_uploads_.begin() + staged_count);
+}
+
+bool GeometryHeap::IsDrawable(uint32_t mesh) const
+{
+    TM_ASSERT(mesh < meshes_.size());
+    return meshes_[mesh].is_live && !IsUploadPending(meshes_[mesh]);
+}
+
+GeometryHeapStats GeometryHeap::stats() const
+{
+    GeometryHeapStats stats;
+    stats.vertex_capacity = vertices_.allocator.size();
+    stats.used_vertices = vertices_.allocator.used_size();
+    stats.index_capacity = indices_.allocator.size();
+    stats.used_indices = indices_.allocator.used_size();
+    stats.mesh_count = mesh_count_;
+    stats.queued_upload_count = static_cast<UINT>(queued_uploads_.size());
+    for (const QueuedUpload& upload : queued_uploads_) {
+        stats.queued_bytes += upload.data.size() - upload.staged_size;
+    }
+    stats.moved_mesh_count = moved_mesh_count_;
+    stats.moved_bytes = moved_bytes_;
+    return stats;
+}
+
+bool GeometryHeap::AllocateRange(ID3D11DeviceContext* device_context,
+                                 UINT count, Pool* pool,
+                                 TlsfAllocator::Allocation* allocation)
+{
+    *allocation = pool->allocator.Allocate(count);
+    if (allocation->IsValid()) {
+        return true;
+    }
+
+    // The free space at the end merges with the new one, so this always fits
+    if (!Grow(device_context, pool->allocator.size() + count, pool)) {
+        return false;
+    }
+    *allocation = pool->allocator.Allocate(count);
+    TM_ASSERT(allocation->IsValid());
+    return true;
+}
+
+void GeometryHeap::SetMesh(const TlsfAllocator::Allocation& allocation,
+                           uint32_t mesh, Pool* pool)
+{
+    if (allocation.node >= pool->mesh_by_node.size()) {
+        pool->mesh_by_node.resize(allocation.node + 1, INVALID_MESH);
+    }
+    pool->mesh_by_node[allocation.node] = mesh;
+}
+
+bool GeometryHeap::Grow(ID3D11DeviceContext* device_context,
+                        UINT min_capacity, Pool* pool)
+{
+    const UINT old_capacity = pool->allocator.size();
+    const uint64_t new_capacity =
+        std::max<uint64_t>(uint64_t(old_capacity) * 2, min_capacity);
+    if (new_capacity * pool->element_size > UINT32_MAX) {
+        TM_LOG_ERROR("Geometry buffer can not grow past 4 GB");
+        return false;
+    }
+
+    const UINT size_in_bytes =
+        static_cast<UINT>(new_capacity * pool->element_size);
+    wrl::ComPtr<ID3D11Buffer> buffer;
+    if (!CreateBuffer(size_in_bytes, pool->bind_flags, &buffer)) {
+        return false;
+    }
+    TM_LOG_INFO("Growing geometry buffer from {} to {} bytes",
+                old_capacity * pool->element_size, size_in_bytes);
+
+    if (pool->buffer && old_capacity > 0) {
+        const D3D11_BOX box =
+            BufferBox(0, old_capacity * pool->element_size);
+        device_context->CopySubresourceRegion(buffer.Get(), 0, 0, 0, 0,
+                                              pool->buffer.Get(), 0, &box);
+    }
+    if (upload_manager_ != nullptr) {
+        // The new buffer holds the old contents at the same offsets
+        upload_manager_->Retarget(pool->buffer.Get(), buffer.Get());
+    }
+    pool->buffer = buffer;
+    pool->allocator.Grow(static_cast<UINT>(new_capacity));
+    return true;
+}
+
+void GeometryHeap::Upload(ID3D11DeviceContext* device_context,
+                          const void* data, UINT first, UINT count,
+                          bool is_vertex_pool, bool is_synchronous,
+                          uint32_t mesh)
+{
+    Pool* pool = is_vertex_pool ? &vertices_ : &indices_;
+    const UINT first_byte = first * pool->element_size;
+    const UINT size_in_bytes = count * pool->element_size;
+    if (upload_manager_ == nullptr || is_synchronous) {
+        const D3D11_BOX box = BufferBox(first_byte, size_in_bytes);
+        device_context->UpdateSubresource(pool->buffer.Get(), 0, &box, data,
+                                          0, 0);
+        return;
+    }
+
+    uint64_t serial;
+    if (upload_manager_->Upload(pool->buffer.Get(), first_byte, data,
+                                size_in_bytes, &serial)) {
+        meshes_[mesh].has_staged_upload = true;
+        meshes_[mesh].upload_serial = serial;
+        return;
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    QueuedUpload upload;
+    upload.mesh = mesh;
+    upload.is_vertex_pool = is_vertex_pool;
+    upload.first_byte = first_byte;
+    upload.data.assign(bytes, bytes + size_in_bytes);
+    queued_uploads_.push_back(std::move(upload));
+    ++meshes_[mesh].queued_upload_count;
+}
+
+bool GeometryHeap::StageUpload(QueuedUpload* upload)
+{
+    // Looked up here, the buffer may have grown since the upload was queued
+    Pool* pool = upload->is_vertex_pool ? &vertices_ : &indices_;
+    Mesh& mesh = meshes_[upload->mesh];
+    const UINT size_in_bytes = static_cast<UINT>(upload->data.size());
+    while (upload->staged_size < size_in_bytes) {
+        const UINT piece_size =
+            std::min(size_in_bytes - upload->staged_size,
+                     upload_manager_->bytes_per_frame());
+        uint64_t serial;
+        if (!upload_manager_->Upload(
+                pool->buffer.Get(), upload->first_byte + upload->staged_size,
+                upload->data.data() + upload->staged_size, piece_size,
+                &serial)) {
+            return false;
+        }
+        upload->staged_size += piece_size;
+        mesh.has_staged_upload = true;
+        mesh.upload_serial = serial;
+    }
+    return true;
+}
+
+bool GeometryHeap::IsUploadPending(const Mesh& mesh) const
+{
+    return mesh.queued_upload_count > 0 ||
+           (mesh.has_staged_upload &&
+            !upload_manager_->IsRecorded(mesh.upload_serial));
+}
+
+void GeometryHeap::ReleaseDeferredFrees()
+{
+    size_t kept = 0;
+    for (uint32_t mesh : deferred_frees_) {
+        Mesh& m = meshes_[mesh];
+        if (IsUploadPending(m)) {
+            deferred_frees_[kept++] = mesh;
+            continue;
+        }
+        vertices_.allocator.Free(m.vertices);
+        indices_.allocator.Free(m.indices);
+        m = Mesh();
+        free_meshes_.push_back(mesh);
+    }
+    deferred_frees_.resize(kept);
+}
+
+GeometryHeap::CompactWalk GeometryHeap::BeginCompactWalk(bool is_vertex_pool)
+{
+    CompactWalk walk;
+    walk.pool = is_vertex_pool ? &vertices_ : &indices_;
+    walk.is_vertex_pool = is_vertex_pool;
+    walk.candidate =
+        walk.pool->allocator.LastAllocationBelow(walk.pool->compact_limit);
+    if (!walk.candidate.IsValid()) {
+        walk.pool->compact_limit = UINT32_MAX;
+        walk.candidate = walk.pool->allocator.LastAllocationBelow(UINT32_MAX);
+    }
+    return walk;
+}
+
+uint64_t GeometryHeap::MoveNextAllocation(ID3D11DeviceContext* device_context,
+                                          CompactWalk* walk)
+{
+    Pool* pool = walk->pool;
+    while (walk->candidate.IsValid() &&
+           walk->skipped_count < MAX_COMPACT_SKIPS) {
+        const TlsfAllocator::Allocation allocation = walk->candidate;
+        // Taken first, moving frees the allocation
+        walk->candidate = pool->allocator.PreviousAllocation(allocation);
+        pool->compact_limit =
+            walk->candidate.IsValid() ? allocation.offset : UINT32_MAX;
+
+        const uint64_t bytes =
+            MoveAllocation(device_context, walk->is_vertex_pool,
+                           pool->mesh_by_node[allocation.node]);
+        if (bytes > 0) {
+            return bytes;
+        }
+        ++walk->skipped_count;
+    }
+    return 0;
+}
+
+uint64_t GeometryHeap::MoveAllocation(ID3D11DeviceContext* device_context,
+                                      bool is_vertex_pool, uint32_t mesh)
+{
+    Pool* pool = is_vertex_pool ? &vertices_ : &indices_;
+    Mesh& m = meshes_[mesh];
+    // A staged mesh moves once its copies are recorded, and a freed one
+    // still here is waiting for them
+    if (!m.is_live || IsUploadPending(m)) {
+        return 0;
+    }
+
+    TlsfAllocator::Allocation* allocation =
+        is_vertex_pool ? &m.vertices : &m.indices;
+    const UINT count =
+        is_vertex_pool ? m.range.vertex_count : m.range.index_count;
+    // Allocate() prefers any hole, often the free space after the mesh. Only
+    // the lowest one below it makes the buffer more compact.
+    const TlsfAllocator::Allocation moved =
+        pool->allocator.AllocateBelow(count, allocation->offset);
+    if (!moved.IsValid()) {
+        return 0;
+    }
+    if (!CopyRange(device_context, allocation->offset, moved.offset, count,
+                   pool)) {
+        pool->allocator.Free(moved);
+        return 0;
+    }
+
+    pool->allocator.Free(*allocation);
+    *allocation = moved;
+    SetMesh(moved, mesh, pool);
+    if (is_vertex_pool) {
+        m.range.first_vertex = moved.offset;
+    } else {
+        m.range.first_index = moved.offset;
+    }
+    ++moved_mesh_count_;
+    return uint64_t(count) * pool->element_size;
+}
+
+bool GeometryHeap::CopyRange(ID3D11DeviceContext* device_context, UINT src,
+                             UINT dst, UINT count, Pool* pool)
+{
+    if (pool->scratch_capacity < count) {
+        const UINT capacity = std::max(pool->scratch_capacity * 2, count);
+        if (!CreateBuffer(capacity * pool->element_size, 0,
+                          &pool->scratch_buffer)) {
+            pool->scratch_capacity = 0;
+            return false;
+        }
+        pool->scratch_capacity = capacity;
+    }
+
+    const UINT size_in_bytes = count * pool->element_size;
+    const D3D11_BOX src_box =
+        BufferBox(src * pool->element_size, size_in_bytes);
+    device_context->CopySubresourceRegion(pool->scratch_buffer.Get(), 0, 0, 0,
+                                          0, pool->buffer.Get(), 0, &src_box);
+    const D3D11_BOX scratch_box = BufferBox(0, size_in_bytes);
+    device_context->CopySubresourceRegion(
+        pool->buffer.Get(), 0, dst * pool->element_size, 0, 0,
+        pool->scratch_buffer.Get(), 0, &scratch_box);
+    return true;
+}
+
+}  // namespace tamarindo
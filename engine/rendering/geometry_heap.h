@@ -0,0 +1,261 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_GEOMETRY_HEAP_H_
+#define ENGINE_LIB_RENDERING_GEOMETRY_HEAP_H_
+
+#include "utils/tlsf_allocator.h"
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace tamarindo
+{
+
+namespace wrl = Microsoft::WRL;
+
+class UploadManager;
+
+struct GeometryHeapParams {
+    // Initial sizes of the buffers, in vertices and indices. They grow when
+    // a mesh does not fit.
+    unsigned int vertex_capacity = 1 << 16;
+    unsigned int index_capacity = 1 << 18;
+    unsigned int vertex_stride = sizeof(float) * 5;
+};
+
+// Where a mesh lives in the heap buffers. Its indices are relative to
+// first_vertex, so draws add both to their offsets.
+struct GeometryRange {
+    UINT first_vertex = 0;
+    UINT vertex_count = 0;
+    UINT first_index = 0;
+    UINT index_count = 0;
+};
+
+struct GeometryHeapStats {
+    UINT vertex_capacity = 0;
+    UINT used_vertices = 0;
+    UINT index_capacity = 0;
+    UINT used_indices = 0;
+    UINT mesh_count = 0;
+    // Uploads over the budget waiting for RetryQueuedUploads()
+    UINT queued_upload_count = 0;
+    uint64_t queued_bytes = 0;
+    // Copies made by Compact() so far
+    UINT moved_mesh_count = 0;
+    uint64_t moved_bytes = 0;
+};
+
+// Vertices and indices of every mesh, suballocated from one vertex buffer
+// and one index buffer with a TlsfAllocator each. All the meshes share the
+// same bindings, and unloading a mesh leaves a hole the next ones reuse.
+//
+// Compact() closes the holes a few meshes at a time. It walks the meshes of
+// a buffer from the end down, resuming where the last call stopped, and
+// moves each into the lowest hole below it that fits, found with a first-fit
+// walk of the blocks rather than the size classes. A mesh with no such hole
+// is skipped, so moving the smaller ones under it merges holes until it
+// fits on a later pass. The copies are recorded on the device context like
+// the draws, so the driver orders them against the draws still reading the
+// old range and nothing needs to wait.
+//
+// With an UploadManager, new meshes go through its staging ring and land at
+// its next Flush(). Until then they are not moved, and freeing one holds
+// its ranges back so no other mesh is written there first. Data over the
+// budget of the frame is copied into a queue and staged by the next
+// RetryQueuedUploads() calls, in pieces if it is larger than the budget, so
+// the budget bounds the geometry copied per frame.
+class GeometryHeap
+{
+   public:
+    static constexpr uint32_t INVALID_MESH = UINT32_MAX;
+
+    GeometryHeap() = delete;
+    // Without `upload_manager` meshes are copied with UpdateSubresource, as
+    // with `is_synchronous` in Allocate()
+    GeometryHeap(const GeometryHeapParams& params,
+                 UploadManager* upload_manager);
+    ~GeometryHeap() = default;
+
+    GeometryHeap(const GeometryHeap& other) = delete;
+    GeometryHeap& operator=(const GeometryHeap& other) = delete;
+
+    // Copies the mesh into the buffers, growing them if it does not fit.
+    // `vertex_data` holds vertex_count vertices of the heap stride. With
+    // `is_synchronous` the data is copied with UpdateSubresource right away,
+    // for loads at startup; otherwise it is staged or queued, and the mesh
+    // is not drawable until it is recorded. Returns INVALID_MESH if a buffer
+    // could not grow.
+    uint32_t Allocate(ID3D11DeviceContext* device_context,
+                      const void* vertex_data, UINT vertex_count,
+                      const unsigned int* index_data, UINT index_count,
+                      bool is_synchronous = false);
+
+    // Stages the queued uploads, oldest first, until the budget of the frame
+    // runs out. Call it right after UploadManager::Flush(), which maps an
+    // empty region.
+    void RetryQueuedUploads();
+
+    // False while part of the mesh is queued or staged, draws of the mesh
+    // would read whatever the range held before
+    bool IsDrawable(uint32_t mesh) const;
+
+    // The range can be handed out again right away, unless the upload of
+    // the mesh is still staged, see the class comment
+    void Free(uint32_t mesh);
+
+    // Moves meshes down to close holes until `max_bytes` were copied, or
+    // every buffer ran out of meshes to try. Moves at least one mesh if any
+    // can, even a larger one. Returns the bytes copied.
+    uint64_t Compact(ID3D11DeviceContext* device_context, uint64_t max_bytes);
+
+    inline const GeometryRange& range(uint32_t mesh) const
+    {
+        return meshes_[mesh].range;
+    }
+
+    // Both change when the buffers grow, bind them again after Allocate()
+    inline ID3D11Buffer* vertex_buffer() const
+    {
+        return vertices_.buffer.Get();
+    }
+    inline ID3D11Buffer* index_buffer() const { return indices_.buffer.Get(); }
+
+    inline UINT vertex_stride() const { return vertices_.element_size; }
+
+    GeometryHeapStats stats() const;
+
+   private:
+    // Meshes Compact() tries without moving one before it gives up on a
+    // buffer until the next call
+    static constexpr UINT MAX_COMPACT_SKIPS = 16;
+
+    // One buffer and its allocator, sizes are in elements
+    struct Pool {
+        Pool(UINT capacity, UINT element_size, UINT bind_flags);
+
+        wrl::ComPtr<ID3D11Buffer> buffer;
+        TlsfAllocator allocator;
+        UINT element_size;
+        UINT bind_flags;
+        // Mesh of every allocation, by allocator node
+        std::vector<uint32_t> mesh_by_node;
+        // Staging for moves, a buffer can not copy onto itself
+        wrl::ComPtr<ID3D11Buffer> scratch_buffer;
+        UINT scratch_capacity = 0;
+        // Compact() resumes with the allocations below this offset
+        UINT compact_limit = UINT32_MAX;
+    };
+
+    // Where Compact() is in the walk of a pool
+    struct CompactWalk {
+        Pool* pool;
+        bool is_vertex_pool;
+        // Next allocation to try, invalid once the walk is over
+        TlsfAllocator::Allocation candidate;
+        UINT skipped_count = 0;
+    };
+
+    struct Mesh {
+        GeometryRange range;
+        TlsfAllocator::Allocation vertices;
+        TlsfAllocator::Allocation indices;
+        bool is_live = false;
+        // Serial of the upload manager while part of the mesh is staged
+        bool has_staged_upload = false;
+        uint64_t upload_serial = 0;
+        // Entries of queued_uploads_ for the mesh
+        UINT queued_upload_count = 0;
+    };
+
+    // Data the upload manager rejected, copied since the caller does not
+    // keep it
+    struct QueuedUpload {
+        uint32_t mesh;
+        bool is_vertex_pool;
+        // In bytes into the pool buffer
+        UINT first_byte;
+        std::vector<uint8_t> data;
+        // Bytes of `data` staged so far
+        UINT staged_size = 0;
+    };
+
+    // Allocates `count` elements, growing the pool if they do not fit
+    bool AllocateRange(ID3D11DeviceContext* device_context, UINT count,
+                       Pool* pool, TlsfAllocator::Allocation* allocation);
+
+    static void SetMesh(const TlsfAllocator::Allocation& allocation,
+                        uint32_t mesh, Pool* pool);
+
+    // Creates a buffer of at least `min_capacity` elements holding the
+    // current contents
+    bool Grow(ID3D11DeviceContext* device_context, UINT min_capacity,
+              Pool* pool);
+
+    void Upload(ID3D11DeviceContext* device_context, const void* data,
+                UINT first, UINT count, bool is_vertex_pool,
+                bool is_synchronous, uint32_t mesh);
+
+    // Stages what is left of the upload, in pieces of at most the budget.
+    // Returns false if the budget of the frame ran out first.
+    bool StageUpload(QueuedUpload* upload);
+
+    bool IsUploadPending(const Mesh& mesh) const;
+
+    // Frees the ranges held back by Free() whose uploads were recorded
+    void ReleaseDeferredFrees();
+
+    // Starts at the top of the pool again once the last walk reached the
+    // bottom
+    CompactWalk BeginCompactWalk(bool is_vertex_pool);
+
+    // Moves the next mesh of the walk that fits a lower hole. Returns the
+    // bytes copied, zero once the walk is over.
+    uint64_t MoveNextAllocation(ID3D11DeviceContext* device_context,
+                                CompactWalk* walk);
+
+    // Moves the allocation of `mesh` into the lowest hole below it that
+    // fits. Returns the bytes copied, zero if it could not move.
+    uint64_t MoveAllocation(ID3D11DeviceContext* device_context,
+                            bool is_vertex_pool, uint32_t mesh);
+
+    static bool CopyRange(ID3D11DeviceContext* device_context, UINT src,
+                          UINT dst, UINT count, Pool* pool);
+
+    UploadManager* upload_manager_;
+
+    Pool vertices_;
+    Pool indices_;
+
+    std::vector<Mesh> meshes_;
+    std::vector<uint32_t> free_meshes_;
+    // Freed while their upload was staged
+    std::vector<uint32_t> deferred_frees_;
+    // Oldest first
+    std::vector<QueuedUpload> queued_uploads_;
+    UINT mesh_count_ = 0;
+
+    UINT moved_mesh_count_ = 0;
+    uint64_t moved_bytes_ = 0;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_GEOMETRY_HEAP_H_
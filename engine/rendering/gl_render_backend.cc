@@ -0,0 +1,558 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/gl_render_backend.h"
+
+#include "logging/logger.h"
+#include "utils/macros.h"
+
+#include <EGL/eglext.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+// Bytes of a matrix in the scene and object constants
+constexpr size_t MATRIX_SIZE = 16 * sizeof(float);
+// Object constant offsets are counted in 16-byte constants, as in D3D11
+constexpr size_t CONSTANT_SIZE = 16;
+
+// SHADER_CODE registers b0 and b1
+constexpr GLuint SCENE_CONSTANTS_BINDING = 0;
+constexpr GLuint OBJECT_CONSTANTS_BINDING = 1;
+
+// Mesh vertex attributes, position then UV
+constexpr GLuint POSITION_LOCATION = 0;
+constexpr GLuint TEX_LOCATION = 1;
+constexpr GLuint VERTEX_BUFFER_BINDING = 0;
+
+constexpr const char* VERTEX_SHADER_HEADER =
+    "#version 450 core\n#define TM_VERTEX_SHADER\n#line 1\n";
+constexpr const char* FRAGMENT_SHADER_HEADER =
+    "#version 450 core\n#define TM_FRAGMENT_SHADER\n#line 1\n";
+
+void APIENTRY LogDebugMessage(GLenum source, GLenum type, GLuint id,
+                              GLenum severity, GLsizei length,
+                              const GLchar* message, const void* user_param)
+{
+    switch (severity) {
+        case GL_DEBUG_SEVERITY_HIGH:
+            TM_LOG_ERROR("GL: {}", message);
+            break;
+        case GL_DEBUG_SEVERITY_MEDIUM:
+            TM_LOG_WARN("GL: {}", message);
+            break;
+        default:
+            TM_LOG_DEBUG("GL: {}", message);
+            break;
+    }
+}
+
+GLuint CompileShader(GLenum stage, const char* header,
+                     const std::string& source)
+{
+    const GLchar* strings[2] = {header, source.c_str()};
+    const GLuint shader = glCreateShader(stage);
+    glShaderSource(shader, 2, strings, nullptr);
+    glCompileShader(shader);
+
+    GLint is_compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &is_compiled);
+    if (is_compiled == GL_FALSE) {
+        GLint log_length = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_length);
+        std::string log(static_cast<size_t>(std::max(log_length, 1)), '\0');
+        glGetShaderInfoLog(shader, log_length, nullptr, log.data());
+        TM_LOG_ERROR("Could not compile shader: {}", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+}  // namespace
+
+GLRenderBackend::GLRenderBackend() = default;
+
+GLRenderBackend::~GLRenderBackend()
+{
+    Shutdown();
+}
+
+bool GLRenderBackend::Initialize(const GLRenderBackendParams& params)
+{
+    TM_ASSERT(framebuffer_ == 0);
+    TM_ASSERT(params.frames_in_flight > 0);
+    params_ = params;
+
+    if (!InitializeContext()) {
+        return false;
+    }
+
+    if (!InitializeRenderTarget()) {
+        return false;
+    }
+
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment_);
+    if (params_.use_persistent_mapping) {
+        if (!dynamic_buffer_.Initialize(params_.dynamic_region_size,
+                                        params_.frames_in_flight,
+                                        uniform_alignment_)) {
+            return false;
+        }
+    } else {
+        glCreateBuffers(1, &scene_constants_buffer_);
+        glCreateBuffers(1, &object_constants_buffer_);
+    }
+
+    // D3D conventions: y points down in the framebuffer, so rows are read
+    // back from the top, and depth goes from 0 to 1. The upper left origin
+    // flips the winding too, so front faces stay clockwise on screen.
+    glClipControl(GL_UPPER_LEFT, GL_ZERO_TO_ONE);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    glFrontFace(GL_CW);
+    glViewport(0, 0, static_cast<GLsizei>(params_.width),
+               static_cast<GLsizei>(params_.height));
+    return true;
+}
+
+void GLRenderBackend::Shutdown()
+{
+    if (framebuffer_ != 0) {
+        for (GLuint program : programs_) {
+            glDeleteProgram(program);
+        }
+        programs_.clear();
+
+        for (Mesh& mesh : meshes_) {
+            glDeleteVertexArrays(1, &mesh.vertex_array);
+            glDeleteBuffers(1, &mesh.vertex_buffer);
+            glDeleteBuffers(1, &mesh.index_buffer);
+        }
+        meshes_.clear();
+
+        dynamic_buffer_.Shutdown();
+        glDeleteBuffers(1, &scene_constants_buffer_);
+        glDeleteBuffers(1, &object_constants_buffer_);
+        scene_constants_buffer_ = 0;
+        object_constants_buffer_ = 0;
+
+        glDeleteFramebuffers(1, &framebuffer_);
+        glDeleteTextures(1, &color_target_);
+        glDeleteRenderbuffers(1, &depth_target_);
+        framebuffer_ = 0;
+        color_target_ = 0;
+        depth_target_ = 0;
+    }
+
+    if (context_ != EGL_NO_CONTEXT) {
+        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                       EGL_NO_CONTEXT);
+        eglDestroyContext(display_, context_);
+        context_ = EGL_NO_CONTEXT;
+    }
+    if (display_ != EGL_NO_DISPLAY) {
+        eglTerminate(display_);
+        display_ = EGL_NO_DISPLAY;
+    }
+
+    is_recording_ = false;
+    has_frame_ = false;
+}
+
+uint32_t GLRenderBackend::CreateShader(const std::string& source)
+{
+    const GLuint vertex_shader =
+        CompileShader(GL_VERTEX_SHADER, VERTEX_SHADER_HEADER, source);
+    const GLuint fragment_shader =
+        CompileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER_HEADER, source);
+    if (vertex_shader == 0 || fragment_shader == 0) {
+        glDeleteShader(vertex_shader);
+        glDeleteShader(fragment_shader);
+        return INVALID_HANDLE;
+    }
+
+    const GLuint program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    GLint is_linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
+    if (is_linked == GL_FALSE) {
+        GLint log_length = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &log_length);
+        std::string log(static_cast<size_t>(std::max(log_length, 1)), '\0');
+        glGetProgramInfoLog(program, log_length, nullptr, log.data());
+        TM_LOG_ERROR("Could not link shader: {}", log);
+        glDeleteProgram(program);
+        return INVALID_HANDLE;
+    }
+
+    programs_.push_back(program);
+    return static_cast<uint32_t>(programs_.size() - 1);
+}
+
+uint32_t GLRenderBackend::CreateMesh(
+    const std::vector<float>& vertex_data,
+    const std::vector<unsigned int>& index_data)
+{
+    if (vertex_data.empty() || index_data.empty() ||
+        vertex_data.size() % MESH_VERTEX_FLOAT_COUNT != 0) {
+        TM_LOG_ERROR("Invalid mesh data.");
+        return INVALID_HANDLE;
+    }
+
+    // Immutable storage without any access flag, the mesh data is written
+    // once
+    Mesh mesh;
+    glCreateBuffers(1, &mesh.vertex_buffer);
+    glNamedBufferStorage(
+        mesh.vertex_buffer,
+        static_cast<GLsizeiptr>(vertex_data.size() * sizeof(float)),
+        vertex_data.data(), 0);
+    glCreateBuffers(1, &mesh.index_buffer);
+    glNamedBufferStorage(
+        mesh.index_buffer,
+        static_cast<GLsizeiptr>(index_data.size() * sizeof(unsigned int)),
+        index_data.data(), 0);
+
+    glCreateVertexArrays(1, &mesh.vertex_array);
+    glVertexArrayVertexBuffer(mesh.vertex_array, VERTEX_BUFFER_BINDING,
+                              mesh.vertex_buffer, 0,
+                              MESH_VERTEX_FLOAT_COUNT * sizeof(float));
+    glEnableVertexArrayAttrib(mesh.vertex_array, POSITION_LOCATION);
+    glVertexArrayAttribFormat(mesh.vertex_array, POSITION_LOCATION, 3,
+                              GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribBinding(mesh.vertex_array, POSITION_LOCATION,
+                               VERTEX_BUFFER_BINDING);
+    glEnableVertexArrayAttrib(mesh.vertex_array, TEX_LOCATION);
+    glVertexArrayAttribFormat(mesh.vertex_array, TEX_LOCATION, 2, GL_FLOAT,
+                              GL_FALSE, 3 * sizeof(float));
+    glVertexArrayAttribBinding(mesh.vertex_array, TEX_LOCATION,
+                               VERTEX_BUFFER_BINDING);
+    glVertexArrayElementBuffer(mesh.vertex_array, mesh.index_buffer);
+
+    meshes_.push_back(mesh);
+    return static_cast<uint32_t>(meshes_.size() - 1);
+}
+
+void GLRenderBackend::BindShader(uint32_t shader)
+{
+    TM_ASSERT(shader < programs_.size());
+    glUseProgram(programs_[shader]);
+}
+
+void GLRenderBackend::BindMaterial(uint32_t material)
+{
+    // The GL path has no materials yet, the shader outputs the UVs
+}
+
+void GLRenderBackend::BindMesh(uint32_t mesh)
+{
+    TM_ASSERT(mesh < meshes_.size());
+    glBindVertexArray(meshes_[mesh].vertex_array);
+}
+
+void GLRenderBackend::BindObjectConstants(uint32_t constants)
+{
+    TM_ASSERT(is_recording_);
+    const size_t offset = constants * CONSTANT_SIZE;
+    TM_ASSERT(offset + MATRIX_SIZE <= object_constants_size_);
+    TM_ASSERT((object_constants_offset_ + offset) % uniform_alignment_ == 0);
+    glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_CONSTANTS_BINDING,
+                      object_constants_,
+                      object_constants_offset_ +
+                          static_cast<GLintptr>(offset),
+                      MATRIX_SIZE);
+}
+
+void GLRenderBackend::DrawIndexed(uint32_t index_count, uint32_t index_offset,
+                                  int32_t vertex_offset)
+{
+    TM_ASSERT(is_recording_);
+    const uintptr_t index_byte_offset =
+        static_cast<uintptr_t>(index_offset) * sizeof(unsigned int);
+    glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(index_count),
+                             GL_UNSIGNED_INT,
+                             reinterpret_cast<const void*>(index_byte_offset),
+                             vertex_offset);
+}
+
+bool GLRenderBackend::BeginFrame(const float clear_color[4])
+{
+    TM_ASSERT(!is_recording_);
+    if (params_.use_persistent_mapping && !dynamic_buffer_.BeginRegion()) {
+        return false;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glClearNamedFramebufferfv(framebuffer_, GL_COLOR, 0, clear_color);
+    glClearNamedFramebufferfi(framebuffer_, GL_DEPTH_STENCIL, 0, 1.0f, 0);
+
+    is_recording_ = true;
+    has_scene_constants_ = false;
+    object_constants_ = 0;
+    object_constants_offset_ = 0;
+    object_constants_size_ = 0;
+    return true;
+}
+
+void GLRenderBackend::SetSceneConstants(const float* view_projection)
+{
+    TM_ASSERT(is_recording_);
+    std::memcpy(view_projection_, view_projection, sizeof(view_projection_));
+    has_scene_constants_ = true;
+
+    if (!params_.use_persistent_mapping) {
+        glNamedBufferData(scene_constants_buffer_, MATRIX_SIZE,
+                          view_projection, GL_STREAM_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, SCENE_CONSTANTS_BINDING,
+                         scene_constants_buffer_);
+        return;
+    }
+
+    void* data = nullptr;
+    GLintptr offset = 0;
+    if (!AllocateDynamicData(MATRIX_SIZE, &data, &offset)) {
+        TM_BREAK();
+        return;
+    }
+    std::memcpy(data, view_projection, MATRIX_SIZE);
+    glBindBufferRange(GL_UNIFORM_BUFFER, SCENE_CONSTANTS_BINDING,
+                      dynamic_buffer_.buffer(), offset, MATRIX_SIZE);
+}
+
+void GLRenderBackend::SetObjectConstantData(const void* data, size_t size)
+{
+    TM_ASSERT(is_recording_);
+    if (!params_.use_persistent_mapping) {
+        // Re-specifying the storage lets the driver orphan the copy the
+        // previous frame still reads
+        glNamedBufferData(object_constants_buffer_,
+                          static_cast<GLsizeiptr>(size), data,
+                          GL_STREAM_DRAW);
+        object_constants_ = object_constants_buffer_;
+        object_constants_offset_ = 0;
+        object_constants_size_ = size;
+        return;
+    }
+
+    void* mapped_data = nullptr;
+    GLintptr offset = 0;
+    if (!AllocateDynamicData(size, &mapped_data, &offset)) {
+        TM_BREAK();
+        return;
+    }
+    std::memcpy(mapped_data, data, size);
+    object_constants_ = dynamic_buffer_.buffer();
+    object_constants_offset_ = offset;
+    object_constants_size_ = size;
+}
+
+bool GLRenderBackend::EndFrame()
+{
+    TM_ASSERT(is_recording_);
+    is_recording_ = false;
+    if (params_.use_persistent_mapping) {
+        dynamic_buffer_.EndRegion();
+    }
+    glFlush();
+
+    const GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        TM_LOG_ERROR("GL error {} in the frame.", error);
+        return false;
+    }
+    has_frame_ = true;
+    return true;
+}
+
+bool GLRenderBackend::ReadColorBuffer(std::vector<uint32_t>* pixels)
+{
+    TM_ASSERT(!is_recording_);
+    if (!has_frame_) {
+        TM_LOG_ERROR("There is no frame to read back.");
+        return false;
+    }
+
+    pixels->resize(static_cast<size_t>(params_.width) * params_.height);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+    glReadnPixels(0, 0, static_cast<GLsizei>(params_.width),
+                  static_cast<GLsizei>(params_.height), GL_RGBA,
+                  GL_UNSIGNED_BYTE,
+                  static_cast<GLsizei>(pixels->size() * sizeof(uint32_t)),
+                  pixels->data());
+    return glGetError() == GL_NO_ERROR;
+}
+
+bool GLRenderBackend::WaitIdle()
+{
+    glFinish();
+    return glGetError() == GL_NO_ERROR;
+}
+
+bool GLRenderBackend::InitializeContext()
+{
+    if (!params_.create_context) {
+        GLint major = 0;
+        GLint minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major * 10 + minor < 45) {
+            TM_LOG_ERROR("The GL backend needs a 4.5 context, got {}.{}.",
+                         major, minor);
+            return false;
+        }
+        return true;
+    }
+
+    // Mesa renders without any window system through its surfaceless
+    // platform. Other drivers get the default display.
+    display_ = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                     EGL_DEFAULT_DISPLAY, nullptr);
+    if (display_ == EGL_NO_DISPLAY) {
+        display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint egl_major = 0;
+    EGLint egl_minor = 0;
+    if (display_ == EGL_NO_DISPLAY ||
+        !eglInitialize(display_, &egl_major, &egl_minor)) {
+        TM_LOG_ERROR("Could not initialize EGL, error {:#x}.", eglGetError());
+        display_ = EGL_NO_DISPLAY;
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        TM_LOG_ERROR("EGL does not support desktop GL.");
+        return false;
+    }
+
+    // Without a config or a surface, the context only renders into
+    // framebuffer objects
+    const EGLint context_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION,
+        4,
+        EGL_CONTEXT_MINOR_VERSION,
+        5,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK,
+        EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_CONTEXT_OPENGL_DEBUG,
+        params_.enable_debug_output ? EGL_TRUE : EGL_FALSE,
+        EGL_NONE};
+    context_ = eglCreateContext(display_, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT,
+                                context_attributes);
+    if (context_ == EGL_NO_CONTEXT) {
+        TM_LOG_ERROR("Could not create a GL 4.5 context, error {:#x}.",
+                     eglGetError());
+        return false;
+    }
+
+    if (!eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_)) {
+        TM_LOG_ERROR("Could not make the GL context current, error {:#x}.",
+                     eglGetError());
+        return false;
+    }
+
+    TM_LOG_INFO("GL renderer: {}",
+                reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+
+    if (params_.enable_debug_output) {
+        glEnable(GL_DEBUG_OUTPUT);
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+        glDebugMessageCallback(LogDebugMessage, nullptr);
+    }
+    return true;
+}
+
+bool GLRenderBackend::InitializeRenderTarget()
+{
+    const GLsizei width = static_cast<GLsizei>(params_.width);
+    const GLsizei height = static_cast<GLsizei>(params_.height);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &color_target_);
+    glTextureStorage2D(color_target_, 1, GL_RGBA8, width, height);
+    glCreateRenderbuffers(1, &depth_target_);
+    glNamedRenderbufferStorage(depth_target_, GL_DEPTH24_STENCIL8, width,
+                               height);
+
+    glCreateFramebuffers(1, &framebuffer_);
+    glNamedFramebufferTexture(framebuffer_, GL_COLOR_ATTACHMENT0,
+                              color_target_, 0);
+    glNamedFramebufferRenderbuffer(framebuffer_, GL_DEPTH_STENCIL_ATTACHMENT,
+                                   GL_RENDERBUFFER, depth_target_);
+    glNamedFramebufferReadBuffer(framebuffer_, GL_COLOR_ATTACHMENT0);
+
+    if (glCheckNamedFramebufferStatus(framebuffer_, GL_FRAMEBUFFER) !=
+        GL_FRAMEBUFFER_COMPLETE) {
+        TM_LOG_ERROR("Could not create the render target.");
+        return false;
+    }
+    return true;
+}
+
+bool GLRenderBackend::AllocateDynamicData(size_t size, void** data,
+                                          GLintptr* offset)
+{
+    size_t ring_offset = 0;
+    if (dynamic_buffer_.Allocate(size, data, &ring_offset)) {
+        *offset = static_cast<GLintptr>(ring_offset);
+        return true;
+    }
+
+    // Room for this allocation and the scene constants, each aligned
+    const size_t required_size =
+        size + MATRIX_SIZE + 2 * static_cast<size_t>(uniform_alignment_);
+    if (!dynamic_buffer_.Resize(
+            std::max(required_size, dynamic_buffer_.region_size() * 2))) {
+        return false;
+    }
+
+    // The region restarts empty in a new buffer, so the scene constants
+    // have to be written again
+    if (has_scene_constants_) {
+        void* scene_data = nullptr;
+        size_t scene_offset = 0;
+        if (!dynamic_buffer_.Allocate(MATRIX_SIZE, &scene_data,
+                                      &scene_offset)) {
+            return false;
+        }
+        std::memcpy(scene_data, view_projection_, MATRIX_SIZE);
+        glBindBufferRange(GL_UNIFORM_BUFFER, SCENE_CONSTANTS_BINDING,
+                          dynamic_buffer_.buffer(),
+                          static_cast<GLintptr>(scene_offset), MATRIX_SIZE);
+    }
+
+    if (!dynamic_buffer_.Allocate(size, data, &ring_offset)) {
+        return false;
+    }
+    *offset = static_cast<GLintptr>(ring_offset);
+    return true;
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,163 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_GL_RENDER_BACKEND_H_
+#define ENGINE_LIB_RENDERING_GL_RENDER_BACKEND_H_
+
+#include "rendering/gl_ring_buffer.h"
+#include "rendering/render_backend.h"
+
+#include <EGL/egl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tamarindo
+{
+
+struct GLRenderBackendParams {
+    unsigned int width = 1280;
+    unsigned int height = 720;
+    // Frames the CPU can record while the GPU works on the previous ones,
+    // one ring buffer region each
+    unsigned int frames_in_flight = 3;
+    // Initial bytes per frame of the dynamic ring buffer. It grows when a
+    // frame does not fit.
+    size_t dynamic_region_size = 1 << 20;
+    // False uploads the dynamic data with glNamedBufferData every frame, as
+    // ResourcesManager::updateBuffer did, to compare against the ring
+    bool use_persistent_mapping = true;
+    // Creates a headless EGL context. False renders with the context
+    // current on the calling thread, which must be 4.5 core.
+    bool create_context = true;
+    bool enable_debug_output = false;
+};
+
+// OpenGL 4.5 implementation of the rendering layer, the direct state access
+// path of ResourcesManager grown into a backend. Renders into an offscreen
+// framebuffer from a surfaceless EGL context, so it runs headless, on Mesa
+// llvmpipe included. Mirrors the D3D11 path: the SHADER_CODE bindings (scene
+// constants in uniform block 0, object constants in block 1), clip space
+// depth in [0, 1], a 24-bit depth buffer with LESS, back face culling with
+// clockwise front faces, and per-draw constants addressed in 16-byte
+// constants.
+//
+// Meshes live in immutable buffers. The scene and object constants of a
+// frame are copied into a persistently mapped ring buffer and bound with
+// glBindBufferRange, see GLRingBuffer.
+class GLRenderBackend : public RenderBackend
+{
+   public:
+    GLRenderBackend();
+    ~GLRenderBackend() override;
+
+    GLRenderBackend(const GLRenderBackend& other) = delete;
+    GLRenderBackend& operator=(const GLRenderBackend& other) = delete;
+
+    bool Initialize(const GLRenderBackendParams& params);
+
+    void Shutdown();
+
+    // GLSL 4.50 source without a #version line, compiled once with
+    // TM_VERTEX_SHADER defined and once with TM_FRAGMENT_SHADER defined
+    uint32_t CreateShader(const std::string& source) override;
+
+    uint32_t CreateMesh(const std::vector<float>& vertex_data,
+                        const std::vector<unsigned int>& index_data) override;
+
+    void BindShader(uint32_t shader) override;
+    void BindMaterial(uint32_t material) override;
+    void BindMesh(uint32_t mesh) override;
+    void BindObjectConstants(uint32_t constants) override;
+    void DrawIndexed(uint32_t index_count, uint32_t index_offset,
+                     int32_t vertex_offset) override;
+
+    // Waits until the GPU is done with the ring buffer region of the frame
+    // and clears the render target. `clear_color` is RGBA in [0, 1].
+    bool BeginFrame(const float clear_color[4]);
+
+    // View projection matrix, laid out like the scene constant buffer
+    void SetSceneConstants(const float* view_projection);
+
+    // Copies the object constants of the frame, laid out like the D3D11
+    // frame constant buffer, before any draw. Offsets must be aligned to
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, 256 bytes covers every driver.
+    void SetObjectConstantData(const void* data, size_t size);
+
+    // Fences the frame and flushes its commands
+    bool EndFrame();
+
+    // Copies the color target, RGBA8 rows of width() pixels from the top
+    bool ReadColorBuffer(std::vector<uint32_t>* pixels);
+
+    bool WaitIdle();
+
+    inline unsigned int width() const { return params_.width; }
+    inline unsigned int height() const { return params_.height; }
+
+    inline const GLRingBuffer& dynamic_buffer() const
+    {
+        return dynamic_buffer_;
+    }
+
+   private:
+    struct Mesh {
+        GLuint vertex_buffer = 0;
+        GLuint index_buffer = 0;
+        GLuint vertex_array = 0;
+    };
+
+    bool InitializeContext();
+    bool InitializeRenderTarget();
+
+    // Allocates from the ring buffer, growing it if the frame does not fit
+    bool AllocateDynamicData(size_t size, void** data, GLintptr* offset);
+
+    GLRenderBackendParams params_;
+
+    EGLDisplay display_ = EGL_NO_DISPLAY;
+    EGLContext context_ = EGL_NO_CONTEXT;
+
+    GLint uniform_alignment_ = 256;
+
+    GLuint color_target_ = 0;
+    GLuint depth_target_ = 0;
+    GLuint framebuffer_ = 0;
+
+    std::vector<GLuint> programs_;
+    std::vector<Mesh> meshes_;
+
+    GLRingBuffer dynamic_buffer_;
+    // Used instead of the ring without persistent mapping
+    GLuint scene_constants_buffer_ = 0;
+    GLuint object_constants_buffer_ = 0;
+
+    // Kept to upload again if the ring buffer grows mid-frame
+    float view_projection_[16] = {};
+    bool has_scene_constants_ = false;
+
+    GLuint object_constants_ = 0;
+    GLintptr object_constants_offset_ = 0;
+    size_t object_constants_size_ = 0;
+
+    bool is_recording_ = false;
+    bool has_frame_ = false;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_GL_RENDER_BACKEND_H_
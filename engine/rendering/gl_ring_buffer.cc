@@ -0,0 +1,178 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/gl_ring_buffer.h"
+
+#include "logging/logger.h"
+#include "utils/macros.h"
+
+#include <chrono>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+// Waits are retried, a timeout only means the GPU is slow
+constexpr GLuint64 WAIT_TIMEOUT_NS = 1'000'000'000;
+
+constexpr GLbitfield MAP_FLAGS =
+    GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+GLRingBuffer::~GLRingBuffer()
+{
+    Shutdown();
+}
+
+bool GLRingBuffer::Initialize(size_t region_size, unsigned int region_count,
+                              size_t alignment)
+{
+    TM_ASSERT(buffer_ == 0);
+    TM_ASSERT(region_count > 0);
+    TM_ASSERT(alignment > 0);
+    alignment_ = alignment;
+    regions_.resize(region_count);
+    region_index_ = 0;
+    return CreateBuffer(region_size);
+}
+
+void GLRingBuffer::Shutdown()
+{
+    for (Region& region : regions_) {
+        if (region.fence != nullptr) {
+            glDeleteSync(region.fence);
+            region.fence = nullptr;
+        }
+    }
+    regions_.clear();
+
+    if (buffer_ != 0) {
+        glUnmapNamedBuffer(buffer_);
+        glDeleteBuffers(1, &buffer_);
+        buffer_ = 0;
+    }
+    mapped_data_ = nullptr;
+    region_size_ = 0;
+    is_region_open_ = false;
+    offset_ = 0;
+}
+
+bool GLRingBuffer::BeginRegion()
+{
+    TM_ASSERT(!is_region_open_);
+    if (!WaitForRegion(&regions_[region_index_])) {
+        return false;
+    }
+    is_region_open_ = true;
+    offset_ = 0;
+    return true;
+}
+
+bool GLRingBuffer::Allocate(size_t size, void** data, size_t* offset)
+{
+    TM_ASSERT(is_region_open_);
+    const size_t start = AlignUp(offset_, alignment_);
+    if (start + size > region_size_) {
+        return false;
+    }
+
+    offset_ = start + size;
+    *offset = region_index_ * region_size_ + start;
+    *data = mapped_data_ + *offset;
+    return true;
+}
+
+void GLRingBuffer::EndRegion()
+{
+    TM_ASSERT(is_region_open_);
+    Region& region = regions_[region_index_];
+    TM_ASSERT(region.fence == nullptr);
+    region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    is_region_open_ = false;
+    region_index_ = (region_index_ + 1) % regions_.size();
+}
+
+bool GLRingBuffer::Resize(size_t region_size)
+{
+    TM_ASSERT(is_region_open_);
+    for (Region& region : regions_) {
+        if (!WaitForRegion(&region)) {
+            return false;
+        }
+    }
+
+    glUnmapNamedBuffer(buffer_);
+    glDeleteBuffers(1, &buffer_);
+    buffer_ = 0;
+    mapped_data_ = nullptr;
+    offset_ = 0;
+    return CreateBuffer(region_size);
+}
+
+bool GLRingBuffer::CreateBuffer(size_t region_size)
+{
+    region_size_ = AlignUp(region_size, alignment_);
+    const GLsizeiptr size =
+        static_cast<GLsizeiptr>(region_size_ * regions_.size());
+
+    glCreateBuffers(1, &buffer_);
+    glNamedBufferStorage(buffer_, size, nullptr, MAP_FLAGS);
+    mapped_data_ = static_cast<uint8_t*>(
+        glMapNamedBufferRange(buffer_, 0, size, MAP_FLAGS));
+    if (mapped_data_ == nullptr) {
+        TM_LOG_ERROR("Could not map the ring buffer, GL error {}.",
+                     glGetError());
+        return false;
+    }
+    return true;
+}
+
+bool GLRingBuffer::WaitForRegion(Region* region)
+{
+    if (region->fence == nullptr) {
+        return true;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    // Flushing the first time makes sure the fence is ever submitted
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    GLenum result = GL_TIMEOUT_EXPIRED;
+    while (result == GL_TIMEOUT_EXPIRED) {
+        result = glClientWaitSync(region->fence, flags, WAIT_TIMEOUT_NS);
+        flags = 0;
+    }
+    wait_time_ += std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+
+    glDeleteSync(region->fence);
+    region->fence = nullptr;
+    if (result == GL_WAIT_FAILED) {
+        TM_LOG_ERROR("Could not wait for a ring buffer fence.");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,103 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_GL_RING_BUFFER_H_
+#define ENGINE_LIB_RENDERING_GL_RING_BUFFER_H_
+
+// Core profile entry points are linked from libOpenGL, there is no loader
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GL/glcorearb.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tamarindo
+{
+
+// Buffer created with glNamedBufferStorage and mapped once, persistent and
+// coherent, for the data written every frame. It is split into one region
+// per frame in flight: the CPU fills a region while the GPU reads the
+// previous ones, and a fence placed after the last command of a frame tells
+// when its region can be written again. Nothing is re-specified or
+// remapped, so the driver never orphans storage or stalls on a map.
+class GLRingBuffer
+{
+   public:
+    GLRingBuffer() = default;
+    ~GLRingBuffer();
+
+    GLRingBuffer(const GLRingBuffer& other) = delete;
+    GLRingBuffer& operator=(const GLRingBuffer& other) = delete;
+
+    // Needs a current context. `alignment` applies to every allocation, use
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT for uniform ranges.
+    bool Initialize(size_t region_size, unsigned int region_count,
+                    size_t alignment);
+
+    void Shutdown();
+
+    // Waits for the fence of the next region and makes it the current one.
+    // Allocations of that region from older frames become invalid.
+    bool BeginRegion();
+
+    // Returns false, and leaves the outputs untouched, if the region is out
+    // of space. `offset` is from the start of buffer().
+    bool Allocate(size_t size, void** data, size_t* offset);
+
+    // Fences the commands issued since BeginRegion(), the last ones reading
+    // the region
+    void EndRegion();
+
+    // Waits for every region, then replaces the buffer with one of
+    // `region_size` bytes per region. The current region restarts empty, so
+    // it has to be written again.
+    bool Resize(size_t region_size);
+
+    inline GLuint buffer() const { return buffer_; }
+    inline size_t region_size() const { return region_size_; }
+    inline size_t used_bytes() const { return offset_; }
+
+    // Time BeginRegion() spent waiting on fences, since the last reset
+    inline double wait_time() const { return wait_time_; }
+    inline void ResetWaitTime() { wait_time_ = 0.0; }
+
+   private:
+    struct Region {
+        GLsync fence = nullptr;
+    };
+
+    bool CreateBuffer(size_t region_size);
+    bool WaitForRegion(Region* region);
+
+    GLuint buffer_ = 0;
+    uint8_t* mapped_data_ = nullptr;
+    size_t region_size_ = 0;
+    size_t alignment_ = 1;
+
+    std::vector<Region> regions_;
+    uint32_t region_index_ = 0;
+    bool is_region_open_ = false;
+    size_t offset_ = 0;
+
+    double wait_time_ = 0.0;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_GL_RING_BUFFER_H_
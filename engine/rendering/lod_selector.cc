@@ -0,0 +1,127 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/lod_selector.h"
+
+#include "utils/macros.h"
+
+#include <cmath>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+// Objects closer than this, or containing the camera, use the most detailed
+// level
+constexpr float MIN_DISTANCE = 1e-3f;
+
+}  // namespace
+
+LodSelector::LodSelector(const LodSelectorParams& params) : params_(params)
+{
+    TM_ASSERT(params_.max_screen_error_in_pixels > 0.0f);
+    TM_ASSERT(params_.hysteresis >= 0.0f && params_.hysteresis < 1.0f);
+}
+
+unsigned int LodSelector::AddObject(const std::vector<LodLevel>& levels)
+{
+    TM_ASSERT(!levels.empty());
+    for (size_t i = 1; i < levels.size(); ++i) {
+        TM_ASSERT(levels[i].geometric_error >= levels[i - 1].geometric_error);
+    }
+
+    Object object;
+    object.first_level = static_cast<unsigned int>(levels_.size());
+    object.level_count = static_cast<unsigned int>(levels.size());
+    object.selected_level = 0;
+    object.center = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+    object.radius = 0.0f;
+    object.scale = 1.0f;
+
+    levels_.insert(levels_.end(), levels.begin(), levels.end());
+    objects_.push_back(object);
+    return static_cast<unsigned int>(objects_.size() - 1);
+}
+
+void LodSelector::SetBounds(unsigned int id,
+                            const DirectX::BoundingSphere& world_bounds,
+                            float scale)
+{
+    Object& object = objects_[id];
+    object.center = world_bounds.Center;
+    object.radius = world_bounds.Radius;
+    object.scale = scale;
+}
+
+void LodSelector::SetCamera(const DirectX::XMFLOAT3& eye_position,
+                            float fov_angle_in_radians, float viewport_height)
+{
+    eye_position_ = eye_position;
+    projection_scale_ =
+        viewport_height / (2.0f * std::tan(fov_angle_in_radians * 0.5f));
+}
+
+unsigned int LodSelector::SelectLevels()
+{
+    const float threshold = params_.max_screen_error_in_pixels;
+    const float coarsen_threshold = threshold * (1.0f - params_.hysteresis);
+    const float refine_threshold = threshold * (1.0f + params_.hysteresis);
+
+    unsigned int switch_count = 0;
+    for (Object& object : objects_) {
+        const LodLevel* levels = &levels_[object.first_level];
+
+        const float dx = object.center.x - eye_position_.x;
+        const float dy = object.center.y - eye_position_.y;
+        const float dz = object.center.z - eye_position_.z;
+        const float distance =
+            std::sqrt(dx * dx + dy * dy + dz * dz) - object.radius;
+
+        unsigned int level = object.selected_level;
+        if (distance <= MIN_DISTANCE) {
+            level = 0;
+        } else {
+            const float pixels_per_unit =
+                projection_scale_ * object.scale / distance;
+            if (levels[level].geometric_error * pixels_per_unit >
+                refine_threshold) {
+                // Errors grow with the level, so the first level under the
+                // threshold is the coarsest acceptable one
+                while (level > 0 &&
+                       levels[level].geometric_error * pixels_per_unit >
+                           threshold) {
+                    --level;
+                }
+            } else {
+                while (level + 1 < object.level_count &&
+                       levels[level + 1].geometric_error * pixels_per_unit <=
+                           coarsen_threshold) {
+                    ++level;
+                }
+            }
+        }
+
+        if (level != object.selected_level) {
+            object.selected_level = level;
+            ++switch_count;
+        }
+    }
+    return switch_count;
+}
+
+}  // namespace tamarindo
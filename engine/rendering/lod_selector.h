@@ -0,0 +1,111 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_LOD_SELECTOR_H_
+#define ENGINE_LIB_RENDERING_LOD_SELECTOR_H_
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include <vector>
+
+namespace tamarindo
+{
+
+// One level of detail of a mesh, drawn with DrawIndexed(index_count,
+// index_offset, vertex_offset).
+struct LodLevel {
+    unsigned int index_offset;
+    unsigned int index_count;
+    unsigned int vertex_offset;
+    // Largest distance, in object units, between this level and the most
+    // detailed one. Zero for the most detailed level.
+    float geometric_error;
+};
+
+struct LodSelectorParams {
+    // Coarsest level whose projected error stays under this is selected
+    float max_screen_error_in_pixels = 1.0f;
+    // Width of the band around the threshold where the current level is
+    // kept, as a fraction of the threshold. Avoids popping back and forth
+    // when the camera hovers around a switch distance.
+    float hysteresis = 0.25f;
+};
+
+// Picks a level of detail per object from the screen-space error of its
+// levels, error_in_pixels = geometric_error * projection_scale / distance.
+class LodSelector
+{
+   public:
+    LodSelector() = delete;
+    explicit LodSelector(const LodSelectorParams& params);
+    ~LodSelector() = default;
+
+    // Levels must go from the most to the least detailed, with a growing
+    // geometric error. Returns the id used by the other methods.
+    unsigned int AddObject(const std::vector<LodLevel>& levels);
+
+    // `scale` converts the object space errors to world units
+    void SetBounds(unsigned int id, const DirectX::BoundingSphere& world_bounds,
+                   float scale = 1.0f);
+
+    // Uses the vertical field of view and the viewport height of the camera
+    void SetCamera(const DirectX::XMFLOAT3& eye_position,
+                   float fov_angle_in_radians, float viewport_height);
+
+    // Updates the selected level of every object. Returns how many objects
+    // switched level.
+    unsigned int SelectLevels();
+
+    inline unsigned int GetSelectedLevelIndex(unsigned int id) const
+    {
+        return objects_[id].selected_level;
+    }
+
+    inline const LodLevel& GetSelectedLevel(unsigned int id) const
+    {
+        const Object& object = objects_[id];
+        return levels_[object.first_level + object.selected_level];
+    }
+
+    inline unsigned int object_count() const
+    {
+        return static_cast<unsigned int>(objects_.size());
+    }
+
+   private:
+    struct Object {
+        unsigned int first_level;
+        unsigned int level_count;
+        unsigned int selected_level;
+        DirectX::XMFLOAT3 center;
+        float radius;
+        float scale;
+    };
+
+    LodSelectorParams params_;
+
+    DirectX::XMFLOAT3 eye_position_ = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+    // Pixels covered by one world unit at distance one from the camera
+    float projection_scale_ = 1.0f;
+
+    std::vector<Object> objects_;
+    std::vector<LodLevel> levels_;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_LOD_SELECTOR_H_
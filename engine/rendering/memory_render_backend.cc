@@ -0,0 +1,75 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/memory_render_backend.h"
+
+namespace tamarindo
+{
+
+uint32_t MemoryRenderBackend::CreateShader(const std::string& /*source*/)
+{
+    return shader_count_++;
+}
+
+uint32_t MemoryRenderBackend::CreateMesh(
+    const std::vector<float>& /*vertex_data*/,
+    const std::vector<unsigned int>& /*index_data*/)
+{
+    return mesh_count_++;
+}
+
+void MemoryRenderBackend::BindShader(uint32_t shader)
+{
+    RecordBind(Call::Type::BindShader, shader);
+}
+
+void MemoryRenderBackend::BindMaterial(uint32_t material)
+{
+    RecordBind(Call::Type::BindMaterial, material);
+}
+
+void MemoryRenderBackend::BindMesh(uint32_t mesh)
+{
+    RecordBind(Call::Type::BindMesh, mesh);
+}
+
+void MemoryRenderBackend::BindObjectConstants(uint32_t constants)
+{
+    RecordBind(Call::Type::BindObjectConstants, constants);
+}
+
+void MemoryRenderBackend::DrawIndexed(uint32_t index_count,
+                                      uint32_t index_offset,
+                                      int32_t vertex_offset)
+{
+    calls_.push_back(Call{Call::Type::DrawIndexed,
+                          {index_count, index_offset,
+                           static_cast<uint32_t>(vertex_offset)}});
+    ++draw_count_;
+}
+
+void MemoryRenderBackend::Clear()
+{
+    calls_.clear();
+    draw_count_ = 0;
+}
+
+void MemoryRenderBackend::RecordBind(Call::Type type, uint32_t handle)
+{
+    calls_.push_back(Call{type, {handle, 0, 0}});
+}
+
+}  // namespace tamarindo
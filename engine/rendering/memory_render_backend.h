@@ -0,0 +1,82 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_MEMORY_RENDER_BACKEND_H_
+#define ENGINE_LIB_RENDERING_MEMORY_RENDER_BACKEND_H_
+
+#include "rendering/render_backend.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace tamarindo
+{
+
+// Backend that appends every call it receives to an array instead of
+// talking to a graphics API. Used to benchmark and inspect command buffers
+// on machines without a GPU.
+class MemoryRenderBackend : public RenderBackend
+{
+   public:
+    struct Call {
+        enum class Type : uint32_t {
+            BindShader,
+            BindMaterial,
+            BindMesh,
+            BindObjectConstants,
+            DrawIndexed
+        };
+
+        Type type;
+        // Handle for binds, (index_count, index_offset, vertex_offset) for
+        // draws
+        uint32_t args[3];
+    };
+
+    MemoryRenderBackend() = default;
+    ~MemoryRenderBackend() override = default;
+
+    // Only hand out handles, nothing is recorded
+    uint32_t CreateShader(const std::string& source) override;
+    uint32_t CreateMesh(const std::vector<float>& vertex_data,
+                        const std::vector<unsigned int>& index_data) override;
+
+    void BindShader(uint32_t shader) override;
+    void BindMaterial(uint32_t material) override;
+    void BindMesh(uint32_t mesh) override;
+    void BindObjectConstants(uint32_t constants) override;
+    void DrawIndexed(uint32_t index_count, uint32_t index_offset,
+                     int32_t vertex_offset) override;
+
+    void Clear();
+
+    inline const std::vector<Call>& calls() const { return calls_; }
+    inline size_t bind_count() const { return calls_.size() - draw_count_; }
+    inline size_t draw_count() const { return draw_count_; }
+
+   private:
+    void RecordBind(Call::Type type, uint32_t handle);
+
+    std::vector<Call> calls_;
+    size_t draw_count_ = 0;
+
+    uint32_t shader_count_ = 0;
+    uint32_t mesh_count_ = 0;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_MEMORY_RENDER_BACKEND_H_
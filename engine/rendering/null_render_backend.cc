@@ -0,0 +1,131 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/null_render_backend.h"
+
+#include "utils/macros.h"
+
+namespace tamarindo
+{
+
+uint32_t NullRenderBackend::CreateShader(const std::string& source)
+{
+    if (source.empty()) {
+        RecordInvalidCall();
+        return INVALID_HANDLE;
+    }
+    ++stats_.shader_count;
+    return shader_count_++;
+}
+
+uint32_t NullRenderBackend::CreateMesh(
+    const std::vector<float>& vertex_data,
+    const std::vector<unsigned int>& index_data)
+{
+    if (vertex_data.size() % MESH_VERTEX_FLOAT_COUNT != 0 ||
+        index_data.size() % 3 != 0) {
+        RecordInvalidCall();
+        return INVALID_HANDLE;
+    }
+
+    Mesh mesh;
+    mesh.vertex_count =
+        static_cast<uint32_t>(vertex_data.size() / MESH_VERTEX_FLOAT_COUNT);
+    mesh.index_count = static_cast<uint32_t>(index_data.size());
+    meshes_.push_back(mesh);
+
+    ++stats_.mesh_count;
+    stats_.uploaded_bytes += vertex_data.size() * sizeof(float) +
+                             index_data.size() * sizeof(unsigned int);
+    return static_cast<uint32_t>(meshes_.size() - 1);
+}
+
+void NullRenderBackend::BindShader(uint32_t shader)
+{
+    ++stats_.bind_count;
+    if (shader >= shader_count_) {
+        RecordInvalidCall();
+        return;
+    }
+    bound_shader_ = shader;
+}
+
+void NullRenderBackend::BindMaterial(uint32_t /*material*/)
+{
+    // There are no materials to check against yet
+    ++stats_.bind_count;
+}
+
+void NullRenderBackend::BindMesh(uint32_t mesh)
+{
+    ++stats_.bind_count;
+    if (mesh >= meshes_.size()) {
+        RecordInvalidCall();
+        return;
+    }
+    bound_mesh_ = mesh;
+}
+
+void NullRenderBackend::BindObjectConstants(uint32_t constants)
+{
+    // Handles are offsets into a buffer this backend does not see, only an
+    // unset one can be caught
+    ++stats_.bind_count;
+    if (constants == INVALID_HANDLE) {
+        RecordInvalidCall();
+    }
+}
+
+void NullRenderBackend::DrawIndexed(uint32_t index_count,
+                                    uint32_t index_offset,
+                                    int32_t vertex_offset)
+{
+    if (bound_shader_ == INVALID_HANDLE || bound_mesh_ == INVALID_HANDLE) {
+        RecordInvalidCall();
+        return;
+    }
+
+    const Mesh& mesh = meshes_[bound_mesh_];
+    const bool is_in_range =
+        static_cast<uint64_t>(index_offset) + index_count <= mesh.index_count;
+    const bool is_vertex_offset_valid =
+        vertex_offset >= 0 &&
+        static_cast<uint32_t>(vertex_offset) < mesh.vertex_count;
+    if (index_count == 0 || index_count % 3 != 0 || !is_in_range ||
+        !is_vertex_offset_valid) {
+        RecordInvalidCall();
+        return;
+    }
+
+    ++stats_.draw_count;
+    stats_.drawn_index_count += index_count;
+}
+
+void NullRenderBackend::ResetFrameStats()
+{
+    stats_.bind_count = 0;
+    stats_.draw_count = 0;
+    stats_.drawn_index_count = 0;
+    stats_.invalid_call_count = 0;
+}
+
+void NullRenderBackend::RecordInvalidCall()
+{
+    ++stats_.invalid_call_count;
+    TM_BREAK();
+}
+
+}  // namespace tamarindo
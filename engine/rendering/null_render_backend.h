@@ -0,0 +1,88 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_NULL_RENDER_BACKEND_H_
+#define ENGINE_LIB_RENDERING_NULL_RENDER_BACKEND_H_
+
+#include "rendering/render_backend.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tamarindo
+{
+
+struct NullRenderBackendStats {
+    size_t shader_count = 0;
+    size_t mesh_count = 0;
+    // Vertex and index data handed to CreateMesh()
+    uint64_t uploaded_bytes = 0;
+
+    size_t bind_count = 0;
+    size_t draw_count = 0;
+    uint64_t drawn_index_count = 0;
+
+    // Calls that would have been an error on a real API. They are counted
+    // and dropped.
+    size_t invalid_call_count = 0;
+};
+
+// Backend that checks and counts every call and discards the work, so the
+// frame loop can run headless and measure the engine CPU cost alone.
+class NullRenderBackend : public RenderBackend
+{
+   public:
+    NullRenderBackend() = default;
+    ~NullRenderBackend() override = default;
+
+    uint32_t CreateShader(const std::string& source) override;
+    uint32_t CreateMesh(const std::vector<float>& vertex_data,
+                        const std::vector<unsigned int>& index_data) override;
+
+    void BindShader(uint32_t shader) override;
+    void BindMaterial(uint32_t material) override;
+    void BindMesh(uint32_t mesh) override;
+    void BindObjectConstants(uint32_t constants) override;
+    void DrawIndexed(uint32_t index_count, uint32_t index_offset,
+                     int32_t vertex_offset) override;
+
+    // Clears the call counters but keeps the resource ones, usually once
+    // per frame
+    void ResetFrameStats();
+
+    inline const NullRenderBackendStats& stats() const { return stats_; }
+
+   private:
+    struct Mesh {
+        uint32_t vertex_count;
+        uint32_t index_count;
+    };
+
+    void RecordInvalidCall();
+
+    uint32_t shader_count_ = 0;
+    std::vector<Mesh> meshes_;
+
+    uint32_t bound_shader_ = INVALID_HANDLE;
+    uint32_t bound_mesh_ = INVALID_HANDLE;
+
+    NullRenderBackendStats stats_;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_NULL_RENDER_BACKEND_H_
@@ -0,0 +1,390 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/occlusion_culler.h"
+
+#include "utils/cpu_features.h"
+#include "utils/macros.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+#ifdef TM_CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace tamarindo
+{
+
+namespace
+{
+
+constexpr unsigned int TILE_WIDTH = OcclusionCuller::TILE_WIDTH;
+constexpr unsigned int TILE_HEIGHT = OcclusionCuller::TILE_HEIGHT;
+constexpr uint32_t FULL_COVERAGE = 0xFFFFFFFFu;
+
+// Depth of a tile nothing has been rendered to
+constexpr float FAR_DEPTH = 1.0f;
+// Marks an empty working layer, nearer than any depth in [0, 1]
+constexpr float EMPTY_LAYER_DEPTH = 0.0f;
+
+// Vertices closer to the camera plane than this are not projected
+constexpr float MIN_CLIP_W = 1e-5f;
+
+// Three edge functions a * x + b * y + c, positive inside the triangle. A
+// pixel center is inside an edge when the function is >= threshold, which is
+// 0 for top-left edges and the smallest float otherwise, so pixels on an edge
+// shared by two triangles are only covered once.
+struct EdgeSetup {
+    float a[3];
+    float b[3];
+    float c[3];
+    float threshold[3];
+};
+
+uint32_t ComputeCoverageScalar(const EdgeSetup& edges, float tile_x,
+                               float tile_y)
+{
+    uint32_t coverage = 0;
+    for (unsigned int row = 0; row < TILE_HEIGHT; ++row) {
+        const float y = tile_y + row + 0.5f;
+        for (unsigned int col = 0; col < TILE_WIDTH; ++col) {
+            const float x = tile_x + col + 0.5f;
+            bool is_inside = true;
+            for (int e = 0; e < 3; ++e) {
+                is_inside &= edges.a[e] * x + edges.b[e] * y + edges.c[e] >=
+                             edges.threshold[e];
+            }
+            coverage |= static_cast<uint32_t>(is_inside)
+                        << (row * TILE_WIDTH + col);
+        }
+    }
+    return coverage;
+}
+
+#ifdef TM_CPU_X86
+
+// One row of the tile is exactly one AVX register
+TM_TARGET_AVX2 uint32_t ComputeCoverageAVX2(const EdgeSetup& edges,
+                                            float tile_x, float tile_y)
+{
+    static_assert(TILE_WIDTH == 8, "A tile row must fill an AVX register");
+
+    const __m256 x = _mm256_add_ps(
+        _mm256_set1_ps(tile_x),
+        _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+    const float y = tile_y + 0.5f;
+
+    __m256 values[3];
+    __m256 row_steps[3];
+    __m256 thresholds[3];
+    for (int e = 0; e < 3; ++e) {
+        values[e] = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edges.a[e]), x),
+                                  _mm256_set1_ps(edges.b[e] * y + edges.c[e]));
+        row_steps[e] = _mm256_set1_ps(edges.b[e]);
+        thresholds[e] = _mm256_set1_ps(edges.threshold[e]);
+    }
+
+    uint32_t coverage = 0;
+    for (unsigned int row = 0; row < TILE_HEIGHT; ++row) {
+        const __m256 inside = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(values[0], thresholds[0], _CMP_GE_OQ),
+                          _mm256_cmp_ps(values[1], thresholds[1], _CMP_GE_OQ)),
+            _mm256_cmp_ps(values[2], thresholds[2], _CMP_GE_OQ));
+        coverage |= static_cast<uint32_t>(_mm256_movemask_ps(inside))
+                    << (row * TILE_WIDTH);
+        for (int e = 0; e < 3; ++e) {
+            values[e] = _mm256_add_ps(values[e], row_steps[e]);
+        }
+    }
+    return coverage;
+}
+
+#endif  // TM_CPU_X86
+
+double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+}  // namespace
+
+OcclusionCuller::OcclusionCuller(const OcclusionCullerParams& params)
+    : width_((params.width + TILE_WIDTH - 1) / TILE_WIDTH * TILE_WIDTH),
+      height_((params.height + TILE_HEIGHT - 1) / TILE_HEIGHT * TILE_HEIGHT),
+      tiles_x_(width_ / TILE_WIDTH),
+      tiles_y_(height_ / TILE_HEIGHT),
+      tile_depth0_(tiles_x_ * tiles_y_, FAR_DEPTH),
+      tile_depth1_(tiles_x_ * tiles_y_, EMPTY_LAYER_DEPTH),
+      tile_coverage_(tiles_x_ * tiles_y_, 0),
+      use_avx2_(CpuSupportsAVX2())
+{
+    TM_ASSERT(tiles_x_ > 0 && tiles_y_ > 0);
+}
+
+void OcclusionCuller::BeginFrame(const DirectX::XMMATRIX& view_proj)
+{
+    view_proj_ = view_proj;
+    std::fill(tile_depth0_.begin(), tile_depth0_.end(), FAR_DEPTH);
+    std::fill(tile_depth1_.begin(), tile_depth1_.end(), EMPTY_LAYER_DEPTH);
+    std::fill(tile_coverage_.begin(), tile_coverage_.end(), 0);
+    stats_ = OcclusionCullerStats();
+}
+
+void OcclusionCuller::RenderOccluder(const float* vertices,
+                                     unsigned int vertex_stride,
+                                     const unsigned int* indices,
+                                     unsigned int index_count,
+                                     const DirectX::XMMATRIX& world)
+{
+    using namespace DirectX;
+
+    const auto start = std::chrono::steady_clock::now();
+    const XMMATRIX world_view_proj = XMMatrixMultiply(world, view_proj_);
+
+    for (unsigned int i = 0; i + 2 < index_count; i += 3) {
+        ScreenVertex screen[3];
+        bool is_projectable = true;
+        for (unsigned int v = 0; v < 3; ++v) {
+            const float* position = vertices + indices[i + v] * vertex_stride;
+            XMFLOAT4 clip;
+            XMStoreFloat4(&clip, XMVector3Transform(
+                                     XMVectorSet(position[0], position[1],
+                                                 position[2], 1.0f),
+                                     world_view_proj));
+            if (clip.w < MIN_CLIP_W) {
+                is_projectable = false;
+                break;
+            }
+            const float inv_w = 1.0f / clip.w;
+            screen[v].x = (clip.x * inv_w * 0.5f + 0.5f) * width_;
+            screen[v].y = (0.5f - clip.y * inv_w * 0.5f) * height_;
+            screen[v].z = clip.z * inv_w;
+        }
+        if (is_projectable) {
+            RasterizeTriangle(screen[0], screen[1], screen[2]);
+        }
+    }
+
+    stats_.rasterize_ms += ElapsedMs(start);
+}
+
+void OcclusionCuller::RasterizeTriangle(const ScreenVertex& v0,
+                                        const ScreenVertex& v1,
+                                        const ScreenVertex& v2)
+{
+    const float area = (v1.x - v0.x) * (v2.y - v0.y) -
+                       (v2.x - v0.x) * (v1.y - v0.y);
+    if (std::abs(area) < FLT_EPSILON) {
+        return;
+    }
+
+    const float min_z = std::min({v0.z, v1.z, v2.z});
+    const float max_z = std::max({v0.z, v1.z, v2.z});
+    if (max_z < 0.0f || min_z > FAR_DEPTH) {
+        return;
+    }
+
+    // Pixel bounds, tiles are visited when any of their pixels may be inside
+    const float min_x = std::max(std::min({v0.x, v1.x, v2.x}), 0.0f);
+    const float max_x =
+        std::min(std::max({v0.x, v1.x, v2.x}), static_cast<float>(width_));
+    const float min_y = std::max(std::min({v0.y, v1.y, v2.y}), 0.0f);
+    const float max_y =
+        std::min(std::max({v0.y, v1.y, v2.y}), static_cast<float>(height_));
+    if (min_x >= max_x || min_y >= max_y) {
+        return;
+    }
+
+    EdgeSetup edges;
+    const ScreenVertex* vertices[3] = {&v0, &v1, &v2};
+    const float sign = area > 0.0f ? 1.0f : -1.0f;
+    for (int e = 0; e < 3; ++e) {
+        const ScreenVertex& a = *vertices[e];
+        const ScreenVertex& b = *vertices[(e + 1) % 3];
+        edges.a[e] = sign * (a.y - b.y);
+        edges.b[e] = sign * (b.x - a.x);
+        edges.c[e] = sign * (a.x * b.y - a.y * b.x);
+        const bool is_top_left =
+            edges.a[e] > 0.0f || (edges.a[e] == 0.0f && edges.b[e] > 0.0f);
+        edges.threshold[e] = is_top_left ? 0.0f : FLT_MIN;
+    }
+
+    // z is linear in screen space: z = v0.z + dz_dx * dx + dz_dy * dy
+    const float dz_dx =
+        ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+    const float dz_dy =
+        ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+    // Largest change of z from the center of a tile to one of its corners
+    const float tile_dz = std::abs(dz_dx) * (TILE_WIDTH * 0.5f) +
+                          std::abs(dz_dy) * (TILE_HEIGHT * 0.5f);
+
+    const unsigned int tile_x0 = static_cast<unsigned int>(min_x) / TILE_WIDTH;
+    const unsigned int tile_x1 = std::min(
+        static_cast<unsigned int>(max_x) / TILE_WIDTH, tiles_x_ - 1);
+    const unsigned int tile_y0 = static_cast<unsigned int>(min_y) / TILE_HEIGHT;
+    const unsigned int tile_y1 = std::min(
+        static_cast<unsigned int>(max_y) / TILE_HEIGHT, tiles_y_ - 1);
+
+    for (unsigned int ty = tile_y0; ty <= tile_y1; ++ty) {
+        const float tile_y = static_cast<float>(ty * TILE_HEIGHT);
+        for (unsigned int tx = tile_x0; tx <= tile_x1; ++tx) {
+            const unsigned int tile = ty * tiles_x_ + tx;
+            if (min_z >= tile_depth0_[tile]) {
+                continue;
+            }
+
+            const float tile_x = static_cast<float>(tx * TILE_WIDTH);
+#ifdef TM_CPU_X86
+            const uint32_t coverage =
+                use_avx2_ ? ComputeCoverageAVX2(edges, tile_x, tile_y)
+                          : ComputeCoverageScalar(edges, tile_x, tile_y);
+#else
+            const uint32_t coverage =
+                ComputeCoverageScalar(edges, tile_x, tile_y);
+#endif
+            if (coverage == 0) {
+                continue;
+            }
+
+            const float center_z =
+                v0.z + dz_dx * (tile_x + TILE_WIDTH * 0.5f - v0.x) +
+                dz_dy * (tile_y + TILE_HEIGHT * 0.5f - v0.y);
+            UpdateTile(tile, coverage, std::min(center_z + tile_dz, max_z));
+        }
+    }
+
+    ++stats_.occluder_triangle_count;
+}
+
+void OcclusionCuller::UpdateTile(unsigned int tile, uint32_t coverage,
+                                 float triangle_depth)
+{
+    float& depth0 = tile_depth0_[tile];
+    float& depth1 = tile_depth1_[tile];
+    uint32_t& mask = tile_coverage_[tile];
+
+    // Layer 0 already bounds every pixel of the tile
+    if (triangle_depth >= depth0) {
+        return;
+    }
+
+    // When the triangle is much nearer than the working layer, merging would
+    // push the layer far away, so it is better to restart it from scratch.
+    // Much nearer means further in front of the layer than the layer is in
+    // front of layer 0.
+    if (depth1 - triangle_depth > depth0 - depth1) {
+        depth1 = EMPTY_LAYER_DEPTH;
+        mask = 0;
+    }
+
+    depth1 = std::max(depth1, triangle_depth);
+    mask |= coverage;
+    if (mask == FULL_COVERAGE) {
+        depth0 = depth1;
+        depth1 = EMPTY_LAYER_DEPTH;
+        mask = 0;
+    }
+}
+
+bool OcclusionCuller::IsVisible(const DirectX::BoundingBox& world_bounds)
+{
+    using namespace DirectX;
+
+    ++stats_.tested_count;
+
+    XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+    world_bounds.GetCorners(corners);
+
+    float min_x = FLT_MAX;
+    float max_x = -FLT_MAX;
+    float min_y = FLT_MAX;
+    float max_y = -FLT_MAX;
+    float min_z = FLT_MAX;
+    for (const XMFLOAT3& corner : corners) {
+        XMFLOAT4 clip;
+        XMStoreFloat4(&clip,
+                      XMVector3Transform(XMLoadFloat3(&corner), view_proj_));
+        // Boxes reaching behind the camera can not be projected
+        if (clip.w < MIN_CLIP_W) {
+            return true;
+        }
+        const float inv_w = 1.0f / clip.w;
+        const float x = (clip.x * inv_w * 0.5f + 0.5f) * width_;
+        const float y = (0.5f - clip.y * inv_w * 0.5f) * height_;
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        min_z = std::min(min_z, clip.z * inv_w);
+    }
+
+    // Off-screen boxes are left to the frustum culling
+    if (min_z <= 0.0f || max_x < 0.0f || max_y < 0.0f ||
+        min_x >= static_cast<float>(width_) ||
+        min_y >= static_cast<float>(height_)) {
+        return true;
+    }
+
+    const unsigned int tile_x0 =
+        static_cast<unsigned int>(std::max(min_x, 0.0f)) / TILE_WIDTH;
+    const unsigned int tile_x1 = std::min(
+        static_cast<unsigned int>(max_x) / TILE_WIDTH, tiles_x_ - 1);
+    const unsigned int tile_y0 =
+        static_cast<unsigned int>(std::max(min_y, 0.0f)) / TILE_HEIGHT;
+    const unsigned int tile_y1 = std::min(
+        static_cast<unsigned int>(max_y) / TILE_HEIGHT, tiles_y_ - 1);
+
+    for (unsigned int ty = tile_y0; ty <= tile_y1; ++ty) {
+        const float* row = tile_depth0_.data() + ty * tiles_x_;
+        for (unsigned int tx = tile_x0; tx <= tile_x1; ++tx) {
+            if (min_z <= row[tx]) {
+                return true;
+            }
+        }
+    }
+
+    ++stats_.occluded_count;
+    return false;
+}
+
+void OcclusionCuller::Cull(const std::vector<DirectX::BoundingBox>& bounds,
+                           std::vector<unsigned int>* ids)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    size_t visible_count = 0;
+    for (const unsigned int id : *ids) {
+        if (IsVisible(bounds[id])) {
+            (*ids)[visible_count++] = id;
+        }
+    }
+    ids->resize(visible_count);
+
+    stats_.test_ms += ElapsedMs(start);
+}
+
+float OcclusionCuller::GetTileDepth(unsigned int x, unsigned int y) const
+{
+    TM_ASSERT(x < width_ && y < height_);
+    return tile_depth0_[(y / TILE_HEIGHT) * tiles_x_ + x / TILE_WIDTH];
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,120 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_OCCLUSION_CULLER_H_
+#define ENGINE_LIB_RENDERING_OCCLUSION_CULLER_H_
+
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace tamarindo
+{
+
+struct OcclusionCullerParams {
+    // Resolution of the depth buffer. Rounded up to whole tiles.
+    unsigned int width = 256;
+    unsigned int height = 128;
+};
+
+// Per-frame counters, reset by BeginFrame()
+struct OcclusionCullerStats {
+    unsigned int occluder_triangle_count = 0;
+    unsigned int tested_count = 0;
+    unsigned int occluded_count = 0;
+    double rasterize_ms = 0.0;
+    double test_ms = 0.0;
+};
+
+// CPU occlusion culling on a low resolution masked depth buffer. Occluder
+// triangles are rasterized into tiles of 8x4 pixels. Each tile keeps a
+// conservative far depth for the whole tile plus a working layer with a
+// 32-bit coverage mask, so a tile becomes fully known once several triangles
+// cover it together. Bounds are then tested against the far depth of every
+// tile they overlap. Nothing here touches the GPU.
+class OcclusionCuller
+{
+   public:
+    static constexpr unsigned int TILE_WIDTH = 8;
+    static constexpr unsigned int TILE_HEIGHT = 4;
+
+    OcclusionCuller() = delete;
+    explicit OcclusionCuller(const OcclusionCullerParams& params);
+    ~OcclusionCuller() = default;
+
+    // Clears the depth buffer and the counters for a new camera
+    void BeginFrame(const DirectX::XMMATRIX& view_proj);
+
+    // Rasterizes indexed triangles. Positions are the first three floats of
+    // every vertex, `vertex_stride` floats apart. Triangles crossing the near
+    // plane are skipped, which only makes the result more conservative.
+    void RenderOccluder(const float* vertices, unsigned int vertex_stride,
+                        const unsigned int* indices, unsigned int index_count,
+                        const DirectX::XMMATRIX& world);
+
+    // True unless the box is fully hidden behind the rendered occluders
+    bool IsVisible(const DirectX::BoundingBox& world_bounds);
+
+    // Removes from `ids` the entries whose bounds[id] are hidden
+    void Cull(const std::vector<DirectX::BoundingBox>& bounds,
+              std::vector<unsigned int>* ids);
+
+    inline const OcclusionCullerStats& stats() const { return stats_; }
+
+    inline unsigned int width() const { return width_; }
+    inline unsigned int height() const { return height_; }
+
+    // Conservative far depth of the tile that contains pixel (x, y)
+    float GetTileDepth(unsigned int x, unsigned int y) const;
+
+   private:
+    // Test seam, drives UpdateTile() on single tiles and reads them back
+    friend class OcclusionCullerTester;
+
+    struct ScreenVertex {
+        float x;
+        float y;
+        float z;
+    };
+
+    void RasterizeTriangle(const ScreenVertex& v0, const ScreenVertex& v1,
+                           const ScreenVertex& v2);
+
+    void UpdateTile(unsigned int tile, uint32_t coverage, float triangle_depth);
+
+    unsigned int width_;
+    unsigned int height_;
+    unsigned int tiles_x_;
+    unsigned int tiles_y_;
+
+    DirectX::XMMATRIX view_proj_ = DirectX::XMMatrixIdentity();
+
+    // One entry per tile. Layer 0 is the far depth of the whole tile, layer
+    // 1 the far depth of the pixels set in the coverage mask.
+    std::vector<float> tile_depth0_;
+    std::vector<float> tile_depth1_;
+    std::vector<uint32_t> tile_coverage_;
+
+    bool use_avx2_;
+
+    OcclusionCullerStats stats_;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_OCCLUSION_CULLER_H_
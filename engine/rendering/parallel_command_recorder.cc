@@ -0,0 +1,83 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/parallel_command_recorder.h"
+
+#include "utils/frame_worker.h"
+#include "utils/macros.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace tamarindo
+{
+
+ParallelCommandRecorder::ParallelCommandRecorder(
+    const ParallelCommandRecorderParams& params)
+    : params_(params)
+{
+    TM_ASSERT(params_.min_draws_per_thread > 0);
+    unsigned int thread_count = params_.thread_count;
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned int i = 1; i < thread_count; ++i) {
+        workers_.push_back(std::make_unique<FrameWorker>());
+    }
+    thread_buffers_.resize(thread_count);
+}
+
+ParallelCommandRecorder::~ParallelCommandRecorder() = default;
+
+void ParallelCommandRecorder::Record(size_t draw_count,
+                                     const RecordFunction& record,
+                                     CommandBuffer* output)
+{
+    const size_t used_threads = std::min<size_t>(
+        thread_count(),
+        std::max<size_t>(1, draw_count / params_.min_draws_per_thread));
+    if (used_threads == 1) {
+        output->Reset();
+        record(0, draw_count, output);
+        output->Sort();
+        return;
+    }
+
+    const size_t slice_size = (draw_count + used_threads - 1) / used_threads;
+    const auto record_slice = [this, draw_count, slice_size,
+                               &record](size_t thread) {
+        const size_t begin = std::min(thread * slice_size, draw_count);
+        const size_t end = std::min(begin + slice_size, draw_count);
+        CommandBuffer& buffer = thread_buffers_[thread];
+        buffer.Reset();
+        record(begin, end, &buffer);
+        buffer.Sort();
+    };
+
+    for (size_t thread = 1; thread < used_threads; ++thread) {
+        workers_[thread - 1]->Start(
+            [&record_slice, thread] { record_slice(thread); });
+    }
+    record_slice(0);
+    for (size_t thread = 1; thread < used_threads; ++thread) {
+        workers_[thread - 1]->Wait();
+    }
+
+    output->MergeSorted(thread_buffers_.data(), used_threads);
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,80 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_PARALLEL_COMMAND_RECORDER_H_
+#define ENGINE_LIB_RENDERING_PARALLEL_COMMAND_RECORDER_H_
+
+#include "rendering/command_buffer.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace tamarindo
+{
+
+class FrameWorker;
+
+struct ParallelCommandRecorderParams {
+    // Threads recording draws, the calling thread included. Zero uses one
+    // per hardware thread.
+    unsigned int thread_count = 0;
+    // Slices never get smaller than this, small draw lists are recorded on
+    // the calling thread alone
+    size_t min_draws_per_thread = 512;
+};
+
+// Splits draw recording across worker threads. Every thread fills and sorts
+// its own command buffer over a contiguous slice of the draw list, without
+// sharing any lock, and the buffers are merged into one sorted buffer.
+class ParallelCommandRecorder
+{
+   public:
+    // Records the draws [begin, end) into `buffer`. Called concurrently on
+    // disjoint ranges, so it must only write to `buffer`.
+    using RecordFunction =
+        std::function<void(size_t begin, size_t end, CommandBuffer* buffer)>;
+
+    ParallelCommandRecorder() = delete;
+    explicit ParallelCommandRecorder(
+        const ParallelCommandRecorderParams& params);
+    ~ParallelCommandRecorder();
+
+    ParallelCommandRecorder(const ParallelCommandRecorder& other) = delete;
+    ParallelCommandRecorder& operator=(const ParallelCommandRecorder& other) =
+        delete;
+
+    // Records `draw_count` draws and leaves them sorted by key in `output`
+    void Record(size_t draw_count, const RecordFunction& record,
+                CommandBuffer* output);
+
+    inline unsigned int thread_count() const
+    {
+        return static_cast<unsigned int>(workers_.size() + 1);
+    }
+
+   private:
+    ParallelCommandRecorderParams params_;
+
+    // The calling thread records the first slice, so there is one worker
+    // less than threads
+    std::vector<std::unique_ptr<FrameWorker>> workers_;
+    std::vector<CommandBuffer> thread_buffers_;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_PARALLEL_COMMAND_RECORDER_H_
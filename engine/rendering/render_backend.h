@@ -0,0 +1,66 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_RENDER_BACKEND_H_
+#define ENGINE_LIB_RENDERING_RENDER_BACKEND_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tamarindo
+{
+
+// Creates the resources of a frame and receives the commands replayed by a
+// CommandBuffer. Resources are referred to by handles the backend hands out,
+// so the commands carry no API types. Binds are only issued when the handle
+// changes from the previous command.
+class RenderBackend
+{
+   public:
+    RenderBackend() = default;
+    virtual ~RenderBackend() = default;
+
+    // Returned by the create calls when they fail
+    static constexpr uint32_t INVALID_HANDLE = UINT32_MAX;
+
+    // Floats per vertex of a mesh, position followed by UV
+    static constexpr uint32_t MESH_VERTEX_FLOAT_COUNT = 5;
+
+    // Shader taking the mesh vertex layout
+    virtual uint32_t CreateShader(const std::string& source) = 0;
+
+    virtual uint32_t CreateMesh(
+        const std::vector<float>& vertex_data,
+        const std::vector<unsigned int>& index_data) = 0;
+
+    virtual void BindShader(uint32_t shader) = 0;
+
+    virtual void BindMaterial(uint32_t material) = 0;
+
+    // Vertex and index buffers
+    virtual void BindMesh(uint32_t mesh) = 0;
+
+    // Per-object constants, such as the model matrix
+    virtual void BindObjectConstants(uint32_t constants) = 0;
+
+    virtual void DrawIndexed(uint32_t index_count, uint32_t index_offset,
+                             int32_t vertex_offset) = 0;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_RENDER_BACKEND_H_
@@ -0,0 +1,312 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/render_graph.h"
+
+#include "logging/logger.h"
+#include "utils/macros.h"
+
+#include <algorithm>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+size_t GetBytesPerPixel(DXGI_FORMAT format)
+{
+    switch (format) {
+        case DXGI_FORMAT_R8_UNORM:
+            return 1;
+        case DXGI_FORMAT_R8G8_UNORM:
+        case DXGI_FORMAT_R16_FLOAT:
+        case DXGI_FORMAT_D16_UNORM:
+            return 2;
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R32G32_FLOAT:
+            return 8;
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            return 16;
+        default:
+            // Every other render target format we use is 32 bits
+            return 4;
+    }
+}
+
+size_t GetTextureBytes(const TransientTextureDesc& desc)
+{
+    return static_cast<size_t>(desc.width) * desc.height *
+           GetBytesPerPixel(desc.format);
+}
+
+}  // namespace
+
+RenderGraphBuilder::RenderGraphBuilder(RenderGraph* graph,
+                                       unsigned int pass_index)
+    : graph_(graph), pass_index_(pass_index)
+{
+}
+
+RenderGraphTexture RenderGraphBuilder::CreateTexture(
+    const char* name, const TransientTextureDesc& desc)
+{
+    RenderGraph::Texture texture = {};
+    texture.name = name;
+    texture.is_imported = false;
+    texture.desc = desc;
+    texture.physical_index = -1;
+    graph_->textures_.push_back(texture);
+    return static_cast<RenderGraphTexture>(graph_->textures_.size() - 1);
+}
+
+void RenderGraphBuilder::Read(RenderGraphTexture texture)
+{
+    TM_ASSERT(texture < graph_->textures_.size());
+    graph_->passes_[pass_index_].reads.push_back(texture);
+}
+
+void RenderGraphBuilder::Write(RenderGraphTexture texture)
+{
+    TM_ASSERT(texture < graph_->textures_.size());
+    graph_->passes_[pass_index_].writes.push_back(texture);
+}
+
+void RenderGraphBuilder::SetSideEffects()
+{
+    graph_->passes_[pass_index_].has_side_effects = true;
+}
+
+void RenderGraph::Reset()
+{
+    textures_.clear();
+    passes_.clear();
+    execution_order_.clear();
+    physical_descs_.clear();
+    physical_textures_.clear();
+    stats_ = RenderGraphStats();
+}
+
+RenderGraphTexture RenderGraph::ImportTexture(
+    const char* name, ID3D11RenderTargetView* render_target_view,
+    ID3D11DepthStencilView* depth_stencil_view,
+    ID3D11ShaderResourceView* shader_resource_view)
+{
+    Texture texture = {};
+    texture.name = name;
+    texture.is_imported = true;
+    texture.render_target_view = render_target_view;
+    texture.depth_stencil_view = depth_stencil_view;
+    texture.shader_resource_view = shader_resource_view;
+    texture.physical_index = -1;
+    textures_.push_back(texture);
+    return static_cast<RenderGraphTexture>(textures_.size() - 1);
+}
+
+void RenderGraph::AddPass(const char* name, const SetupFunction& setup,
+                          ExecuteFunction execute)
+{
+    Pass pass;
+    pass.name = name;
+    pass.has_side_effects = false;
+    pass.is_culled = false;
+    pass.execute = std::move(execute);
+    passes_.push_back(std::move(pass));
+
+    RenderGraphBuilder builder(this,
+                               static_cast<unsigned int>(passes_.size() - 1));
+    setup(&builder);
+}
+
+void RenderGraph::Compile()
+{
+    CullPasses();
+    ComputeLifetimes();
+    AssignPhysicalTextures();
+}
+
+void RenderGraph::CullPasses()
+{
+    // Walk back from the passes that must run. A pass is needed if it
+    // writes something a needed pass reads.
+    std::vector<bool> is_needed(textures_.size(), false);
+    for (size_t i = 0; i < textures_.size(); ++i) {
+        is_needed[i] = textures_[i].is_imported;
+    }
+
+    for (size_t i = passes_.size(); i-- > 0;) {
+        Pass& pass = passes_[i];
+        bool is_kept = pass.has_side_effects;
+        for (const RenderGraphTexture texture : pass.writes) {
+            is_kept = is_kept || is_needed[texture];
+        }
+
+        pass.is_culled = !is_kept;
+        if (is_kept) {
+            for (const RenderGraphTexture texture : pass.reads) {
+                is_needed[texture] = true;
+            }
+        }
+    }
+
+    execution_order_.clear();
+    for (unsigned int i = 0; i < passes_.size(); ++i) {
+        if (!passes_[i].is_culled) {
+            execution_order_.push_back(i);
+        }
+    }
+
+    stats_.pass_count = static_cast<unsigned int>(passes_.size());
+    stats_.culled_pass_count =
+        stats_.pass_count - static_cast<unsigned int>(execution_order_.size());
+}
+
+void RenderGraph::ComputeLifetimes()
+{
+    for (Texture& texture : textures_) {
+        texture.first_use = NO_PASS;
+        texture.last_use = NO_PASS;
+    }
+
+    std::vector<bool> is_written(textures_.size(), false);
+    for (unsigned int step = 0; step < execution_order_.size(); ++step) {
+        const Pass& pass = passes_[execution_order_[step]];
+        for (const RenderGraphTexture texture : pass.reads) {
+            if (!textures_[texture].is_imported && !is_written[texture]) {
+                TM_LOG_WARN("Pass {} reads {} before any pass writes it",
+                            pass.name, textures_[texture].name);
+            }
+        }
+
+        const auto use = [this, step](RenderGraphTexture texture) {
+            Texture& t = textures_[texture];
+            if (t.first_use == NO_PASS) {
+                t.first_use = step;
+            }
+            t.last_use = step;
+        };
+        std::for_each(pass.reads.begin(), pass.reads.end(), use);
+        std::for_each(pass.writes.begin(), pass.writes.end(), use);
+        for (const RenderGraphTexture texture : pass.writes) {
+            is_written[texture] = true;
+        }
+    }
+}
+
+void RenderGraph::AssignPhysicalTextures()
+{
+    // Transients sorted by the step they start at
+    std::vector<RenderGraphTexture> transients;
+    for (RenderGraphTexture i = 0; i < textures_.size(); ++i) {
+        const Texture& texture = textures_[i];
+        if (!texture.is_imported && texture.first_use != NO_PASS) {
+            transients.push_back(i);
+        }
+    }
+    std::stable_sort(transients.begin(), transients.end(),
+                     [this](RenderGraphTexture a, RenderGraphTexture b) {
+                         return textures_[a].first_use <
+                                textures_[b].first_use;
+                     });
+
+    // Step after which each physical texture is free again
+    std::vector<unsigned int> physical_last_use;
+    physical_descs_.clear();
+    stats_.transient_bytes = 0;
+    stats_.physical_bytes = 0;
+
+    for (const RenderGraphTexture index : transients) {
+        Texture& texture = textures_[index];
+        stats_.transient_bytes += GetTextureBytes(texture.desc);
+
+        // A texture used until step N can back one that starts after N. Two
+        // textures used by the same pass never alias.
+        int physical_index = -1;
+        for (size_t i = 0; i < physical_descs_.size(); ++i) {
+            if (physical_last_use[i] < texture.first_use &&
+                physical_descs_[i] == texture.desc) {
+                physical_index = static_cast<int>(i);
+                break;
+            }
+        }
+        if (physical_index == -1) {
+            physical_index = static_cast<int>(physical_descs_.size());
+            physical_descs_.push_back(texture.desc);
+            physical_last_use.push_back(0);
+            stats_.physical_bytes += GetTextureBytes(texture.desc);
+        }
+
+        texture.physical_index = physical_index;
+        physical_last_use[physical_index] = texture.last_use;
+    }
+
+    stats_.transient_texture_count =
+        static_cast<unsigned int>(transients.size());
+    stats_.physical_texture_count =
+        static_cast<unsigned int>(physical_descs_.size());
+}
+
+bool RenderGraph::Execute(TransientTexturePool* pool)
+{
+    pool->BeginFrame();
+    physical_textures_.resize(physical_descs_.size());
+    for (size_t i = 0; i < physical_descs_.size(); ++i) {
+        physical_textures_[i] = pool->Acquire(physical_descs_[i]);
+        if (physical_textures_[i] == nullptr) {
+            return false;
+        }
+    }
+
+    for (const unsigned int pass_index : execution_order_) {
+        passes_[pass_index].execute(*this);
+    }
+    return true;
+}
+
+ID3D11RenderTargetView* RenderGraph::GetRenderTargetView(
+    RenderGraphTexture texture) const
+{
+    const Texture& t = textures_[texture];
+    if (t.is_imported) {
+        return t.render_target_view;
+    }
+    TM_ASSERT(t.physical_index >= 0);
+    return physical_textures_[t.physical_index]->render_target_view.Get();
+}
+
+ID3D11DepthStencilView* RenderGraph::GetDepthStencilView(
+    RenderGraphTexture texture) const
+{
+    const Texture& t = textures_[texture];
+    if (t.is_imported) {
+        return t.depth_stencil_view;
+    }
+    TM_ASSERT(t.physical_index >= 0);
+    return physical_textures_[t.physical_index]->depth_stencil_view.Get();
+}
+
+ID3D11ShaderResourceView* RenderGraph::GetShaderResourceView(
+    RenderGraphTexture texture) const
+{
+    const Texture& t = textures_[texture];
+    if (t.is_imported) {
+        return t.shader_resource_view;
+    }
+    TM_ASSERT(t.physical_index >= 0);
+    return physical_textures_[t.physical_index]->shader_resource_view.Get();
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,183 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_RENDER_GRAPH_H_
+#define ENGINE_LIB_RENDERING_RENDER_GRAPH_H_
+
+#include "rendering/transient_texture_pool.h"
+
+#include <d3d11.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace tamarindo
+{
+
+class RenderGraph;
+
+// Handle of a texture in a render graph, valid until the graph is reset
+using RenderGraphTexture = uint32_t;
+
+struct RenderGraphStats {
+    unsigned int pass_count = 0;
+    unsigned int culled_pass_count = 0;
+    // Transient textures used by the passes that were kept
+    unsigned int transient_texture_count = 0;
+    // Textures backing them after aliasing
+    unsigned int physical_texture_count = 0;
+    size_t transient_bytes = 0;
+    size_t physical_bytes = 0;
+};
+
+// Declares what a pass reads and writes. Only valid inside the setup
+// function given to RenderGraph::AddPass().
+class RenderGraphBuilder
+{
+   public:
+    // The texture only lives between the first and the last pass that use
+    // it, and shares memory with other transients outside of that range
+    RenderGraphTexture CreateTexture(const char* name,
+                                     const TransientTextureDesc& desc);
+
+    void Read(RenderGraphTexture texture);
+    void Write(RenderGraphTexture texture);
+
+    // Keeps the pass even if nothing reads what it writes
+    void SetSideEffects();
+
+   private:
+    friend class RenderGraph;
+
+    RenderGraphBuilder(RenderGraph* graph, unsigned int pass_index);
+
+    RenderGraph* graph_;
+    unsigned int pass_index_;
+};
+
+// Frame graph rebuilt every frame. Passes declare the textures they read
+// and write, then Compile() culls the passes whose results are never used
+// and assigns the transient textures to pooled ones. Transients whose
+// lifetimes do not overlap share the same texture, which is how D3D11 can
+// alias them without placed resources.
+//
+// Passes run in the order they were added. That order always respects the
+// dependencies, a pass can only read what an earlier pass wrote.
+class RenderGraph
+{
+   public:
+    using SetupFunction = std::function<void(RenderGraphBuilder* builder)>;
+    using ExecuteFunction = std::function<void(const RenderGraph& graph)>;
+
+    RenderGraph() = default;
+    ~RenderGraph() = default;
+
+    RenderGraph(const RenderGraph& other) = delete;
+    RenderGraph& operator=(const RenderGraph& other) = delete;
+
+    // Drops the passes and textures of the previous frame
+    void Reset();
+
+    // Textures owned outside of the graph, like the back buffer. Passes
+    // writing them are never culled. Views that do not apply can be null.
+    RenderGraphTexture ImportTexture(
+        const char* name, ID3D11RenderTargetView* render_target_view,
+        ID3D11DepthStencilView* depth_stencil_view,
+        ID3D11ShaderResourceView* shader_resource_view);
+
+    // Calls `setup` right away to collect the reads and writes of the pass
+    void AddPass(const char* name, const SetupFunction& setup,
+                 ExecuteFunction execute);
+
+    void Compile();
+
+    // Acquires the physical textures from `pool` and runs the passes that
+    // were not culled. Returns false if a texture could not be created.
+    bool Execute(TransientTexturePool* pool);
+
+    // Views of a texture, only valid while the passes execute
+    ID3D11RenderTargetView* GetRenderTargetView(
+        RenderGraphTexture texture) const;
+    ID3D11DepthStencilView* GetDepthStencilView(
+        RenderGraphTexture texture) const;
+    ID3D11ShaderResourceView* GetShaderResourceView(
+        RenderGraphTexture texture) const;
+
+    // Index of the pooled texture backing a transient after Compile(), or
+    // -1 if no kept pass uses it
+    inline int GetPhysicalIndex(RenderGraphTexture texture) const
+    {
+        return textures_[texture].physical_index;
+    }
+
+    inline bool IsPassCulled(unsigned int pass_index) const
+    {
+        return passes_[pass_index].is_culled;
+    }
+
+    inline const RenderGraphStats& stats() const { return stats_; }
+
+   private:
+    friend class RenderGraphBuilder;
+
+    static constexpr unsigned int NO_PASS = UINT32_MAX;
+
+    struct Texture {
+        std::string name;
+        bool is_imported;
+        TransientTextureDesc desc;
+
+        ID3D11RenderTargetView* render_target_view;
+        ID3D11DepthStencilView* depth_stencil_view;
+        ID3D11ShaderResourceView* shader_resource_view;
+
+        // Positions in execution_order_ of the first and last kept pass
+        // using the texture
+        unsigned int first_use;
+        unsigned int last_use;
+        int physical_index;
+    };
+
+    struct Pass {
+        std::string name;
+        std::vector<RenderGraphTexture> reads;
+        std::vector<RenderGraphTexture> writes;
+        bool has_side_effects;
+        bool is_culled;
+        ExecuteFunction execute;
+    };
+
+    void CullPasses();
+    void ComputeLifetimes();
+    void AssignPhysicalTextures();
+
+    std::vector<Texture> textures_;
+    std::vector<Pass> passes_;
+
+    // Indices of the kept passes
+    std::vector<unsigned int> execution_order_;
+    std::vector<TransientTextureDesc> physical_descs_;
+    // Filled by Execute()
+    std::vector<TransientTexture*> physical_textures_;
+
+    RenderGraphStats stats_;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_RENDER_GRAPH_H_
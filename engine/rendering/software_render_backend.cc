@@ -0,0 +1,605 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/software_render_backend.h"
+
+#include "utils/cpu_features.h"
+#include "utils/frame_worker.h"
+#include "utils/macros.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#ifdef TM_CPU_X86
+#include <immintrin.h>
+#endif
+
+namespace tamarindo
+{
+
+namespace
+{
+
+// Bytes of a model matrix in the object constants
+constexpr size_t MATRIX_SIZE = 16 * sizeof(float);
+// Object constant offsets are counted in 16-byte constants, as in D3D11
+constexpr size_t CONSTANT_SIZE = 16;
+
+// Rounds half to even like _mm_cvtps_epi32, so both paths give the same
+// bytes
+uint32_t PackColor(float r, float g, float b, float a)
+{
+    const auto to_byte = [](float value) {
+        return static_cast<uint32_t>(
+            std::nearbyint(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+    };
+    return to_byte(r) | (to_byte(g) << 8) | (to_byte(b) << 16) |
+           (to_byte(a) << 24);
+}
+
+}  // namespace
+
+SoftwareRenderBackend::SoftwareRenderBackend(
+    const SoftwareRenderBackendParams& params)
+    : width_(params.width), height_(params.height)
+{
+    TM_ASSERT(width_ > 0 && height_ > 0);
+    tile_count_x_ = (width_ + TILE_SIZE - 1) / TILE_SIZE;
+    tile_count_y_ = (height_ + TILE_SIZE - 1) / TILE_SIZE;
+
+    // Rows are padded to whole tiles, so the four pixel steps never need to
+    // check the right border
+    row_pitch_ = static_cast<size_t>(tile_count_x_) * TILE_SIZE;
+    const size_t pixel_count =
+        row_pitch_ * static_cast<size_t>(tile_count_y_) * TILE_SIZE;
+    color_.resize(pixel_count, 0);
+    depth_.resize(pixel_count, MAX_DEPTH);
+    tile_bins_.resize(static_cast<size_t>(tile_count_x_) * tile_count_y_);
+
+    unsigned int thread_count = params.thread_count;
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned int i = 1; i < thread_count; ++i) {
+        workers_.push_back(std::make_unique<FrameWorker>());
+    }
+
+    // Identity until the scene constants are set
+    for (int i = 0; i < 16; ++i) {
+        view_projection_[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    }
+}
+
+SoftwareRenderBackend::~SoftwareRenderBackend() = default;
+
+uint32_t SoftwareRenderBackend::CreateShader(const std::string& source)
+{
+    if (source.empty()) {
+        return INVALID_HANDLE;
+    }
+    return shader_count_++;
+}
+
+uint32_t SoftwareRenderBackend::CreateMesh(
+    const std::vector<float>& vertex_data,
+    const std::vector<unsigned int>& index_data)
+{
+    if (vertex_data.size() % MESH_VERTEX_FLOAT_COUNT != 0 ||
+        index_data.size() % 3 != 0) {
+        return INVALID_HANDLE;
+    }
+
+    Mesh mesh;
+    mesh.vertices = vertex_data;
+    mesh.indices = index_data;
+    meshes_.push_back(std::move(mesh));
+    return static_cast<uint32_t>(meshes_.size() - 1);
+}
+
+void SoftwareRenderBackend::BindShader(uint32_t shader)
+{
+    TM_ASSERT(shader < shader_count_);
+    bound_shader_ = shader;
+}
+
+void SoftwareRenderBackend::BindMaterial(uint32_t /*material*/)
+{
+    // The program outputs the UVs, there is nothing to sample yet
+}
+
+void SoftwareRenderBackend::BindMesh(uint32_t mesh)
+{
+    TM_ASSERT(mesh < meshes_.size());
+    bound_mesh_ = mesh;
+}
+
+void SoftwareRenderBackend::BindObjectConstants(uint32_t constants)
+{
+    TM_ASSERT(constants * CONSTANT_SIZE + MATRIX_SIZE <=
+              object_constants_size_);
+    bound_object_constants_ = constants;
+    is_transform_dirty_ = true;
+}
+
+void SoftwareRenderBackend::DrawIndexed(uint32_t index_count,
+                                        uint32_t index_offset,
+                                        int32_t vertex_offset)
+{
+    if (bound_shader_ == INVALID_HANDLE || bound_mesh_ == INVALID_HANDLE ||
+        bound_object_constants_ == INVALID_HANDLE) {
+        TM_BREAK();
+        return;
+    }
+
+    const Mesh& mesh = meshes_[bound_mesh_];
+    if (static_cast<uint64_t>(index_offset) + index_count >
+        mesh.indices.size()) {
+        TM_BREAK();
+        return;
+    }
+
+    if (is_transform_dirty_) {
+        UpdateTransform();
+    }
+
+    ++stats_.draw_count;
+    const size_t vertex_count = mesh.vertices.size() / MESH_VERTEX_FLOAT_COUNT;
+    const float* t = transform_;
+
+    // Vertex program of SHADER_CODE: position times model and view
+    // projection, the UVs passed through
+    const auto transform_vertex = [&](unsigned int index, ClipVertex* out) {
+        const int64_t vertex = static_cast<int64_t>(index) + vertex_offset;
+        if (vertex < 0 || static_cast<size_t>(vertex) >= vertex_count) {
+            return false;
+        }
+        const float* v = &mesh.vertices[vertex * MESH_VERTEX_FLOAT_COUNT];
+        out->x = v[0] * t[0] + v[1] * t[4] + v[2] * t[8] + t[12];
+        out->y = v[0] * t[1] + v[1] * t[5] + v[2] * t[9] + t[13];
+        out->z = v[0] * t[2] + v[1] * t[6] + v[2] * t[10] + t[14];
+        out->w = v[0] * t[3] + v[1] * t[7] + v[2] * t[11] + t[15];
+        out->u = v[3];
+        out->v = v[4];
+        return true;
+    };
+
+    const auto near_distance = [](const ClipVertex& v) { return v.z; };
+    const auto far_distance = [](const ClipVertex& v) { return v.w - v.z; };
+
+    for (uint32_t i = 0; i + 2 < index_count; i += 3) {
+        const unsigned int* indices = &mesh.indices[index_offset + i];
+        ClipVertex vertices[3];
+        if (!transform_vertex(indices[0], &vertices[0]) ||
+            !transform_vertex(indices[1], &vertices[1]) ||
+            !transform_vertex(indices[2], &vertices[2])) {
+            TM_BREAK();
+            return;
+        }
+        ++stats_.triangle_count;
+
+        bool is_inside = true;
+        bool is_outside = false;
+        for (int plane = 0; plane < 2; ++plane) {
+            int outside_count = 0;
+            for (const ClipVertex& v : vertices) {
+                const float d = plane == 0 ? near_distance(v) : far_distance(v);
+                outside_count += d < 0.0f ? 1 : 0;
+            }
+            is_inside = is_inside && outside_count == 0;
+            is_outside = is_outside || outside_count == 3;
+        }
+
+        if (is_outside) {
+            ++stats_.culled_triangle_count;
+            continue;
+        }
+        if (is_inside) {
+            SetupTriangle(vertices[0], vertices[1], vertices[2]);
+            continue;
+        }
+
+        // Each plane can add one vertex
+        ClipVertex near_clipped[4];
+        ClipVertex clipped[5];
+        const int near_count =
+            ClipPolygon(vertices, 3, near_clipped, near_distance);
+        const int count =
+            ClipPolygon(near_clipped, near_count, clipped, far_distance);
+        if (count < 3) {
+            ++stats_.culled_triangle_count;
+            continue;
+        }
+        stats_.clipped_triangle_count += count - 3;
+        for (int v = 1; v + 1 < count; ++v) {
+            SetupTriangle(clipped[0], clipped[v], clipped[v + 1]);
+        }
+    }
+}
+
+void SoftwareRenderBackend::BeginFrame(const float clear_color[4])
+{
+    const uint32_t color = PackColor(clear_color[0], clear_color[1],
+                                     clear_color[2], clear_color[3]);
+    std::fill(color_.begin(), color_.end(), color);
+    std::fill(depth_.begin(), depth_.end(), MAX_DEPTH);
+
+    triangles_.clear();
+    for (std::vector<uint32_t>& bin : tile_bins_) {
+        bin.clear();
+    }
+    stats_ = SoftwareRenderStats();
+}
+
+void SoftwareRenderBackend::SetSceneConstants(const float* view_projection)
+{
+    std::memcpy(view_projection_, view_projection, sizeof(view_projection_));
+    is_transform_dirty_ = true;
+}
+
+void SoftwareRenderBackend::SetObjectConstantData(const void* data,
+                                                  size_t size)
+{
+    object_constants_ = static_cast<const uint8_t*>(data);
+    object_constants_size_ = size;
+    bound_object_constants_ = INVALID_HANDLE;
+    is_transform_dirty_ = true;
+}
+
+void SoftwareRenderBackend::Rasterize()
+{
+    const auto start = std::chrono::steady_clock::now();
+    RasterizeTiles();
+    stats_.raster_time = std::chrono::duration<float, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+}
+
+void SoftwareRenderBackend::UpdateTransform()
+{
+    // Both matrices are stored transposed, as the shader reads them, so
+    // element [r][c] of the model matrix is model[c * 4 + r]
+    float model[16];
+    std::memcpy(model,
+                object_constants_ + bound_object_constants_ * CONSTANT_SIZE,
+                MATRIX_SIZE);
+    const float* vp = view_projection_;
+    for (int row = 0; row < 4; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k) {
+                sum += model[k * 4 + row] * vp[column * 4 + k];
+            }
+            transform_[row * 4 + column] = sum;
+        }
+    }
+    is_transform_dirty_ = false;
+}
+
+template <typename Distance>
+int SoftwareRenderBackend::ClipPolygon(const ClipVertex* in, int count,
+                                       ClipVertex* out,
+                                       const Distance& distance)
+{
+    int out_count = 0;
+    for (int i = 0; i < count; ++i) {
+        const ClipVertex& a = in[i];
+        const ClipVertex& b = in[(i + 1) % count];
+        const float da = distance(a);
+        const float db = distance(b);
+        if (da >= 0.0f) {
+            out[out_count++] = a;
+        }
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            const float t = da / (da - db);
+            ClipVertex& v = out[out_count++];
+            v.x = a.x + (b.x - a.x) * t;
+            v.y = a.y + (b.y - a.y) * t;
+            v.z = a.z + (b.z - a.z) * t;
+            v.w = a.w + (b.w - a.w) * t;
+            v.u = a.u + (b.u - a.u) * t;
+            v.v = a.v + (b.v - a.v) * t;
+        }
+    }
+    return out_count;
+}
+
+void SoftwareRenderBackend::SetupTriangle(const ClipVertex& v0,
+                                          const ClipVertex& v1,
+                                          const ClipVertex& v2)
+{
+    const ClipVertex* clip[3] = {&v0, &v1, &v2};
+    float x[3];
+    float y[3];
+    Triangle triangle;
+    for (int i = 0; i < 3; ++i) {
+        // Clipping against the near plane keeps w positive
+        const float one_over_w = 1.0f / clip[i]->w;
+        x[i] = (clip[i]->x * one_over_w * 0.5f + 0.5f) * width_;
+        y[i] = (0.5f - clip[i]->y * one_over_w * 0.5f) * height_;
+        triangle.z[i] = std::clamp(clip[i]->z * one_over_w, 0.0f, 1.0f);
+        triangle.u_over_w[i] = clip[i]->u * one_over_w;
+        triangle.v_over_w[i] = clip[i]->v * one_over_w;
+        triangle.one_over_w[i] = one_over_w;
+    }
+
+    // Front faces are clockwise on screen, which with y pointing down gives
+    // a positive area. Back faces and slivers are culled.
+    const float area =
+        (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (!(area > 1e-6f)) {
+        ++stats_.culled_triangle_count;
+        return;
+    }
+
+    triangle.min_x = std::max(
+        0, static_cast<int>(std::floor(std::min({x[0], x[1], x[2]}))));
+    triangle.min_y = std::max(
+        0, static_cast<int>(std::floor(std::min({y[0], y[1], y[2]}))));
+    triangle.max_x =
+        std::min(static_cast<int>(width_) - 1,
+                 static_cast<int>(std::ceil(std::max({x[0], x[1], x[2]}))));
+    triangle.max_y =
+        std::min(static_cast<int>(height_) - 1,
+                 static_cast<int>(std::ceil(std::max({y[0], y[1], y[2]}))));
+    if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y) {
+        ++stats_.culled_triangle_count;
+        return;
+    }
+
+    // Edge i is opposite to vertex i. Dividing by the area makes the edge
+    // functions the barycentric coordinates.
+    const float inv_area = 1.0f / area;
+    for (int i = 0; i < 3; ++i) {
+        const int j = (i + 1) % 3;
+        const int k = (i + 2) % 3;
+        const float dx = x[k] - x[j];
+        const float dy = y[k] - y[j];
+        triangle.edge_a[i] = -dy * inv_area;
+        triangle.edge_b[i] = dx * inv_area;
+        triangle.edge_c[i] = (dy * x[j] - dx * y[j]) * inv_area;
+        triangle.is_edge_inclusive[i] = (dy == 0.0f && dx > 0.0f) || dy < 0.0f;
+    }
+
+    const uint32_t triangle_index = static_cast<uint32_t>(triangles_.size());
+    triangles_.push_back(triangle);
+
+    const uint32_t first_tile_x = triangle.min_x / TILE_SIZE;
+    const uint32_t last_tile_x = triangle.max_x / TILE_SIZE;
+    const uint32_t first_tile_y = triangle.min_y / TILE_SIZE;
+    const uint32_t last_tile_y = triangle.max_y / TILE_SIZE;
+    for (uint32_t ty = first_tile_y; ty <= last_tile_y; ++ty) {
+        for (uint32_t tx = first_tile_x; tx <= last_tile_x; ++tx) {
+            tile_bins_[ty * tile_count_x_ + tx].push_back(triangle_index);
+        }
+    }
+    stats_.binned_triangle_count +=
+        (last_tile_x - first_tile_x + 1) * (last_tile_y - first_tile_y + 1);
+}
+
+void SoftwareRenderBackend::RasterizeTiles()
+{
+    // Threads take the next tile until none is left, which balances tiles
+    // with very different triangle counts
+    const uint32_t tile_count = tile_count_x_ * tile_count_y_;
+    std::atomic<uint32_t> next_tile{0};
+    std::vector<uint64_t> shaded_pixel_counts(workers_.size() + 1, 0);
+    const auto rasterize = [this, tile_count, &next_tile,
+                            &shaded_pixel_counts](size_t thread) {
+        uint32_t tile;
+        while ((tile = next_tile.fetch_add(1, std::memory_order_relaxed)) <
+               tile_count) {
+            RasterizeTile(tile, &shaded_pixel_counts[thread]);
+        }
+    };
+
+    const size_t used_workers =
+        std::min<size_t>(workers_.size(), triangles_.empty() ? 0 : tile_count);
+    for (size_t i = 0; i < used_workers; ++i) {
+        workers_[i]->Start([&rasterize, i] { rasterize(i + 1); });
+    }
+    rasterize(0);
+    for (size_t i = 0; i < used_workers; ++i) {
+        workers_[i]->Wait();
+    }
+
+    for (uint64_t count : shaded_pixel_counts) {
+        stats_.shaded_pixel_count += count;
+    }
+}
+
+void SoftwareRenderBackend::RasterizeTile(uint32_t tile,
+                                          uint64_t* shaded_pixel_count)
+{
+    const std::vector<uint32_t>& bin = tile_bins_[tile];
+    if (bin.empty()) {
+        return;
+    }
+
+    const int tile_x = static_cast<int>((tile % tile_count_x_) * TILE_SIZE);
+    const int tile_y = static_cast<int>((tile / tile_count_x_) * TILE_SIZE);
+    uint64_t shaded_count = 0;
+
+    for (uint32_t triangle_index : bin) {
+        const Triangle& t = triangles_[triangle_index];
+
+        // Tiles start on a multiple of four, so aligning the start keeps the
+        // four pixel steps inside the tile
+        const int min_x = std::max(t.min_x, tile_x) & ~3;
+        const int max_x = std::min(t.max_x, tile_x + int(TILE_SIZE) - 1);
+        const int min_y = std::max(t.min_y, tile_y);
+        const int max_y = std::min(t.max_y, tile_y + int(TILE_SIZE) - 1);
+
+#ifdef TM_CPU_X86
+        __m128 edge_a[3], edge_b[3], edge_c[3], is_inclusive[3];
+        __m128 z[3], u_over_w[3], v_over_w[3], one_over_w[3];
+        for (int i = 0; i < 3; ++i) {
+            edge_a[i] = _mm_set1_ps(t.edge_a[i]);
+            edge_b[i] = _mm_set1_ps(t.edge_b[i]);
+            edge_c[i] = _mm_set1_ps(t.edge_c[i]);
+            is_inclusive[i] = _mm_castsi128_ps(
+                _mm_set1_epi32(t.is_edge_inclusive[i] ? -1 : 0));
+            z[i] = _mm_set1_ps(t.z[i]);
+            u_over_w[i] = _mm_set1_ps(t.u_over_w[i]);
+            v_over_w[i] = _mm_set1_ps(t.v_over_w[i]);
+            one_over_w[i] = _mm_set1_ps(t.one_over_w[i]);
+        }
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 depth_scale = _mm_set1_ps(float(MAX_DEPTH));
+        const __m128 color_scale = _mm_set1_ps(255.0f);
+        const __m128i alpha = _mm_set1_epi32(0xFF000000);
+        const __m128 pixel_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 x_end = _mm_set1_ps(max_x + 1.0f);
+
+        for (int y = min_y; y <= max_y; ++y) {
+            const __m128 py = _mm_set1_ps(y + 0.5f);
+            __m128 row_edges[3];
+            for (int i = 0; i < 3; ++i) {
+                row_edges[i] = _mm_add_ps(_mm_mul_ps(edge_b[i], py), edge_c[i]);
+            }
+            uint32_t* color_row = &color_[y * row_pitch_];
+            uint32_t* depth_row = &depth_[y * row_pitch_];
+
+            for (int x = min_x; x <= max_x; x += 4) {
+                const __m128 px =
+                    _mm_add_ps(_mm_set1_ps(float(x)), pixel_offsets);
+                __m128 barycentric[3];
+                // The last step can run past the triangle bounds into the
+                // row padding
+                __m128 coverage = _mm_cmplt_ps(px, x_end);
+                for (int i = 0; i < 3; ++i) {
+                    barycentric[i] =
+                        _mm_add_ps(_mm_mul_ps(edge_a[i], px), row_edges[i]);
+                    const __m128 is_inside = _mm_or_ps(
+                        _mm_cmpgt_ps(barycentric[i], zero),
+                        _mm_and_ps(_mm_cmpeq_ps(barycentric[i], zero),
+                                   is_inclusive[i]));
+                    coverage = _mm_and_ps(coverage, is_inside);
+                }
+                if (_mm_movemask_ps(coverage) == 0) {
+                    continue;
+                }
+
+                const auto interpolate = [&barycentric](const __m128* values) {
+                    return _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(barycentric[0], values[0]),
+                                   _mm_mul_ps(barycentric[1], values[1])),
+                        _mm_mul_ps(barycentric[2], values[2]));
+                };
+
+                const __m128 pixel_z =
+                    _mm_min_ps(_mm_max_ps(interpolate(z), zero), one);
+                const __m128i depth =
+                    _mm_cvtps_epi32(_mm_mul_ps(pixel_z, depth_scale));
+                __m128i* depth_address =
+                    reinterpret_cast<__m128i*>(depth_row + x);
+                const __m128i old_depth = _mm_loadu_si128(depth_address);
+                // Depths fit in 24 bits, so the signed compare is safe
+                const __m128i pass = _mm_and_si128(
+                    _mm_castps_si128(coverage),
+                    _mm_cmplt_epi32(depth, old_depth));
+                const int pass_mask = _mm_movemask_ps(_mm_castsi128_ps(pass));
+                if (pass_mask == 0) {
+                    continue;
+                }
+
+                // Pixel program of SHADER_CODE: the UVs as red and green
+                const __m128 w = _mm_div_ps(one, interpolate(one_over_w));
+                const __m128 u = _mm_min_ps(
+                    _mm_max_ps(_mm_mul_ps(interpolate(u_over_w), w), zero),
+                    one);
+                const __m128 v = _mm_min_ps(
+                    _mm_max_ps(_mm_mul_ps(interpolate(v_over_w), w), zero),
+                    one);
+                const __m128i red = _mm_cvtps_epi32(_mm_mul_ps(u, color_scale));
+                const __m128i green =
+                    _mm_cvtps_epi32(_mm_mul_ps(v, color_scale));
+                const __m128i color = _mm_or_si128(
+                    _mm_or_si128(red, _mm_slli_epi32(green, 8)), alpha);
+
+                __m128i* color_address =
+                    reinterpret_cast<__m128i*>(color_row + x);
+                const __m128i old_color = _mm_loadu_si128(color_address);
+                _mm_storeu_si128(
+                    depth_address,
+                    _mm_or_si128(_mm_and_si128(pass, depth),
+                                 _mm_andnot_si128(pass, old_depth)));
+                _mm_storeu_si128(
+                    color_address,
+                    _mm_or_si128(_mm_and_si128(pass, color),
+                                 _mm_andnot_si128(pass, old_color)));
+
+                static constexpr uint8_t BIT_COUNTS[16] = {
+                    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+                shaded_count += BIT_COUNTS[pass_mask];
+            }
+        }
+#else
+        for (int y = min_y; y <= max_y; ++y) {
+            const float py = y + 0.5f;
+            uint32_t* color_row = &color_[y * row_pitch_];
+            uint32_t* depth_row = &depth_[y * row_pitch_];
+
+            for (int x = min_x; x <= max_x; ++x) {
+                const float px = x + 0.5f;
+                float barycentric[3];
+                bool is_covered = true;
+                for (int i = 0; i < 3; ++i) {
+                    barycentric[i] =
+                        t.edge_a[i] * px + (t.edge_b[i] * py + t.edge_c[i]);
+                    is_covered =
+                        is_covered &&
+                        (barycentric[i] > 0.0f ||
+                         (barycentric[i] == 0.0f && t.is_edge_inclusive[i]));
+                }
+                if (!is_covered) {
+                    continue;
+                }
+
+                const auto interpolate = [&barycentric](const float* values) {
+                    return barycentric[0] * values[0] +
+                           barycentric[1] * values[1] +
+                           barycentric[2] * values[2];
+                };
+
+                const float pixel_z =
+                    std::clamp(interpolate(t.z), 0.0f, 1.0f);
+                const uint32_t depth =
+                    static_cast<uint32_t>(std::nearbyint(pixel_z * MAX_DEPTH));
+                if (depth >= depth_row[x]) {
+                    continue;
+                }
+
+                // Pixel program of SHADER_CODE: the UVs as red and green
+                const float w = 1.0f / interpolate(t.one_over_w);
+                depth_row[x] = depth;
+                color_row[x] = PackColor(interpolate(t.u_over_w) * w,
+                                         interpolate(t.v_over_w) * w, 0.0f,
+                                         1.0f);
+                ++shaded_count;
+            }
+        }
+#endif  // TM_CPU_X86
+    }
+
+    *shaded_pixel_count += shaded_count;
+}
+
+}  // namespace tamarindo
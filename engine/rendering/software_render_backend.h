@@ -0,0 +1,200 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_SOFTWARE_RENDER_BACKEND_H_
+#define ENGINE_LIB_RENDERING_SOFTWARE_RENDER_BACKEND_H_
+
+#include "rendering/render_backend.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tamarindo
+{
+
+class FrameWorker;
+
+struct SoftwareRenderBackendParams {
+    unsigned int width = 1280;
+    unsigned int height = 720;
+    // Threads rasterizing tiles, the calling thread included. Zero uses one
+    // per hardware thread.
+    unsigned int thread_count = 0;
+};
+
+struct SoftwareRenderStats {
+    size_t draw_count = 0;
+    size_t triangle_count = 0;
+    // Back facing, zero area or fully outside the depth range
+    size_t culled_triangle_count = 0;
+    // Triangles added by clipping against the near and far planes
+    size_t clipped_triangle_count = 0;
+    // Sum over the triangles of the tiles they were binned into
+    size_t binned_triangle_count = 0;
+    // Pixels that passed the depth test
+    uint64_t shaded_pixel_count = 0;
+    // Time spent in Rasterize(), in milliseconds
+    float raster_time = 0.0f;
+};
+
+// CPU backend running the same draw path as the D3D11 one, the shader in
+// game_data.h included. Draws transform their vertices on the calling thread
+// and bin the triangles into screen tiles. Rasterize() then works through
+// the tiles in parallel, evaluating the edge functions on four pixels at a
+// time, testing against a 24-bit depth buffer with LESS and writing the UVs
+// as the color. Tiles keep their triangles in submission order, so the
+// image does not depend on the thread count.
+class SoftwareRenderBackend : public RenderBackend
+{
+   public:
+    static constexpr unsigned int TILE_SIZE = 64;
+
+    // Cleared depth, the 24-bit equivalent of 1.0
+    static constexpr uint32_t MAX_DEPTH = 0xFFFFFF;
+
+    SoftwareRenderBackend() = delete;
+    explicit SoftwareRenderBackend(const SoftwareRenderBackendParams& params);
+    ~SoftwareRenderBackend() override;
+
+    SoftwareRenderBackend(const SoftwareRenderBackend& other) = delete;
+    SoftwareRenderBackend& operator=(const SoftwareRenderBackend& other) =
+        delete;
+
+    // Every source runs as the position and UV program of SHADER_CODE, there
+    // is no shader compiler on this path
+    uint32_t CreateShader(const std::string& source) override;
+    uint32_t CreateMesh(const std::vector<float>& vertex_data,
+                        const std::vector<unsigned int>& index_data) override;
+
+    void BindShader(uint32_t shader) override;
+    void BindMaterial(uint32_t material) override;
+    void BindMesh(uint32_t mesh) override;
+    void BindObjectConstants(uint32_t constants) override;
+    void DrawIndexed(uint32_t index_count, uint32_t index_offset,
+                     int32_t vertex_offset) override;
+
+    // Clears the color and depth buffers and drops the binned triangles.
+    // `clear_color` is RGBA in [0, 1].
+    void BeginFrame(const float clear_color[4]);
+
+    // View projection matrix, laid out like the scene constant buffer:
+    // 16 floats of the transposed row-vector matrix
+    void SetSceneConstants(const float* view_projection);
+
+    // Object constants, laid out like the D3D11 frame constant buffer:
+    // BindObjectConstants() takes the offset of a transposed model matrix in
+    // 16-byte constants. The memory must stay valid until the draws are
+    // submitted.
+    void SetObjectConstantData(const void* data, size_t size);
+
+    // Rasterizes the triangles binned since BeginFrame()
+    void Rasterize();
+
+    inline unsigned int width() const { return width_; }
+    inline unsigned int height() const { return height_; }
+
+    // Color and depth rows are `row_pitch()` pixels apart. Colors are RGBA8,
+    // red in the lowest byte, and depths are in [0, MAX_DEPTH].
+    inline size_t row_pitch() const { return row_pitch_; }
+    inline const uint32_t* color_buffer() const { return color_.data(); }
+    inline const uint32_t* depth_buffer() const { return depth_.data(); }
+
+    inline const SoftwareRenderStats& stats() const { return stats_; }
+
+   private:
+    struct Mesh {
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+    };
+
+    // Clip space vertex plus the attributes the pixel program reads
+    struct ClipVertex {
+        float x, y, z, w;
+        float u, v;
+    };
+
+    // Plane equations of a screen space triangle, evaluated at pixel
+    // centers: value = a * x + b * y + c
+    struct Triangle {
+        float edge_a[3];
+        float edge_b[3];
+        float edge_c[3];
+        // Edges on the top or left of the triangle own the pixels exactly
+        // on them
+        bool is_edge_inclusive[3];
+
+        // Depth is interpolated linearly in screen space, the UVs through
+        // u/w, v/w and 1/w
+        float z[3];
+        float u_over_w[3];
+        float v_over_w[3];
+        float one_over_w[3];
+
+        int min_x, min_y, max_x, max_y;
+    };
+
+    // Keeps the part of a convex polygon where `distance` is positive.
+    // Writes at most `count` + 1 vertices to `out` and returns their count.
+    template <typename Distance>
+    static int ClipPolygon(const ClipVertex* in, int count, ClipVertex* out,
+                           const Distance& distance);
+
+    void UpdateTransform();
+    void SetupTriangle(const ClipVertex& v0, const ClipVertex& v1,
+                       const ClipVertex& v2);
+    void RasterizeTiles();
+    void RasterizeTile(uint32_t tile, uint64_t* shaded_pixel_count);
+
+    unsigned int width_;
+    unsigned int height_;
+    size_t row_pitch_;
+    uint32_t tile_count_x_;
+    uint32_t tile_count_y_;
+
+    std::vector<uint32_t> color_;
+    std::vector<uint32_t> depth_;
+
+    uint32_t shader_count_ = 0;
+    std::vector<Mesh> meshes_;
+
+    uint32_t bound_shader_ = INVALID_HANDLE;
+    uint32_t bound_mesh_ = INVALID_HANDLE;
+
+    float view_projection_[16];
+    const uint8_t* object_constants_ = nullptr;
+    size_t object_constants_size_ = 0;
+    uint32_t bound_object_constants_ = INVALID_HANDLE;
+
+    // Model times view projection, row-vector convention
+    float transform_[16];
+    bool is_transform_dirty_ = true;
+
+    std::vector<Triangle> triangles_;
+    // Triangle indices per tile, in submission order
+    std::vector<std::vector<uint32_t>> tile_bins_;
+
+    // The calling thread rasterizes too, so there is one worker less than
+    // threads
+    std::vector<std::unique_ptr<FrameWorker>> workers_;
+
+    SoftwareRenderStats stats_;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_SOFTWARE_RENDER_BACKEND_H_
@@ -0,0 +1,166 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/transient_texture_pool.h"
+
+#include "logging/logger.h"
+#include "rendering/render_state.h"
+#include "utils/macros.h"
+
+#include <algorithm>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+struct DepthFormats {
+    // Format of the texture, so it can be viewed as depth and as color
+    DXGI_FORMAT typeless;
+    DXGI_FORMAT shader_resource;
+};
+
+bool GetDepthFormats(DXGI_FORMAT format, DepthFormats* formats)
+{
+    switch (format) {
+        case DXGI_FORMAT_D16_UNORM:
+            *formats = {DXGI_FORMAT_R16_TYPELESS, DXGI_FORMAT_R16_UNORM};
+            return true;
+        case DXGI_FORMAT_D24_UNORM_S8_UINT:
+            *formats = {DXGI_FORMAT_R24G8_TYPELESS,
+                        DXGI_FORMAT_R24_UNORM_X8_TYPELESS};
+            return true;
+        case DXGI_FORMAT_D32_FLOAT:
+            *formats = {DXGI_FORMAT_R32_TYPELESS, DXGI_FORMAT_R32_FLOAT};
+            return true;
+        default:
+            return false;
+    }
+}
+
+}  // namespace
+
+bool TransientTexturePool::IsDepthFormat(DXGI_FORMAT format)
+{
+    DepthFormats formats;
+    return GetDepthFormats(format, &formats);
+}
+
+TransientTexturePool::TransientTexturePool(
+    const TransientTexturePoolParams& params)
+    : params_(params)
+{
+}
+
+void TransientTexturePool::BeginFrame()
+{
+    ++frame_;
+    textures_.erase(
+        std::remove_if(textures_.begin(), textures_.end(),
+                       [this](const std::unique_ptr<TransientTexture>& t) {
+                           return frame_ - t->last_used_frame >
+                                  params_.max_unused_frames;
+                       }),
+        textures_.end());
+}
+
+TransientTexture* TransientTexturePool::Acquire(
+    const TransientTextureDesc& desc)
+{
+    for (const std::unique_ptr<TransientTexture>& texture : textures_) {
+        if (texture->last_used_frame != frame_ && texture->desc == desc) {
+            texture->last_used_frame = frame_;
+            return texture.get();
+        }
+    }
+
+    std::unique_ptr<TransientTexture> texture = CreateTexture(desc);
+    if (!texture) {
+        return nullptr;
+    }
+    texture->last_used_frame = frame_;
+    textures_.push_back(std::move(texture));
+    return textures_.back().get();
+}
+
+std::unique_ptr<TransientTexture> TransientTexturePool::CreateTexture(
+    const TransientTextureDesc& desc)
+{
+    DepthFormats depth_formats;
+    const bool is_depth = GetDepthFormats(desc.format, &depth_formats);
+
+    D3D11_TEXTURE2D_DESC texture_desc;
+    ZeroMemory(&texture_desc, sizeof(texture_desc));
+    texture_desc.Width = desc.width;
+    texture_desc.Height = desc.height;
+    texture_desc.MipLevels = 1;
+    texture_desc.ArraySize = 1;
+    texture_desc.Format = is_depth ? depth_formats.typeless : desc.format;
+    texture_desc.SampleDesc.Count = 1;
+    texture_desc.SampleDesc.Quality = 0;
+    texture_desc.Usage = D3D11_USAGE_DEFAULT;
+    texture_desc.BindFlags =
+        D3D11_BIND_SHADER_RESOURCE |
+        (is_depth ? D3D11_BIND_DEPTH_STENCIL : D3D11_BIND_RENDER_TARGET);
+    texture_desc.CPUAccessFlags = 0;
+    texture_desc.MiscFlags = 0;
+
+    auto texture = std::make_unique<TransientTexture>();
+    texture->desc = desc;
+    HRESULT res = g_Device->CreateTexture2D(&texture_desc, NULL,
+                                            texture->texture.GetAddressOf());
+    if (FAILED(res)) {
+        TM_LOG_ERROR("Could not create transient texture. Error: {}", res);
+        return nullptr;
+    }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc;
+    ZeroMemory(&srv_desc, sizeof(srv_desc));
+    srv_desc.Format = is_depth ? depth_formats.shader_resource : desc.format;
+    srv_desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    srv_desc.Texture2D.MipLevels = 1;
+    res = g_Device->CreateShaderResourceView(
+        texture->texture.Get(), &srv_desc,
+        texture->shader_resource_view.GetAddressOf());
+    if (FAILED(res)) {
+        TM_LOG_ERROR("Could not create transient texture view. Error: {}",
+                     res);
+        return nullptr;
+    }
+
+    if (is_depth) {
+        D3D11_DEPTH_STENCIL_VIEW_DESC dsv_desc;
+        ZeroMemory(&dsv_desc, sizeof(dsv_desc));
+        dsv_desc.Format = desc.format;
+        dsv_desc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+        res = g_Device->CreateDepthStencilView(
+            texture->texture.Get(), &dsv_desc,
+            texture->depth_stencil_view.GetAddressOf());
+    } else {
+        res = g_Device->CreateRenderTargetView(
+            texture->texture.Get(), NULL,
+            texture->render_target_view.GetAddressOf());
+    }
+    if (FAILED(res)) {
+        TM_LOG_ERROR("Could not create transient texture view. Error: {}",
+                     res);
+        return nullptr;
+    }
+    return texture;
+}
+
+}  // namespace tamarindo
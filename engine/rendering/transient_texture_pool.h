@@ -0,0 +1,98 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_TRANSIENT_TEXTURE_POOL_H_
+#define ENGINE_LIB_RENDERING_TRANSIENT_TEXTURE_POOL_H_
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tamarindo
+{
+
+namespace wrl = Microsoft::WRL;
+
+struct TransientTextureDesc {
+    unsigned int width;
+    unsigned int height;
+    // Depth formats get a depth stencil view, the rest a render target
+    // view. Both get a shader resource view.
+    DXGI_FORMAT format;
+
+    inline bool operator==(const TransientTextureDesc& other) const
+    {
+        return width == other.width && height == other.height &&
+               format == other.format;
+    }
+};
+
+struct TransientTexture {
+    TransientTextureDesc desc;
+    wrl::ComPtr<ID3D11Texture2D> texture;
+    wrl::ComPtr<ID3D11RenderTargetView> render_target_view;
+    wrl::ComPtr<ID3D11DepthStencilView> depth_stencil_view;
+    wrl::ComPtr<ID3D11ShaderResourceView> shader_resource_view;
+    // Frame the texture was last handed out in
+    uint64_t last_used_frame;
+};
+
+struct TransientTexturePoolParams {
+    // Textures not handed out for this many frames are released
+    unsigned int max_unused_frames = 60;
+};
+
+// Keeps the textures backing render graph transients alive across frames, so
+// a graph that does not change does not create any texture after the first
+// frame.
+class TransientTexturePool
+{
+   public:
+    static bool IsDepthFormat(DXGI_FORMAT format);
+
+    TransientTexturePool() = delete;
+    explicit TransientTexturePool(const TransientTexturePoolParams& params);
+    ~TransientTexturePool() = default;
+
+    TransientTexturePool(const TransientTexturePool& other) = delete;
+    TransientTexturePool& operator=(const TransientTexturePool& other) =
+        delete;
+
+    // Textures handed out in the previous frame can be handed out again
+    void BeginFrame();
+
+    // Returns a texture matching `desc` that was not handed out yet this
+    // frame, creating it if needed. Returns nullptr if the creation fails.
+    TransientTexture* Acquire(const TransientTextureDesc& desc);
+
+    inline size_t texture_count() const { return textures_.size(); }
+
+   private:
+    std::unique_ptr<TransientTexture> CreateTexture(
+        const TransientTextureDesc& desc);
+
+    TransientTexturePoolParams params_;
+    uint64_t frame_ = 0;
+
+    std::vector<std::unique_ptr<TransientTexture>> textures_;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_TRANSIENT_TEXTURE_POOL_H_
@@ -0,0 +1,211 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/upload_manager.h"
+
+#include "logging/logger.h"
+#include "rendering/render_state.h"
+#include "utils/macros.h"
+
+#include <cstring>
+
+namespace tamarindo
+{
+
+UploadManager::UploadManager(const UploadManagerParams& params)
+    : regions_(params.region_count), region_size_(params.bytes_per_frame)
+{
+    TM_ASSERT(params.region_count > 0);
+    TM_ASSERT(params.bytes_per_frame > 0);
+
+    D3D11_BUFFER_DESC buffer_desc;
+    buffer_desc.Usage = D3D11_USAGE_STAGING;
+    buffer_desc.ByteWidth = region_size_;
+    buffer_desc.BindFlags = 0;
+    buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    buffer_desc.MiscFlags = 0;
+    buffer_desc.StructureByteStride = 0;
+
+    D3D11_QUERY_DESC query_desc;
+    query_desc.Query = D3D11_QUERY_EVENT;
+    query_desc.MiscFlags = 0;
+
+    for (Region& region : regions_) {
+        HRESULT hr = g_Device->CreateBuffer(
+            &buffer_desc, nullptr, region.staging_buffer.GetAddressOf());
+        if (FAILED(hr)) {
+            TM_LOG_ERROR("Could not create upload staging buffer. Error: {}",
+                         hr);
+        }
+        hr = g_Device->CreateQuery(&query_desc, region.fence.GetAddressOf());
+        if (FAILED(hr)) {
+            TM_LOG_ERROR("Could not create upload fence. Error: {}", hr);
+        }
+    }
+}
+
+bool UploadManager::Upload(ID3D11Buffer* buffer, UINT offset,
+                           const void* data, UINT size, uint64_t* serial)
+{
+    TM_ASSERT(buffer);
+    TM_ASSERT(size > 0);
+    uint8_t* staging_data;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (mapped_data_ == nullptr || size > region_size_ - offset_) {
+            ++stats_.rejected_count;
+            return false;
+        }
+
+        copies_.push_back(Copy{buffer, offset, offset_, size});
+        staging_data = mapped_data_ + offset_;
+        offset_ += size;
+        ++pending_writes_;
+        if (serial != nullptr) {
+            *serial = flushed_count_.load();
+        }
+    }
+
+    // Concurrent uploads write disjoint ranges, no need to hold the lock
+    std::memcpy(staging_data, data, size);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--pending_writes_ == 0) {
+        writes_finished_.notify_all();
+    }
+    return true;
+}
+
+void UploadManager::Flush(ID3D11DeviceContext* device_context)
+{
+    std::vector<Copy> copies;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        writes_finished_.wait(lock, [this] { return pending_writes_ == 0; });
+        if (mapped_data_ == nullptr) {
+            lock.unlock();
+            // The GPU was still reading the region at the last flush
+            OpenRegion(device_context);
+            return;
+        }
+        if (copies_.empty()) {
+            return;
+        }
+        copies.swap(copies_);
+        mapped_data_ = nullptr;
+        offset_ = 0;
+    }
+
+    Region& region = regions_[region_index_];
+    device_context->Unmap(region.staging_buffer.Get(), 0);
+
+    UploadStats frame_stats;
+    frame_stats.upload_count = static_cast<unsigned int>(copies.size());
+    size_t first = 0;
+    while (first < copies.size()) {
+        // Uploads that follow each other in staging and in the destination
+        // go in one copy, like consecutive ranges of a geometry buffer
+        const Copy& copy = copies[first];
+        UINT size = copy.size;
+        size_t next = first + 1;
+        while (next < copies.size() &&
+               copies[next].buffer.Get() == copy.buffer.Get() &&
+               copies[next].offset == copy.offset + size &&
+               copies[next].staging_offset == copy.staging_offset + size) {
+            size += copies[next].size;
+            ++next;
+        }
+
+        D3D11_BOX box;
+        box.left = copy.staging_offset;
+        box.right = copy.staging_offset + size;
+        box.top = 0;
+        box.bottom = 1;
+        box.front = 0;
+        box.back = 1;
+        device_context->CopySubresourceRegion(copy.buffer.Get(), 0,
+                                              copy.offset, 0, 0,
+                                              region.staging_buffer.Get(), 0,
+                                              &box);
+        frame_stats.uploaded_bytes += size;
+        ++frame_stats.copy_count;
+        first = next;
+    }
+
+    device_context->End(region.fence.Get());
+    region.is_fenced = true;
+    region_index_ = (region_index_ + 1) % regions_.size();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.uploaded_bytes = frame_stats.uploaded_bytes;
+        stats_.upload_count = frame_stats.upload_count;
+        stats_.copy_count = frame_stats.copy_count;
+        // Only bumped once the copies are on the context, see IsRecorded()
+        ++flushed_count_;
+    }
+
+    OpenRegion(device_context);
+}
+
+void UploadManager::Retarget(ID3D11Buffer* old_buffer,
+                             ID3D11Buffer* new_buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Copy& copy : copies_) {
+        if (copy.buffer.Get() == old_buffer) {
+            copy.buffer = new_buffer;
+        }
+    }
+}
+
+UploadStats UploadManager::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void UploadManager::OpenRegion(ID3D11DeviceContext* device_context)
+{
+    Region& region = regions_[region_index_];
+    if (!region.staging_buffer) {
+        return;
+    }
+    if (region.is_fenced) {
+        // Present submits the fence, no need to flush for it
+        if (device_context->GetData(region.fence.Get(), nullptr, 0,
+                                    D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.busy_region_count;
+            return;
+        }
+        region.is_fenced = false;
+    }
+
+    // The GPU is done with the region, mapping does not wait
+    D3D11_MAPPED_SUBRESOURCE mapped_res;
+    HRESULT hr = device_context->Map(region.staging_buffer.Get(), 0,
+                                     D3D11_MAP_WRITE, 0, &mapped_res);
+    if (FAILED(hr)) {
+        TM_LOG_ERROR("Could not map upload staging buffer. Error: {}", hr);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    mapped_data_ = static_cast<uint8_t*>(mapped_res.pData);
+    offset_ = 0;
+}
+
+}  // namespace tamarindo
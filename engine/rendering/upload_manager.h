@@ -0,0 +1,144 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_UPLOAD_MANAGER_H_
+#define ENGINE_LIB_RENDERING_UPLOAD_MANAGER_H_
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace tamarindo
+{
+
+namespace wrl = Microsoft::WRL;
+
+struct UploadManagerParams {
+    // Size of every staging region, which is also the most bytes copied
+    // into destination buffers per frame
+    unsigned int bytes_per_frame = 4 << 20;
+    // Frames whose copies the GPU can still be reading from staging
+    unsigned int region_count = 3;
+};
+
+struct UploadStats {
+    // Of the last Flush()
+    unsigned int uploaded_bytes = 0;
+    unsigned int upload_count = 0;
+    // Copies recorded, after merging contiguous uploads
+    unsigned int copy_count = 0;
+
+    // Since creation. Uploads that did not fit the budget of their frame,
+    // and flushes that found the next region still in use by the GPU.
+    unsigned int rejected_count = 0;
+    unsigned int busy_region_count = 0;
+};
+
+// Streams data into default usage buffers without creating a buffer per
+// upload or blocking the caller on the driver.
+//
+// Uploads are written into a mapped staging buffer, one region per frame
+// used as a ring. Flush() unmaps the region, records the copies into their
+// destination buffers and fences the region with an event query. The
+// region is only mapped again once its query has passed, so mapping never
+// waits on the GPU; if it has not, uploads are rejected until the next
+// Flush(). The region size is the per-frame budget: an upload that does not
+// fit is rejected and the caller tries again next frame.
+//
+// Upload() can be called from any thread, the rest only from the thread
+// that owns the device context.
+class UploadManager
+{
+   public:
+    UploadManager() = delete;
+    explicit UploadManager(const UploadManagerParams& params);
+    ~UploadManager() = default;
+
+    UploadManager(const UploadManager& other) = delete;
+    UploadManager& operator=(const UploadManager& other) = delete;
+
+    // Copies `size` bytes of `data` into the staging region, to land at
+    // `offset` bytes into `buffer` once the region is flushed. Returns false
+    // if the region is full or not mapped. `serial`, if set, receives the
+    // value to check with IsRecorded().
+    bool Upload(ID3D11Buffer* buffer, UINT offset, const void* data,
+                UINT size, uint64_t* serial = nullptr);
+
+    // Records the copies of the frame, then maps the next region if the GPU
+    // is done with it. Waits for the uploads being written. Call it once
+    // per frame, before the draws reading the uploaded data.
+    void Flush(ID3D11DeviceContext* device_context);
+
+    // True once the copies of an upload are on the device context, so any
+    // later command sees the data
+    inline bool IsRecorded(uint64_t serial) const
+    {
+        return serial < flushed_count_.load();
+    }
+
+    // Points the pending copies into `old_buffer` at `new_buffer`, for a
+    // buffer that is replaced by a larger copy of itself
+    void Retarget(ID3D11Buffer* old_buffer, ID3D11Buffer* new_buffer);
+
+    UploadStats stats() const;
+
+    // Largest upload that can be staged, into an empty region
+    inline UINT bytes_per_frame() const { return region_size_; }
+
+   private:
+    struct Region {
+        wrl::ComPtr<ID3D11Buffer> staging_buffer;
+        wrl::ComPtr<ID3D11Query> fence;
+        bool is_fenced = false;
+    };
+
+    struct Copy {
+        // Keeps the destination alive until the copy is recorded
+        wrl::ComPtr<ID3D11Buffer> buffer;
+        UINT offset;
+        UINT staging_offset;
+        UINT size;
+    };
+
+    // Maps the current region if its fence has passed
+    void OpenRegion(ID3D11DeviceContext* device_context);
+
+    std::vector<Region> regions_;
+    size_t region_index_ = 0;
+    UINT region_size_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable writes_finished_;
+    // Null while the current region is not mapped
+    uint8_t* mapped_data_ = nullptr;
+    UINT offset_ = 0;
+    // Uploads copying into the region outside of the lock
+    unsigned int pending_writes_ = 0;
+    std::vector<Copy> copies_;
+    // Flushes that recorded copies, the serial of the open region
+    std::atomic<uint64_t> flushed_count_ = 0;
+
+    UploadStats stats_;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_UPLOAD_MANAGER_H_
@@ -0,0 +1,1350 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "rendering/vulkan_render_backend.h"
+
+#include "logging/logger.h"
+#include "rendering/command_buffer.h"
+#include "utils/frame_worker.h"
+#include "utils/macros.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace tamarindo
+{
+
+namespace
+{
+
+// Bytes of a matrix in the scene and object constants
+constexpr VkDeviceSize MATRIX_SIZE = 16 * sizeof(float);
+// Object constant offsets are counted in 16-byte constants, as in D3D11
+constexpr VkDeviceSize CONSTANT_SIZE = 16;
+constexpr VkDeviceSize INITIAL_OBJECT_CONSTANTS_SIZE = 64 * 1024;
+
+// SHADER_CODE registers b0 and b1
+constexpr uint32_t SCENE_CONSTANTS_BINDING = 0;
+constexpr uint32_t OBJECT_CONSTANTS_BINDING = 1;
+
+constexpr VkFormat COLOR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+bool HasStencil(VkFormat format)
+{
+    return format == VK_FORMAT_D24_UNORM_S8_UINT ||
+           format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+}  // namespace
+
+// Records draws into one secondary command buffer. Every thread has its
+// own, so they share no state but the backend resources, which are not
+// modified while recording.
+class VulkanRenderBackend::ThreadRecorder : public RenderBackend
+{
+   public:
+    explicit ThreadRecorder(const VulkanRenderBackend* backend)
+        : backend_(backend)
+    {
+    }
+    ~ThreadRecorder() override = default;
+
+    bool Begin(VkCommandBuffer command_buffer,
+               VkDescriptorSet descriptor_set)
+    {
+        command_buffer_ = command_buffer;
+        descriptor_set_ = descriptor_set;
+
+        VkCommandBufferInheritanceInfo inheritance = {};
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.renderPass = backend_->render_pass_;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = backend_->framebuffer_;
+
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                           VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        begin_info.pInheritanceInfo = &inheritance;
+        if (vkBeginCommandBuffer(command_buffer_, &begin_info) != VK_SUCCESS) {
+            TM_LOG_ERROR("Could not begin a secondary command buffer.");
+            return false;
+        }
+
+        // Dynamic state is not inherited from the primary command buffer.
+        // The negative height flips y, so clip space matches D3D.
+        const float width = static_cast<float>(backend_->params_.width);
+        const float height = static_cast<float>(backend_->params_.height);
+        VkViewport viewport = {};
+        viewport.x = 0.0f;
+        viewport.y = height;
+        viewport.width = width;
+        viewport.height = -height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(command_buffer_, 0, 1, &viewport);
+
+        VkRect2D scissor = {};
+        scissor.extent.width = backend_->params_.width;
+        scissor.extent.height = backend_->params_.height;
+        vkCmdSetScissor(command_buffer_, 0, 1, &scissor);
+        return true;
+    }
+
+    bool End()
+    {
+        TM_ASSERT(command_buffer_ != VK_NULL_HANDLE);
+        const VkResult result = vkEndCommandBuffer(command_buffer_);
+        command_buffer_ = VK_NULL_HANDLE;
+        if (result != VK_SUCCESS) {
+            TM_LOG_ERROR("Could not record a secondary command buffer.");
+            return false;
+        }
+        return true;
+    }
+
+    // Resources are created on the backend
+    uint32_t CreateShader(const std::string& source) override
+    {
+        TM_BREAK();
+        return INVALID_HANDLE;
+    }
+
+    uint32_t CreateMesh(const std::vector<float>& vertex_data,
+                        const std::vector<unsigned int>& index_data) override
+    {
+        TM_BREAK();
+        return INVALID_HANDLE;
+    }
+
+    void BindShader(uint32_t shader) override
+    {
+        TM_ASSERT(shader < backend_->pipelines_.size());
+        vkCmdBindPipeline(command_buffer_, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          backend_->pipelines_[shader]);
+    }
+
+    void BindMaterial(uint32_t material) override
+    {
+        // The Vulkan path has no materials yet, the shader outputs the UVs
+    }
+
+    void BindMesh(uint32_t mesh) override
+    {
+        TM_ASSERT(mesh < backend_->meshes_.size());
+        const Mesh& m = backend_->meshes_[mesh];
+        const VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(command_buffer_, 0, 1, &m.vertices.buffer,
+                               &offset);
+        vkCmdBindIndexBuffer(command_buffer_, m.indices.buffer, 0,
+                             VK_INDEX_TYPE_UINT32);
+    }
+
+    void BindObjectConstants(uint32_t constants) override
+    {
+        const uint32_t offsets[2] = {
+            0, static_cast<uint32_t>(constants * CONSTANT_SIZE)};
+        TM_ASSERT(offsets[1] % backend_->device_properties_.limits
+                                   .minUniformBufferOffsetAlignment ==
+                  0);
+        vkCmdBindDescriptorSets(command_buffer_,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                backend_->pipeline_layout_, 0, 1,
+                                &descriptor_set_, 2, offsets);
+    }
+
+    void DrawIndexed(uint32_t index_count, uint32_t index_offset,
+                     int32_t vertex_offset) override
+    {
+        vkCmdDrawIndexed(command_buffer_, index_count, 1, index_offset,
+                         vertex_offset, 0);
+    }
+
+   private:
+    const VulkanRenderBackend* backend_;
+    VkCommandBuffer command_buffer_ = VK_NULL_HANDLE;
+    VkDescriptorSet descriptor_set_ = VK_NULL_HANDLE;
+};
+
+VulkanRenderBackend::VulkanRenderBackend() = default;
+
+VulkanRenderBackend::~VulkanRenderBackend()
+{
+    Shutdown();
+}
+
+bool VulkanRenderBackend::Initialize(const VulkanRenderBackendParams& params)
+{
+    TM_ASSERT(instance_ == VK_NULL_HANDLE);
+    TM_ASSERT(params.frames_in_flight > 0);
+    TM_ASSERT(params.min_draws_per_thread > 0);
+    params_ = params;
+
+    unsigned int thread_count = params_.thread_count;
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned int i = 0; i < thread_count; ++i) {
+        recorders_.push_back(std::make_unique<ThreadRecorder>(this));
+        if (i > 0) {
+            workers_.push_back(std::make_unique<FrameWorker>());
+        }
+    }
+
+    if (!InitializeInstance()) {
+        return false;
+    }
+
+    if (!InitializeDevice()) {
+        return false;
+    }
+
+    if (!InitializeRenderTarget()) {
+        return false;
+    }
+
+    if (!InitializeRenderPass()) {
+        return false;
+    }
+
+    if (!InitializePipelineLayout()) {
+        return false;
+    }
+
+    if (!InitializeFrames()) {
+        return false;
+    }
+
+    return true;
+}
+
+void VulkanRenderBackend::Shutdown()
+{
+    workers_.clear();
+    recorders_.clear();
+
+    if (device_ != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(device_);
+
+        for (VkPipeline pipeline : pipelines_) {
+            vkDestroyPipeline(device_, pipeline, nullptr);
+        }
+        pipelines_.clear();
+
+        for (Mesh& mesh : meshes_) {
+            DestroyBuffer(&mesh.vertices);
+            DestroyBuffer(&mesh.indices);
+        }
+        meshes_.clear();
+
+        // Destroying the pools frees their command buffers, and destroying
+        // the descriptor pool frees the sets
+        for (Frame& frame : frames_) {
+            vkDestroyCommandPool(device_, frame.command_pool, nullptr);
+            for (VkCommandPool pool : frame.thread_pools) {
+                vkDestroyCommandPool(device_, pool, nullptr);
+            }
+            DestroyBuffer(&frame.scene_constants);
+            DestroyBuffer(&frame.object_constants);
+        }
+        frames_.clear();
+
+        DestroyBuffer(&readback_);
+        vkDestroyCommandPool(device_, readback_pool_, nullptr);
+        readback_pool_ = VK_NULL_HANDLE;
+
+        vkDestroySemaphore(device_, timeline_, nullptr);
+        timeline_ = VK_NULL_HANDLE;
+
+        vkDestroyDescriptorPool(device_, descriptor_pool_, nullptr);
+        vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
+        vkDestroyDescriptorSetLayout(device_, descriptor_set_layout_,
+                                     nullptr);
+        descriptor_pool_ = VK_NULL_HANDLE;
+        pipeline_layout_ = VK_NULL_HANDLE;
+        descriptor_set_layout_ = VK_NULL_HANDLE;
+
+        vkDestroyFramebuffer(device_, framebuffer_, nullptr);
+        vkDestroyRenderPass(device_, render_pass_, nullptr);
+        framebuffer_ = VK_NULL_HANDLE;
+        render_pass_ = VK_NULL_HANDLE;
+
+        DestroyImage(&color_target_);
+        DestroyImage(&depth_target_);
+
+        vkDestroyDevice(device_, nullptr);
+        device_ = VK_NULL_HANDLE;
+        queue_ = VK_NULL_HANDLE;
+    }
+    physical_device_ = VK_NULL_HANDLE;
+    depth_format_ = VK_FORMAT_UNDEFINED;
+
+    if (instance_ != VK_NULL_HANDLE) {
+        vkDestroyInstance(instance_, nullptr);
+        instance_ = VK_NULL_HANDLE;
+    }
+
+    timeline_value_ = 0;
+    frame_index_ = 0;
+    is_recording_ = false;
+}
+
+uint32_t VulkanRenderBackend::CreateShader(const std::string& source)
+{
+    TM_LOG_ERROR("The Vulkan backend takes SPIR-V shaders only.");
+    return INVALID_HANDLE;
+}
+
+uint32_t VulkanRenderBackend::CreateShaderFromSpirv(
+    const std::vector<uint32_t>& vertex_code,
+    const std::vector<uint32_t>& pixel_code)
+{
+    const auto create_module = [this](const std::vector<uint32_t>& code) {
+        VkShaderModuleCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        info.codeSize = code.size() * sizeof(uint32_t);
+        info.pCode = code.data();
+        VkShaderModule module = VK_NULL_HANDLE;
+        if (vkCreateShaderModule(device_, &info, nullptr, &module) !=
+            VK_SUCCESS) {
+            TM_LOG_ERROR("Could not create shader module.");
+        }
+        return module;
+    };
+
+    const VkShaderModule vertex_module = create_module(vertex_code);
+    const VkShaderModule pixel_module = create_module(pixel_code);
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (vertex_module != VK_NULL_HANDLE && pixel_module != VK_NULL_HANDLE) {
+        VkPipelineShaderStageCreateInfo stages[2] = {};
+        stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[0].module = vertex_module;
+        stages[0].pName = "vs";
+        stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[1].module = pixel_module;
+        stages[1].pName = "ps";
+
+        // Position followed by UV, as in ModelData
+        VkVertexInputBindingDescription binding = {};
+        binding.binding = 0;
+        binding.stride = MESH_VERTEX_FLOAT_COUNT * sizeof(float);
+        binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        VkVertexInputAttributeDescription attributes[2] = {};
+        attributes[0].location = 0;
+        attributes[0].binding = 0;
+        attributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributes[0].offset = 0;
+        attributes[1].location = 1;
+        attributes[1].binding = 0;
+        attributes[1].format = VK_FORMAT_R32G32_SFLOAT;
+        attributes[1].offset = 3 * sizeof(float);
+
+        VkPipelineVertexInputStateCreateInfo vertex_input = {};
+        vertex_input.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertex_input.vertexBindingDescriptionCount = 1;
+        vertex_input.pVertexBindingDescriptions = &binding;
+        vertex_input.vertexAttributeDescriptionCount = 2;
+        vertex_input.pVertexAttributeDescriptions = attributes;
+
+        VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+        input_assembly.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+        VkPipelineViewportStateCreateInfo viewport = {};
+        viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewport.viewportCount = 1;
+        viewport.scissorCount = 1;
+
+        // Same as RenderState: back faces culled, clockwise front faces.
+        // The flipped viewport keeps the D3D winding.
+        VkPipelineRasterizationStateCreateInfo rasterization = {};
+        rasterization.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterization.cullMode = VK_CULL_MODE_BACK_BIT;
+        rasterization.frontFace = VK_FRONT_FACE_CLOCKWISE;
+        rasterization.lineWidth = 1.0f;
+
+        VkPipelineMultisampleStateCreateInfo multisample = {};
+        multisample.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+        depth_stencil.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depth_stencil.depthTestEnable = VK_TRUE;
+        depth_stencil.depthWriteEnable = VK_TRUE;
+        depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+        VkPipelineColorBlendAttachmentState blend_attachment = {};
+        blend_attachment.colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+        VkPipelineColorBlendStateCreateInfo blend = {};
+        blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        blend.attachmentCount = 1;
+        blend.pAttachments = &blend_attachment;
+
+        const VkDynamicState dynamic_states[2] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                                  VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo dynamic = {};
+        dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic.dynamicStateCount = 2;
+        dynamic.pDynamicStates = dynamic_states;
+
+        VkGraphicsPipelineCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        info.stageCount = 2;
+        info.pStages = stages;
+        info.pVertexInputState = &vertex_input;
+        info.pInputAssemblyState = &input_assembly;
+        info.pViewportState = &viewport;
+        info.pRasterizationState = &rasterization;
+        info.pMultisampleState = &multisample;
+        info.pDepthStencilState = &depth_stencil;
+        info.pColorBlendState = &blend;
+        info.pDynamicState = &dynamic;
+        info.layout = pipeline_layout_;
+        info.renderPass = render_pass_;
+        info.subpass = 0;
+        if (vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &info,
+                                      nullptr, &pipeline) != VK_SUCCESS) {
+            TM_LOG_ERROR("Could not create graphics pipeline.");
+            pipeline = VK_NULL_HANDLE;
+        }
+    }
+
+    vkDestroyShaderModule(device_, vertex_module, nullptr);
+    vkDestroyShaderModule(device_, pixel_module, nullptr);
+    if (pipeline == VK_NULL_HANDLE) {
+        return INVALID_HANDLE;
+    }
+
+    pipelines_.push_back(pipeline);
+    return static_cast<uint32_t>(pipelines_.size() - 1);
+}
+
+uint32_t VulkanRenderBackend::CreateMesh(
+    const std::vector<float>& vertex_data,
+    const std::vector<unsigned int>& index_data)
+{
+    if (vertex_data.empty() || index_data.empty() ||
+        vertex_data.size() % MESH_VERTEX_FLOAT_COUNT != 0) {
+        TM_LOG_ERROR("Invalid mesh data.");
+        return INVALID_HANDLE;
+    }
+
+    // Buffers stay host visible, the mesh data is written once
+    Mesh mesh;
+    const VkDeviceSize vertex_size = vertex_data.size() * sizeof(float);
+    const VkDeviceSize index_size = index_data.size() * sizeof(unsigned int);
+    if (!CreateBuffer(vertex_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                      &mesh.vertices) ||
+        !CreateBuffer(index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                      &mesh.indices)) {
+        DestroyBuffer(&mesh.vertices);
+        DestroyBuffer(&mesh.indices);
+        return INVALID_HANDLE;
+    }
+    std::memcpy(mesh.vertices.mapped, vertex_data.data(), vertex_size);
+    std::memcpy(mesh.indices.mapped, index_data.data(), index_size);
+
+    meshes_.push_back(mesh);
+    return static_cast<uint32_t>(meshes_.size() - 1);
+}
+
+void VulkanRenderBackend::BindShader(uint32_t shader)
+{
+    TM_ASSERT(is_recording_);
+    recorders_[0]->BindShader(shader);
+}
+
+void VulkanRenderBackend::BindMaterial(uint32_t material)
+{
+    TM_ASSERT(is_recording_);
+    recorders_[0]->BindMaterial(material);
+}
+
+void VulkanRenderBackend::BindMesh(uint32_t mesh)
+{
+    TM_ASSERT(is_recording_);
+    recorders_[0]->BindMesh(mesh);
+}
+
+void VulkanRenderBackend::BindObjectConstants(uint32_t constants)
+{
+    TM_ASSERT(is_recording_);
+    recorders_[0]->BindObjectConstants(constants);
+}
+
+void VulkanRenderBackend::DrawIndexed(uint32_t index_count,
+                                      uint32_t index_offset,
+                                      int32_t vertex_offset)
+{
+    TM_ASSERT(is_recording_);
+    recorders_[0]->DrawIndexed(index_count, index_offset, vertex_offset);
+}
+
+bool VulkanRenderBackend::BeginFrame(const float clear_color[4])
+{
+    TM_ASSERT(!is_recording_);
+    Frame& frame = frames_[frame_index_];
+    if (!WaitForTimeline(frame.timeline_value)) {
+        return false;
+    }
+
+    vkResetCommandPool(device_, frame.command_pool, 0);
+    for (VkCommandPool pool : frame.thread_pools) {
+        vkResetCommandPool(device_, pool, 0);
+    }
+
+    std::memcpy(clear_color_, clear_color, sizeof(clear_color_));
+    if (!recorders_[0]->Begin(frame.thread_command_buffers[0],
+                              frame.descriptor_set)) {
+        return false;
+    }
+    is_recording_ = true;
+    parallel_thread_count_ = 0;
+    return true;
+}
+
+void VulkanRenderBackend::SetSceneConstants(const float* view_projection)
+{
+    TM_ASSERT(is_recording_);
+    std::memcpy(frames_[frame_index_].scene_constants.mapped, view_projection,
+                MATRIX_SIZE);
+}
+
+void VulkanRenderBackend::SetObjectConstantData(const void* data, size_t size)
+{
+    TM_ASSERT(is_recording_);
+    Frame& frame = frames_[frame_index_];
+    if (size > frame.object_constants.size) {
+        // The GPU is done with the frame, so its buffer can be replaced. The
+        // descriptor set changes too, so this has to run before any draw.
+        const VkDeviceSize new_size =
+            std::max<VkDeviceSize>(size, frame.object_constants.size * 2);
+        DestroyBuffer(&frame.object_constants);
+        if (!CreateBuffer(new_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                          &frame.object_constants)) {
+            TM_BREAK();
+            return;
+        }
+        UpdateObjectConstantsDescriptor(frame);
+    }
+    std::memcpy(frame.object_constants.mapped, data, size);
+}
+
+void VulkanRenderBackend::SubmitParallel(const CommandBuffer& commands)
+{
+    TM_ASSERT(is_recording_);
+    TM_ASSERT(parallel_thread_count_ == 0);
+
+    const size_t command_count = commands.command_count();
+    const size_t used_threads = std::min<size_t>(
+        thread_count(),
+        std::max<size_t>(1, command_count / params_.min_draws_per_thread));
+    parallel_thread_count_ = used_threads;
+    if (used_threads == 1) {
+        commands.Submit(recorders_[0].get());
+        return;
+    }
+
+    // Contiguous ranges, so executing the secondary command buffers in
+    // thread order keeps the sorted order
+    const Frame& frame = frames_[frame_index_];
+    const size_t slice_size = (command_count + used_threads - 1) / used_threads;
+    // Not vector<bool>, the threads write their flags concurrently
+    std::vector<uint8_t> succeeded(used_threads, 1);
+    const auto record_slice = [this, &commands, &frame, &succeeded,
+                               command_count, slice_size](size_t thread) {
+        const size_t begin = std::min(thread * slice_size, command_count);
+        const size_t end = std::min(begin + slice_size, command_count);
+        ThreadRecorder* recorder = recorders_[thread].get();
+        if (thread == 0) {
+            commands.Submit(recorder, begin, end);
+            return;
+        }
+        if (!recorder->Begin(frame.thread_command_buffers[thread],
+                             frame.descriptor_set)) {
+            succeeded[thread] = 0;
+            return;
+        }
+        commands.Submit(recorder, begin, end);
+        succeeded[thread] = recorder->End() ? 1 : 0;
+    };
+
+    for (size_t thread = 1; thread < used_threads; ++thread) {
+        workers_[thread - 1]->Start(
+            [&record_slice, thread] { record_slice(thread); });
+    }
+    record_slice(0);
+    for (size_t thread = 1; thread < used_threads; ++thread) {
+        workers_[thread - 1]->Wait();
+    }
+
+    // A buffer that failed to record cannot be executed, drop its draws
+    // and the ones after it
+    for (size_t thread = 1; thread < used_threads; ++thread) {
+        if (!succeeded[thread]) {
+            parallel_thread_count_ = thread;
+            break;
+        }
+    }
+}
+
+bool VulkanRenderBackend::EndFrame()
+{
+    TM_ASSERT(is_recording_);
+    is_recording_ = false;
+    Frame& frame = frames_[frame_index_];
+    if (!recorders_[0]->End()) {
+        return false;
+    }
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(frame.command_buffer, &begin_info) !=
+        VK_SUCCESS) {
+        TM_LOG_ERROR("Could not begin the frame command buffer.");
+        return false;
+    }
+
+    VkClearValue clear_values[2] = {};
+    std::memcpy(clear_values[0].color.float32, clear_color_,
+                sizeof(clear_color_));
+    clear_values[1].depthStencil.depth = 1.0f;
+    clear_values[1].depthStencil.stencil = 0;
+
+    VkRenderPassBeginInfo render_pass_info = {};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_info.renderPass = render_pass_;
+    render_pass_info.framebuffer = framebuffer_;
+    render_pass_info.renderArea.extent.width = params_.width;
+    render_pass_info.renderArea.extent.height = params_.height;
+    render_pass_info.clearValueCount = 2;
+    render_pass_info.pClearValues = clear_values;
+    vkCmdBeginRenderPass(frame.command_buffer, &render_pass_info,
+                         VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(
+        frame.command_buffer,
+        static_cast<uint32_t>(std::max<size_t>(1, parallel_thread_count_)),
+        frame.thread_command_buffers.data());
+    vkCmdEndRenderPass(frame.command_buffer);
+
+    if (vkEndCommandBuffer(frame.command_buffer) != VK_SUCCESS) {
+        TM_LOG_ERROR("Could not record the frame command buffer.");
+        return false;
+    }
+
+    const uint64_t signal_value = timeline_value_ + 1;
+    VkTimelineSemaphoreSubmitInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues = &signal_value;
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_info;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &frame.command_buffer;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &timeline_;
+    if (vkQueueSubmit(queue_, 1, &submit_info, VK_NULL_HANDLE) !=
+        VK_SUCCESS) {
+        TM_LOG_ERROR("Could not submit the frame.");
+        return false;
+    }
+
+    timeline_value_ = signal_value;
+    frame.timeline_value = signal_value;
+    frame_index_ = (frame_index_ + 1) % params_.frames_in_flight;
+    return true;
+}
+
+bool VulkanRenderBackend::ReadColorBuffer(std::vector<uint32_t>* pixels)
+{
+    TM_ASSERT(!is_recording_);
+    if (timeline_value_ == 0) {
+        TM_LOG_ERROR("There is no frame to read back.");
+        return false;
+    }
+
+    const VkDeviceSize size =
+        static_cast<VkDeviceSize>(params_.width) * params_.height * 4;
+    if (readback_.buffer == VK_NULL_HANDLE) {
+        if (!CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          &readback_)) {
+            return false;
+        }
+
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = queue_family_;
+        if (vkCreateCommandPool(device_, &pool_info, nullptr,
+                                &readback_pool_) != VK_SUCCESS) {
+            TM_LOG_ERROR("Could not create the readback command pool.");
+            return false;
+        }
+    }
+
+    VkCommandBufferAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.commandPool = readback_pool_;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandBufferCount = 1;
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    if (vkAllocateCommandBuffers(device_, &allocate_info, &command_buffer) !=
+        VK_SUCCESS) {
+        TM_LOG_ERROR("Could not allocate the readback command buffer.");
+        return false;
+    }
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(command_buffer, &begin_info);
+
+    // The render pass leaves the color target ready to be copied
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = params_.width;
+    region.imageExtent.height = params_.height;
+    region.imageExtent.depth = 1;
+    vkCmdCopyImageToBuffer(command_buffer, color_target_.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           readback_.buffer, 1, &region);
+
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = readback_.buffer;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1,
+                         &barrier, 0, nullptr);
+
+    bool is_copied = vkEndCommandBuffer(command_buffer) == VK_SUCCESS;
+    if (is_copied) {
+        const uint64_t signal_value = timeline_value_ + 1;
+        VkTimelineSemaphoreSubmitInfo timeline_info = {};
+        timeline_info.sType =
+            VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &signal_value;
+
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = &timeline_info;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &command_buffer;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &timeline_;
+        is_copied = vkQueueSubmit(queue_, 1, &submit_info, VK_NULL_HANDLE) ==
+                        VK_SUCCESS &&
+                    WaitForTimeline(signal_value);
+        if (is_copied) {
+            timeline_value_ = signal_value;
+        }
+    }
+
+    if (is_copied) {
+        pixels->resize(static_cast<size_t>(params_.width) * params_.height);
+        std::memcpy(pixels->data(), readback_.mapped, size);
+    } else {
+        TM_LOG_ERROR("Could not read back the color target.");
+        vkQueueWaitIdle(queue_);
+    }
+    vkFreeCommandBuffers(device_, readback_pool_, 1, &command_buffer);
+    return is_copied;
+}
+
+bool VulkanRenderBackend::WaitIdle()
+{
+    return vkQueueWaitIdle(queue_) == VK_SUCCESS;
+}
+
+bool VulkanRenderBackend::InitializeInstance()
+{
+    VkApplicationInfo app_info = {};
+    app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app_info.pApplicationName = "Tamarindo";
+    app_info.pEngineName = "Tamarindo";
+    // Timeline semaphores are core in 1.2
+    app_info.apiVersion = VK_API_VERSION_1_2;
+
+    const char* validation_layer = "VK_LAYER_KHRONOS_validation";
+    VkInstanceCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    info.pApplicationInfo = &app_info;
+    if (params_.enable_validation) {
+        info.enabledLayerCount = 1;
+        info.ppEnabledLayerNames = &validation_layer;
+    }
+
+    const VkResult result = vkCreateInstance(&info, nullptr, &instance_);
+    if (result != VK_SUCCESS) {
+        TM_LOG_ERROR("Could not create Vulkan instance. Error: {}",
+                     static_cast<int>(result));
+        return false;
+    }
+    return true;
+}
+
+bool VulkanRenderBackend::InitializeDevice()
+{
+    uint32_t device_count = 0;
+    vkEnumeratePhysicalDevices(instance_, &device_count, nullptr);
+    std::vector<VkPhysicalDevice> devices(device_count);
+    vkEnumeratePhysicalDevices(instance_, &device_count, devices.data());
+
+    // First device with Vulkan 1.2, timeline semaphores and a graphics
+    // queue. VK_ICD_FILENAMES selects lavapipe on machines with a GPU.
+    for (VkPhysicalDevice device : devices) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        if (properties.apiVersion < VK_API_VERSION_1_2) {
+            continue;
+        }
+
+        VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features = {};
+        timeline_features.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &timeline_features;
+        vkGetPhysicalDeviceFeatures2(device, &features);
+        if (!timeline_features.timelineSemaphore) {
+            continue;
+        }
+
+        uint32_t family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count,
+                                                 nullptr);
+        std::vector<VkQueueFamilyProperties> families(family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count,
+                                                 families.data());
+        for (uint32_t i = 0; i < family_count; ++i) {
+            if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                physical_device_ = device;
+                device_properties_ = properties;
+                queue_family_ = i;
+                break;
+            }
+        }
+        if (physical_device_ != VK_NULL_HANDLE) {
+            break;
+        }
+    }
+
+    if (physical_device_ == VK_NULL_HANDLE) {
+        TM_LOG_ERROR("There is no Vulkan 1.2 device with timeline semaphores.");
+        return false;
+    }
+    vkGetPhysicalDeviceMemoryProperties(physical_device_, &memory_properties_);
+    TM_LOG_INFO("Vulkan device: {}", device_properties_.deviceName);
+
+    const float queue_priority = 1.0f;
+    VkDeviceQueueCreateInfo queue_info = {};
+    queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queue_info.queueFamilyIndex = queue_family_;
+    queue_info.queueCount = 1;
+    queue_info.pQueuePriorities = &queue_priority;
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features = {};
+    timeline_features.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timeline_features.timelineSemaphore = VK_TRUE;
+
+    VkDeviceCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    info.pNext = &timeline_features;
+    info.queueCreateInfoCount = 1;
+    info.pQueueCreateInfos = &queue_info;
+    const VkResult result =
+        vkCreateDevice(physical_device_, &info, nullptr, &device_);
+    if (result != VK_SUCCESS) {
+        TM_LOG_ERROR("Could not create Vulkan device. Error: {}",
+                     static_cast<int>(result));
+        return false;
+    }
+    vkGetDeviceQueue(device_, queue_family_, 0, &queue_);
+
+    VkSemaphoreTypeCreateInfo type_info = {};
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_info = {};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = &type_info;
+    if (vkCreateSemaphore(device_, &semaphore_info, nullptr, &timeline_) !=
+        VK_SUCCESS) {
+        TM_LOG_ERROR("Could not create the timeline semaphore.");
+        return false;
+    }
+    return true;
+}
+
+bool VulkanRenderBackend::InitializeRenderTarget()
+{
+    // The D3D11 path uses D24S8, fall back to 32-bit float depth where it is
+    // not supported
+    const VkFormat depth_formats[3] = {VK_FORMAT_D24_UNORM_S8_UINT,
+                                       VK_FORMAT_X8_D24_UNORM_PACK32,
+                                       VK_FORMAT_D32_SFLOAT};
+    for (VkFormat format : depth_formats) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physical_device_, format,
+                                            &properties);
+        if (properties.optimalTilingFeatures &
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            depth_format_ = format;
+            break;
+        }
+    }
+    if (depth_format_ == VK_FORMAT_UNDEFINED) {
+        TM_LOG_ERROR("There is no supported depth format.");
+        return false;
+    }
+
+    if (!CreateImage(COLOR_FORMAT,
+                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                         VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                     VK_IMAGE_ASPECT_COLOR_BIT, &color_target_)) {
+        TM_LOG_ERROR("Could not create the color target.");
+        return false;
+    }
+
+    VkImageAspectFlags depth_aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (HasStencil(depth_format_)) {
+        depth_aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    if (!CreateImage(depth_format_,
+                     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                     depth_aspect, &depth_target_)) {
+        TM_LOG_ERROR("Could not create the depth target.");
+        return false;
+    }
+    return true;
+}
+
+bool VulkanRenderBackend::InitializeRenderPass()
+{
+    VkAttachmentDescription attachments[2] = {};
+    attachments[0].format = COLOR_FORMAT;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    attachments[1].format = depth_format_;
+    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[1].finalLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference color_reference = {
+        0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depth_reference = {
+        1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_reference;
+    subpass.pDepthStencilAttachment = &depth_reference;
+
+    // Frames in flight share the targets, so a frame waits for the
+    // attachment writes and the readback of the previous one, and the
+    // readback waits for the color writes
+    VkSubpassDependency dependencies[2] = {};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+        VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[0].srcAccessMask =
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstStageMask =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask =
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    VkRenderPassCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    info.attachmentCount = 2;
+    info.pAttachments = attachments;
+    info.subpassCount = 1;
+    info.pSubpasses = &subpass;
+    info.dependencyCount = 2;
+    info.pDependencies = dependencies;
+    if (vkCreateRenderPass(device_, &info, nullptr, &render_pass_) !=
+        VK_SUCCESS) {
+        TM_LOG_ERROR("Could not create render pass.");
+        return false;
+    }
+
+    const VkImageView views[2] = {color_target_.view, depth_target_.view};
+    VkFramebufferCreateInfo framebuffer_info = {};
+    framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebuffer_info.renderPass = render_pass_;
+    framebuffer_info.attachmentCount = 2;
+    framebuffer_info.pAttachments = views;
+    framebuffer_info.width = params_.width;
+    framebuffer_info.height = params_.height;
+    framebuffer_info.layers = 1;
+    if (vkCreateFramebuffer(device_, &framebuffer_info, nullptr,
+                            &framebuffer_) != VK_SUCCESS) {
+        TM_LOG_ERROR("Could not create framebuffer.");
+        return false;
+    }
+    return true;
+}
+
+bool VulkanRenderBackend::InitializePipelineLayout()
+{
+    // Dynamic uniform buffers, so binding the constants of a draw is only a
+    // new offset
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = SCENE_CONSTANTS_BINDING;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    bindings[1].binding = OBJECT_CONSTANTS_BINDING;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo set_layout_info = {};
+    set_layout_info.sType =
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_info.bindingCount = 2;
+    set_layout_info.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device_, &set_layout_info, nullptr,
+                                    &descriptor_set_layout_) != VK_SUCCESS) {
+        TM_LOG_ERROR("Could not create descriptor set layout.");
+        return false;
+    }
+
+    VkPipelineLayoutCreateInfo layout_info = {};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &descriptor_set_layout_;
+    if (vkCreatePipelineLayout(device_, &layout_info, nullptr,
+                               &pipeline_layout_) != VK_SUCCESS) {
+        TM_LOG_ERROR("Could not create pipeline layout.");
+        return false;
+    }
+
+    VkDescriptorPoolSize pool_size = {};
+    pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    pool_size.descriptorCount = 2 * params_.frames_in_flight;
+
+    VkDescriptorPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = params_.frames_in_flight;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    if (vkCreateDescriptorPool(device_, &pool_info, nullptr,
+                               &descriptor_pool_) != VK_SUCCESS) {
+        TM_LOG_ERROR("Could not create descriptor pool.");
+        return false;
+    }
+    return true;
+}
+
+bool VulkanRenderBackend::InitializeFrames()
+{
+    frames_.resize(params_.frames_in_flight);
+    for (Frame& frame : frames_) {
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex = queue_family_;
+
+        VkCommandBufferAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocate_info.commandBufferCount = 1;
+
+        if (vkCreateCommandPool(device_, &pool_info, nullptr,
+                                &frame.command_pool) != VK_SUCCESS) {
+            TM_LOG_ERROR("Could not create command pool.");
+            return false;
+        }
+        allocate_info.commandPool = frame.command_pool;
+        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        if (vkAllocateCommandBuffers(device_, &allocate_info,
+                                     &frame.command_buffer) != VK_SUCCESS) {
+            TM_LOG_ERROR("Could not allocate command buffer.");
+            return false;
+        }
+
+        // Command pools are externally synchronized, so every recording
+        // thread gets its own
+        frame.thread_pools.resize(thread_count(), VK_NULL_HANDLE);
+        frame.thread_command_buffers.resize(thread_count(), VK_NULL_HANDLE);
+        for (unsigned int thread = 0; thread < thread_count(); ++thread) {
+            if (vkCreateCommandPool(device_, &pool_info, nullptr,
+                                    &frame.thread_pools[thread]) !=
+                VK_SUCCESS) {
+                TM_LOG_ERROR("Could not create command pool.");
+                return false;
+            }
+            allocate_info.commandPool = frame.thread_pools[thread];
+            allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            if (vkAllocateCommandBuffers(
+                    device_, &allocate_info,
+                    &frame.thread_command_buffers[thread]) != VK_SUCCESS) {
+                TM_LOG_ERROR("Could not allocate command buffer.");
+                return false;
+            }
+        }
+
+        if (!CreateBuffer(MATRIX_SIZE, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                          &frame.scene_constants) ||
+            !CreateBuffer(INITIAL_OBJECT_CONSTANTS_SIZE,
+                          VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                          &frame.object_constants)) {
+            return false;
+        }
+
+        VkDescriptorSetAllocateInfo set_info = {};
+        set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        set_info.descriptorPool = descriptor_pool_;
+        set_info.descriptorSetCount = 1;
+        set_info.pSetLayouts = &descriptor_set_layout_;
+        if (vkAllocateDescriptorSets(device_, &set_info,
+                                     &frame.descriptor_set) != VK_SUCCESS) {
+            TM_LOG_ERROR("Could not allocate descriptor set.");
+            return false;
+        }
+
+        VkDescriptorBufferInfo scene_info = {};
+        scene_info.buffer = frame.scene_constants.buffer;
+        scene_info.offset = 0;
+        scene_info.range = MATRIX_SIZE;
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = frame.descriptor_set;
+        write.dstBinding = SCENE_CONSTANTS_BINDING;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        write.pBufferInfo = &scene_info;
+        vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+        UpdateObjectConstantsDescriptor(frame);
+    }
+    return true;
+}
+
+bool VulkanRenderBackend::CreateBuffer(VkDeviceSize size,
+                                       VkBufferUsageFlags usage,
+                                       Buffer* buffer)
+{
+    VkBufferCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = size;
+    info.usage = usage;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device_, &info, nullptr, &buffer->buffer) !=
+        VK_SUCCESS) {
+        TM_LOG_ERROR("Could not create buffer.");
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device_, buffer->buffer, &requirements);
+
+    VkMemoryAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.allocationSize = requirements.size;
+    if (!FindMemoryType(requirements.memoryTypeBits,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        &allocate_info.memoryTypeIndex) ||
+        vkAllocateMemory(device_, &allocate_info, nullptr,
+                         &buffer->memory) != VK_SUCCESS ||
+        vkBindBufferMemory(device_, buffer->buffer, buffer->memory, 0) !=
+            VK_SUCCESS ||
+        vkMapMemory(device_, buffer->memory, 0, VK_WHOLE_SIZE, 0,
+                    &buffer->mapped) != VK_SUCCESS) {
+        TM_LOG_ERROR("Could not allocate buffer memory.");
+        DestroyBuffer(buffer);
+        return false;
+    }
+    buffer->size = size;
+    return true;
+}
+
+void VulkanRenderBackend::DestroyBuffer(Buffer* buffer)
+{
+    // Freeing the memory unmaps it
+    vkDestroyBuffer(device_, buffer->buffer, nullptr);
+    vkFreeMemory(device_, buffer->memory, nullptr);
+    *buffer = Buffer();
+}
+
+bool VulkanRenderBackend::CreateImage(VkFormat format,
+                                      VkImageUsageFlags usage,
+                                      VkImageAspectFlags aspect, Image* image)
+{
+    VkImageCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    info.imageType = VK_IMAGE_TYPE_2D;
+    info.format = format;
+    info.extent.width = params_.width;
+    info.extent.height = params_.height;
+    info.extent.depth = 1;
+    info.mipLevels = 1;
+    info.arrayLayers = 1;
+    info.samples = VK_SAMPLE_COUNT_1_BIT;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.usage = usage;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device_, &info, nullptr, &image->image) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device_, image->image, &requirements);
+
+    VkMemoryAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.allocationSize = requirements.size;
+    if (!FindMemoryType(requirements.memoryTypeBits,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        &allocate_info.memoryTypeIndex) ||
+        vkAllocateMemory(device_, &allocate_info, nullptr, &image->memory) !=
+            VK_SUCCESS ||
+        vkBindImageMemory(device_, image->image, image->memory, 0) !=
+            VK_SUCCESS) {
+        DestroyImage(image);
+        return false;
+    }
+
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = image->image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.subresourceRange.aspectMask = aspect;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(device_, &view_info, nullptr, &image->view) !=
+        VK_SUCCESS) {
+        DestroyImage(image);
+        return false;
+    }
+    return true;
+}
+
+void VulkanRenderBackend::DestroyImage(Image* image)
+{
+    vkDestroyImageView(device_, image->view, nullptr);
+    vkDestroyImage(device_, image->image, nullptr);
+    vkFreeMemory(device_, image->memory, nullptr);
+    *image = Image();
+}
+
+bool VulkanRenderBackend::FindMemoryType(uint32_t type_bits,
+                                         VkMemoryPropertyFlags properties,
+                                         uint32_t* type_index) const
+{
+    for (uint32_t i = 0; i < memory_properties_.memoryTypeCount; ++i) {
+        const VkMemoryPropertyFlags flags =
+            memory_properties_.memoryTypes[i].propertyFlags;
+        if ((type_bits & (1u << i)) && (flags & properties) == properties) {
+            *type_index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void VulkanRenderBackend::UpdateObjectConstantsDescriptor(const Frame& frame)
+{
+    // Draws only see one model matrix past their dynamic offset
+    VkDescriptorBufferInfo buffer_info = {};
+    buffer_info.buffer = frame.object_constants.buffer;
+    buffer_info.offset = 0;
+    buffer_info.range = MATRIX_SIZE;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = frame.descriptor_set;
+    write.dstBinding = OBJECT_CONSTANTS_BINDING;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+}
+
+bool VulkanRenderBackend::WaitForTimeline(uint64_t value)
+{
+    if (value == 0) {
+        return true;
+    }
+
+    VkSemaphoreWaitInfo wait_info = {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &timeline_;
+    wait_info.pValues = &value;
+    if (vkWaitSemaphores(device_, &wait_info, UINT64_MAX) != VK_SUCCESS) {
+        TM_LOG_ERROR("Could not wait for the GPU.");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace tamarindo
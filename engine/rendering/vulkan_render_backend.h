@@ -0,0 +1,235 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_RENDERING_VULKAN_RENDER_BACKEND_H_
+#define ENGINE_LIB_RENDERING_VULKAN_RENDER_BACKEND_H_
+
+#include "rendering/render_backend.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tamarindo
+{
+
+class CommandBuffer;
+class FrameWorker;
+
+struct VulkanRenderBackendParams {
+    unsigned int width = 1280;
+    unsigned int height = 720;
+    // Frames the CPU can record while the GPU works on the previous ones
+    unsigned int frames_in_flight = 2;
+    // Threads recording secondary command buffers, the calling thread
+    // included. Zero uses one per hardware thread.
+    unsigned int thread_count = 0;
+    // Ranges never get smaller than this, small frames are recorded on the
+    // calling thread alone
+    size_t min_draws_per_thread = 256;
+    bool enable_validation = false;
+};
+
+// Vulkan 1.2 implementation of the rendering layer. Renders into an
+// offscreen color and depth target, so it runs headless, on Mesa lavapipe
+// included. Mirrors the D3D11 path: the SHADER_CODE bindings (scene
+// constants in b0, object constants in b1), a 24-bit depth buffer with
+// LESS, back face culling with clockwise front faces, and per-draw
+// constants addressed in 16-byte constants.
+//
+// Every thread records into its own secondary command buffer, allocated
+// from its own pool per frame in flight, and the primary command buffer
+// executes them in order. A timeline semaphore tracks the frames: each
+// submission signals the next value, and a frame slot is reused once the
+// GPU has reached the value it was submitted with.
+class VulkanRenderBackend : public RenderBackend
+{
+   public:
+    VulkanRenderBackend();
+    ~VulkanRenderBackend() override;
+
+    VulkanRenderBackend(const VulkanRenderBackend& other) = delete;
+    VulkanRenderBackend& operator=(const VulkanRenderBackend& other) = delete;
+
+    bool Initialize(const VulkanRenderBackendParams& params);
+
+    void Shutdown();
+
+    // There is no HLSL compiler at runtime, shaders have to be compiled to
+    // SPIR-V offline and created with CreateShaderFromSpirv()
+    uint32_t CreateShader(const std::string& source) override;
+
+    // SPIR-V of the `vs` and `ps` entry points of SHADER_CODE, or of any
+    // program with the same inputs and bindings
+    uint32_t CreateShaderFromSpirv(const std::vector<uint32_t>& vertex_code,
+                                   const std::vector<uint32_t>& pixel_code);
+
+    uint32_t CreateMesh(const std::vector<float>& vertex_data,
+                        const std::vector<unsigned int>& index_data) override;
+
+    // Recorded on the calling thread, before the draws of SubmitParallel()
+    void BindShader(uint32_t shader) override;
+    void BindMaterial(uint32_t material) override;
+    void BindMesh(uint32_t mesh) override;
+    void BindObjectConstants(uint32_t constants) override;
+    void DrawIndexed(uint32_t index_count, uint32_t index_offset,
+                     int32_t vertex_offset) override;
+
+    // Waits until the GPU is done with the frame slot and starts recording.
+    // `clear_color` is RGBA in [0, 1].
+    bool BeginFrame(const float clear_color[4]);
+
+    // View projection matrix, laid out like the scene constant buffer
+    void SetSceneConstants(const float* view_projection);
+
+    // Copies the object constants of the frame, laid out like the D3D11
+    // frame constant buffer. Offsets must be aligned to the device minimum
+    // uniform buffer offset alignment, 256 bytes covers every device.
+    void SetObjectConstantData(const void* data, size_t size);
+
+    // Splits `commands` into contiguous ranges and records each one into the
+    // secondary command buffer of a thread. Once per frame.
+    void SubmitParallel(const CommandBuffer& commands);
+
+    // Executes the secondary command buffers and submits the frame
+    bool EndFrame();
+
+    // Waits for the last frame and copies its color target, RGBA8 rows of
+    // width() pixels
+    bool ReadColorBuffer(std::vector<uint32_t>* pixels);
+
+    bool WaitIdle();
+
+    inline unsigned int width() const { return params_.width; }
+    inline unsigned int height() const { return params_.height; }
+
+    inline unsigned int thread_count() const
+    {
+        return static_cast<unsigned int>(workers_.size() + 1);
+    }
+
+    inline const VkPhysicalDeviceProperties& device_properties() const
+    {
+        return device_properties_;
+    }
+
+   private:
+    class ThreadRecorder;
+
+    struct Buffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;
+    };
+
+    struct Image {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+    };
+
+    struct Mesh {
+        Buffer vertices;
+        Buffer indices;
+    };
+
+    struct Frame {
+        VkCommandPool command_pool = VK_NULL_HANDLE;
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+
+        // One pool and secondary command buffer per thread
+        std::vector<VkCommandPool> thread_pools;
+        std::vector<VkCommandBuffer> thread_command_buffers;
+
+        Buffer scene_constants;
+        Buffer object_constants;
+        VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+
+        // Timeline value signaled when the GPU is done with the frame
+        uint64_t timeline_value = 0;
+    };
+
+    bool InitializeInstance();
+    bool InitializeDevice();
+    bool InitializeRenderTarget();
+    bool InitializeRenderPass();
+    bool InitializePipelineLayout();
+    bool InitializeFrames();
+
+    bool CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                      Buffer* buffer);
+    void DestroyBuffer(Buffer* buffer);
+    bool CreateImage(VkFormat format, VkImageUsageFlags usage,
+                     VkImageAspectFlags aspect, Image* image);
+    void DestroyImage(Image* image);
+    bool FindMemoryType(uint32_t type_bits, VkMemoryPropertyFlags properties,
+                        uint32_t* type_index) const;
+
+    // Points the object constants binding of `frame` at its buffer
+    void UpdateObjectConstantsDescriptor(const Frame& frame);
+
+    bool WaitForTimeline(uint64_t value);
+
+    VulkanRenderBackendParams params_;
+
+    VkInstance instance_ = VK_NULL_HANDLE;
+    VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties device_properties_ = {};
+    VkPhysicalDeviceMemoryProperties memory_properties_ = {};
+    VkDevice device_ = VK_NULL_HANDLE;
+    uint32_t queue_family_ = 0;
+    VkQueue queue_ = VK_NULL_HANDLE;
+
+    VkFormat depth_format_ = VK_FORMAT_UNDEFINED;
+    Image color_target_;
+    Image depth_target_;
+    VkRenderPass render_pass_ = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer_ = VK_NULL_HANDLE;
+
+    VkDescriptorSetLayout descriptor_set_layout_ = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+    VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+
+    std::vector<VkPipeline> pipelines_;
+    std::vector<Mesh> meshes_;
+
+    VkSemaphore timeline_ = VK_NULL_HANDLE;
+    uint64_t timeline_value_ = 0;
+
+    std::vector<Frame> frames_;
+    uint32_t frame_index_ = 0;
+    bool is_recording_ = false;
+    // Secondary command buffers recorded by SubmitParallel() this frame,
+    // zero until it runs
+    size_t parallel_thread_count_ = 0;
+    float clear_color_[4] = {};
+
+    // Recorder 0 belongs to the calling thread
+    std::vector<std::unique_ptr<ThreadRecorder>> recorders_;
+    std::vector<std::unique_ptr<FrameWorker>> workers_;
+
+    // Readback of the color target, created on first use
+    Buffer readback_;
+    VkCommandPool readback_pool_ = VK_NULL_HANDLE;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_RENDERING_VULKAN_RENDER_BACKEND_H_
@@ -0,0 +1,63 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "utils/cpu_features.h"
+
+#if defined(TM_CPU_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace tamarindo
+{
+
+namespace
+{
+
+bool DetectAVX2()
+{
+#if defined(TM_CPU_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+
+    // The OS must also save the YMM registers on context switches
+    __cpuid(info, 1);
+    const bool has_osxsave = (info[2] & (1 << 27)) != 0;
+    const bool has_avx = (info[2] & (1 << 28)) != 0;
+    if (!has_osxsave || !has_avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(TM_CPU_X86)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+}  // namespace
+
+bool CpuSupportsAVX2()
+{
+    static const bool s_supports_avx2 = DetectAVX2();
+    return s_supports_avx2;
+}
+
+}  // namespace tamarindo
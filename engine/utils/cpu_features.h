@@ -0,0 +1,41 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_UTILS_CPU_FEATURES_H_
+#define ENGINE_LIB_UTILS_CPU_FEATURES_H_
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || \
+    defined(__i386__)
+#define TM_CPU_X86
+#endif
+
+// GCC and Clang need the AVX2 functions to be flagged, so the rest of a file
+// can still be built for the baseline instruction set.
+#if defined(TM_CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TM_TARGET_AVX2
+#endif
+
+namespace tamarindo
+{
+
+// True when the CPU and the OS support AVX2. Detected once and cached.
+bool CpuSupportsAVX2();
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_UTILS_CPU_FEATURES_H_
@@ -0,0 +1,54 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_UTILS_DOUBLE_BUFFER_H_
+#define ENGINE_LIB_UTILS_DOUBLE_BUFFER_H_
+
+#include <array>
+
+namespace tamarindo
+{
+
+// Two copies of T: one being written for the next frame and one, immutable,
+// being read for the current frame. The writer and the reader may run on
+// different threads, but Swap() must only be called while neither of them
+// is using the buffers.
+template <typename T>
+class DoubleBuffer
+{
+   public:
+    DoubleBuffer() = default;
+    ~DoubleBuffer() = default;
+
+    DoubleBuffer(const DoubleBuffer& other) = delete;
+    DoubleBuffer& operator=(const DoubleBuffer& other) = delete;
+
+    inline T& GetWriteBuffer() { return buffers_[1 - read_index_]; }
+
+    inline const T& GetReadBuffer() const { return buffers_[read_index_]; }
+
+    // Publishes the write buffer to the reader. The old read buffer becomes
+    // the next write buffer, so the writer has to fill it completely.
+    inline void Swap() { read_index_ = 1 - read_index_; }
+
+   private:
+    std::array<T, 2> buffers_;
+    int read_index_ = 0;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_UTILS_DOUBLE_BUFFER_H_
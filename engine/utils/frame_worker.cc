@@ -0,0 +1,78 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "utils/frame_worker.h"
+
+#include "utils/macros.h"
+
+namespace tamarindo
+{
+
+FrameWorker::FrameWorker() : thread_(&FrameWorker::WorkerLoop, this) {}
+
+FrameWorker::~FrameWorker()
+{
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_stopping_ = true;
+    }
+    job_available_.notify_one();
+    thread_.join();
+}
+
+void FrameWorker::Start(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TM_ASSERT(!has_job_);
+        job_ = std::move(job);
+        has_job_ = true;
+    }
+    job_available_.notify_one();
+}
+
+void FrameWorker::Wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_finished_.wait(lock, [this] { return !has_job_; });
+}
+
+void FrameWorker::WorkerLoop()
+{
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            job_available_.wait(lock,
+                                [this] { return has_job_ || is_stopping_; });
+            if (is_stopping_) {
+                return;
+            }
+            job = std::move(job_);
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            has_job_ = false;
+        }
+        job_finished_.notify_all();
+    }
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,61 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_UTILS_FRAME_WORKER_H_
+#define ENGINE_LIB_UTILS_FRAME_WORKER_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace tamarindo
+{
+
+// Dedicated thread that runs one job per frame, so the job overlaps with
+// whatever the calling thread does between Start() and Wait().
+class FrameWorker
+{
+   public:
+    FrameWorker();
+    ~FrameWorker();
+
+    FrameWorker(const FrameWorker& other) = delete;
+    FrameWorker& operator=(const FrameWorker& other) = delete;
+
+    // Hands `job` to the worker thread. The previous job must be finished.
+    void Start(std::function<void()> job);
+
+    // Blocks until the current job, if any, has finished
+    void Wait();
+
+   private:
+    void WorkerLoop();
+
+    std::mutex mutex_;
+    std::condition_variable job_available_;
+    std::condition_variable job_finished_;
+
+    std::function<void()> job_;
+    bool has_job_ = false;
+    bool is_stopping_ = false;
+
+    std::thread thread_;
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_UTILS_FRAME_WORKER_H_
@@ -0,0 +1,349 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "utils/tlsf_allocator.h"
+
+#include "utils/macros.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace tamarindo
+{
+
+namespace
+{
+
+// Index of the highest set bit, `value` must not be zero
+inline uint32_t FindLastSet(uint32_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return 31 - static_cast<uint32_t>(__builtin_clz(value));
+#endif
+}
+
+// Index of the lowest set bit, `value` must not be zero
+inline uint32_t FindFirstSet(uint32_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(value));
+#endif
+}
+
+// Size class of a block of `size` units
+inline void Mapping(uint32_t size, uint32_t* first_level,
+                    uint32_t* second_level)
+{
+    if (size < TlsfAllocator::SECOND_LEVEL_COUNT) {
+        *first_level = 0;
+        *second_level = size;
+        return;
+    }
+    const uint32_t msb = FindLastSet(size);
+    *first_level = msb - TlsfAllocator::SECOND_LEVEL_BITS + 1;
+    *second_level = (size >> (msb - TlsfAllocator::SECOND_LEVEL_BITS)) &
+                    (TlsfAllocator::SECOND_LEVEL_COUNT - 1);
+}
+
+// Smallest size class whose blocks all fit `size` units
+inline void MappingSearch(uint32_t size, uint32_t* first_level,
+                          uint32_t* second_level)
+{
+    uint64_t rounded_size = size;
+    if (size >= TlsfAllocator::SECOND_LEVEL_COUNT) {
+        const uint32_t msb = FindLastSet(size);
+        rounded_size +=
+            (1ull << (msb - TlsfAllocator::SECOND_LEVEL_BITS)) - 1;
+    }
+    if (rounded_size > UINT32_MAX) {
+        *first_level = TlsfAllocator::FIRST_LEVEL_COUNT;
+        *second_level = 0;
+        return;
+    }
+    Mapping(static_cast<uint32_t>(rounded_size), first_level, second_level);
+}
+
+}  // namespace
+
+TlsfAllocator::TlsfAllocator(uint32_t size) : size_(0)
+{
+    for (uint32_t& head : free_heads_) {
+        head = INVALID_NODE;
+    }
+    Grow(size);
+}
+
+TlsfAllocator::Allocation TlsfAllocator::Allocate(uint32_t size)
+{
+    TM_ASSERT(size > 0);
+    uint32_t first_level;
+    uint32_t second_level;
+    MappingSearch(size, &first_level, &second_level);
+    uint32_t node = first_level < FIRST_LEVEL_COUNT
+                        ? FindFreeBlock(first_level, second_level)
+                        : INVALID_NODE;
+
+    // The rounded class can miss a block of the exact class that is large
+    // enough, such as the last one left
+    if (node == INVALID_NODE) {
+        Mapping(size, &first_level, &second_level);
+        const uint32_t head =
+            free_heads_[first_level * SECOND_LEVEL_COUNT + second_level];
+        if (head != INVALID_NODE && nodes_[head].size >= size) {
+            node = head;
+        }
+    }
+    if (node == INVALID_NODE) {
+        return Allocation();
+    }
+
+    return AllocateFromBlock(node, size);
+}
+
+TlsfAllocator::Allocation TlsfAllocator::AllocateBelow(uint32_t size,
+                                                       uint32_t limit)
+{
+    TM_ASSERT(size > 0);
+    for (uint32_t node = first_node_;
+         node != INVALID_NODE && nodes_[node].offset < limit;
+         node = nodes_[node].next_physical) {
+        if (nodes_[node].is_free && nodes_[node].size >= size &&
+            size <= limit - nodes_[node].offset) {
+            return AllocateFromBlock(node, size);
+        }
+    }
+    return Allocation();
+}
+
+void TlsfAllocator::Free(const Allocation& allocation)
+{
+    TM_ASSERT(allocation.IsValid());
+    uint32_t node = allocation.node;
+    TM_ASSERT(!nodes_[node].is_free);
+    used_size_ -= nodes_[node].size;
+    --allocation_count_;
+
+    const uint32_t next = nodes_[node].next_physical;
+    if (next != INVALID_NODE && nodes_[next].is_free) {
+        RemoveFreeBlock(next);
+        nodes_[node].size += nodes_[next].size;
+        nodes_[node].next_physical = nodes_[next].next_physical;
+        if (nodes_[next].next_physical != INVALID_NODE) {
+            nodes_[nodes_[next].next_physical].prev_physical = node;
+        } else {
+            last_node_ = node;
+        }
+        ReleaseNode(next);
+    }
+
+    const uint32_t prev = nodes_[node].prev_physical;
+    if (prev != INVALID_NODE && nodes_[prev].is_free) {
+        RemoveFreeBlock(prev);
+        nodes_[prev].size += nodes_[node].size;
+        nodes_[prev].next_physical = nodes_[node].next_physical;
+        if (nodes_[node].next_physical != INVALID_NODE) {
+            nodes_[nodes_[node].next_physical].prev_physical = prev;
+        } else {
+            last_node_ = prev;
+        }
+        ReleaseNode(node);
+        node = prev;
+    }
+
+    InsertFreeBlock(node);
+}
+
+TlsfAllocator::Allocation TlsfAllocator::LastAllocationBelow(
+    uint32_t limit) const
+{
+    uint32_t node = last_node_;
+    while (node != INVALID_NODE &&
+           (nodes_[node].is_free || nodes_[node].offset >= limit)) {
+        node = nodes_[node].prev_physical;
+    }
+    return node == INVALID_NODE ? Allocation()
+                                : Allocation{nodes_[node].offset, node};
+}
+
+TlsfAllocator::Allocation TlsfAllocator::PreviousAllocation(
+    const Allocation& allocation) const
+{
+    TM_ASSERT(allocation.IsValid());
+    uint32_t node = nodes_[allocation.node].prev_physical;
+    if (node != INVALID_NODE && nodes_[node].is_free) {
+        node = nodes_[node].prev_physical;
+    }
+    return node == INVALID_NODE ? Allocation()
+                                : Allocation{nodes_[node].offset, node};
+}
+
+void TlsfAllocator::Grow(uint32_t new_size)
+{
+    TM_ASSERT(new_size >= size_);
+    const uint32_t added_size = new_size - size_;
+    if (added_size == 0) {
+        return;
+    }
+
+    if (last_node_ != INVALID_NODE && nodes_[last_node_].is_free) {
+        RemoveFreeBlock(last_node_);
+        nodes_[last_node_].size += added_size;
+        InsertFreeBlock(last_node_);
+    } else {
+        const uint32_t node = CreateNode(size_, added_size);
+        nodes_[node].prev_physical = last_node_;
+        if (last_node_ != INVALID_NODE) {
+            nodes_[last_node_].next_physical = node;
+        } else {
+            first_node_ = node;
+        }
+        last_node_ = node;
+        InsertFreeBlock(node);
+    }
+    size_ = new_size;
+}
+
+TlsfAllocator::Allocation TlsfAllocator::AllocateFromBlock(uint32_t node,
+                                                           uint32_t size)
+{
+    RemoveFreeBlock(node);
+    if (nodes_[node].size > size) {
+        // The rest of the block stays free, right after the allocation
+        const uint32_t remainder = CreateNode(nodes_[node].offset + size,
+                                              nodes_[node].size - size);
+        nodes_[remainder].prev_physical = node;
+        nodes_[remainder].next_physical = nodes_[node].next_physical;
+        if (nodes_[node].next_physical != INVALID_NODE) {
+            nodes_[nodes_[node].next_physical].prev_physical = remainder;
+        } else {
+            last_node_ = remainder;
+        }
+        nodes_[node].next_physical = remainder;
+        nodes_[node].size = size;
+        InsertFreeBlock(remainder);
+    }
+
+    nodes_[node].is_free = false;
+    used_size_ += size;
+    ++allocation_count_;
+    return Allocation{nodes_[node].offset, node};
+}
+
+uint32_t TlsfAllocator::AllocationSize(const Allocation& allocation) const
+{
+    TM_ASSERT(allocation.IsValid());
+    return nodes_[allocation.node].size;
+}
+
+uint32_t TlsfAllocator::CreateNode(uint32_t offset, uint32_t size)
+{
+    uint32_t node;
+    if (unused_nodes_.empty()) {
+        node = static_cast<uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+    } else {
+        node = unused_nodes_.back();
+        unused_nodes_.pop_back();
+        nodes_[node] = Node();
+    }
+    nodes_[node].offset = offset;
+    nodes_[node].size = size;
+    return node;
+}
+
+void TlsfAllocator::ReleaseNode(uint32_t node)
+{
+    unused_nodes_.push_back(node);
+}
+
+void TlsfAllocator::InsertFreeBlock(uint32_t node)
+{
+    uint32_t first_level;
+    uint32_t second_level;
+    Mapping(nodes_[node].size, &first_level, &second_level);
+    uint32_t& head =
+        free_heads_[first_level * SECOND_LEVEL_COUNT + second_level];
+
+    nodes_[node].is_free = true;
+    nodes_[node].prev_free = INVALID_NODE;
+    nodes_[node].next_free = head;
+    if (head != INVALID_NODE) {
+        nodes_[head].prev_free = node;
+    }
+    head = node;
+
+    first_level_bitmap_ |= 1u << first_level;
+    second_level_bitmaps_[first_level] |= 1u << second_level;
+}
+
+void TlsfAllocator::RemoveFreeBlock(uint32_t node)
+{
+    uint32_t first_level;
+    uint32_t second_level;
+    Mapping(nodes_[node].size, &first_level, &second_level);
+    uint32_t& head =
+        free_heads_[first_level * SECOND_LEVEL_COUNT + second_level];
+
+    const Node& n = nodes_[node];
+    if (n.prev_free != INVALID_NODE) {
+        nodes_[n.prev_free].next_free = n.next_free;
+    } else {
+        head = n.next_free;
+    }
+    if (n.next_free != INVALID_NODE) {
+        nodes_[n.next_free].prev_free = n.prev_free;
+    }
+    nodes_[node].is_free = false;
+
+    if (head == INVALID_NODE) {
+        second_level_bitmaps_[first_level] &= ~(1u << second_level);
+        if (second_level_bitmaps_[first_level] == 0) {
+            first_level_bitmap_ &= ~(1u << first_level);
+        }
+    }
+}
+
+uint32_t TlsfAllocator::FindFreeBlock(uint32_t first_level,
+                                      uint32_t second_level) const
+{
+    uint32_t second_level_map =
+        second_level_bitmaps_[first_level] & (~0u << second_level);
+    if (second_level_map == 0) {
+        // Any block of a larger power of two fits
+        const uint32_t first_level_map =
+            first_level + 1 < FIRST_LEVEL_COUNT
+                ? first_level_bitmap_ & (~0u << (first_level + 1))
+                : 0;
+        if (first_level_map == 0) {
+            return INVALID_NODE;
+        }
+        first_level = FindFirstSet(first_level_map);
+        second_level_map = second_level_bitmaps_[first_level];
+    }
+    second_level = FindFirstSet(second_level_map);
+    return free_heads_[first_level * SECOND_LEVEL_COUNT + second_level];
+}
+
+}  // namespace tamarindo
@@ -0,0 +1,131 @@
+/*
+ Copyright 2023 Emmanuel Arias Soto
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      https://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#ifndef ENGINE_LIB_UTILS_TLSF_ALLOCATOR_H_
+#define ENGINE_LIB_UTILS_TLSF_ALLOCATOR_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace tamarindo
+{
+
+// Two-level segregated fit allocator of ranges, in whatever unit the caller
+// picks, such as vertices or indices. It only hands out offsets, the memory
+// usually lives in a GPU buffer.
+//
+// Free blocks are kept in lists by size class: the first level is the power
+// of two of the size, and the second level splits every power of two in
+// SECOND_LEVEL_COUNT linear steps. Bitmaps of the non-empty lists find a
+// block in a class at least as large as the request with two bit scans, so
+// allocating and freeing take constant time. Freed blocks merge with their
+// free neighbors right away.
+class TlsfAllocator
+{
+   public:
+    static constexpr uint32_t SECOND_LEVEL_BITS = 3;
+    static constexpr uint32_t SECOND_LEVEL_COUNT = 1 << SECOND_LEVEL_BITS;
+    static constexpr uint32_t FIRST_LEVEL_COUNT = 32 - SECOND_LEVEL_BITS + 1;
+
+    static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+    static constexpr uint32_t INVALID_NODE = UINT32_MAX;
+
+    struct Allocation {
+        uint32_t offset = INVALID_OFFSET;
+        // Internal block, needed to free the allocation
+        uint32_t node = INVALID_NODE;
+
+        inline bool IsValid() const { return offset != INVALID_OFFSET; }
+    };
+
+    TlsfAllocator() = delete;
+    explicit TlsfAllocator(uint32_t size);
+    ~TlsfAllocator() = default;
+
+    // Returns an invalid allocation if there is no free block large enough
+    Allocation Allocate(uint32_t size);
+
+    // Allocates `size` units at the lowest offset of a free block where they
+    // end at or before `limit`, for moving data down. Walks the blocks in
+    // address order, so it takes linear time unlike Allocate().
+    Allocation AllocateBelow(uint32_t size, uint32_t limit);
+
+    void Free(const Allocation& allocation);
+
+    // Allocation with the highest offset below `limit`, invalid if there is
+    // none. Walks the blocks down from the end of the range.
+    Allocation LastAllocationBelow(uint32_t limit) const;
+
+    // Allocation right before `allocation` in the range, invalid if it is
+    // the first. Free neighbors are always merged, so this takes at most
+    // two steps.
+    Allocation PreviousAllocation(const Allocation& allocation) const;
+
+    // Adds free space at the end of the range, for when the memory behind
+    // it grows. `new_size` can not be smaller than size().
+    void Grow(uint32_t new_size);
+
+    uint32_t AllocationSize(const Allocation& allocation) const;
+
+    inline uint32_t size() const { return size_; }
+    inline uint32_t used_size() const { return used_size_; }
+    inline uint32_t free_size() const { return size_ - used_size_; }
+    inline uint32_t allocation_count() const { return allocation_count_; }
+
+   private:
+    struct Node {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        // Neighbors in the range
+        uint32_t prev_physical = INVALID_NODE;
+        uint32_t next_physical = INVALID_NODE;
+        // Neighbors in the free list of the size class
+        uint32_t prev_free = INVALID_NODE;
+        uint32_t next_free = INVALID_NODE;
+        bool is_free = false;
+    };
+
+    // Takes the first `size` units of the free `node`, the rest stays free
+    Allocation AllocateFromBlock(uint32_t node, uint32_t size);
+
+    uint32_t CreateNode(uint32_t offset, uint32_t size);
+    void ReleaseNode(uint32_t node);
+
+    void InsertFreeBlock(uint32_t node);
+    void RemoveFreeBlock(uint32_t node);
+
+    // First free block in the class of `size` or above, INVALID_NODE if
+    // there is none
+    uint32_t FindFreeBlock(uint32_t first_level, uint32_t second_level) const;
+
+    uint32_t size_;
+    uint32_t used_size_ = 0;
+    uint32_t allocation_count_ = 0;
+
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> unused_nodes_;
+    // Blocks at the start and at the end of the range
+    uint32_t first_node_ = INVALID_NODE;
+    uint32_t last_node_ = INVALID_NODE;
+
+    uint32_t first_level_bitmap_ = 0;
+    uint32_t second_level_bitmaps_[FIRST_LEVEL_COUNT] = {};
+    uint32_t free_heads_[FIRST_LEVEL_COUNT * SECOND_LEVEL_COUNT];
+};
+
+}  // namespace tamarindo
+
+#endif  // ENGINE_LIB_UTILS_TLSF_ALLOCATOR_H_